@@ -3,6 +3,9 @@
  * Layout:
  *   Row 1: Format | Copy | Verify | Quit
  *   Row 2: Read ADF | Write ADF | Verify ADF | About
+ *   Row 3: Queue Job | Run Queue | Remove Job | Clear Queue
+ *   Row 4: Station | Make Patch | Apply Patch | Benchmark
+ *   Row 5: Session | Profiles  (+ job list below)
  *
  * Changes in v7c:
  *   - Format now has 3 modalità:
@@ -18,6 +21,7 @@
 #include <exec/ports.h>
 #include <exec/io.h>
 #include <devices/trackdisk.h>
+#include <devices/timer.h>
 
 #include <intuition/intuition.h>
 #include <graphics/gfxbase.h>
@@ -31,6 +35,7 @@
 #include <proto/gadtools.h>
 #include <proto/asl.h>
 #include <proto/dos.h>
+#include <proto/timer.h>
 
 
 #ifndef CMD_FORMAT
@@ -42,6 +47,16 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "fthash.h"
+#include "ftgz.h"
+#include "ftdms.h"
+#include "ftdat.h"
+#include "ftpatch.h"
+#include "ftkern.h"
+#include "fttrace.h"
+#include "ftboot.h"
+#include "ftpack.h"
+
 #define APP_NAME "FloppyTool"
 #define APP_VER  "v7s"
 
@@ -50,17 +65,24 @@ struct IntuitionBase *IntuitionBase = NULL;
 struct GfxBase       *GfxBase       = NULL;
 struct Library       *GadToolsBase  = NULL;
 struct Library       *AslBase       = NULL;
+struct Device        *TimerBase     = NULL;   /* while a benchmark, trace or motor-off timer runs */
 extern struct DosLibrary *DOSBase;
+static struct timerequest *gTraceTimer = NULL; /* E-clock for the trace ring */
+static struct timerequest *gMotorTimer = NULL; /* polls delayed motor-offs once a second */
+static BOOL gMotorArmed = FALSE;               /* gMotorTimer request outstanding */
 
 /* ----- Gadget IDs (main) ----- */
 enum {
   GID_FORMAT=1, GID_COPY, GID_VERIFY, GID_QUIT,
-  GID_READADF, GID_WRITEADF, GID_VERIFYADF, GID_ABOUT
+  GID_READADF, GID_WRITEADF, GID_VERIFYADF, GID_ABOUT,
+  GID_QADD, GID_QRUN, GID_QDEL, GID_QCLEAR, GID_QLIST,
+  GID_STATION, GID_MKPATCH, GID_APPATCH, GID_BENCH,
+  GID_SESSION, GID_PROFILES
 };
 
 /* ----- Window size & layout ----- */
 #define WIN_W  500
-#define WIN_H 168
+#define WIN_H 294
 
 /* Gadget row layout */
 #define GAD_LEFT   12
@@ -69,9 +91,16 @@ enum {
 #define GAD_GAP    12
 #define ROW1_Y 10
 #define ROW2_Y (ROW1_Y + GAD_H + 8)
+#define ROW3_Y (ROW2_Y + GAD_H + 8)
+#define ROW4_Y (ROW3_Y + GAD_H + 8)
+#define ROW5_Y (ROW4_Y + GAD_H + 8)
+
+/* Job queue list under the rows (4 lines) */
+#define QLIST_Y (ROW5_Y + GAD_H + 4)
+#define QLIST_H 44
 
 /* ASCII banner area between rows and log */
-#define ASCII_Y (ROW2_Y + GAD_H + 10)
+#define ASCII_Y (QLIST_Y + QLIST_H + 6)
 #define ASCII_H 26  /* tight 3-line banner */
 
 /* Log, progress, status */
@@ -89,6 +118,14 @@ enum {
 #define TRACK_SIZE  (SECTORS*BYTES_PER_SECTOR)  /* 5632 bytes */
 #define DISK_SIZE   (TRACKS*TRACK_SIZE)         /* 901120 bytes */
 #define TOTAL_SECTORS (TRACKS*SECTORS)          /* 1760 */
+#define ROOT_BLOCK  880                         /* OFS/FFS root on DD */
+#define ROOT_TRACK  (ROOT_BLOCK/SECTORS)        /* 80, sector 0 */
+#define ROOT_NAME_OFS 432                       /* BCPL volume name */
+
+/* Recovery engine: raw MFM track (one revolution + one sector of slack) */
+#define RAW_TRACK_SIZE  0x3500                  /* 13568 bytes, CHIP RAM */
+#define RAW_SECTOR_LONGS 270                    /* info+label+sums+data */
+#define MAX_REREADS     10
 
 /* ----- UI state ----- */
 struct AppUI {
@@ -105,6 +142,18 @@ struct AppUI {
   struct Gadget *gadVerifyADF;
   struct Gadget *gadAbout;
 
+  struct Gadget *gadQAdd;
+  struct Gadget *gadQRun;
+  struct Gadget *gadQDel;
+  struct Gadget *gadQClear;
+  struct Gadget *gadQList;
+  struct Gadget *gadStation;
+  struct Gadget *gadMkPatch;
+  struct Gadget *gadApPatch;
+  struct Gadget *gadBench;
+  struct Gadget *gadSession;
+  struct Gadget *gadProfiles;
+
   char logbuf[2][120];
   int  logcount;
 } ui;
@@ -112,6 +161,20 @@ struct AppUI {
 /* Last drawn status/progress */
 static char  gStatus[128] = "";
 static ULONG gProgDone = 0, gProgTotal = 0;
+static ULONG gProgPart[4];                     /* per-unit bars, gProgParts > 0 */
+static UBYTE gProgParts = 0;
+
+/* Bad-sector map of the last read/verify/copy (filled by the recovery pass) */
+static struct BadMap gBad;
+
+/* Trace event names, by gadget ID */
+static const char *const gidName[] = {
+  "", "Format", "Copy", "Verify", "Quit",
+  "Read ADF", "Write ADF", "Verify ADF", "About",
+  "Queue Add", "Queue Run", "Queue Remove", "Queue Clear", "Queue List",
+  "Station", "Make Patch", "Apply Patch", "Benchmark",
+  "Session", "Profiles"
+};
 
 
 /* ----- Prototypes ----- */
@@ -125,6 +188,7 @@ static void CloseUI(void);
 
 static void DrawStatus(const char *msg);
 static void DrawProgress(ULONG done, ULONG total);
+static void DrawProgressParts(const ULONG *done, UBYTE parts, ULONG total);
 static void ClearProgress(void);
 static void DrawFrame(struct RastPort *rp, WORD x, WORD y, WORD w, WORD h);
 static void DrawLog(void);
@@ -141,10 +205,23 @@ static void DoVerifyADF(void);
 static void DoAbout(void);
 
 static BOOL AskFloppyUnit(UBYTE *unitOut, CONST_STRPTR action);
+static BOOL AskSwap(CONST_STRPTR which);
 typedef enum { FMT_CANCEL=0, FMT_QUICK_OS=1, FMT_FULL_OS=2, FMT_DEEP=3 } FormatMode;
 static FormatMode AskFormatMode(void);
+static LONG AskWriteMode(void);
 static BOOL AskVolumeName(char *outName, int maxlen, CONST_STRPTR defName);
 
+/* Requester-free runners (shared by the buttons and the job queue) */
+static BOOL RunFormat(UBYTE unit, FormatMode mode, CONST_STRPTR volname);
+static BOOL RunVerify(UBYTE unit);
+static BOOL RunTriage(UBYTE unit, UBYTE *verdictOut);
+static void DoTriage(UBYTE unit);
+static BOOL RunCopy(UBYTE src, UBYTE dst);
+static BOOL RunReadADF(UBYTE unit, CONST_STRPTR path, BOOL resume);
+#define WRITE_VERIFY 1                 /* read back and check every track */
+#define WRITE_FORMAT 2                 /* TD_FORMAT with the image data (one pass on blanks) */
+static BOOL RunWriteADF(UBYTE unit, CONST_STRPTR path, UBYTE mode);
+
 /* ASL helpers (used by Write/Verify ADF) */
 static BOOL PathSplit(CONST_STRPTR in, char *drawerOut, int dsz, char *fileOut, int fsz);
 static BOOL ASL_OpenFile(char *outPath, int maxlen, CONST_STRPTR title, CONST_STRPTR defPath);
@@ -154,37 +231,327 @@ static BOOL RawWritePass(UBYTE unit);
 static BOOL RawVerify(UBYTE unit);
 static BOOL RawCopyTwoDrives(UBYTE srcUnit, UBYTE dstUnit);
 static BOOL RawCopyOneDrive(UBYTE unit);
-static BOOL ADF_ReadFromDrive(UBYTE unit, CONST_STRPTR path);
-static BOOL ADF_WriteToDrive(UBYTE unit, CONST_STRPTR path);
+static BOOL ADF_ReadFromDrive(UBYTE unit, CONST_STRPTR path, BOOL resume);
+static BOOL ADF_WriteToDrive(UBYTE unit, CONST_STRPTR path, UBYTE mode);
 static BOOL OpenTD(UBYTE unit, struct MsgPort **pp, struct IOExtTD **pio);
 static void CloseTD(struct MsgPort *p, struct IOExtTD *io);
 static void SetFloppyMotor(UBYTE unit, BOOL on);
 
+/* Recovery engine (deferred second pass over failed tracks) */
+typedef enum { SEC_OK=0, SEC_REREAD, SEC_VOTED, SEC_WEAK, SEC_DEAD } SectorState;
+struct BadMap {
+  UBYTE state[TOTAL_SECTORS];          /* SectorState per sector */
+  UBYTE failed[TRACKS];                /* 1 = failed on first pass */
+  ULONG nFailed;                       /* tracks failed on first pass */
+  ULONG nBad;                          /* sectors left WEAK/DEAD */
+};
+struct RecoverCtx {
+  UBYTE *raw;                          /* CHIP buffer for TD_RAWREAD */
+  UBYTE *cand;                         /* rereads * TRACK_SIZE decoded copies */
+  UBYTE  have[MAX_REREADS][SECTORS];
+  ULONG  dsum[MAX_REREADS][SECTORS];   /* stored data checksum per copy */
+  UBYTE  rereads;
+};
+static void  BadMap_Init(struct BadMap *bm);
+static void  BadMap_FailTrack(struct BadMap *bm, ULONG t);
+static BOOL  BadMap_Save(const struct BadMap *bm, CONST_STRPTR adfPath);
+static BOOL  BadMap_Load(struct BadMap *bm, CONST_STRPTR adfPath);
+static UBYTE Recover_AskRereads(ULONG nTracks);
+static BOOL  Recover_Start(struct RecoverCtx *rc, struct BadMap *bm);
+static void  Recover_Close(struct RecoverCtx *rc);
+static ULONG Recover_Track(struct RecoverCtx *rc, struct IOExtTD *io, ULONG t, UBYTE *dst, struct BadMap *bm);
+static ULONG Recover_DecodeRaw(struct RecoverCtx *rc, ULONG a, ULONG t);
+
+/* Capture journal (<adf>.ftj, resumable ADF reads) */
+#define JRN_NONE 0
+#define JRN_OK   1
+#define JRN_BAD  2                     /* stored with bad sectors: redone on resume */
+#define JRN_MAX_SIZE 8192
+struct Journal {
+  UBYTE state[TRACKS];
+  ULONG crc[TRACKS];                   /* CRC32 of the track as written */
+  BPTR  fh;
+};
+static BOOL  Journal_Load(struct Journal *j, CONST_STRPTR adfPath);
+static BOOL  Journal_Create(struct Journal *j, CONST_STRPTR adfPath, UBYTE unit);
+static void  Journal_Add(struct Journal *j, ULONG t, ULONG crc, BOOL bad);
+static void  Journal_Close(struct Journal *j);
+static ULONG Journal_Verify(struct Journal *j, BPTR fh, UBYTE *buf, ULONG *imageCrc);
+static BOOL  ADF_PadFile(BPTR fh, UBYTE *zero);
+static ULONG Resume_PrevBad(const struct Journal *j, const struct BadMap *prev, ULONG t);
+
+/* Image source: raw .adf, gzip .adz or .dms (detected by magic), read sequentially */
+#define ADZ_LEVEL 3                    /* short chains: deflate keeps up with the drive on a 68000 */
+
+/* Disk image in RAM, track by track: empty, shared with an identical
+   earlier track, ByteRun1 (ftpack.h) or as is. Unpacked on the fly. */
+struct PackImg {
+  UBYTE *trk[TRACKS];                  /* NULL = all zeros */
+  UWORD  len[TRACKS];                  /* bytes at trk; TRACK_SIZE = not packed */
+  UBYTE  kind[TRACKS];                 /* PACK_* */
+  ULONG  crc[TRACKS];
+  ULONG  used;                         /* bytes allocated */
+};
+#define PACK_NONE   0                  /* not stored (reads as zeros) */
+#define PACK_EMPTY  1
+#define PACK_DUP    2                  /* trk belongs to another track */
+#define PACK_RUN1   3
+#define PACK_RAW    4
+#define PACK_RESERVE (64*1024)         /* AvailMem a one-drive copy leaves free */
+static BOOL Pack_Put(struct PackImg *pi, ULONG t, const UBYTE *buf, UBYTE *tmp);
+static BOOL Pack_Get(const struct PackImg *pi, ULONG t, UBYTE *buf);
+static void Pack_Free(struct PackImg *pi);
+static void Pack_Log(const struct PackImg *pi, CONST_STRPTR what);
+
+struct ImgSrc {
+  BPTR         fh;
+  struct GzIn *gz;                     /* .adz */
+  struct DmsIn *dms;                   /* .dms (both NULL = raw ADF) */
+  LONG         size;                   /* uncompressed bytes (gzip ISIZE for .adz) */
+  LONG         packed;                 /* file size on disk */
+  LONG         pos;                    /* image bytes read so far */
+  const struct PackImg *mem;           /* cache hit: image in RAM, no file */
+  UBYTE       *memBuf;                 /* its track last unpacked, for partial reads */
+  LONG         memTrack;
+  struct CacheEnt *fill;               /* cache miss: entry filled as tracks are read */
+  BOOL         stream;                 /* cannot seek: size -1 until the end (.dms: DISK_SIZE) */
+  UBYTE        peek[4], npeek, peekPos;  /* magic bytes a stream gave up, read again first */
+};
+
+/* Write ADF from a raw stream: async reads into a ring of tracks */
+#define STREAM_RING 8                  /* tracks a stream may run ahead of the drive */
+struct StreamRing {
+  BPTR   fh;
+  struct MsgPort *port;                /* ACTION_READ replies */
+  struct DosPacket *dp;
+  UBYTE *buf;                          /* STREAM_RING tracks */
+  ULONG  in;                           /* bytes received */
+  BOOL   pending, eof, err, more;
+};
+static struct StreamRing *Stream_Open(struct ImgSrc *src);
+static void Stream_Close(struct StreamRing *st);
+
+/* Resident image cache for Write ADF: decoded images keyed by the file's
+   full path, size and date, most recently used first */
+#define CACHE_MAX      8                /* images */
+#define CACHE_RESERVE  (256*1024)       /* AvailMem left over while caching */
+struct CacheEnt {
+  struct Node node;                    /* ln_Name = path */
+  char   path[256];
+  LONG   packed;
+  struct DateStamp date;
+  struct PackImg img;
+  UBYTE *stage;                        /* while filling: track being assembled + packing buffer */
+};
+static struct {
+  struct List lru;
+  ULONG count, hits, misses;
+} gCache;
+static BOOL Cache_Open(struct ImgSrc *src, CONST_STRPTR path);
+static void Cache_Fill(struct ImgSrc *src, const UBYTE *buf, LONG n);
+static void Cache_Discard(struct ImgSrc *src);
+static void Cache_Keep(struct ImgSrc *src);
+static void Cache_Free(void);
+
+static BOOL Img_Open(struct ImgSrc *src, CONST_STRPTR path);
+static LONG Img_Read(struct ImgSrc *src, UBYTE *buf, LONG len);
+static BOOL Img_End(struct ImgSrc *src);
+static void Img_Close(struct ImgSrc *src);
+static const char *Img_Error(const struct ImgSrc *src);
+static void Img_Report(const struct ImgSrc *src);
+static LONG Img_Hash(struct ImgSrc *src, ULONG *crcOut, UBYTE *md5Out, UBYTE *sha1Out, char *label, UBYTE *boot);
+static BOOL IsAdzPath(CONST_STRPTR path);
+static LONG Gz_DosRead(void *h, UBYTE *buf, LONG len);
+static LONG Img_FileRead(void *h, UBYTE *buf, LONG len);
+static BOOL ADZ_ReadFromDrive(UBYTE unit, CONST_STRPTR path);
+
+/* Known-dump lookup (index built by host/datindex.c) */
+#define DAT_INDEX "PROGDIR:FloppyTool.fdx"
+static void Dat_Identify(const UBYTE *sha1, const UBYTE *md5, ULONG crc);
+
+/* Bootblock check (signatures built by host/bootsig.c) */
+#define BOOT_DB "PROGDIR:FloppyTool.bbd"
+static char gBootAlert[48];                    /* virus named by the last Boot_Report */
+static void Boot_Report(const UBYTE *bb);
+static void Boot_Alert(void);
+static BOOL Boot_Confirm(void);
+static void Boot_Free(void);
+
+/* Job queue: operations run in order, persisted in PROGDIR: */
+typedef enum { JOB_READ=0, JOB_WRITE, JOB_COPY, JOB_VERIFY, JOB_FORMAT, JOB_KINDS } JobKind;
+typedef enum { JS_QUEUED=0, JS_RUNNING, JS_OK, JS_FAILED } JobState;
+#define MAX_JOBS   64
+#define QUEUE_FILE "PROGDIR:FloppyTool.queue"
+struct Job {
+  struct Node node;                    /* ln_Name = label, shown in the list */
+  UBYTE kind, unit, arg, state;        /* arg: copy dst unit, FormatMode, read 1 = .adz, write 1 = verify */
+  ULONG ticks;                         /* run time, 1/50 s */
+  char  path[256];                     /* write: image; format: volume name */
+  char  label[100];
+};
+static struct List gJobs;
+static ULONG gJobCount = 0;
+static LONG  gJobSel = -1;             /* list selection, for Remove Job */
+static BOOL  gQueueRunning = FALSE;    /* unattended: no requesters mid-job */
+static void  Queue_Free(void);
+static BOOL  Queue_Load(void);
+static void  DoQueueAdd(void);
+static void  DoQueueRun(void);
+static void  DoQueueRemove(void);
+static void  DoQueueClear(void);
+
+/* Duplication station (disk-change driven, resident source image) */
+#define STATION_UNITS 4
+struct StationUnit {
+  struct MsgPort   *port, *cport;
+  struct IOExtTD   *io, *cio;          /* work request / held TD_ADDCHANGEINT */
+  struct Interrupt  irq;
+  ULONG changeNum;                     /* last TD_CHANGENUM seen */
+  ULONG ok, fail;
+  BOOL  armed;
+};
+static struct Task *gStationTask = NULL;
+static BYTE  gStationSigBit = -1;
+static void  DoStation(void);
+static UBYTE AskUnitMask(CONST_STRPTR what, UBYTE exclude);
+
+/* Multi-unit capture (one ADF per unit, all units in flight) */
+#define MULTI_UNITS 4
+struct CapUnit {
+  struct MsgPort *port;
+  struct IOExtTD *io;
+  BPTR   fh;
+  UBYTE *buf;                          /* two tracks: one in flight, one being written */
+  struct BadMap *bad;
+  char   path[300];
+  ULONG  next;                         /* track of the request in flight */
+  ULONG  done;                         /* tracks written */
+  BOOL   busy, ok;
+};
+static void  DoCaptureMulti(void);
+
+/* Track/sector patches (.adp, see ftpatch.h) */
+static void  DoMakePatch(void);
+static void  DoApplyPatch(void);
+
+/* Drive benchmark (timer.device), one history line per run in PROGDIR: */
+#define BENCH_FILE      "PROGDIR:FloppyTool.bench"
+#define BENCH_TURNS     10                     /* index-to-index periods timed */
+#define BENCH_STEPS     20                     /* single-cylinder seeks timed */
+#define BENCH_STROKES   6                      /* 0 <-> 79 seeks timed */
+#define BENCH_RAW_STEP  4                      /* raw sector check on every 4th track */
+#define BENCH_RPM_SPEC  45                     /* rpm x10: 300 +/- 1.5% */
+#define BENCH_RPM_DRIFT 30                     /* rpm x10 away from the baseline */
+#define BENCH_WEAK_PM   5                      /* weak sectors per mille over the baseline */
+#define BENCH_KERN_US   250000                 /* E-clock time per CPU kernel loop */
+struct BenchResult {
+  ULONG days;                                  /* DateStamp day of the run */
+  ULONG rotUs, stepUs, strokeUs;               /* rotation, track-to-track, full stroke */
+  ULONG readBps;                               /* sustained CMD_READ */
+  ULONG weakPm;                                /* sectors failing one raw read, per mille */
+  ULONG readErr;                               /* cylinders CMD_READ could not read */
+};
+static void  DoBenchmark(void);
+
+/* Capture session: output drawer, naming template, catalogue */
+#define SESSION_CAT       "FloppyTool.catalog"
+#define SESSION_TPL_DEF   "DF%u_%n"            /* the old RAM:DF<u>_<n>.adf names */
+#define SESSION_BUCKETS   64
+#define SESSION_EXALL_BUF 2048
+#define SESSION_MAX_N     10000
+struct SessName { struct SessName *next; char name[1]; };
+static struct {
+  BOOL  open;
+  char  dir[256];
+  char  tpl[64];
+  ULONG counter;                               /* next %n to try */
+  ULONG names, captures;
+  struct SessName *bucket[SESSION_BUCKETS];    /* names present in dir */
+} gSess;
+/* Hashes of a session capture, fed in track order as tracks become final */
+static struct {
+  BOOL  on;
+  ULONG next;                                  /* tracks hashed so far */
+  ULONG crc;
+  struct Md5  md5;
+  struct Sha1 sha1;
+  char  label[32];
+} gCap;
+static void  Session_Free(void);
+static void  Session_Release(CONST_STRPTR name);
+static void  Capture_Hash(ULONG t, const UBYTE *buf);
+static BOOL  Session_Capture(UBYTE unit, BOOL adz);
+static void  Root_Label(const UBYTE *blk, char *out);
+static void  DoSession(void);
+
+/* Per-drive tuning and calibration, kept in ENV:/ENVARC: */
+#define PROF_VAR        "FloppyTool/DF%u"
+#define PROF_TEXT_MAX   160
+#define PROF_MAX_RETRY  10
+#define PROF_CAL_TRACK  (TRACKS-2)             /* calibration writes cylinder 79, head 0 */
+#define PROF_CAL_WRITES 8
+#define PROF_CAL_READ   40                     /* tracks read per transfer-size test */
+enum { PROF_FMT_UNKNOWN=0, PROF_FMT_YES, PROF_FMT_NO };
+struct DriveProfile {
+  UBYTE retry0, retry;                         /* write+verify attempts: track 0 / others */
+  UBYTE xfer;                                  /* tracks per read request (1, 2) */
+  UBYTE motorOff;                              /* seconds the motor spins on after an op */
+  UBYTE format;                                /* CMD_FORMAT usable: PROF_FMT_* */
+  ULONG rpm10, stepUs;                         /* last benchmark */
+  ULONG calDays;                               /* day of the last calibration, 0 = never */
+};
+static struct DriveProfile gProf[4];
+static ULONG gMotorOff[4];                     /* StampTicks deadline, 0 = none */
+static void  Prof_Load(void);
+static BOOL  Prof_Save(UBYTE unit);
+static void  Motor_Release(UBYTE unit);
+static void  Motor_Tick(BOOL all);
+static ULONG Motor_Signal(void);
+static void  Motor_Poll(void);
+static void  Motor_Close(void);
+static void  DoProfiles(void);
+
 /* helpers */
 static BOOL HasFile(CONST_STRPTR path);
-static BOOL GenUniqueAdfPath(UBYTE unit, char *out, int maxlen);
 
-/* CRC32 */
-static ULONG crc32_init(void);
-static ULONG crc32_update(ULONG crc, const UBYTE *buf, ULONG len);
-static ULONG crc32_final(ULONG crc);
+/* Traced system calls (see Trace section) */
+static void Trace_Start(void);
+static void Trace_Stop(void);
+static BYTE Trace_DoIO(struct IORequest *r);
+static void Trace_SendIO(struct IORequest *r);
+static BYTE Trace_WaitIO(struct IORequest *r);
+static LONG Trace_Read(BPTR fh, APTR buf, LONG len);
+static LONG Trace_Write(BPTR fh, APTR buf, LONG len);
+static LONG Trace_EasyRequest(struct Window *w, struct EasyStruct *es, ULONG *idcmp, APTR args);
+static BOOL Trace_AslRequest(struct FileRequester *fr);
 
 /* ========================= MAIN ========================= */
 
 int main(void) {
+  NewList(&gJobs);
+  NewList(&gCache.lru);
   if (!OpenLibs()) return 20;
+  Prof_Load();
+  Queue_Load();
   if (!OpenUI())   { CloseAll(); return 10; }
+  Trace_Start();
 
   DrawStatus("Ready.");
   ClearProgress();
   LogClear();
   DrawAsciiBanner();
+  if (gJobCount) {
+    char m[64]; sprintf(m, "%lu queued job(s) restored.", (unsigned long)gJobCount);
+    LogAdd(m);
+  }
 
   BOOL running = TRUE;
   ULONG sigmask = 1UL << ui.win->UserPort->mp_SigBit;
 
   while (running) {
-    ULONG sigs = Wait(sigmask);
+    ULONG motorSig = Motor_Signal();
+    ULONG sigs = Wait(sigmask | motorSig);
+    if (sigs & motorSig) Motor_Poll();
     if (sigs & sigmask) {
       struct IntuiMessage *imsg;
       while ((imsg = GT_GetIMsg(ui.win->UserPort)) != NULL) {
@@ -196,6 +563,8 @@ int main(void) {
         switch (cls) {
           case IDCMP_GADGETUP: {
             struct Gadget *gad = (struct Gadget *)iad;
+            const char *op = (gad->GadgetID < sizeof(gidName)/sizeof(gidName[0])) ? gidName[gad->GadgetID] : "Gadget";
+            TRACE_BEGIN("op", op);
             switch (gad->GadgetID) {
               case GID_FORMAT:    DoFormatFloppy(); break;
               case GID_COPY:      DoCopyFloppy();   break;
@@ -206,7 +575,20 @@ int main(void) {
               case GID_WRITEADF:  DoWriteADF();     break;
               case GID_VERIFYADF: DoVerifyADF();    break;
               case GID_ABOUT:     DoAbout();        break;
+
+              case GID_QADD:      DoQueueAdd();     break;
+              case GID_QRUN:      DoQueueRun();     break;
+              case GID_QDEL:      DoQueueRemove();  break;
+              case GID_QCLEAR:    DoQueueClear();   break;
+              case GID_QLIST:     gJobSel = (LONG)code; break;
+              case GID_STATION:   DoStation();      break;
+              case GID_MKPATCH:   DoMakePatch();    break;
+              case GID_APPATCH:   DoApplyPatch();   break;
+              case GID_BENCH:     DoBenchmark();    break;
+              case GID_SESSION:   DoSession();      break;
+              case GID_PROFILES:  DoProfiles();     break;
             }
+            TRACE_END("op", op);
           } break;
 
           case IDCMP_REFRESHWINDOW:
@@ -265,7 +647,7 @@ static BOOL OpenUI(void) {
     WA_Activate,    TRUE,
     WA_SimpleRefresh, TRUE,
     WA_GimmeZeroZero, TRUE,
-    WA_IDCMP,       IDCMP_GADGETUP | IDCMP_CLOSEWINDOW | IDCMP_REFRESHWINDOW | IDCMP_VANILLAKEY,
+    WA_IDCMP,       IDCMP_GADGETUP | IDCMP_CLOSEWINDOW | IDCMP_REFRESHWINDOW | IDCMP_VANILLAKEY | LISTVIEWIDCMP,
     TAG_END
   );
   if (!ui.win) return FALSE;
@@ -283,6 +665,7 @@ static BOOL OpenUI(void) {
   const UWORD left = GAD_LEFT;
   const UWORD top1 = ROW1_Y;
   const UWORD top2 = ROW2_Y;
+  const UWORD top3 = ROW3_Y;
   const UWORD w    = GAD_W;
   const UWORD h    = GAD_H;
   const UWORD gap  = GAD_GAP;
@@ -341,6 +724,83 @@ static BOOL OpenUI(void) {
   ui.gadAbout = CreateGadget(BUTTON_KIND, ui.gadVerifyADF, &ng, TAG_END);
   if (!ui.gadAbout) return FALSE;
 
+  /* Row 3: Queue Job | Run Queue | Remove Job | Clear Queue */
+  ng.ng_LeftEdge  = left;
+  ng.ng_TopEdge   = top3;
+  ng.ng_GadgetText= (UBYTE*)"Queue Job...";
+  ng.ng_GadgetID  = GID_QADD;
+  ui.gadQAdd = CreateGadget(BUTTON_KIND, ui.gadAbout, &ng, TAG_END);
+  if (!ui.gadQAdd) return FALSE;
+
+  ng.ng_LeftEdge  = left + (w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Run Queue";
+  ng.ng_GadgetID  = GID_QRUN;
+  ui.gadQRun = CreateGadget(BUTTON_KIND, ui.gadQAdd, &ng, TAG_END);
+  if (!ui.gadQRun) return FALSE;
+
+  ng.ng_LeftEdge  = left + 2*(w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Remove Job";
+  ng.ng_GadgetID  = GID_QDEL;
+  ui.gadQDel = CreateGadget(BUTTON_KIND, ui.gadQRun, &ng, TAG_END);
+  if (!ui.gadQDel) return FALSE;
+
+  ng.ng_LeftEdge  = left + 3*(w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Clear Queue";
+  ng.ng_GadgetID  = GID_QCLEAR;
+  ui.gadQClear = CreateGadget(BUTTON_KIND, ui.gadQDel, &ng, TAG_END);
+  if (!ui.gadQClear) return FALSE;
+
+  /* Row 4: Station | Make Patch | Apply Patch | Benchmark */
+  ng.ng_LeftEdge  = left;
+  ng.ng_TopEdge   = ROW4_Y;
+  ng.ng_GadgetText= (UBYTE*)"Station...";
+  ng.ng_GadgetID  = GID_STATION;
+  ui.gadStation = CreateGadget(BUTTON_KIND, ui.gadQClear, &ng, TAG_END);
+  if (!ui.gadStation) return FALSE;
+
+  ng.ng_LeftEdge  = left + (w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Make Patch...";
+  ng.ng_GadgetID  = GID_MKPATCH;
+  ui.gadMkPatch = CreateGadget(BUTTON_KIND, ui.gadStation, &ng, TAG_END);
+  if (!ui.gadMkPatch) return FALSE;
+
+  ng.ng_LeftEdge  = left + 2*(w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Apply Patch...";
+  ng.ng_GadgetID  = GID_APPATCH;
+  ui.gadApPatch = CreateGadget(BUTTON_KIND, ui.gadMkPatch, &ng, TAG_END);
+  if (!ui.gadApPatch) return FALSE;
+
+  ng.ng_LeftEdge  = left + 3*(w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Benchmark...";
+  ng.ng_GadgetID  = GID_BENCH;
+  ui.gadBench = CreateGadget(BUTTON_KIND, ui.gadApPatch, &ng, TAG_END);
+  if (!ui.gadBench) return FALSE;
+
+  /* Row 5: Session | Profiles */
+  ng.ng_LeftEdge  = left;
+  ng.ng_TopEdge   = ROW5_Y;
+  ng.ng_GadgetText= (UBYTE*)"Session...";
+  ng.ng_GadgetID  = GID_SESSION;
+  ui.gadSession = CreateGadget(BUTTON_KIND, ui.gadBench, &ng, TAG_END);
+  if (!ui.gadSession) return FALSE;
+
+  ng.ng_LeftEdge  = left + (w+gap);
+  ng.ng_GadgetText= (UBYTE*)"Profiles...";
+  ng.ng_GadgetID  = GID_PROFILES;
+  ui.gadProfiles = CreateGadget(BUTTON_KIND, ui.gadSession, &ng, TAG_END);
+  if (!ui.gadProfiles) return FALSE;
+
+  /* Job list (selectable, for Remove Job) */
+  ng.ng_LeftEdge  = left;
+  ng.ng_TopEdge   = QLIST_Y;
+  ng.ng_Width     = WIN_W - 24;
+  ng.ng_Height    = QLIST_H;
+  ng.ng_GadgetText= NULL;
+  ng.ng_GadgetID  = GID_QLIST;
+  ui.gadQList = CreateGadget(LISTVIEW_KIND, ui.gadProfiles, &ng,
+                             GTLV_Labels, (ULONG)&gJobs, GTLV_ShowSelected, 0, TAG_END);
+  if (!ui.gadQList) return FALSE;
+
   AddGList(ui.win, ui.gadlist, (UWORD)-1, (UWORD)-1, NULL);
   RefreshGList(ui.gadlist, ui.win, NULL, (UWORD)-1);
   GT_BeginRefresh(ui.win);
@@ -359,11 +819,13 @@ static void DrawStatus(const char *msg) {
   const WORD y = STATUS_Y;
   const WORD w = WIN_W - 24;
   const WORD h = 14;
+  TRACE_BEGIN("ui", "DrawStatus");
   SetAPen(rp, 0);
   RectFill(rp, x-2, y-12, x-2 + w, y-12 + h + 4);
   SetAPen(rp, 1);
   Move(rp, x, y);
   Text(rp, (STRPTR)msg, (ULONG)strlen(msg));
+  TRACE_END("ui", "DrawStatus");
 }
 
 static void DrawFrame(struct RastPort *rp, WORD x, WORD y, WORD w, WORD h) {
@@ -375,19 +837,48 @@ static void DrawFrame(struct RastPort *rp, WORD x, WORD y, WORD w, WORD h) {
 }
 
 static void DrawProgress(ULONG done, ULONG total) {
-  gProgDone = done; gProgTotal = total;
+  Motor_Poll();                                /* other units' motor-offs during a long operation */
+  gProgDone = done; gProgTotal = total; gProgParts = 0;
   if (!ui.win) return;
   struct RastPort *rp = ui.win->RPort;
   WORD x = 12, y = PROGRESS_Y, w = WIN_W - 24, h = 12;
+  TRACE_BEGIN("ui", "DrawProgress");
   SetAPen(rp, 1);
   DrawFrame(rp, x, y, w, h);
   ULONG frac = (total>0) ? (done * w) / total : 0;
   if (frac > (ULONG)w) frac = w;
   SetAPen(rp, 2);
   RectFill(rp, x+1, y+1, x+(WORD)frac, y+h-1);
+  TRACE_END("ui", "DrawProgress");
+}
+
+/* One bar per part, side by side in the progress area */
+static void DrawProgressParts(const ULONG *done, UBYTE parts, ULONG total) {
+  Motor_Poll();
+  if (parts > 4) parts = 4;
+  if (done != gProgPart) memcpy(gProgPart, done, parts * sizeof(ULONG));
+  gProgParts = parts; gProgTotal = total;
+  if (!ui.win || !parts) return;
+  struct RastPort *rp = ui.win->RPort;
+  WORD x = 12, y = PROGRESS_Y, w = WIN_W - 24, h = 12, gap = 6;
+  WORD pw = (WORD)((w - gap * (parts - 1)) / parts);
+  TRACE_BEGIN("ui", "DrawProgress");
+  SetAPen(rp, 0);
+  RectFill(rp, x-2, y-2, x+w+2, y+h+2);
+  for (UBYTE i=0; i<parts; ++i) {
+    WORD px = x + i * (pw + gap);
+    SetAPen(rp, 1);
+    DrawFrame(rp, px, y, pw, h);
+    ULONG frac = (total>0) ? (gProgPart[i] * pw) / total : 0;
+    if (frac > (ULONG)pw) frac = pw;
+    SetAPen(rp, 2);
+    if (frac) RectFill(rp, px+1, y+1, px+(WORD)frac, y+h-1);
+  }
+  TRACE_END("ui", "DrawProgress");
 }
 
 static void ClearProgress(void) {
+  gProgParts = 0;
   if (!ui.win) return;
   struct RastPort *rp = ui.win->RPort;
   WORD x = 12, y = PROGRESS_Y, w = WIN_W - 24, h = 12;
@@ -401,6 +892,7 @@ static void DrawLog(void) {
   if (!ui.win) return;
   struct RastPort *rp = ui.win->RPort;
   WORD x = 12, y = LOG_Y, w = WIN_W - 24, h = LOG_H;
+  TRACE_BEGIN("ui", "DrawLog");
   SetAPen(rp, 0);
   RectFill(rp, x, y, x+w, y+h);
   SetAPen(rp, 1);
@@ -410,6 +902,7 @@ static void DrawLog(void) {
     Text(rp, (STRPTR)ui.logbuf[i], (ULONG)strlen(ui.logbuf[i]));
   }
   DrawFrame(rp, x, y, w, h);
+  TRACE_END("ui", "DrawLog");
 }
 
 /* ====== ASCII banner (3 lines: pattern + title + pattern) ====== */
@@ -485,10 +978,13 @@ static void LogAdd(const char *msg) {
 /* ====== Redraw helpers ====== */
 static void RedrawAll(void) {
   if (!ui.win) return;
+  TRACE_BEGIN("ui", "RedrawAll");
   DrawAsciiBanner();
   DrawLog();
-  DrawProgress(gProgDone, gProgTotal);
+  if (gProgParts) DrawProgressParts(gProgPart, gProgParts, gProgTotal);
+  else DrawProgress(gProgDone, gProgTotal);
   if (gStatus[0]) DrawStatus(gStatus);
+  TRACE_END("ui", "RedrawAll");
 }
 
 static void PumpRefresh(void) {
@@ -524,7 +1020,7 @@ static BOOL AskFloppyUnit(UBYTE *unitOut, CONST_STRPTR action) {
   es.es_TextFormat = body;
   es.es_GadgetFormat = (UBYTE*)"DF0|DF1|DF2|DF3|Cancel";
 
-  LONG sel = EasyRequestArgs(ui.win, &es, NULL, NULL);
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
   PumpRefresh();
   if (sel == 0 || sel == 5) return FALSE;
   if (sel < 1 || sel > 4) return FALSE;
@@ -532,12 +1028,48 @@ static BOOL AskFloppyUnit(UBYTE *unitOut, CONST_STRPTR action) {
   return TRUE;
 }
 
+/* One-drive copies: which is "SOURCE" or "DESTINATION" */
+static BOOL AskSwap(CONST_STRPTR which) {
+  char text[64];
+  sprintf(text, "Insert %s disk and click Continue", which);
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, (UBYTE*)APP_NAME, (UBYTE*)text, (UBYTE*)"Continue|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  return sel == 1;
+}
+
+/* Toggle units on and off, then Start. Returns the unit mask, 0 = canceled.
+ * exclude is a unit that cannot be picked (0xFF = none). */
+static UBYTE AskUnitMask(CONST_STRPTR what, UBYTE exclude) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, NULL, (UBYTE*)"DF0|DF1|DF2|DF3|Start|Cancel" };
+  UBYTE mask = 0;
+  for (;;) {
+    char body[120], *q = body;
+    q += sprintf(q, "%s:", (const char*)what);
+    for (UBYTE u=0; u<4; ++u) if (mask & (1 << u)) q += sprintf(q, " DF%u", (unsigned)u);
+    if (!mask) q += sprintf(q, " (none)");
+    sprintf(q, "\nToggle a unit, then Start.");
+    es.es_TextFormat = (UBYTE*)body;
+    LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+    PumpRefresh();
+    if (sel >= 1 && sel <= 4) {
+      if ((UBYTE)(sel - 1) == exclude) { DrawStatus("The master drive cannot be a target."); continue; }
+      mask ^= (UBYTE)(1 << (sel - 1));
+      continue;
+    }
+    if (sel == 5 && mask) return mask;
+    if (sel == 5) continue;
+    return 0;
+  }
+}
+
 static FormatMode AskFormatMode(void) {
   static UBYTE title[] = APP_NAME " " APP_VER;
   static UBYTE text[]  = "Choose format mode";
   static UBYTE gadgets[] = "Quick (OS)|Full (OS)|Deep (RAW+Quick)|Cancel";
   struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, text, gadgets };
-  LONG sel = EasyRequestArgs(ui.win, &es, NULL, NULL);
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
   PumpRefresh();
   if (sel == 0 || sel == 4) return FMT_CANCEL;
   if (sel == 1) return FMT_QUICK_OS;
@@ -546,6 +1078,22 @@ static FormatMode AskFormatMode(void) {
   return FMT_CANCEL;
 }
 
+/* WRITE_* flags, -1 = cancel */
+static LONG AskWriteMode(void) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  static UBYTE text[]  = "Read back and check each track as it is written?\n(about one extra revolution per track)\n"
+                         "Format+ also lays down the track format in the\nsame pass, for blank or badly formatted disks.";
+  static UBYTE gadgets[] = "Write+Verify|Write only|Format+Verify|Format+Write|Cancel";
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, text, gadgets };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel == 1) return WRITE_VERIFY;
+  if (sel == 2) return 0;
+  if (sel == 3) return WRITE_FORMAT | WRITE_VERIFY;
+  if (sel == 4) return WRITE_FORMAT;
+  return -1;
+}
+
 static BOOL AskVolumeName(char *outName, int maxlen, CONST_STRPTR defName) {
   if (!outName || maxlen < 2) return FALSE;
   strncpy(outName, defName ? defName : "Untitled", maxlen-1);
@@ -596,7 +1144,7 @@ static BOOL ASL_OpenFile(char *outPath, int maxlen, CONST_STRPTR title, CONST_ST
   if (!fr) return FALSE;
 
   BOOL ok = FALSE;
-  if (AslRequest(fr, NULL)) {
+  if (Trace_AslRequest(fr)) {
     const char *d = fr->fr_Drawer ? fr->fr_Drawer : "";
     const char *f = fr->fr_File   ? fr->fr_File   : "";
     if (d[0]) {
@@ -632,79 +1180,101 @@ static void DoFormatFloppy(void) {
   char volname[32];
   if (!AskVolumeName(volname, sizeof(volname), "Untitled")) { DrawStatus("Format canceled."); return; }
 
+  RunFormat(unit, mode, volname);
+}
+
+static BOOL RunFormat(UBYTE unit, FormatMode mode, CONST_STRPTR volname) {
   const char *candidates[] = { "C:Format", "SYS:C/Format", NULL };
   const char *fmt = NULL;
   for (int i=0; candidates[i]; ++i) { if (HasFile(candidates[i])) { fmt = candidates[i]; break; } }
-  if (!fmt) { DrawStatus("No Format in C: (install Workbench C:Format)."); return; }
+  if (!fmt) { DrawStatus("No Format in C: (install Workbench C:Format)."); return FALSE; }
 
   LogClear();
 
   if (mode == FMT_QUICK_OS) {
     char cmd[256]; sprintf(cmd, "%s DRIVE DF%u: NAME \"%s\" QUICK", fmt, (unsigned)unit, volname);
     DrawStatus("Quick format (OS)...");
-    BPTR inTmp = Open("T:ft_yes", MODE_NEWFILE); if (inTmp) { Write(inTmp, (APTR)"y\n", 2); Close(inTmp); }
+    BPTR inTmp = Open("T:ft_yes", MODE_NEWFILE); if (inTmp) { Trace_Write(inTmp, (APTR)"y\n", 2); Close(inTmp); }
     BPTR in  = Open("T:ft_yes", MODE_OLDFILE);
     BPTR out = Open("NIL:", MODE_NEWFILE);
     LONG ok = Execute((STRPTR)cmd, in ? in : Open("NIL:", MODE_OLDFILE), out);
     if (in) Close(in); if (out) Close(out); DeleteFile("T:ft_yes");
-    SetFloppyMotor(unit, FALSE);
+    Motor_Release(unit);
     DrawStatus(ok ? "Quick format done." : "Quick format failed.");
     ClearProgress();
-    return;
+    return (BOOL)(ok != 0);
   }
 
   if (mode == FMT_FULL_OS) {
     char cmd[256]; sprintf(cmd, "%s DRIVE DF%u: NAME \"%s\"", fmt, (unsigned)unit, volname);
     DrawStatus("Full format (OS)...");
-    BPTR inTmp = Open("T:ft_yes", MODE_NEWFILE); if (inTmp) { Write(inTmp, (APTR)"y\n", 2); Close(inTmp); }
+    BPTR inTmp = Open("T:ft_yes", MODE_NEWFILE); if (inTmp) { Trace_Write(inTmp, (APTR)"y\n", 2); Close(inTmp); }
     BPTR in  = Open("T:ft_yes", MODE_OLDFILE);
     BPTR out = Open("NIL:", MODE_NEWFILE);
     LONG ok = Execute((STRPTR)cmd, in ? in : Open("NIL:", MODE_OLDFILE), out);
     if (in) Close(in); if (out) Close(out); DeleteFile("T:ft_yes");
-    SetFloppyMotor(unit, FALSE);
+    Motor_Release(unit);
     DrawStatus(ok ? "Full format done." : "Full format failed.");
     ClearProgress();
-    return;
+    return (BOOL)(ok != 0);
   }
 
   if (mode == FMT_DEEP) {
     DrawStatus("Deep format: RAW pass...");
     ClearProgress();
     BOOL passOk = RawWritePass(unit);
-    SetFloppyMotor(unit, FALSE);
-    if (!passOk) { DrawStatus("RAW pass failed."); ClearProgress(); return; }
+    Motor_Release(unit);
+    if (!passOk) { DrawStatus("RAW pass failed."); ClearProgress(); return FALSE; }
 
     /* Now install filesystem quickly */
     char cmd2[256]; sprintf(cmd2, "%s DRIVE DF%u: NAME \"%s\" QUICK", fmt, (unsigned)unit, volname);
     DrawStatus("Installing filesystem (Quick)...");
-    BPTR inTmp = Open("T:ft_yes", MODE_NEWFILE); if (inTmp) { Write(inTmp, (APTR)"y\n", 2); Close(inTmp); }
+    BPTR inTmp = Open("T:ft_yes", MODE_NEWFILE); if (inTmp) { Trace_Write(inTmp, (APTR)"y\n", 2); Close(inTmp); }
     BPTR in  = Open("T:ft_yes", MODE_OLDFILE);
     BPTR out = Open("NIL:", MODE_NEWFILE);
     LONG ok2 = Execute((STRPTR)cmd2, in ? in : Open("NIL:", MODE_OLDFILE), out);
     if (in) Close(in); if (out) Close(out); DeleteFile("T:ft_yes");
-    SetFloppyMotor(unit, FALSE);
+    Motor_Release(unit);
     DrawStatus(ok2 ? "Deep format done." : "Deep format failed at OS stage.");
     ClearProgress();
-    return;
+    return (BOOL)(ok2 != 0);
   }
+  return FALSE;
 }
 
 static void DoVerifyFloppy(void) {
   UBYTE unit;
   if (!AskFloppyUnit(&unit, "VERIFY")) { DrawStatus("Verify canceled."); return; }
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title,
+                           (UBYTE*)"Full verify reads all 160 tracks.\nTriage samples a few for a quick verdict.",
+                           (UBYTE*)"Full|Triage|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel == 1) RunVerify(unit);
+  else if (sel == 2) DoTriage(unit);
+  else DrawStatus("Verify canceled.");
+}
+
+static BOOL RunVerify(UBYTE unit) {
   LogClear();
   DrawStatus("Verify: reading tracks...");
   BOOL ok = RawVerify(unit);
-  SetFloppyMotor(unit, FALSE);
-  DrawStatus(ok ? "Verify OK." : "Verify FAILED (read error).");
+  Motor_Release(unit);
+  if (ok && gBad.nFailed) DrawStatus("Verify OK (weak tracks recovered).");
+  else DrawStatus(ok ? "Verify OK." : "Verify FAILED (read error).");
   ClearProgress();
+  return ok;
 }
 
 static void DoCopyFloppy(void) {
   UBYTE src, dst;
   if (!AskFloppyUnit(&src, "COPY (source)")) { DrawStatus("Copy canceled."); return; }
   if (!AskFloppyUnit(&dst, "COPY (destination)")) { DrawStatus("Copy canceled."); return; }
+  RunCopy(src, dst);
+}
 
+static BOOL RunCopy(UBYTE src, UBYTE dst) {
   LogClear();
   DrawStatus("Copy (raw) in progress...");
   DrawProgress(0, DISK_SIZE);
@@ -713,27 +1283,57 @@ static void DoCopyFloppy(void) {
   if (src == dst) ok = RawCopyOneDrive(src);
   else            ok = RawCopyTwoDrives(src, dst);
 
-  SetFloppyMotor(src, FALSE);
-  SetFloppyMotor(dst, FALSE);
+  Motor_Release(src);
+  Motor_Release(dst);
 
-  DrawStatus(ok ? "Copy completed." : "Copy failed.");
+  if (ok && gBad.nBad) {
+    char m[80]; sprintf(m, "Copy completed, %lu bad sector(s).", (unsigned long)gBad.nBad);
+    DrawStatus(m);
+  } else DrawStatus(ok ? "Copy completed." : "Copy failed.");
   ClearProgress();
+  return ok;
 }
 
-/* Read ADF: select only DFx, auto path RAM:DF<unit>_<n>.adf */
+/* Read ADF: select DFx (or several units at once), named by the capture
+ * session (RAM:DF<unit>_<n>.adf by default) */
 static void DoReadADF(void) {
-  UBYTE unit;
-  if (!AskFloppyUnit(&unit, "READ ADF (source DFx:)")) { DrawStatus("Read ADF canceled."); return; }
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title,
+                           (UBYTE*)"Select FLOPPY drive for READ ADF (source DFx:)",
+                           (UBYTE*)"DF0|DF1|DF2|DF3|Several...|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel == 5) { DoCaptureMulti(); return; }
+  if (sel < 1 || sel > 4) { DrawStatus("Read ADF canceled."); return; }
+  UBYTE unit = (UBYTE)(sel - 1);
+
+  es.es_TextFormat   = (UBYTE*)"Capture to a raw ADF or a compressed ADZ,\nor resume a partial ADF from its journal?";
+  es.es_GadgetFormat = (UBYTE*)"ADF|ADZ|Resume...|Cancel";
+  sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel < 1 || sel > 3) { DrawStatus("Read ADF canceled."); return; }
+  BOOL resume = (sel == 3);
+
+  if (!resume) { Session_Capture(unit, sel == 2); return; }
 
   char path[300];
-  if (!GenUniqueAdfPath(unit, path, sizeof(path))) { DrawStatus("Cannot build RAM: output path"); return; }
+  if (!ASL_OpenFile(path, sizeof(path), "Select partial ADF to resume...", gSess.open ? gSess.dir : "RAM:")) { DrawStatus("Read ADF canceled."); return; }
+  RunReadADF(unit, path, TRUE);
+}
 
-  char msg[160]; sprintf(msg, "Saving to %s", path); LogClear(); LogAdd(msg);
+static BOOL RunReadADF(UBYTE unit, CONST_STRPTR path, BOOL resume) {
+  char msg[160]; sprintf(msg, "%s %s", resume ? "Resuming" : "Saving to", path); LogClear(); LogAdd(msg);
   DrawStatus("Reading DFx: to ADF...");
-  BOOL ok = ADF_ReadFromDrive(unit, path);
-  SetFloppyMotor(unit, FALSE);
-  DrawStatus(ok ? "ADF saved." : "ADF read failed.");
+  gBootAlert[0] = '\0';
+  BOOL ok = ADF_ReadFromDrive(unit, path, resume);
+  Motor_Release(unit);
+  if (ok && gBad.nBad) {
+    char m[80]; sprintf(m, "ADF saved, %lu bad sector(s).", (unsigned long)gBad.nBad);
+    DrawStatus(m);
+  } else DrawStatus(ok ? "ADF saved." : "ADF read failed.");
+  Boot_Alert();
   ClearProgress();
+  return ok;
 }
 
 static void DoWriteADF(void) {
@@ -741,64 +1341,164 @@ static void DoWriteADF(void) {
   if (!AskFloppyUnit(&unit, "WRITE ADF (destination DFx:)")) { DrawStatus("Write ADF canceled."); return; }
 
   char path[300];
-  if (!ASL_OpenFile(path, sizeof(path), "Select ADF to write...", "RAM:floppy.adf")) { DrawStatus("Write ADF canceled."); return; }
+  if (!ASL_OpenFile(path, sizeof(path), "Select ADF/ADZ/DMS to write...", "RAM:floppy.adf")) { DrawStatus("Write ADF canceled."); return; }
+  LONG mode = AskWriteMode();
+  if (mode < 0) { DrawStatus("Write ADF canceled."); return; }
+  RunWriteADF(unit, path, (UBYTE)mode);
+}
 
+static BOOL RunWriteADF(UBYTE unit, CONST_STRPTR path, UBYTE mode) {
   LogClear();
-  DrawStatus("Writing ADF to DFx: ...");
-  BOOL ok = ADF_WriteToDrive(unit, path);
-  SetFloppyMotor(unit, FALSE);
+  DrawStatus((mode & WRITE_VERIFY) ? "Writing and verifying ADF to DFx: ..." : "Writing ADF to DFx: ...");
+  gBootAlert[0] = '\0';
+  BOOL ok = ADF_WriteToDrive(unit, path, mode);
+  Motor_Release(unit);
   DrawStatus(ok ? "ADF written to disk." : "ADF write failed.");
+  Boot_Alert();
   ClearProgress();
+  return ok;
 }
 
 static void DoVerifyADF(void) {
   char path[300];
-  if (!ASL_OpenFile(path, sizeof(path), "Select ADF to verify...", "RAM:floppy.adf")) { DrawStatus("Verify ADF canceled."); return; }
+  if (!ASL_OpenFile(path, sizeof(path), "Select ADF/ADZ/DMS to verify...", "RAM:floppy.adf")) { DrawStatus("Verify ADF canceled."); return; }
 
   LogClear();
   DrawStatus("Verifying ADF...");
-  BPTR fh = Open((STRPTR)path, MODE_OLDFILE);
-  if (!fh) { LogAdd("Cannot open ADF"); DrawStatus("Verify ADF failed."); return; }
-
-  /* Size via ExamineFH (fallback Seek) */
-  LONG size = -1;
-  struct FileInfoBlock *fib = (struct FileInfoBlock*)AllocVec(sizeof(struct FileInfoBlock), MEMF_CLEAR);
-  if (fib && ExamineFH(fh, fib)) size = fib->fib_Size;
-  else {
-    LONG end = Seek(fh, 0, OFFSET_END); if (end >= 0) size = end;
-    Seek(fh, 0, OFFSET_BEGINNING);
-  }
-  if (fib) FreeVec(fib);
-  char smsg[120]; sprintf(smsg, "ADF size: %ld bytes", (long)size); LogAdd(smsg);
-
-  if (size != (LONG)DISK_SIZE) {
+  struct ImgSrc src;
+  if (!Img_Open(&src, path)) { DrawStatus("Verify ADF failed."); return; }
+
+  LONG size = src.size;
+  char smsg[120];
+  if (src.stream)   sprintf(smsg, "Streaming %s source", src.gz ? "ADZ" : src.dms ? "DMS" : "ADF");
+  else if (src.gz)  sprintf(smsg, "ADZ: %ld bytes -> %ld bytes", (long)src.packed, (long)size);
+  else if (src.dms) sprintf(smsg, "DMS: %ld bytes -> %ld bytes", (long)src.packed, (long)size);
+  else              sprintf(smsg, "ADF size: %ld bytes", (long)size);
+  LogAdd(smsg);
+
+  if (size >= 0 && size != (LONG)DISK_SIZE) {
     LogAdd("Warning: size is not 901,120 bytes");
   }
-  Seek(fh, 0, OFFSET_BEGINNING);
 
-  /* CRC32 */
-  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  if (!buf) { Close(fh); LogAdd("No memory for CRC"); DrawStatus("Verify ADF failed."); return; }
+  ULONG crc;
+  UBYTE md5Sum[MD5_LEN], sha1Sum[SHA1_LEN];
+  static UBYTE boot[BOOT_SIZE];
+  LONG total = Img_Hash(&src, &crc, md5Sum, sha1Sum, NULL, boot);
+  if (total < 0) { Img_Close(&src); DrawStatus("Verify ADF failed."); return; }
+  if (size < 0 && total != (LONG)DISK_SIZE) LogAdd("Warning: size is not 901,120 bytes");
+  Img_Report(&src);
+  Img_Close(&src);
+
+  char hex[2*SHA1_LEN+1], cmsg[120];
+  hash_hex(md5Sum, MD5_LEN, hex);
+  sprintf(cmsg, "CRC32: %08lx  MD5: %s", (ULONG)crc, hex);
+  LogAdd(cmsg);
+  hash_hex(sha1Sum, SHA1_LEN, hex);
+  sprintf(cmsg, "SHA-1: %s", hex);
+  LogAdd(cmsg);
+  gBootAlert[0] = '\0';
+  if (total >= BOOT_SIZE) Boot_Report(boot);
+  DrawStatus((total == (LONG)DISK_SIZE) ? "ADF looks OK (size+CRC computed)." : "ADF verified (non-standard size).");
+  Dat_Identify(sha1Sum, md5Sum, crc);
+  Boot_Alert();
+  ClearProgress();
+}
 
-  ULONG crc = crc32_init();
-  LONG remaining = size > 0 ? size : 0;
-  while (remaining > 0) {
-    LONG chunk = (remaining >= TRACK_SIZE) ? TRACK_SIZE : remaining;
-    LONG rd = Read(fh, buf, chunk);
-    if (rd != chunk) { LogAdd("File read error during CRC"); FreeVec(buf); Close(fh); DrawStatus("Verify ADF failed."); return; }
-    crc = crc32_update(crc, buf, (ULONG)chunk);
-    remaining -= chunk;
-    DrawProgress(size - remaining, size > 0 ? (ULONG)size : 1);
+static LONG Dat_DosReadAt(void *h, ULONG off, UBYTE *buf, LONG len) {
+  if (Seek((BPTR)h, (LONG)off, OFFSET_BEGINNING) < 0) return -1;
+  return Trace_Read((BPTR)h, buf, len);
+}
+
+/* Name the dump from the DAT index, if one is installed; result on the status line */
+static void Dat_Identify(const UBYTE *sha1, const UBYTE *md5, ULONG crc) {
+  BPTR fh = Open(DAT_INDEX, MODE_OLDFILE);
+  if (!fh) return;
+  static struct DatHit hit;
+  int rc = dat_lookup(Dat_DosReadAt, (void*)fh, sha1, &hit);
+  Close(fh);
+
+  char m[128];
+  if (rc == DAT_FOUND) {
+    static const UBYTE zero[MD5_LEN];
+    BOOL exact = (memcmp(hit.md5, zero, MD5_LEN) == 0 || memcmp(hit.md5, md5, MD5_LEN) == 0) && hit.crc == crc;
+    sprintf(m, "%s: %.90s", exact ? "Known dump" : "SHA-1 match (MD5/CRC differ)", hit.name);
+  } else if (rc == DAT_NOT_FOUND) {
+    sprintf(m, "Not in DAT index (unknown or modified dump).");
+  } else {
+    sprintf(m, "DAT index unreadable: %s", DAT_INDEX);
   }
-  crc = crc32_final(crc);
+  DrawStatus(m);
+}
 
-  FreeVec(buf);
+/* ====== Bootblock check ======
+ * Captures, writes and Verify ADF hand the image's first 1,024 bytes to
+ * ftboot.c before the rest is processed: the log gets the DOS type, the
+ * class of boot code (none, Install's, or custom with its CRC32 and
+ * checksum state) and every virus, loader or utility the signature database
+ * knows it by. The database is loaded on first use and kept; without one
+ * only the class is shown. */
+static UBYTE *gBootDb = NULL;
+
+static const UBYTE *Boot_Db(void) {
+  if (gBootDb) return gBootDb;
+  BPTR fh = Open(BOOT_DB, MODE_OLDFILE);
+  if (!fh) return NULL;
+  LONG size = Seek(fh, 0, OFFSET_END);
+  size = Seek(fh, 0, OFFSET_BEGINNING);
+  UBYTE *db = (size > 0) ? (UBYTE*)AllocVec(size, MEMF_ANY) : NULL;
+  if (db && (Trace_Read(fh, db, size) != size || boot_db_check(db, (ULONG)size) != BOOT_OK)) {
+    FreeVec(db); db = NULL;
+    LogAdd("Bootblock signatures unreadable: " BOOT_DB);
+  }
   Close(fh);
+  return gBootDb = db;
+}
 
-  char cmsg[120]; sprintf(cmsg, "CRC32: %08lx", (ULONG)crc);
-  LogAdd(cmsg);
-  DrawStatus((size == (LONG)DISK_SIZE) ? "ADF looks OK (size+CRC computed)." : "ADF verified (non-standard size).");
-  ClearProgress();
+static void Boot_Report(const UBYTE *bb) {
+  struct BootInfo bi;
+  boot_scan(bb, Boot_Db(), &bi);
+  char m[100];
+  const char *sum = bi.sumOk ? "" : ", bad checksum";
+  switch (bi.class) {
+    case BOOT_NDOS:     strcpy(m, "Bootblock: not DOS"); break;
+    case BOOT_EMPTY:    sprintf(m, "Bootblock: DOS%u, not bootable", (unsigned)bi.dosType); break;
+    case BOOT_STANDARD: sprintf(m, "Bootblock: DOS%u, standard code%s", (unsigned)bi.dosType, sum); break;
+    default:            sprintf(m, "Bootblock: DOS%u, custom code %08lx%s", (unsigned)bi.dosType, (unsigned long)bi.codeCrc, sum); break;
+  }
+  LogAdd(m);
+  gBootAlert[0] = '\0';
+  for (UWORD i=0; i<bi.nHits; ++i) {
+    sprintf(m, "Bootblock %s: %.70s", boot_kind_name(bi.hit[i].kind), bi.hit[i].name);
+    LogAdd(m);
+    if (bi.hit[i].kind == BOOT_KIND_VIRUS && !gBootAlert[0]) snprintf(gBootAlert, sizeof(gBootAlert), "%s", bi.hit[i].name);
+  }
+  if (bi.more) LogAdd("Bootblock: more signatures matched");
+  Boot_Alert();
+}
+
+/* A virus stays on the status line after the operation's own result */
+static void Boot_Alert(void) {
+  if (!gBootAlert[0]) return;
+  char m[80]; sprintf(m, "VIRUS in bootblock: %s", gBootAlert);
+  DrawStatus(m);
+}
+
+/* Before writing an image: a virus named by Boot_Report needs an explicit
+ * Continue. Queued jobs have nobody to ask and do not write it. */
+static BOOL Boot_Confirm(void) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  if (!gBootAlert[0]) return TRUE;
+  if (gQueueRunning) return FALSE;
+  char body[120];
+  sprintf(body, "VIRUS in the image's bootblock:\n%s\n\nWrite it to disk anyway?", gBootAlert);
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, (UBYTE*)body, (UBYTE*)"Continue|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  return sel == 1;
+}
+
+static void Boot_Free(void) {
+  if (gBootDb) { FreeVec(gBootDb); gBootDb = NULL; }
 }
 
 static void DoAbout(void) {
@@ -809,378 +1509,3814 @@ static void DoAbout(void) {
     "Features:\n"
     "  • Format (Quick/Full/Deep)\n"
     "  • Verify/Copy raw\n"
-    "  • Read/Write/Verify ADF\n"
+    "  • Read/Write/Verify ADF (.adf/.adz)\n"
+    "  • Write/Verify straight from .dms\n"
+    "  • Weak-track recovery (re-read + vote)\n"
+    "  • Job queue with per-job timing\n"
+    "  • Station mode (write on disk insert)\n"
+    "  • Dump ID: CRC32/MD5/SHA-1 + DAT index\n"
+    "  • Sector patches for ADF files and disks\n"
+    "  • Drive benchmark with history\n"
     "\n"
     "© 2025 Danilo Savioni + Stella\n"
     "Built for AmigaOS 2.0+ (68k)\n";
   static UBYTE gadgets[] = "OK";
   struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, text, gadgets };
-  EasyRequestArgs(ui.win, &es, NULL, NULL);
+  Trace_EasyRequest(ui.win, &es, NULL, NULL);
 }
 
-/* ====== Raw ops via trackdisk.device ====== */
+/* ====== Job queue ======
+ * Jobs run one after another in list order. While a job runs, the drive of
+ * the next one (if it uses other units) is spun up and seeked to cylinder 0
+ * with an async TD_SEEK, so its motor start and head travel are done by the
+ * time it begins. Pending jobs are rewritten to QUEUE_FILE on every change
+ * and reloaded at startup; finished jobs stay in the list with their time.
+ */
+static const char *const jobName[JOB_KINDS] = { "READ", "WRITE", "COPY", "VERIFY", "FORMAT" };
+static const char *const jobAsk[JOB_KINDS]  = {
+  "READ ADF (source DFx:)", "WRITE ADF (destination DFx:)", "COPY (source)", "VERIFY", "FORMAT"
+};
+static const char *const fmtName[4] = { "?", "Quick", "Full", "Deep" };
 
-static BOOL OpenTD(UBYTE unit, struct MsgPort **pp, struct IOExtTD **pio) {
-  if (!pp || !pio) return FALSE;
-  *pp = NULL; *pio = NULL;
+/* DOS clock in 1/50 s; wraps, but differences stay exact */
+static ULONG StampTicks(void) {
+  struct DateStamp ds;
+  DateStamp(&ds);
+  return ((ULONG)ds.ds_Days * 1440UL + (ULONG)ds.ds_Minute) * 3000UL + (ULONG)ds.ds_Tick;
+}
 
-  struct MsgPort *port = CreateMsgPort();
-  if (!port) return FALSE;
-  struct IOExtTD *io = (struct IOExtTD*)CreateIORequest(port, sizeof(struct IOExtTD));
-  if (!io) { DeleteMsgPort(port); return FALSE; }
+static UBYTE Job_Units(const struct Job *j) {
+  UBYTE m = (UBYTE)(1 << j->unit);
+  if (j->kind == JOB_COPY) m |= (UBYTE)(1 << j->arg);
+  return m;
+}
 
-  if (OpenDevice("trackdisk.device", unit, (struct IORequest*)io, 0) != 0) {
-    DeleteIORequest((struct IORequest*)io);
-    DeleteMsgPort(port);
-    return FALSE;
+static void Job_Label(struct Job *j, ULONG n) {
+  char what[64];
+  switch (j->kind) {
+    case JOB_READ:   sprintf(what, "DF%u: -> session *.%s", (unsigned)j->unit, j->arg ? "adz" : "adf"); break;
+    case JOB_WRITE:  sprintf(what, "%.30s -> DF%u:%s", (char*)FilePart((STRPTR)j->path), (unsigned)j->unit,
+                             (j->arg & WRITE_FORMAT) ? ((j->arg & WRITE_VERIFY) ? " +fmt+vfy" : " +fmt") : j->arg ? " +vfy" : ""); break;
+    case JOB_COPY:   sprintf(what, "DF%u: -> DF%u:", (unsigned)j->unit, (unsigned)j->arg); break;
+    case JOB_VERIFY: sprintf(what, "DF%u:", (unsigned)j->unit); break;
+    default:         sprintf(what, "DF%u: %s \"%.24s\"", (unsigned)j->unit, fmtName[j->arg & 3], j->path); break;
   }
-  *pp = port; *pio = io;
+  if (j->state == JS_QUEUED)       sprintf(j->label, "%2lu %-6s %s", (unsigned long)n, jobName[j->kind], what);
+  else if (j->state == JS_RUNNING) sprintf(j->label, "%2lu %-6s %s  (running)", (unsigned long)n, jobName[j->kind], what);
+  else sprintf(j->label, "%2lu %-6s %s  %s %lu.%lu s", (unsigned long)n, jobName[j->kind], what,
+               j->state == JS_OK ? "OK" : "FAILED",
+               (unsigned long)(j->ticks / 50), (unsigned long)((j->ticks % 50) / 5));
+}
+
+/* The list must be detached from the listview while it is changed */
+static void Queue_Detach(void) {
+  if (ui.win && ui.gadQList) GT_SetGadgetAttrs(ui.gadQList, ui.win, NULL, GTLV_Labels, ~0UL, TAG_END);
+}
+
+static void Queue_Attach(void) {
+  ULONG n = 0;
+  for (struct Node *nd = gJobs.lh_Head; nd->ln_Succ; nd = nd->ln_Succ) Job_Label((struct Job*)nd, ++n);
+  gJobSel = -1;
+  if (ui.win && ui.gadQList)
+    GT_SetGadgetAttrs(ui.gadQList, ui.win, NULL, GTLV_Labels, (ULONG)&gJobs, GTLV_Selected, ~0UL, TAG_END);
+}
+
+static struct Job *Queue_Add(UBYTE kind, UBYTE unit, UBYTE arg, CONST_STRPTR path) {
+  if (gJobCount >= MAX_JOBS) return NULL;
+  struct Job *j = (struct Job*)AllocVec(sizeof(struct Job), MEMF_CLEAR);
+  if (!j) return NULL;
+  j->kind = kind; j->unit = unit; j->arg = arg; j->state = JS_QUEUED;
+  if (path) { strncpy(j->path, path, sizeof(j->path)-1); j->path[sizeof(j->path)-1] = '\0'; }
+  j->node.ln_Name = j->label;
+  AddTail(&gJobs, &j->node);
+  gJobCount++;
+  return j;
+}
+
+static void Queue_Free(void) {
+  struct Node *nd;
+  while ((nd = RemHead(&gJobs)) != NULL) FreeVec(nd);
+  gJobCount = 0;
+}
+
+/* "FTQ1" line, then one "<kind> <unit> <arg> <path>" line per pending job */
+static BOOL Queue_Save(void) {
+  ULONG pending = 0;
+  for (struct Node *nd = gJobs.lh_Head; nd->ln_Succ; nd = nd->ln_Succ)
+    if (((struct Job*)nd)->state == JS_QUEUED) pending++;
+  if (!pending) { DeleteFile(QUEUE_FILE); return TRUE; }
+
+  BPTR fh = Open(QUEUE_FILE, MODE_NEWFILE);
+  if (!fh) { LogAdd("Cannot save job queue"); return FALSE; }
+  BOOL ok = (Trace_Write(fh, (APTR)"FTQ1\n", 5) == 5);
+  for (struct Node *nd = gJobs.lh_Head; ok && nd->ln_Succ; nd = nd->ln_Succ) {
+    struct Job *j = (struct Job*)nd;
+    if (j->state != JS_QUEUED) continue;
+    char line[300];
+    sprintf(line, "%u %u %u %s\n", (unsigned)j->kind, (unsigned)j->unit, (unsigned)j->arg, j->path);
+    LONG len = (LONG)strlen(line);
+    ok = (Trace_Write(fh, line, len) == len);
+  }
+  Close(fh);
+  if (!ok) LogAdd("Cannot save job queue");
+  return ok;
+}
+
+static BOOL Queue_Load(void) {
+  BPTR fh = Open(QUEUE_FILE, MODE_OLDFILE);
+  if (!fh) return FALSE;
+  const LONG max = MAX_JOBS * 280;
+  char *buf = (char*)AllocVec(max + 1, MEMF_CLEAR);
+  if (!buf) { Close(fh); return FALSE; }
+  LONG n = Trace_Read(fh, buf, max);
+  Close(fh);
+  if (n < 5 || strncmp(buf, "FTQ1\n", 5) != 0) { FreeVec(buf); return FALSE; }
+  buf[n] = '\0';
+
+  char *line = buf + 5;
+  while (*line) {
+    char *eol = strchr(line, '\n');
+    if (eol) *eol = '\0';
+    unsigned k, u, a; int off = 0;
+    if (sscanf(line, "%u %u %u %n", &k, &u, &a, &off) == 3 && off > 0 && k < JOB_KINDS && u < 4 && a < 4 &&
+        !(k == JOB_FORMAT && a == FMT_CANCEL) && !(k == JOB_WRITE && !line[off]))
+      Queue_Add((UBYTE)k, (UBYTE)u, (UBYTE)a, line + off);
+    if (!eol) break;
+    line = eol + 1;
+  }
+  FreeVec(buf);
   return TRUE;
 }
 
-static void CloseTD(struct MsgPort *p, struct IOExtTD *io) {
-  if (io) { CloseDevice((struct IORequest*)io); DeleteIORequest((struct IORequest*)io); }
-  if (p)  { DeleteMsgPort(p); }
+/* Background spin-up + seek of the next job's drive */
+static BOOL Job_SpinUp(UBYTE unit, struct MsgPort **pp, struct IOExtTD **pio) {
+  if (!OpenTD(unit, pp, pio)) return FALSE;
+  gMotorOff[unit] = 0;                         /* a pending motor-off would stop it mid-job */
+  (*pio)->iotd_Req.io_Command = TD_SEEK;
+  (*pio)->iotd_Req.io_Offset  = 0;
+  Trace_SendIO((struct IORequest*)*pio);
+  return TRUE;
 }
 
-static void SetFloppyMotor(UBYTE unit, BOOL on) {
+static void Job_SpinWait(struct MsgPort **pp, struct IOExtTD **pio) {
+  if (!*pio) return;
+  Trace_WaitIO((struct IORequest*)*pio);
+  CloseTD(*pp, *pio);
+  *pp = NULL; *pio = NULL;
+}
+
+static BOOL Job_Run(const struct Job *j) {
+  switch (j->kind) {
+    case JOB_READ:   return Session_Capture(j->unit, j->arg != 0);
+    case JOB_WRITE:  return RunWriteADF(j->unit, j->path, j->arg);
+    case JOB_COPY:   return RunCopy(j->unit, j->arg);
+    case JOB_VERIFY: return RunVerify(j->unit);
+    case JOB_FORMAT: return RunFormat(j->unit, (FormatMode)j->arg, j->path);
+  }
+  return FALSE;
+}
+
+static void DoQueueAdd(void) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title,
+                           (UBYTE*)"Operation to add to the queue:", (UBYTE*)"Read|Write|Copy|Verify|Format|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel < 1 || sel > 5) { DrawStatus("Queue canceled."); return; }
+  if (gJobCount >= MAX_JOBS) { DrawStatus("Queue full."); return; }
+
+  UBYTE kind = (UBYTE)(sel - 1), unit, arg = 0;
+  char path[256]; path[0] = '\0';
+  if (!AskFloppyUnit(&unit, jobAsk[kind])) { DrawStatus("Queue canceled."); return; }
+
+  switch (kind) {
+    case JOB_READ:
+      es.es_TextFormat   = (UBYTE*)"Capture to a raw ADF or a compressed ADZ?";
+      es.es_GadgetFormat = (UBYTE*)"ADF|ADZ|Cancel";
+      sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+      PumpRefresh();
+      if (sel < 1 || sel > 2) { DrawStatus("Queue canceled."); return; }
+      arg = (UBYTE)(sel == 2);
+      break;
+    case JOB_WRITE:
+      if (!ASL_OpenFile(path, sizeof(path), "Select ADF/ADZ/DMS to queue...", "RAM:floppy.adf")) { DrawStatus("Queue canceled."); return; }
+      sel = AskWriteMode();
+      if (sel < 0) { DrawStatus("Queue canceled."); return; }
+      arg = (UBYTE)sel;
+      break;
+    case JOB_COPY:
+      if (!AskFloppyUnit(&arg, "COPY (destination)")) { DrawStatus("Queue canceled."); return; }
+      break;
+    case JOB_FORMAT: {
+      FormatMode mode = AskFormatMode();
+      if (mode == FMT_CANCEL || !AskVolumeName(path, 32, "Untitled")) { DrawStatus("Queue canceled."); return; }
+      arg = (UBYTE)mode;
+    } break;
+  }
+
+  Queue_Detach();
+  struct Job *j = Queue_Add(kind, unit, arg, path);
+  Queue_Attach();
+  if (!j) { DrawStatus("No memory for job."); return; }
+  Queue_Save();
+  DrawStatus("Job queued.");
+}
+
+static void DoQueueRun(void) {
+  ULONG pending = 0;
+  for (struct Node *nd = gJobs.lh_Head; nd->ln_Succ; nd = nd->ln_Succ)
+    if (((struct Job*)nd)->state == JS_QUEUED) pending++;
+  if (!pending) { DrawStatus("No queued jobs."); return; }
+
+  struct MsgPort *spinPort = NULL; struct IOExtTD *spinIo = NULL;
+  ULONG idx = 0, done = 0, failed = 0, t0 = StampTicks();
+  char m[120];
+  gQueueRunning = TRUE;
+
+  for (struct Node *nd = gJobs.lh_Head; nd->ln_Succ; nd = nd->ln_Succ) {
+    struct Job *j = (struct Job*)nd;
+    ++idx;
+    if (j->state != JS_QUEUED) continue;
+    Job_SpinWait(&spinPort, &spinIo);  /* this job's drive, if pre-started */
+
+    /* Next pending job on other drives: start its motor and seek now */
+    struct Job *next = NULL;
+    for (struct Node *nn = nd->ln_Succ; nn->ln_Succ; nn = nn->ln_Succ)
+      if (((struct Job*)nn)->state == JS_QUEUED) { next = (struct Job*)nn; break; }
+    if (next && !(Job_Units(next) & Job_Units(j))) Job_SpinUp(next->unit, &spinPort, &spinIo);
+
+    Queue_Detach(); j->state = JS_RUNNING; Queue_Attach();
+    ULONG t = StampTicks();
+    BOOL ok = Job_Run(j);
+    j->ticks = StampTicks() - t;
+    Queue_Detach(); j->state = ok ? JS_OK : JS_FAILED; Queue_Attach();
+    Queue_Save();
+
+    done++; if (!ok) failed++;
+    sprintf(m, "Job %lu %s: %s in %lu.%lu s", (unsigned long)idx, jobName[j->kind], ok ? "OK" : "FAILED",
+            (unsigned long)(j->ticks / 50), (unsigned long)((j->ticks % 50) / 5));
+    LogAdd(m);
+  }
+  Job_SpinWait(&spinPort, &spinIo);
+  gQueueRunning = FALSE;
+
+  ULONG total = StampTicks() - t0;
+  sprintf(m, "Queue done: %lu job(s), %lu failed, %lu.%lu s.", (unsigned long)done, (unsigned long)failed,
+          (unsigned long)(total / 50), (unsigned long)((total % 50) / 5));
+  DrawStatus(m);
+}
+
+static void DoQueueRemove(void) {
+  if (gJobSel < 0) { DrawStatus("Select a job in the list first."); return; }
+  LONG i = 0;
+  struct Node *nd;
+  for (nd = gJobs.lh_Head; nd->ln_Succ && i < gJobSel; nd = nd->ln_Succ) ++i;
+  if (!nd->ln_Succ) { DrawStatus("Select a job in the list first."); return; }
+  Queue_Detach();
+  Remove(nd);
+  FreeVec(nd);
+  gJobCount--;
+  Queue_Attach();
+  Queue_Save();
+  DrawStatus("Job removed.");
+}
+
+static void DoQueueClear(void) {
+  Queue_Detach();
+  Queue_Free();
+  Queue_Attach();
+  Queue_Save();
+  DrawStatus("Queue cleared.");
+}
+
+/* ====== Duplication station ======
+ * One source (an image file or a master disk read once) stays resident in
+ * RAM; every armed unit gets a TD_ADDCHANGEINT interrupt that just wakes the
+ * loop, which compares TD_CHANGENUM per unit to find the new disk. A
+ * write-protected disk fails at once via TD_PROTSTATUS. Writes use ETD_WRITE
+ * with the change count, so a disk pulled mid-write errors out instead of
+ * the rest landing on the next one. Disks already present when the station
+ * starts are left alone.
+ */
+static void Station_ChangeInt(void) {
+  if (gStationTask) Signal(gStationTask, 1UL << gStationSigBit);
+}
+
+static UBYTE *Station_LoadImage(CONST_STRPTR path) {
+  struct ImgSrc src;
+  if (!Img_Open(&src, path)) return NULL;
+  if (src.size != (LONG)DISK_SIZE && !src.stream) { Img_Close(&src); LogAdd("Invalid ADF size (need 901,120 bytes)"); return NULL; }
+  UBYTE *img = (UBYTE*)AllocVec(DISK_SIZE, MEMF_ANY);
+  if (!img) { Img_Close(&src); LogAdd("No memory for resident image"); return NULL; }
+
+  BOOL ok = TRUE;
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    ok = (Img_Read(&src, img + t * TRACK_SIZE, TRACK_SIZE) == TRACK_SIZE);
+    DrawProgress((t+1) * TRACK_SIZE, DISK_SIZE);
+  }
+  if (ok) ok = Img_End(&src);
+  if (!ok) LogAdd(Img_Error(&src));
+  Img_Close(&src);
+  ClearProgress();
+  if (!ok) { FreeVec(img); return NULL; }
+  return img;
+}
+
+static UBYTE *Station_ReadMaster(UBYTE unit) {
   struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
-  if (!OpenTD(unit, &p, &io)) return;
+  if (!OpenTD(unit, &p, &io)) { LogAdd("Open trackdisk failed"); return NULL; }
+  UBYTE *img = (UBYTE*)AllocVec(DISK_SIZE, MEMF_ANY);
+  if (!img) { CloseTD(p, io); LogAdd("No memory for resident image"); return NULL; }
+
+  BOOL ok = TRUE;
+  for (ULONG c=0; c<CYLINDERS && ok; ++c) {
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)(img + c * 2 * TRACK_SIZE);
+    io->iotd_Req.io_Length  = 2 * TRACK_SIZE;
+    io->iotd_Req.io_Offset  = c * 2 * TRACK_SIZE;
+    if (Trace_DoIO((struct IORequest*)io) != 0) {
+      char m[64]; sprintf(m, "Master read error at cylinder %lu", (unsigned long)c); LogAdd(m);
+      ok = FALSE;
+    }
+    DrawProgress((c+1) * 2 * TRACK_SIZE, DISK_SIZE);
+  }
   io->iotd_Req.io_Command = TD_MOTOR;
-  io->iotd_Req.io_Length  = on ? 1 : 0;
-  (void)DoIO((struct IORequest*)io);
+  io->iotd_Req.io_Length  = 0;
+  Trace_DoIO((struct IORequest*)io);
   CloseTD(p, io);
+  ClearProgress();
+  if (!ok) { FreeVec(img); return NULL; }
+  return img;
 }
 
-static BOOL RawWritePass(UBYTE unit) {
-  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
-  if (!OpenTD(unit, &p, &io)) return FALSE;
+static BOOL Station_Arm(struct StationUnit *su, UBYTE unit) {
+  memset(su, 0, sizeof(*su));
+  if (!OpenTD(unit, &su->port, &su->io)) return FALSE;
+  if (!OpenTD(unit, &su->cport, &su->cio)) { CloseTD(su->port, su->io); su->io = NULL; return FALSE; }
+
+  su->io->iotd_Req.io_Command = TD_CHANGENUM;
+  Trace_DoIO((struct IORequest*)su->io);
+  su->changeNum = su->io->iotd_Req.io_Actual;
+
+  su->irq.is_Node.ln_Type = NT_INTERRUPT;
+  su->irq.is_Node.ln_Name = (char*)APP_NAME " station";
+  su->irq.is_Data = (APTR)su;
+  su->irq.is_Code = (void (*)(void))Station_ChangeInt;
+  su->cio->iotd_Req.io_Command = TD_ADDCHANGEINT;
+  su->cio->iotd_Req.io_Data    = (APTR)&su->irq;
+  su->cio->iotd_Req.io_Length  = sizeof(struct Interrupt);
+  Trace_SendIO((struct IORequest*)su->cio);     /* held by the device until TD_REMCHANGEINT */
+  su->armed = TRUE;
+  return TRUE;
+}
 
-  SetFloppyMotor(unit, TRUE);
+static void Station_Disarm(struct StationUnit *su) {
+  if (!su->armed) return;
+  su->cio->iotd_Req.io_Command = TD_REMCHANGEINT;
+  Trace_DoIO((struct IORequest*)su->cio);
+  CloseTD(su->cport, su->cio);
+  CloseTD(su->port, su->io);
+  su->armed = FALSE;
+}
 
-  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  UBYTE *verifyBuf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  if (!buf || !verifyBuf) {
-    if (buf) FreeVec(buf);
-    if (verifyBuf) FreeVec(verifyBuf);
-    CloseTD(p, io);
+static BOOL Station_WriteDisk(struct StationUnit *su, UBYTE unit, const UBYTE *img) {
+  struct IOExtTD *io = su->io;
+  char m[80];
+
+  io->iotd_Req.io_Command = TD_PROTSTATUS;
+  Trace_DoIO((struct IORequest*)io);
+  if (io->iotd_Req.io_Actual != 0) {
+    sprintf(m, "DF%u: write-protected, skipped", (unsigned)unit); LogAdd(m);
     return FALSE;
   }
-  memset(buf, 0, TRACK_SIZE);
 
+  sprintf(m, "DF%u: writing...", (unsigned)unit); LogAdd(m);
+  /* ETD_FORMAT formats and writes a blank in one pass; a cylinder the
+   * drive rejects goes again with ETD_WRITE */
   BOOL ok = TRUE;
-  for (ULONG t=0; t<TRACKS; ++t) {
-    int maxRetry = (t == 0) ? 5 : 2;  // More retries on track 0
-    BOOL success = FALSE;
+  UWORD cmd = (gProf[unit].format != PROF_FMT_NO) ? ETD_FORMAT : ETD_WRITE;
+  for (ULONG c=0; c<CYLINDERS && ok; ++c) {
+    io->iotd_Req.io_Command = cmd;
+    io->iotd_Req.io_Data    = (APTR)(img + c * 2 * TRACK_SIZE);
+    io->iotd_Req.io_Length  = 2 * TRACK_SIZE;
+    io->iotd_Req.io_Offset  = c * 2 * TRACK_SIZE;
+    io->iotd_Count          = su->changeNum;
+    BYTE err = Trace_DoIO((struct IORequest*)io);
+    if (err != 0 && cmd == ETD_FORMAT && err != TDERR_DiskChanged) {
+      io->iotd_Req.io_Command = ETD_WRITE;
+      err = Trace_DoIO((struct IORequest*)io);
+    }
+    if (err != 0) {
+      sprintf(m, "DF%u: write error at cylinder %lu", (unsigned)unit, (unsigned long)c); LogAdd(m);
+      ok = FALSE;
+    }
+    DrawProgress((c+1) * 2 * TRACK_SIZE, DISK_SIZE);
+  }
+  if (ok) {
+    io->iotd_Req.io_Command = CMD_UPDATE;
+    if (Trace_DoIO((struct IORequest*)io) != 0) { sprintf(m, "DF%u: write error (flush)", (unsigned)unit); LogAdd(m); ok = FALSE; }
+  }
+  io->iotd_Req.io_Command = TD_MOTOR;
+  io->iotd_Req.io_Length  = 0;
+  Trace_DoIO((struct IORequest*)io);
+  ClearProgress();
+  if (ok) { sprintf(m, "DF%u: done, insert next disk", (unsigned)unit); LogAdd(m); }
+  return ok;
+}
 
-    if (t == 0) {
-      // Pre-scrub with pattern A5
-      memset(buf, 0xA5, TRACK_SIZE);
-      io->iotd_Req.io_Command = CMD_WRITE;
-      io->iotd_Req.io_Data    = (APTR)buf;
-      io->iotd_Req.io_Length  = TRACK_SIZE;
-      io->iotd_Req.io_Offset  = 0;
-      DoIO((struct IORequest*)io); // Ignore result
+static void Station_Status(struct StationUnit *su, UBYTE mask, ULONG t0) {
+  ULONG okTotal = 0, secs = (StampTicks() - t0) / 50;
+  char m[128], *q = m;
+  for (UBYTE u=0; u<STATION_UNITS; ++u) if (mask & (1 << u)) okTotal += su[u].ok;
+  if (secs < 1) secs = 1;
+  ULONG rate10 = okTotal * 36000UL / secs;         /* disks per hour x10 */
+  q += sprintf(q, "Station: %lu ok, %lu.%lu/h | fail", (unsigned long)okTotal,
+               (unsigned long)(rate10 / 10), (unsigned long)(rate10 % 10));
+  for (UBYTE u=0; u<STATION_UNITS; ++u)
+    if (mask & (1 << u)) q += sprintf(q, " DF%u:%lu", (unsigned)u, (unsigned long)su[u].fail);
+  DrawStatus(m);
+}
 
-      // Pre-scrub with pattern 00
-      memset(buf, 0x00, TRACK_SIZE);
-      io->iotd_Req.io_Command = CMD_WRITE;
-      io->iotd_Req.io_Data    = (APTR)buf;
-      io->iotd_Req.io_Length  = TRACK_SIZE;
-      io->iotd_Req.io_Offset  = 0;
-      DoIO((struct IORequest*)io); // Ignore result
+static void DoStation(void) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title,
+                           (UBYTE*)"Station source: an image file, or a master\ndisk read once into memory?",
+                           (UBYTE*)"Image...|Master disk|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel < 1 || sel > 2) { DrawStatus("Station canceled."); return; }
+
+  LogClear();
+  UBYTE master = 0xFF;
+  UBYTE *img = NULL;
+  if (sel == 1) {
+    char path[300];
+    if (!ASL_OpenFile(path, sizeof(path), "Select ADF/ADZ/DMS for the station...", "RAM:floppy.adf")) { DrawStatus("Station canceled."); return; }
+    DrawStatus("Loading image into memory...");
+    img = Station_LoadImage(path);
+  } else {
+    if (!AskFloppyUnit(&master, "STATION master (source)")) { DrawStatus("Station canceled."); return; }
+    DrawStatus("Reading master disk into memory...");
+    img = Station_ReadMaster(master);
+  }
+  if (!img) { DrawStatus("Station: no source image."); return; }
+  gBootAlert[0] = '\0';
+  Boot_Report(img);
+  if (!Boot_Confirm()) { FreeVec(img); DrawStatus("Station canceled: virus in bootblock."); return; }
+
+  UBYTE mask = AskUnitMask("Station target units", master);
+  if (!mask) { FreeVec(img); DrawStatus("Station canceled."); return; }
+
+  gStationSigBit = AllocSignal(-1);
+  if (gStationSigBit < 0) { FreeVec(img); DrawStatus("Station: no free signal."); return; }
+  struct StationUnit su[STATION_UNITS];
+  memset(su, 0, sizeof(su));
+  gStationTask = FindTask(NULL);
+  for (UBYTE u=0; u<STATION_UNITS; ++u) {
+    if (!(mask & (1 << u))) continue;
+    if (!Station_Arm(&su[u], u)) {
+      char m[48]; sprintf(m, "DF%u: cannot open, not armed", (unsigned)u); LogAdd(m);
+      mask &= (UBYTE)~(1 << u);
     }
+  }
 
-    while (maxRetry-- > 0 && !success) {
+  ULONG t0 = StampTicks();
+  ULONG winSig = 1UL << ui.win->UserPort->mp_SigBit, stSig = 1UL << gStationSigBit;
+  BOOL running = (mask != 0);
+  if (running) { LogAdd("Station armed: insert disks. Esc or Station stops."); Station_Status(su, mask, t0); }
 
-    // Try CMD_FORMAT if supported
-    io->iotd_Req.io_Command = CMD_FORMAT;
-    io->iotd_Req.io_Data    = (APTR)NULL;
+  while (running) {
+    ULONG motorSig = Motor_Signal();
+    ULONG sigs = Wait(winSig | stSig | motorSig | SIGBREAKF_CTRL_C);
+    if (sigs & SIGBREAKF_CTRL_C) running = FALSE;
+    if (sigs & motorSig) Motor_Poll();
+
+    if (sigs & winSig) {
+      struct IntuiMessage *imsg;
+      while ((imsg = GT_GetIMsg(ui.win->UserPort)) != NULL) {
+        ULONG cls = imsg->Class; UWORD code = imsg->Code; APTR iad = imsg->IAddress;
+        GT_ReplyIMsg(imsg);
+        if (cls == IDCMP_REFRESHWINDOW) { GT_BeginRefresh(ui.win); RedrawAll(); GT_EndRefresh(ui.win, TRUE); }
+        else if (cls == IDCMP_CLOSEWINDOW || (cls == IDCMP_VANILLAKEY && code == 27)) running = FALSE;
+        else if (cls == IDCMP_GADGETUP && ((struct Gadget*)iad)->GadgetID == GID_STATION) running = FALSE;
+      }
+    }
+
+    if (running && (sigs & stSig)) {
+      for (UBYTE u=0; u<STATION_UNITS; ++u) {
+        if (!(mask & (1 << u))) continue;
+        struct IOExtTD *io = su[u].io;
+        io->iotd_Req.io_Command = TD_CHANGENUM;
+        Trace_DoIO((struct IORequest*)io);
+        if (io->iotd_Req.io_Actual == su[u].changeNum) continue;
+        su[u].changeNum = io->iotd_Req.io_Actual;
+        io->iotd_Req.io_Command = TD_CHANGESTATE;
+        Trace_DoIO((struct IORequest*)io);
+        if (io->iotd_Req.io_Actual != 0) continue;      /* removed, not inserted */
+        if (Station_WriteDisk(&su[u], u, img)) su[u].ok++; else su[u].fail++;
+        Station_Status(su, mask, t0);
+      }
+    }
+  }
+
+  for (UBYTE u=0; u<STATION_UNITS; ++u) Station_Disarm(&su[u]);
+  gStationTask = NULL;
+  FreeSignal(gStationSigBit);
+  gStationSigBit = -1;
+  FreeVec(img);
+  if (mask) Station_Status(su, mask, t0);
+  else DrawStatus("Station: no unit could be armed.");
+  LogAdd("Station stopped.");
+}
+
+/* ====== Multi-unit capture ======
+ * Reads every picked unit into its own ADF at once. Each unit has its own
+ * trackdisk request and two track buffers: as soon as a read completes the
+ * next one is queued on that unit, then the finished track is written to
+ * its file. trackdisk runs a task per unit and disk.resource lends the
+ * controller to one of them at a time, so the disk DMA itself stays
+ * serialized; spin-up, head settling, decoding and the DOS writes of one
+ * unit overlap the transfers of the others. No journal in this mode:
+ * failed tracks are zeros until the recovery pass, run per unit at the end.
+ */
+
+/* "RAM:disk.adf" -> "RAM:disk_df1.adf" */
+static void Multi_Path(CONST_STRPTR base, UBYTE unit, char *out, int max) {
+  const char *b = (const char*)base;
+  const char *dot = strrchr(b, '.');
+  if (dot && (strchr(dot, '/') || strchr(dot, ':'))) dot = NULL;
+  if (dot) snprintf(out, max, "%.*s_df%u%s", (int)(dot - b), b, (unsigned)unit, dot);
+  else     snprintf(out, max, "%s_df%u.adf", b, (unsigned)unit);
+}
+
+static void Multi_Send(struct CapUnit *cu) {
+  struct IOExtTD *io = cu->io;
+  io->iotd_Req.io_Command = CMD_READ;
+  io->iotd_Req.io_Data    = (APTR)(cu->buf + (cu->next & 1) * TRACK_SIZE);
+  io->iotd_Req.io_Length  = TRACK_SIZE;
+  io->iotd_Req.io_Offset  = cu->next * TRACK_SIZE;
+  Trace_SendIO((struct IORequest*)io);
+  cu->busy = TRUE;
+}
+
+static void Multi_Stop(struct CapUnit *cu) {
+  if (!cu->busy) return;
+  AbortIO((struct IORequest*)cu->io);
+  Trace_WaitIO((struct IORequest*)cu->io);
+  cu->busy = FALSE;
+}
+
+static BOOL Multi_Open(struct CapUnit *cu, UBYTE unit) {
+  char m[64];
+  if (!OpenTD(unit, &cu->port, &cu->io)) { sprintf(m, "DF%u: open trackdisk failed", (unsigned)unit); LogAdd(m); return FALSE; }
+  cu->buf = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_CLEAR);
+  cu->bad = (struct BadMap*)AllocVec(sizeof(struct BadMap), MEMF_CLEAR);
+  if (!cu->buf || !cu->bad) { sprintf(m, "DF%u: no memory", (unsigned)unit); LogAdd(m); return FALSE; }
+  cu->fh = Open((STRPTR)cu->path, MODE_NEWFILE);
+  if (!cu->fh) { sprintf(m, "DF%u: cannot create ADF file", (unsigned)unit); LogAdd(m); return FALSE; }
+  cu->ok = TRUE;
+  return TRUE;
+}
+
+static void Multi_Close(struct CapUnit *cu) {
+  Multi_Stop(cu);
+  if (cu->fh)  Close(cu->fh);
+  if (cu->buf) FreeVec(cu->buf);
+  if (cu->bad) FreeVec(cu->bad);
+  CloseTD(cu->port, cu->io);
+  cu->fh = 0; cu->buf = NULL; cu->bad = NULL; cu->port = NULL; cu->io = NULL;
+}
+
+/* Per-unit percent and the aggregate rate over all units */
+static void Multi_Status(struct CapUnit *cu, UBYTE mask, ULONG t0) {
+  ULONG bytes = 0, ticks = StampTicks() - t0;
+  char m[128], *q = m;
+  for (UBYTE u=0; u<MULTI_UNITS; ++u) {
+    if (!(mask & (1 << u))) continue;
+    bytes += cu[u].done * TRACK_SIZE;
+    q += sprintf(q, "DF%u %lu%%  ", (unsigned)u, (unsigned long)(cu[u].done * 100 / TRACKS));
+  }
+  if (ticks < 1) ticks = 1;
+  sprintf(q, "| %lu KB/s", (unsigned long)(bytes / 1024 * 50 / ticks));
+  DrawStatus(m);
+}
+
+static void Multi_Progress(struct CapUnit *cu, UBYTE mask) {
+  ULONG done[MULTI_UNITS];
+  UBYTE n = 0;
+  for (UBYTE u=0; u<MULTI_UNITS; ++u) if (mask & (1 << u)) done[n++] = cu[u].done;
+  DrawProgressParts(done, n, TRACKS);
+}
+
+/* Deferred pass for one unit, then its .bad map */
+static void Multi_Recover(struct CapUnit *cu, UBYTE unit) {
+  struct BadMap *bm = cu->bad;
+  struct RecoverCtx rc;
+  char m[80];
+  sprintf(m, "DF%u: %lu track(s) failed", (unsigned)unit, (unsigned long)bm->nFailed);
+  DrawStatus(m);
+  if (Recover_Start(&rc, bm)) {
+    sprintf(m, "DF%u: recovering failed tracks...", (unsigned)unit); DrawStatus(m);
+    ULONG n = 0;
+    for (ULONG t=0; t<TRACKS && cu->ok; ++t) {
+      if (!bm->failed[t]) continue;
+      Recover_Track(&rc, cu->io, t, cu->buf, bm);
+      if (Seek(cu->fh, (LONG)(t * TRACK_SIZE), OFFSET_BEGINNING) < 0 ||
+          Trace_Write(cu->fh, cu->buf, TRACK_SIZE) != TRACK_SIZE) { cu->ok = FALSE; LogAdd("File write error"); }
+      DrawProgress(++n, bm->nFailed);
+    }
+    Recover_Close(&rc);
+  }
+  if (cu->ok && !BadMap_Save(bm, cu->path)) LogAdd("Bad-sector map not saved");
+}
+
+static void DoCaptureMulti(void) {
+  UBYTE mask = AskUnitMask("Capture units", 0xFF);
+  if (!mask) { DrawStatus("Read ADF canceled."); return; }
+  char base[300];
+  if (!ASL_OpenFile(base, sizeof(base), "Base name for the ADFs (_dfN is added)...", gSess.open ? gSess.dir : "RAM:disk.adf")) { DrawStatus("Read ADF canceled."); return; }
+  if (IsAdzPath(base)) { DrawStatus("Multi-unit capture writes raw .adf only."); return; }
+
+  LogClear();
+  gBootAlert[0] = '\0';
+  static struct CapUnit cu[MULTI_UNITS];
+  memset(cu, 0, sizeof(cu));
+  ULONG portSigs = 0;
+  for (UBYTE u=0; u<MULTI_UNITS; ++u) {
+    if (!(mask & (1 << u))) continue;
+    Multi_Path(base, u, cu[u].path, sizeof(cu[u].path));
+    if (!Multi_Open(&cu[u], u)) { Multi_Close(&cu[u]); mask &= (UBYTE)~(1 << u); continue; }
+    portSigs |= 1UL << cu[u].port->mp_SigBit;
+  }
+  if (!mask) { DrawStatus("Read ADF failed."); return; }
+
+  /* Every unit gets its first read before any completes: the spin-ups overlap */
+  for (UBYTE u=0; u<MULTI_UNITS; ++u) if (mask & (1 << u)) Multi_Send(&cu[u]);
+  LogAdd("Capturing. Esc stops.");
+
+  ULONG t0 = StampTicks(), shown = t0;
+  ULONG winSig = 1UL << ui.win->UserPort->mp_SigBit;
+  BOOL running = TRUE, busy = TRUE;
+  Multi_Progress(cu, mask);
+  while (running && busy) {
+    ULONG sigs = Wait(portSigs | winSig | SIGBREAKF_CTRL_C);
+    if (sigs & SIGBREAKF_CTRL_C) running = FALSE;
+    if (sigs & winSig) {
+      struct IntuiMessage *imsg;
+      while ((imsg = GT_GetIMsg(ui.win->UserPort)) != NULL) {
+        ULONG cls = imsg->Class; UWORD code = imsg->Code;
+        GT_ReplyIMsg(imsg);
+        if (cls == IDCMP_REFRESHWINDOW) { GT_BeginRefresh(ui.win); RedrawAll(); GT_EndRefresh(ui.win, TRUE); }
+        else if (cls == IDCMP_CLOSEWINDOW || (cls == IDCMP_VANILLAKEY && code == 27)) running = FALSE;
+      }
+    }
+
+    BOOL finished = FALSE;
+    busy = FALSE;
+    for (UBYTE u=0; u<MULTI_UNITS && running; ++u) {
+      struct CapUnit *c = &cu[u];
+      if (!c->busy) continue;
+      if (!CheckIO((struct IORequest*)c->io)) { busy = TRUE; continue; }
+      BOOL got = (Trace_WaitIO((struct IORequest*)c->io) == 0);
+      ULONG t = c->next;
+      UBYTE *cur = c->buf + (t & 1) * TRACK_SIZE;
+      c->busy = FALSE;
+      /* Queue the next track first: it runs while this one is written */
+      if (++c->next < TRACKS) Multi_Send(c);
+
+      char m[64];
+      if (!got) {
+        sprintf(m, "DF%u: read error at track %lu, deferred", (unsigned)u, (unsigned long)t); LogAdd(m);
+        BadMap_FailTrack(c->bad, t);
+        memset(cur, 0, TRACK_SIZE);
+      } else if (t == 0) Boot_Report(cur);
+      if (Trace_Write(c->fh, cur, TRACK_SIZE) != TRACK_SIZE) {
+        sprintf(m, "DF%u: file write error", (unsigned)u); LogAdd(m);
+        c->ok = FALSE;
+        Multi_Stop(c);
+      } else c->done++;
+      if (c->busy) busy = TRUE; else finished = TRUE;
+    }
+
+    ULONG now = StampTicks();
+    if (finished || now - shown >= 25) {
+      Multi_Progress(cu, mask);
+      Multi_Status(cu, mask, t0);
+      shown = now;
+    }
+  }
+  ULONG ticks = StampTicks() - t0;
+
+  for (UBYTE u=0; u<MULTI_UNITS; ++u) {
+    if (!(mask & (1 << u))) continue;
+    Multi_Stop(&cu[u]);
+    if (running && cu[u].ok && cu[u].bad->nFailed) Multi_Recover(&cu[u], u);
+  }
+
+  ULONG bytes = 0, units = 0, okUnits = 0;
+  char m[160];
+  for (UBYTE u=0; u<MULTI_UNITS; ++u) {
+    if (!(mask & (1 << u))) continue;
+    struct CapUnit *c = &cu[u];
+    bytes += c->done * TRACK_SIZE;
+    units++;
+    if (c->ok && c->done == TRACKS) {
+      okUnits++;
+      if (c->bad->nBad) sprintf(m, "DF%u: %.100s, %lu bad sector(s)", (unsigned)u, c->path, (unsigned long)c->bad->nBad);
+      else              sprintf(m, "DF%u: %.100s", (unsigned)u, c->path);
+    } else sprintf(m, "DF%u: incomplete (%lu/%u tracks) %.90s", (unsigned)u, (unsigned long)c->done, TRACKS, c->path);
+    LogAdd(m);
+    Multi_Close(c);
+    Motor_Release(u);
+  }
+  if (ticks < 1) ticks = 1;
+  sprintf(m, "%lu of %lu ADF(s) saved, %lu KB/s overall%s", (unsigned long)okUnits, (unsigned long)units,
+          (unsigned long)(bytes / 1024 * 50 / ticks), running ? "." : " (stopped)");
+  DrawStatus(m);
+  Boot_Alert();
+  ClearProgress();
+}
+
+/* ====== Track/sector patches ======
+ * Make Patch compares two images track by track (.adf, .adz or .dms) and
+ * keeps only the sectors that differ. Apply Patch works on a raw ADF in
+ * place or on a disk: pass 1 reads every track and proves the base CRC32
+ * and the result CRC32 before anything is written, pass 2 rewrites only
+ * the patched tracks and reads each one back.
+ */
+struct PatchDst { BPTR fh; struct IOExtTD *io; };   /* ADF file or trackdisk unit */
+
+static ULONG TrackCrc(const UBYTE *buf) {
+  return crc32_final(crc32_update(crc32_init(), buf, TRACK_SIZE));
+}
+
+static BOOL Patch_Track(struct PatchDst *pd, UWORD cmd, ULONG t, UBYTE *buf) {
+  if (pd->io) {
+    pd->io->iotd_Req.io_Command = cmd;
+    pd->io->iotd_Req.io_Data    = (APTR)buf;
+    pd->io->iotd_Req.io_Length  = TRACK_SIZE;
+    pd->io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+    if (Trace_DoIO((struct IORequest*)pd->io) != 0) return FALSE;
+    if (cmd != CMD_WRITE) return TRUE;
+    /* Flush, then drop the track buffer so the read-back comes from the disk */
+    pd->io->iotd_Req.io_Command = CMD_UPDATE;
+    if (Trace_DoIO((struct IORequest*)pd->io) != 0) return FALSE;
+    pd->io->iotd_Req.io_Command = CMD_CLEAR;
+    Trace_DoIO((struct IORequest*)pd->io);
+    return TRUE;
+  }
+  if (Seek(pd->fh, (LONG)(t * TRACK_SIZE), OFFSET_BEGINNING) < 0) return FALSE;
+  if (cmd == CMD_WRITE) return Trace_Write(pd->fh, buf, TRACK_SIZE) == TRACK_SIZE;
+  return Trace_Read(pd->fh, buf, TRACK_SIZE) == TRACK_SIZE;
+}
+
+static BOOL Patch_Make(CONST_STRPTR basePath, CONST_STRPTR newPath, CONST_STRPTR outPath) {
+  struct ImgSrc a, b;
+  if (!Img_Open(&a, basePath)) return FALSE;
+  if (!Img_Open(&b, newPath)) { Img_Close(&a); return FALSE; }
+  if (a.size != (LONG)DISK_SIZE || b.size != (LONG)DISK_SIZE) {
+    Img_Close(&a); Img_Close(&b);
+    LogAdd("Both images must be 901,120 bytes");
+    return FALSE;
+  }
+
+  static struct PatchRec rec;
+  UBYTE *buf = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_ANY);
+  BPTR fh = buf ? Open((STRPTR)outPath, MODE_NEWFILE) : 0;
+  if (!fh) {
+    if (buf) FreeVec(buf);
+    Img_Close(&a); Img_Close(&b);
+    LogAdd(buf ? "Cannot create patch file" : "No memory");
+    return FALSE;
+  }
+
+  struct PatchHead ph;
+  UBYTE hb[PATCH_HEAD_SIZE];
+  ULONG ca = crc32_init(), cb = crc32_init(), sectors = 0;
+  memset(&ph, 0, sizeof(ph));
+  patch_put_head(hb, &ph);                       /* rewritten at the end */
+  BOOL ok = (Trace_Write(fh, hb, PATCH_HEAD_SIZE) == PATCH_HEAD_SIZE);
+  if (!ok) LogAdd("Patch write error");
+
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    if (Img_Read(&a, buf, TRACK_SIZE) != TRACK_SIZE)              { LogAdd(Img_Error(&a)); ok = FALSE; break; }
+    if (Img_Read(&b, buf + TRACK_SIZE, TRACK_SIZE) != TRACK_SIZE) { LogAdd(Img_Error(&b)); ok = FALSE; break; }
+    ca = crc32_update(ca, buf, TRACK_SIZE);
+    cb = crc32_update(cb, buf + TRACK_SIZE, TRACK_SIZE);
+    if (patch_diff(&rec, (UWORD)t, buf, buf + TRACK_SIZE)) {
+      UBYTE rb[PATCH_REC_SIZE];
+      LONG dl = (LONG)(patch_rec_len(&rec) - PATCH_REC_SIZE);
+      patch_put_rec(rb, &rec);
+      if (Trace_Write(fh, rb, PATCH_REC_SIZE) != PATCH_REC_SIZE || Trace_Write(fh, rec.data, dl) != dl) {
+        LogAdd("Patch write error"); ok = FALSE; break;
+      }
+      ph.count++;
+      sectors += patch_sectors(rec.mask);
+    }
+    DrawProgress(t+1, TRACKS);
+  }
+  if (ok && (!Img_End(&a) || !Img_End(&b))) { LogAdd("Image stream corrupt (CRC/data)"); ok = FALSE; }
+
+  ph.baseCrc = crc32_final(ca);
+  ph.newCrc  = crc32_final(cb);
+  LONG size = Seek(fh, 0, OFFSET_BEGINNING);
+  patch_put_head(hb, &ph);
+  if (ok && (size < 0 || Trace_Write(fh, hb, PATCH_HEAD_SIZE) != PATCH_HEAD_SIZE)) { LogAdd("Patch write error"); ok = FALSE; }
+  Close(fh);
+  FreeVec(buf);
+  Img_Close(&a); Img_Close(&b);
+
+  if (!ok) { DeleteFile((STRPTR)outPath); return FALSE; }
+  char m[100];
+  sprintf(m, "%lu track(s), %lu sector(s) changed, %ld bytes", (unsigned long)ph.count,
+          (unsigned long)sectors, (long)size);
+  LogAdd(m);
+  sprintf(m, "Base CRC32 %08lx -> result %08lx", (unsigned long)ph.baseCrc, (unsigned long)ph.newCrc);
+  LogAdd(m);
+  return TRUE;
+}
+
+static BOOL Patch_Apply(CONST_STRPTR patchPath, struct PatchDst *pd) {
+  BPTR pf = Open((STRPTR)patchPath, MODE_OLDFILE);
+  if (!pf) { LogAdd("Cannot open patch"); return FALSE; }
+  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_ANY);
+  if (!buf) { Close(pf); LogAdd("No memory"); return FALSE; }
+
+  static struct PatchIn pi;
+  static struct PatchRec rec;
+  struct PatchHead ph;
+  char m[100];
+  BOOL ok = (patch_open(&pi, &ph, Gz_DosRead, (void*)pf) == PATCH_OK);
+  if (!ok) LogAdd("Not a valid patch file");
+  else {
+    sprintf(m, "Patch: %lu track(s), CRC32 %08lx -> %08lx", (unsigned long)ph.count,
+            (unsigned long)ph.baseCrc, (unsigned long)ph.newCrc);
+    LogAdd(m);
+  }
+
+  /* Pass 1: base and result CRC of the whole target, nothing written yet */
+  DrawStatus("Checking target against patch...");
+  ULONG baseCrc = crc32_init(), newCrc = crc32_init();
+  BOOL trackBad = FALSE;
+  int rc = ok ? patch_read_rec(&pi, &rec) : PATCH_END;
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    if (!Patch_Track(pd, CMD_READ, t, buf)) {
+      sprintf(m, "Read error at track %lu", (unsigned long)t); LogAdd(m);
+      ok = FALSE; break;
+    }
+    baseCrc = crc32_update(baseCrc, buf, TRACK_SIZE);
+    if (rc == PATCH_OK && rec.track == t) {
+      if (TrackCrc(buf) != rec.baseCrc) trackBad = TRUE;
+      patch_apply(&rec, buf);
+      rc = patch_read_rec(&pi, &rec);
+    }
+    newCrc = crc32_update(newCrc, buf, TRACK_SIZE);
+    DrawProgress(t+1, TRACKS);
+  }
+  baseCrc = crc32_final(baseCrc);
+  newCrc  = crc32_final(newCrc);
+  if (ok && rc != PATCH_END) { LogAdd("Patch file corrupt"); ok = FALSE; }
+  if (ok && baseCrc != ph.baseCrc) {
+    if (baseCrc == ph.newCrc) LogAdd("Patch already applied");
+    else { sprintf(m, "Wrong base: CRC32 %08lx, patch needs %08lx", (unsigned long)baseCrc, (unsigned long)ph.baseCrc); LogAdd(m); }
+    ok = FALSE;
+  } else if (ok && (trackBad || newCrc != ph.newCrc)) {
+    LogAdd("Patch does not match its base (result CRC)");
+    ok = FALSE;
+  }
+
+  /* Pass 2: patched tracks only, each one read back */
+  if (ok && (Seek(pf, 0, OFFSET_BEGINNING) < 0 || patch_open(&pi, &ph, Gz_DosRead, (void*)pf) != PATCH_OK)) {
+    LogAdd("Patch read error"); ok = FALSE;
+  }
+  if (ok) DrawStatus("Writing patched tracks...");
+  ULONG n = 0;
+  while (ok && (rc = patch_read_rec(&pi, &rec)) == PATCH_OK) {
+    ULONG t = rec.track;
+    if (!Patch_Track(pd, CMD_READ, t, buf) || TrackCrc(buf) != rec.baseCrc) {
+      sprintf(m, "Track %lu changed since the check", (unsigned long)t); LogAdd(m);
+      ok = FALSE; break;
+    }
+    patch_apply(&rec, buf);
+    ULONG want = TrackCrc(buf);
+    if (!Patch_Track(pd, CMD_WRITE, t, buf)) {
+      sprintf(m, "Write error at track %lu", (unsigned long)t); LogAdd(m);
+      ok = FALSE; break;
+    }
+    if (!Patch_Track(pd, CMD_READ, t, buf) || TrackCrc(buf) != want) {
+      sprintf(m, "Track %lu failed read-back", (unsigned long)t); LogAdd(m);
+      ok = FALSE; break;
+    }
+    DrawProgress(++n, ph.count);
+  }
+  if (ok && rc != PATCH_END) { LogAdd("Patch read error"); ok = FALSE; }
+  if (ok) {
+    sprintf(m, "%lu track(s) patched, CRC32 %08lx", (unsigned long)n, (unsigned long)ph.newCrc);
+    LogAdd(m);
+  }
+
+  FreeVec(buf);
+  Close(pf);
+  return ok;
+}
+
+static void DoMakePatch(void) {
+  char basePath[300], newPath[300], outPath[300];
+  if (!ASL_OpenFile(basePath, sizeof(basePath), "Select the OLD (base) image...", "RAM:floppy.adf") ||
+      !ASL_OpenFile(newPath, sizeof(newPath), "Select the NEW image...", basePath) ||
+      !ASL_OpenFile(outPath, sizeof(outPath), "Save patch as...", "RAM:floppy.adp")) {
+    DrawStatus("Make patch canceled."); return;
+  }
+  LogClear();
+  DrawStatus("Comparing images...");
+  BOOL ok = Patch_Make(basePath, newPath, outPath);
+  DrawStatus(ok ? "Patch saved." : "Make patch failed.");
+  ClearProgress();
+}
+
+static void DoApplyPatch(void) {
+  char patchPath[300];
+  if (!ASL_OpenFile(patchPath, sizeof(patchPath), "Select patch (.adp)...", "RAM:floppy.adp")) { DrawStatus("Apply patch canceled."); return; }
+
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title,
+                           (UBYTE*)"Apply the patch to an ADF file (in place)\nor to a disk in a drive?",
+                           (UBYTE*)"ADF File...|Disk...|Cancel" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel < 1) { DrawStatus("Apply patch canceled."); return; }
+
+  struct PatchDst pd;
+  memset(&pd, 0, sizeof(pd));
+  BOOL ok = FALSE;
+  if (sel == 1) {
+    char adfPath[300];
+    if (!ASL_OpenFile(adfPath, sizeof(adfPath), "Select ADF to patch...", "RAM:floppy.adf")) { DrawStatus("Apply patch canceled."); return; }
+    LogClear();
+    pd.fh = Open((STRPTR)adfPath, MODE_OLDFILE);
+    if (!pd.fh) LogAdd("Cannot open ADF");
+    else {
+      ok = Patch_Apply(patchPath, &pd);
+      Close(pd.fh);
+    }
+  } else {
+    UBYTE unit;
+    struct MsgPort *p = NULL;
+    if (!AskFloppyUnit(&unit, "APPLY PATCH (target DFx:)")) { DrawStatus("Apply patch canceled."); return; }
+    LogClear();
+    if (!OpenTD(unit, &p, &pd.io)) LogAdd("Open trackdisk failed");
+    else {
+      pd.io->iotd_Req.io_Command = TD_PROTSTATUS;
+      Trace_DoIO((struct IORequest*)pd.io);
+      if (pd.io->iotd_Req.io_Actual != 0) LogAdd("Disk is write-protected");
+      else {
+        SetFloppyMotor(unit, TRUE);
+        ok = Patch_Apply(patchPath, &pd);
+        Motor_Release(unit);
+      }
+      CloseTD(p, pd.io);
+    }
+  }
+  DrawStatus(ok ? "Patch applied and verified." : "Apply patch failed.");
+  ClearProgress();
+}
+
+/* ====== Drive benchmark ======
+ * Read-only checks on a test disk, timed with the E-clock (timer.device):
+ * rotation period from index-synced raw reads, track-to-track and
+ * full-stroke TD_SEEK, sustained CMD_READ by cylinder, and the share of
+ * sectors that fail their checksum on a single raw read (what trackdisk
+ * would have to retry). Every run is appended to BENCH_FILE; the unit's
+ * first run there is its baseline.
+ */
+static ULONG gEFreq = 0;                       /* E-clock ticks per second */
+
+static ULONG Bench_Us(const struct EClockVal *a, const struct EClockVal *b) {
+  ULONG t = b->ev_lo - a->ev_lo, f = gEFreq;   /* wraps after ~100 min, fine here */
+  ULONG r = (t % f) * 1000;
+  return (t / f) * 1000000UL + (r / f) * 1000 + (r % f) * 1000 / f;
+}
+
+static BOOL Bench_Seek(struct IOExtTD *io, ULONG cyl) {
+  io->iotd_Req.io_Flags   = 0;
+  io->iotd_Req.io_Command = TD_SEEK;
+  io->iotd_Req.io_Offset  = cyl * 2 * TRACK_SIZE;
+  return Trace_DoIO((struct IORequest*)io) == 0;
+}
+
+static BOOL Bench_Run(struct IOExtTD *io, struct RecoverCtx *rc, UBYTE *buf, struct BenchResult *r) {
+  struct EClockVal t0, t1;
+  ULONG us = 0;
+
+  /* Rotation: each index-synced raw read starts at the next index pulse */
+  DrawStatus("Benchmark: rotation...");
+  io->iotd_Req.io_Command = TD_RAWREAD;
+  io->iotd_Req.io_Flags   = IOTDF_INDEXSYNC;
+  io->iotd_Req.io_Data    = (APTR)rc->raw;
+  io->iotd_Req.io_Length  = 1024;              /* ~16 ms, well inside one turn */
+  io->iotd_Req.io_Offset  = 0;
+  if (Trace_DoIO((struct IORequest*)io) != 0) { io->iotd_Req.io_Flags = 0; LogAdd("Raw read failed (no disk?)"); return FALSE; }
+  ReadEClock(&t0);
+  for (ULONG i=0; i<BENCH_TURNS; ++i) Trace_DoIO((struct IORequest*)io);
+  ReadEClock(&t1);
+  io->iotd_Req.io_Flags = 0;
+  r->rotUs = Bench_Us(&t0, &t1) / BENCH_TURNS;
+
+  /* Seeks: single steps outwards, then end to end */
+  DrawStatus("Benchmark: seek times...");
+  Bench_Seek(io, 0);
+  for (ULONG c=1; c<=BENCH_STEPS; ++c) {
+    ReadEClock(&t0); Bench_Seek(io, c); ReadEClock(&t1);
+    us += Bench_Us(&t0, &t1);
+  }
+  r->stepUs = us / BENCH_STEPS;
+  us = 0;
+  for (ULONG i=0; i<BENCH_STROKES; ++i) {
+    ReadEClock(&t0); Bench_Seek(io, (i & 1) ? 0 : CYLINDERS-1); ReadEClock(&t1);
+    us += Bench_Us(&t0, &t1);
+  }
+  r->strokeUs = us / BENCH_STROKES;
+
+  /* Sustained read, a cylinder per request as the copy loops do */
+  DrawStatus("Benchmark: read throughput...");
+  io->iotd_Req.io_Command = CMD_CLEAR;
+  Trace_DoIO((struct IORequest*)io);
+  Bench_Seek(io, 0);
+  r->readErr = 0;
+  ReadEClock(&t0);
+  for (ULONG c=0; c<CYLINDERS; ++c) {
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)buf;
+    io->iotd_Req.io_Length  = 2 * TRACK_SIZE;
+    io->iotd_Req.io_Offset  = c * 2 * TRACK_SIZE;
+    if (Trace_DoIO((struct IORequest*)io) != 0) r->readErr++;
+    DrawProgress(c+1, CYLINDERS);
+  }
+  ReadEClock(&t1);
+  us = Bench_Us(&t0, &t1) / 1000;
+  r->readBps = us ? (ULONG)DISK_SIZE * 1000UL / us : 0;
+
+  /* Raw single-read sector failures over every BENCH_RAW_STEP-th track */
+  DrawStatus("Benchmark: raw sector check...");
+  ULONG weak = 0, seen = 0;
+  for (ULONG t=0; t<TRACKS; t += BENCH_RAW_STEP) {
+    io->iotd_Req.io_Command = TD_RAWREAD;
+    io->iotd_Req.io_Flags   = IOTDF_WORDSYNC;
+    io->iotd_Req.io_Data    = (APTR)rc->raw;
+    io->iotd_Req.io_Length  = RAW_TRACK_SIZE;
+    io->iotd_Req.io_Offset  = t;
+    LONG err = Trace_DoIO((struct IORequest*)io);
+    io->iotd_Req.io_Flags   = 0;
+    memset(rc->have, 0, sizeof(rc->have));
+    weak += SECTORS - (err ? 0 : Recover_DecodeRaw(rc, 0, t));
+    seen += SECTORS;
+    DrawProgress(t+1, TRACKS);
+  }
+  r->weakPm = weak * 1000 / seen;
+  ClearProgress();
+  return TRUE;
+}
+
+/* "FTB1" line, then "<unit> <days> <rot> <step> <stroke> <bps> <weak> <errs>" per run */
+static ULONG Bench_History(UBYTE unit, struct BenchResult *base) {
+  BPTR fh = Open(BENCH_FILE, MODE_OLDFILE);
+  if (!fh) return 0;
+  LONG size = Seek(fh, 0, OFFSET_END);
+  size = Seek(fh, 0, OFFSET_BEGINNING);
+  char *buf = (size > 0) ? (char*)AllocVec(size + 1, MEMF_ANY) : NULL;
+  LONG n = buf ? Trace_Read(fh, buf, size) : 0;
+  Close(fh);
+  if (!buf) return 0;
+  buf[n > 0 ? n : 0] = '\0';
+
+  ULONG runs = 0;
+  char *line = buf + 5;
+  if (strncmp(buf, "FTB1\n", 5) != 0) line = buf + strlen(buf);
+  while (*line) {
+    char *eol = strchr(line, '\n');
+    if (eol) *eol = '\0';
+    unsigned u; struct BenchResult r;
+    if (sscanf(line, "%u %lu %lu %lu %lu %lu %lu %lu", &u, &r.days, &r.rotUs, &r.stepUs,
+               &r.strokeUs, &r.readBps, &r.weakPm, &r.readErr) == 8 && u == unit) {
+      if (runs++ == 0) *base = r;
+    }
+    if (!eol) break;
+    line = eol + 1;
+  }
+  FreeVec(buf);
+  return runs;
+}
+
+static BOOL Bench_Save(UBYTE unit, const struct BenchResult *r) {
+  BPTR fh = Open(BENCH_FILE, MODE_READWRITE);
+  if (!fh) return FALSE;
+  char line[120];
+  BOOL ok = TRUE;
+  if (Seek(fh, 0, OFFSET_END) == 0) ok = (Trace_Write(fh, (APTR)"FTB1\n", 5) == 5);
+  sprintf(line, "%u %lu %lu %lu %lu %lu %lu %lu\n", (unsigned)unit, (unsigned long)r->days,
+          (unsigned long)r->rotUs, (unsigned long)r->stepUs, (unsigned long)r->strokeUs,
+          (unsigned long)r->readBps, (unsigned long)r->weakPm, (unsigned long)r->readErr);
+  LONG len = (LONG)strlen(line);
+  if (ok) ok = (Trace_Write(fh, line, len) == len);
+  Close(fh);
+  return ok;
+}
+
+/* One report line; returns 1 if the value is flagged */
+static ULONG Bench_Line(char **q, CONST_STRPTR what, ULONG now, ULONG base, BOOL hasBase,
+                        ULONG div, CONST_STRPTR unitName, BOOL bad) {
+  *q += sprintf(*q, "%s: %lu.%lu %s", (const char*)what, (unsigned long)(now / div),
+                (unsigned long)((now % div) * 10 / div), (const char*)unitName);
+  if (hasBase) *q += sprintf(*q, "  (base %lu.%lu)", (unsigned long)(base / div), (unsigned long)((base % div) * 10 / div));
+  *q += sprintf(*q, "%s\n", bad ? "  <<" : "");
+  return bad ? 1 : 0;
+}
+
+/* E-clock unit of timer.device; sets TimerBase and gEFreq until closed */
+static struct timerequest *Bench_TimerOpen(void) {
+  struct MsgPort *tport = CreateMsgPort();
+  struct timerequest *tr = tport ? (struct timerequest*)CreateIORequest(tport, sizeof(struct timerequest)) : NULL;
+  if (!tr || OpenDevice(TIMERNAME, UNIT_ECLOCK, (struct IORequest*)tr, 0) != 0) {
+    if (tr) DeleteIORequest((struct IORequest*)tr);
+    if (tport) DeleteMsgPort(tport);
+    LogAdd("Cannot open timer.device");
+    return NULL;
+  }
+  TimerBase = tr->tr_node.io_Device;
+  struct EClockVal ev;
+  gEFreq = ReadEClock(&ev);
+  return tr;
+}
+
+static void Bench_TimerClose(struct timerequest *tr) {
+  struct MsgPort *tport = tr->tr_node.io_Message.mn_ReplyPort;
+  CloseDevice((struct IORequest*)tr);
+  DeleteIORequest((struct IORequest*)tr);
+  DeleteMsgPort(tport);
+  /* a trace or the motor-off timer keeps its own unit */
+  TimerBase = gTraceTimer ? gTraceTimer->tr_node.io_Device : gMotorTimer ? gMotorTimer->tr_node.io_Device : NULL;
+}
+
+/* KB/s of one ftkern.c loop over a track: 0 compare, 1 zero, 2 sum, 3 CRC */
+static ULONG Bench_Kernel(const struct FtKern *k, int which, const UBYTE *a, const UBYTE *b) {
+  struct EClockVal t0, t1;
+  ULONG n = 0, us, sink = 0;
+  ReadEClock(&t0);
+  do {
+    switch (which) {
+      case 0:  sink += k->equal(a, b, TRACK_SIZE); break;
+      case 1:  sink += k->zero(b, TRACK_SIZE); break;
+      case 2:  sink += k->sum(a, TRACK_SIZE); break;
+      default: sink = k->crc(sink, a, TRACK_SIZE); break;
+    }
+    n++;
+    ReadEClock(&t1);
+    us = Bench_Us(&t0, &t1);
+  } while (us < BENCH_KERN_US);
+  (void)sink;
+  return n * (TRACK_SIZE / 512) * 500 / (us / 1000);   /* bytes/1024 per ms/1000 */
+}
+
+/* Every compare/checksum variant this CPU runs, in MB/s */
+static void Bench_Kernels(void) {
+  LogClear();
+  UBYTE *a = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_ANY | MEMF_CLEAR);   /* equal and all zero: every loop reads it all */
+  struct timerequest *tr = a ? Bench_TimerOpen() : NULL;
+  if (!tr) {
+    if (a) FreeVec(a); else LogAdd("No memory");
+    DrawStatus("Benchmark failed.");
+    return;
+  }
+  static char text[400];
+  char *q = text;
+  q += sprintf(q, "CPU kernels, MB/s over one track\n\n%-8s %7s %7s %7s %7s\n", "", "compare", "zero", "sum", "CRC32");
+  const struct FtKern *k;
+  for (int v=0; (k = kern_variant(v)) != NULL; ++v) {
+    char m[80];
+    sprintf(m, "Benchmark: %s kernels...", k->name);
+    DrawStatus(m);
+    q += sprintf(q, "%-8s", k->name);
+    for (int w=0; w<4; ++w) {
+      ULONG kb = Bench_Kernel(k, w, a, a + TRACK_SIZE);
+      q += sprintf(q, " %4lu.%02lu", (unsigned long)(kb / 1024), (unsigned long)((kb % 1024) * 100 / 1024));
+    }
+    q += sprintf(q, "\n");
+  }
+  q += sprintf(q, "\nIn use: %s", kern_get()->name);
+  Bench_TimerClose(tr);
+  FreeVec(a);
+  char m[60];
+  sprintf(m, "Compare/checksum kernels in use: %s", kern_get()->name);
+  LogAdd(m);
+  DrawStatus("Kernel benchmark done.");
+
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, (UBYTE*)text, (UBYTE*)"OK" };
+  Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+}
+
+static void DoBenchmark(void) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  struct EasyStruct what = { sizeof(struct EasyStruct), 0, title,
+    (UBYTE*)"Benchmark a drive (test disk, read only)\nor the CPU's compare/checksum loops?",
+    (UBYTE*)"Drive...|CPU kernels|Cancel" };
+  LONG pick = Trace_EasyRequest(ui.win, &what, NULL, NULL);
+  PumpRefresh();
+  if (pick == 2) { Bench_Kernels(); return; }
+  if (pick != 1) { DrawStatus("Benchmark canceled."); return; }
+
+  UBYTE unit;
+  if (!AskFloppyUnit(&unit, "BENCHMARK (test disk in DFx:, read only)")) { DrawStatus("Benchmark canceled."); return; }
+  LogClear();
+
+  struct timerequest *tr = Bench_TimerOpen();
+  if (!tr) { DrawStatus("Benchmark failed."); return; }
+
+  struct RecoverCtx rc;
+  memset(&rc, 0, sizeof(rc));
+  rc.raw  = (UBYTE*)AllocVec(RAW_TRACK_SIZE, MEMF_CHIP | MEMF_CLEAR);
+  rc.cand = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
+  UBYTE *buf = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_ANY);
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  struct BenchResult r;
+  BOOL ok = FALSE;
+  memset(&r, 0, sizeof(r));
+  if (!rc.raw || !rc.cand || !buf) LogAdd("No memory");
+  else if (!OpenTD(unit, &p, &io)) LogAdd("Open trackdisk failed");
+  else {
+    io->iotd_Req.io_Command = TD_CHANGESTATE;
+    Trace_DoIO((struct IORequest*)io);
+    if (io->iotd_Req.io_Actual != 0) LogAdd("No disk in drive");
+    else {
+      io->iotd_Req.io_Command = TD_MOTOR;
+      io->iotd_Req.io_Length  = 1;
+      Trace_DoIO((struct IORequest*)io);
+      ok = Bench_Run(io, &rc, buf, &r);
+      io->iotd_Req.io_Command = TD_MOTOR;
+      io->iotd_Req.io_Length  = 0;
+      Trace_DoIO((struct IORequest*)io);
+    }
+    CloseTD(p, io);
+  }
+  Recover_Close(&rc);
+  if (buf) FreeVec(buf);
+  Bench_TimerClose(tr);
+  if (!ok) { DrawStatus("Benchmark failed."); ClearProgress(); return; }
+
+  struct DateStamp ds;
+  DateStamp(&ds);
+  r.days = (ULONG)ds.ds_Days;
+  struct BenchResult b;
+  memset(&b, 0, sizeof(b));
+  ULONG runs = Bench_History(unit, &b);
+  BOOL hb = (runs > 0);
+  if (!Bench_Save(unit, &r)) LogAdd("Cannot save benchmark history");
+
+  /* Flags: rotation out of spec or drifting, slower seeks/reads, more weak sectors */
+  ULONG rpm = r.rotUs ? 600000000UL / r.rotUs : 0, rpmB = b.rotUs ? 600000000UL / b.rotUs : 0;   /* x10 */
+  BOOL rpmBad = (rpm > 3000 + BENCH_RPM_SPEC || rpm + BENCH_RPM_SPEC < 3000) ||
+                (hb && (rpm > rpmB + BENCH_RPM_DRIFT || rpm + BENCH_RPM_DRIFT < rpmB));
+  static char text[640];
+  char *q = text;
+  ULONG flags = 0;
+  q += sprintf(q, "DF%u: benchmark run %lu", (unsigned)unit, (unsigned long)(runs + 1));
+  if (hb) q += sprintf(q, ", baseline %lu day(s) old", (unsigned long)(r.days - b.days));
+  q += sprintf(q, "\n\n");
+  flags += Bench_Line(&q, "Rotation", rpm, rpmB, hb, 10, "rpm", rpmBad);
+  flags += Bench_Line(&q, "Track-to-track seek", r.stepUs, b.stepUs, hb, 1000, "ms",
+                      hb && r.stepUs * 4 > b.stepUs * 5);
+  flags += Bench_Line(&q, "Full-stroke seek", r.strokeUs, b.strokeUs, hb, 1000, "ms",
+                      hb && r.strokeUs * 4 > b.strokeUs * 5);
+  flags += Bench_Line(&q, "Sustained read", r.readBps, b.readBps, hb, 1024, "KB/s",
+                      hb && r.readBps * 10 < b.readBps * 9);
+  flags += Bench_Line(&q, "Weak sectors (raw)", r.weakPm, b.weakPm, hb, 10, "%",
+                      r.weakPm > (hb ? b.weakPm : 0) + BENCH_WEAK_PM);
+  q += sprintf(q, "Read errors: %lu%s\n", (unsigned long)r.readErr, r.readErr ? "  <<" : "");
+  if (r.readErr) flags++;
+  q += sprintf(q, "\n%s", flags ? "Marked values deviate: check or service this drive."
+                                : (hb ? "Within tolerance of the baseline." : "Saved as this drive's baseline."));
+
+  gProf[unit].rpm10  = rpm;
+  gProf[unit].stepUs = r.stepUs;
+  Prof_Save(unit);
+
+  char m[100];
+  sprintf(m, "DF%u: %lu.%lu rpm, seek %lu/%lu ms, %lu KB/s, weak %lu.%lu%%", (unsigned)unit,
+          (unsigned long)(rpm / 10), (unsigned long)(rpm % 10), (unsigned long)(r.stepUs / 1000),
+          (unsigned long)(r.strokeUs / 1000), (unsigned long)(r.readBps / 1024),
+          (unsigned long)(r.weakPm / 10), (unsigned long)(r.weakPm % 10));
+  LogAdd(m);
+  sprintf(m, "DF%u: %lu deviation(s) from baseline", (unsigned)unit, (unsigned long)flags);
+  DrawStatus(flags ? m : "Benchmark OK.");
+
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, (UBYTE*)text, (UBYTE*)"OK" };
+  Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+}
+
+/* ====== Capture session ======
+ * Captures go to a session directory chosen once (RAM: until then). The
+ * directory is listed once with ExAll into a small hash of used names, so
+ * picking the next free name costs no filesystem lookups. Names come from
+ * a template:
+ *   %u unit   %n counter (000..)   %l volume label   %d date (YYYYMMDD)
+ *   %t time (HHMM)   %c CRC32 of the image   %% a literal %
+ * %c is only known after the capture, so the file is renamed then and
+ * the placeholder name released. The hashes are taken as tracks arrive
+ * (gCap) and every capture is appended to SESSION_CAT with them.
+ */
+static ULONG Session_Hash(CONST_STRPTR name) {
+  ULONG h = 0;
+  for (const UBYTE *p = (const UBYTE*)name; *p; ++p) h = h * 31 + (*p | 0x20);
+  return h % SESSION_BUCKETS;
+}
+
+/* AmigaDOS names are case-insensitive (ASCII is enough here) */
+static BOOL Session_SameName(const char *a, const char *b) {
+  for (; *a && *b; ++a, ++b) {
+    char x = *a, y = *b;
+    if (x >= 'A' && x <= 'Z') x += 32;
+    if (y >= 'A' && y <= 'Z') y += 32;
+    if (x != y) return FALSE;
+  }
+  return *a == *b;
+}
+
+static BOOL Session_Used(CONST_STRPTR name) {
+  for (struct SessName *n = gSess.bucket[Session_Hash(name)]; n; n = n->next)
+    if (Session_SameName(n->name, (const char*)name)) return TRUE;
+  return FALSE;
+}
+
+static void Session_Reserve(CONST_STRPTR name) {
+  if (Session_Used(name)) return;
+  ULONG len = (ULONG)strlen((const char*)name);
+  struct SessName *n = (struct SessName*)AllocVec(sizeof(struct SessName) + len, MEMF_ANY);
+  if (!n) return;                              /* worst case: a name clash on Open */
+  strcpy(n->name, (const char*)name);
+  ULONG h = Session_Hash(name);
+  n->next = gSess.bucket[h];
+  gSess.bucket[h] = n;
+  gSess.names++;
+}
+
+static void Session_Release(CONST_STRPTR name) {
+  struct SessName **pn = &gSess.bucket[Session_Hash(name)];
+  for (; *pn; pn = &(*pn)->next) {
+    if (!Session_SameName((*pn)->name, (const char*)name)) continue;
+    struct SessName *n = *pn;
+    *pn = n->next;
+    FreeVec(n);
+    gSess.names--;
+    return;
+  }
+}
+
+static void Session_Free(void) {
+  for (ULONG h=0; h<SESSION_BUCKETS; ++h) {
+    while (gSess.bucket[h]) {
+      struct SessName *n = gSess.bucket[h];
+      gSess.bucket[h] = n->next;
+      FreeVec(n);
+    }
+  }
+  gSess.names = 0;
+  gSess.open = FALSE;
+}
+
+static BOOL Session_Open(CONST_STRPTR dir, CONST_STRPTR tpl) {
+  BPTR lock = Lock((STRPTR)dir, ACCESS_READ);
+  if (!lock) { LogAdd("Session directory not found"); return FALSE; }
+  struct ExAllControl *eac = (struct ExAllControl*)AllocDosObject(DOS_EXALLCONTROL, NULL);
+  UBYTE *buf = (UBYTE*)AllocVec(SESSION_EXALL_BUF, MEMF_ANY);
+  if (!eac || !buf) {
+    if (eac) FreeDosObject(DOS_EXALLCONTROL, eac);
+    if (buf) FreeVec(buf);
+    UnLock(lock);
+    LogAdd("No memory");
+    return FALSE;
+  }
+
+  Session_Free();
+  strncpy(gSess.dir, (const char*)dir, sizeof(gSess.dir)-1); gSess.dir[sizeof(gSess.dir)-1] = '\0';
+  strncpy(gSess.tpl, (const char*)tpl, sizeof(gSess.tpl)-1); gSess.tpl[sizeof(gSess.tpl)-1] = '\0';
+  gSess.counter = 0;
+  gSess.captures = 0;
+
+  BOOL more;
+  eac->eac_LastKey = 0;
+  do {
+    more = ExAll(lock, (struct ExAllData*)buf, SESSION_EXALL_BUF, ED_NAME, eac);
+    if (!more && IoErr() != ERROR_NO_MORE_ENTRIES) break;
+    if (eac->eac_Entries == 0) continue;
+    for (struct ExAllData *ed = (struct ExAllData*)buf; ed; ed = ed->ed_Next) Session_Reserve((CONST_STRPTR)ed->ed_Name);
+  } while (more);
+
+  FreeDosObject(DOS_EXALLCONTROL, eac);
+  FreeVec(buf);
+  UnLock(lock);
+  gSess.open = TRUE;
+  return TRUE;
+}
+
+/* Days since 1.1.1978 -> YYYYMMDD */
+static ULONG Session_Date(LONG days) {
+  ULONG y = 1978, m = 1;
+  static const UBYTE mdays[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
+  for (;;) {
+    LONG yd = ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0) ? 366 : 365;
+    if (days < yd) break;
+    days -= yd; y++;
+  }
+  for (; m < 12; ++m) {
+    LONG md = mdays[m-1] + (m == 2 && ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0));
+    if (days < md) break;
+    days -= md;
+  }
+  return y * 10000 + m * 100 + (ULONG)days + 1;
+}
+
+/* Template -> file name (no extension); without %n a counter n > 0 becomes a _n suffix */
+static void Session_Expand(UBYTE unit, ULONG n, CONST_STRPTR label, const ULONG *crc, char *out, int maxlen) {
+  struct DateStamp ds;
+  DateStamp(&ds);
+  BOOL counted = FALSE;
+  char *q = out, *end = out + maxlen - 12;
+  for (const char *t = gSess.tpl; *t && q < end; ++t) {
+    if (*t != '%' || !t[1]) { *q++ = *t; continue; }
+    switch (*++t) {
+      case 'u': q += sprintf(q, "%u", (unsigned)unit); break;
+      case 'n': q += sprintf(q, "%03lu", (unsigned long)n); counted = TRUE; break;
+      case 'd': q += sprintf(q, "%08lu", (unsigned long)Session_Date(ds.ds_Days)); break;
+      case 't': q += sprintf(q, "%02ld%02ld", (long)(ds.ds_Minute / 60), (long)(ds.ds_Minute % 60)); break;
+      case 'c': q += crc ? sprintf(q, "%08lx", (unsigned long)*crc) : sprintf(q, "crc"); break;
+      case 'l':
+        for (const char *l = (const char*)label; *l && q < end; ++l)
+          *q++ = (*l == '/' || *l == ':' || *l == '"' || *l == '*' || *l == '?' || *l == '#') ? '_' : *l;
+        break;
+      default:  *q++ = *t; break;
+    }
+  }
+  *q = '\0';
+  if (!counted && n > 0) sprintf(q, "_%lu", (unsigned long)n);
+}
+
+/* First unused name for the template from counter 'from' on; path in out */
+static BOOL Session_Pick(UBYTE unit, CONST_STRPTR label, const ULONG *crc, CONST_STRPTR ext,
+                         ULONG from, ULONG *nOut, char *out, int maxlen) {
+  char name[108];
+  for (ULONG n = from; n < SESSION_MAX_N; ++n) {
+    Session_Expand(unit, n, label, crc, name, sizeof(name) - 5);
+    strcat(name, ".");
+    strcat(name, (const char*)ext);
+    if (Session_Used(name)) continue;
+    strncpy(out, gSess.dir, maxlen-1); out[maxlen-1] = '\0';
+    if (!AddPart((STRPTR)out, (STRPTR)name, (ULONG)maxlen)) return FALSE;
+    Session_Reserve(name);
+    if (nOut) *nOut = n;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* Volume name from a root block, "NDOS" if it is not one */
+static void Root_Label(const UBYTE *blk, char *out) {
+  ULONG len = blk[ROOT_NAME_OFS];
+  if ((blk[0] | blk[1] | blk[2]) || blk[3] != 2 || blk[BYTES_PER_SECTOR-1] != 1 || len == 0 || len > 30) { strcpy(out, "NDOS"); return; }
+  memcpy(out, blk + ROOT_NAME_OFS + 1, len);
+  out[len] = '\0';
+}
+
+static void Disk_Label(UBYTE unit, char *out) {
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  UBYTE *blk = (UBYTE*)AllocVec(BYTES_PER_SECTOR, MEMF_ANY);
+  strcpy(out, "NDOS");
+  if (blk && OpenTD(unit, &p, &io)) {
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)blk;
+    io->iotd_Req.io_Length  = BYTES_PER_SECTOR;
+    io->iotd_Req.io_Offset  = ROOT_BLOCK * BYTES_PER_SECTOR;
+    if (Trace_DoIO((struct IORequest*)io) == 0) Root_Label(blk, out);
+    CloseTD(p, io);
+  }
+  if (blk) FreeVec(blk);
+}
+
+static void Session_Catalog(CONST_STRPTR name, UBYTE unit, CONST_STRPTR label, LONG size, ULONG crc,
+                            const UBYTE *md5, const UBYTE *sha1, ULONG ticks) {
+  char path[300];
+  strncpy(path, gSess.dir, sizeof(path)-1); path[sizeof(path)-1] = '\0';
+  if (!AddPart((STRPTR)path, (STRPTR)SESSION_CAT, sizeof(path))) return;
+  BPTR fh = Open((STRPTR)path, MODE_READWRITE);
+  if (!fh) { LogAdd("Cannot write session catalogue"); return; }
+  Session_Reserve((CONST_STRPTR)SESSION_CAT);
+
+  static char line[400];
+  char *q = line, hex[2*SHA1_LEN+1];
+  struct DateStamp ds;
+  DateStamp(&ds);
+  if (Seek(fh, 0, OFFSET_END) == 0)
+    q += sprintf(q, "# file\tunit\tdate\ttime\tlabel\tsize\tcrc32\tmd5\tsha1\tseconds\tbad\n");
+  q += sprintf(q, "%s\t%u\t%08lu\t%02ld:%02ld\t%s\t%ld\t%08lx\t", (const char*)name, (unsigned)unit,
+               (unsigned long)Session_Date(ds.ds_Days), (long)(ds.ds_Minute / 60), (long)(ds.ds_Minute % 60),
+               (const char*)label, (long)size, (unsigned long)crc);
+  hash_hex(md5, MD5_LEN, hex);   q += sprintf(q, "%s\t", hex);
+  hash_hex(sha1, SHA1_LEN, hex); q += sprintf(q, "%s\t", hex);
+  q += sprintf(q, "%lu.%lu\t%lu\n", (unsigned long)(ticks / 50), (unsigned long)((ticks % 50) / 5),
+               (unsigned long)gBad.nBad);
+  LONG len = (LONG)(q - line);
+  if (Trace_Write(fh, line, len) != len) LogAdd("Cannot write session catalogue");
+  Close(fh);
+}
+
+/* Track t of a session capture, once its data is final. A track that
+ * failed stops the hashes there until the read-back after recovery. */
+static void Capture_Hash(ULONG t, const UBYTE *buf) {
+  if (!gCap.on || t != gCap.next) return;
+  if (t == ROOT_TRACK) Root_Label(buf, gCap.label);
+  gCap.crc = crc32_update(gCap.crc, buf, TRACK_SIZE);
+  md5_update(&gCap.md5, buf, TRACK_SIZE);
+  sha1_update(&gCap.sha1, buf, TRACK_SIZE);
+  gCap.next++;
+}
+
+/* Capture unit into the session: name, read (hashing as it goes), rename for %c, catalogue */
+static BOOL Session_Capture(UBYTE unit, BOOL adz) {
+  if (!gSess.open && !Session_Open((CONST_STRPTR)"RAM:", (CONST_STRPTR)SESSION_TPL_DEF)) {
+    DrawStatus("Cannot open capture session"); return FALSE;
+  }
+  CONST_STRPTR ext = (CONST_STRPTR)(adz ? "adz" : "adf");
+  char label[32] = "";
+  if (strstr(gSess.tpl, "%l")) Disk_Label(unit, label);
+  BOOL crcName = (strstr(gSess.tpl, "%c") != NULL);
+
+  char path[300];
+  ULONG n;
+  if (!Session_Pick(unit, label, NULL, ext, gSess.counter, &n, path, sizeof(path))) {
+    DrawStatus("No free name for this template"); return FALSE;
+  }
+  gSess.counter = n + 1;
+
+  memset(&gCap, 0, sizeof(gCap));
+  gCap.on  = TRUE;
+  gCap.crc = crc32_init();
+  md5_init(&gCap.md5); sha1_init(&gCap.sha1);
+  strcpy(gCap.label, "NDOS");
+  ULONG t0 = StampTicks();
+  BOOL ok = RunReadADF(unit, path, FALSE);
+  ULONG ticks = StampTicks() - t0;
+  gCap.on = FALSE;
+  if (!ok) return FALSE;
+
+  ULONG crc;
+  UBYTE md5[MD5_LEN], sha1[SHA1_LEN];
+  LONG size = (LONG)DISK_SIZE;
+  if (gCap.next == TRACKS) {
+    crc = crc32_final(gCap.crc);
+    md5_final(&gCap.md5, md5);
+    sha1_final(&gCap.sha1, sha1);
+  } else {
+    /* An .adz whose failed tracks stayed zeros (recovery skipped or the
+     * re-encode failed) was never read back: hash the file */
+    struct ImgSrc src;
+    size = -1;
+    if (Img_Open(&src, path)) {
+      size = Img_Hash(&src, &crc, md5, sha1, gCap.label, NULL);
+      Img_Close(&src);
+    }
+    ClearProgress();
+    if (size < 0) { LogAdd("Capture saved, but could not be hashed"); return ok; }
+  }
+  if (!label[0]) strcpy(label, gCap.label);
+
+  if (crcName) {
+    char final[300];
+    if (Session_Pick(unit, label, &crc, ext, n, NULL, final, sizeof(final)) && Rename((STRPTR)path, (STRPTR)final)) {
+      Session_Release(FilePart((STRPTR)path));   /* the "crc" placeholder is free again */
+      strcpy(path, final);
+    } else LogAdd("Could not rename capture to its CRC name");
+  }
+  Session_Catalog(FilePart((STRPTR)path), unit, label, size, crc, md5, sha1, ticks);
+  gSess.captures++;
+
+  char m[160];
+  sprintf(m, "Saved %.100s  CRC32 %08lx", (const char*)FilePart((STRPTR)path), (unsigned long)crc);
+  LogAdd(m);
+  return ok;
+}
+
+/* Drawer requester (ASL, drawers only) */
+static BOOL ASL_OpenDrawer(char *outPath, int maxlen, CONST_STRPTR title, CONST_STRPTR defDir) {
+  struct FileRequester *fr = (struct FileRequester*)AllocAslRequestTags(ASL_FileRequest,
+    ASLFR_TitleText,     (ULONG)title,
+    ASLFR_InitialDrawer, (ULONG)defDir,
+    ASLFR_DrawersOnly,   TRUE,
+    TAG_END);
+  if (!fr) return FALSE;
+  BOOL ok = FALSE;
+  if (Trace_AslRequest(fr) && fr->fr_Drawer) {
+    strncpy(outPath, fr->fr_Drawer, maxlen-1);
+    outPath[maxlen-1] = '\0';
+    ok = TRUE;
+  }
+  FreeAslRequest(fr);
+  PumpRefresh();
+  return ok;
+}
+
+static void DoSession(void) {
+  char dir[256];
+  if (!ASL_OpenDrawer(dir, sizeof(dir), "Capture session: destination drawer...", gSess.open ? gSess.dir : "RAM:")) {
+    DrawStatus("Session unchanged."); return;
+  }
+
+  /* Preset templates; ENV:FloppyTool/Template adds a custom one */
+  static char custom[64];
+  BOOL hasCustom = (GetVar((STRPTR)"FloppyTool/Template", (STRPTR)custom, sizeof(custom), 0) > 0);
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  /* Requester text is RawDoFmt'd: % in the gadgets doubled, the path passed as an argument */
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title,
+                           (UBYTE*)"Name captures in\n%s\nwith which template?",
+                           (UBYTE*)(hasCustom ? "DF%%u_%%n|%%l_%%n|%%d_%%l_%%c|Custom|Cancel"
+                                              : "DF%%u_%%n|%%l_%%n|%%d_%%l_%%c|Cancel") };
+  ULONG args[1] = { (ULONG)dir };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, args);
+  PumpRefresh();
+  if (sel < 1) { DrawStatus("Session unchanged."); return; }
+  static const char *const presets[3] = { SESSION_TPL_DEF, "%l_%n", "%d_%l_%c" };
+  CONST_STRPTR tpl = (CONST_STRPTR)(sel <= 3 ? presets[sel-1] : custom);
+
+  LogClear();
+  if (!Session_Open((CONST_STRPTR)dir, tpl)) { DrawStatus("Session not opened."); return; }
+  char m[160];
+  sprintf(m, "Session: %.80s (%lu names indexed)", gSess.dir, (unsigned long)gSess.names);
+  LogAdd(m);
+  sprintf(m, "Captures named %s, catalogue %s", gSess.tpl, SESSION_CAT);
+  LogAdd(m);
+  DrawStatus("Capture session ready.");
+}
+
+/* ====== Drive profiles ======
+ * One global variable per unit, FloppyTool/DF<n> (ENV: for the running
+ * system, ENVARC: to survive a reboot: SetVar with GVF_SAVE_VAR), holding
+ * "key=value" pairs. Missing keys keep the built-in defaults, which are the
+ * values FloppyTool always used. Calibrate measures a unit on a scratch
+ * disk; Benchmark records rotation and step time into the profile too.
+ */
+static const struct DriveProfile profDefault = { 5, 2, 1, 0, PROF_FMT_UNKNOWN, 0, 0, 0 };
+
+static void Prof_Format(const struct DriveProfile *dp, char *out) {
+  sprintf(out, "retry0=%u retry=%u xfer=%u motoroff=%u format=%u rpm=%lu step=%lu cal=%lu",
+          (unsigned)dp->retry0, (unsigned)dp->retry, (unsigned)dp->xfer, (unsigned)dp->motorOff,
+          (unsigned)dp->format, (unsigned long)dp->rpm10, (unsigned long)dp->stepUs, (unsigned long)dp->calDays);
+}
+
+/* Unknown keys are skipped, out-of-range values clamped */
+static void Prof_Parse(const char *text, struct DriveProfile *dp) {
+  char key[16]; unsigned long v; int used;
+  while (*text) {
+    while (*text == ' ' || *text == '\t') text++;
+    if (sscanf(text, "%15[^= ]=%lu%n", key, &v, &used) != 2) break;
+    text += used;
+    if      (!strcmp(key, "retry0"))   dp->retry0   = (UBYTE)(v < 1 ? 1 : v > PROF_MAX_RETRY ? PROF_MAX_RETRY : v);
+    else if (!strcmp(key, "retry"))    dp->retry    = (UBYTE)(v < 1 ? 1 : v > PROF_MAX_RETRY ? PROF_MAX_RETRY : v);
+    else if (!strcmp(key, "xfer"))     dp->xfer     = (UBYTE)(v == 2 ? 2 : 1);
+    else if (!strcmp(key, "motoroff")) dp->motorOff = (UBYTE)(v > 60 ? 60 : v);
+    else if (!strcmp(key, "format"))   dp->format   = (UBYTE)(v > PROF_FMT_NO ? PROF_FMT_UNKNOWN : v);
+    else if (!strcmp(key, "rpm"))      dp->rpm10    = (ULONG)v;
+    else if (!strcmp(key, "step"))     dp->stepUs   = (ULONG)v;
+    else if (!strcmp(key, "cal"))      dp->calDays  = (ULONG)v;
+  }
+}
+
+static void Prof_Load(void) {
+  for (UBYTE u=0; u<4; ++u) {
+    char name[24], text[PROF_TEXT_MAX];
+    gProf[u] = profDefault;
+    sprintf(name, PROF_VAR, (unsigned)u);
+    if (GetVar((STRPTR)name, (STRPTR)text, sizeof(text), GVF_GLOBAL_ONLY) > 0) Prof_Parse(text, &gProf[u]);
+  }
+}
+
+static BOOL Prof_Save(UBYTE unit) {
+  char name[24], text[PROF_TEXT_MAX];
+  sprintf(name, PROF_VAR, (unsigned)unit);
+  Prof_Format(&gProf[unit], text);
+  if (SetVar((STRPTR)name, (STRPTR)text, (LONG)strlen(text), GVF_GLOBAL_ONLY | GVF_SAVE_VAR)) return TRUE;
+  LogAdd("Cannot save drive profile to ENVARC:");
+  return FALSE;
+}
+
+/* Motor off now, or after the unit's motoroff seconds. The deadlines are
+ * checked once a second by a timer.device request, whose signal the main
+ * and Station loops wait on and DrawProgress polls while an operation
+ * runs, so they fire whichever window is active. */
+static void Motor_Arm(void) {
+  if (gMotorArmed) return;
+  gMotorTimer->tr_node.io_Command = TR_ADDREQUEST;
+  gMotorTimer->tr_time.tv_secs    = 0;         /* UNIT_ECLOCK: a delay in E-clock ticks, hi/lo */
+  gMotorTimer->tr_time.tv_micro   = gEFreq;    /* one second */
+  SendIO((struct IORequest*)gMotorTimer);
+  gMotorArmed = TRUE;
+}
+
+static void Motor_Release(UBYTE unit) {
+  if (unit >= 4 || gProf[unit].motorOff == 0) { SetFloppyMotor(unit, FALSE); return; }
+  if (!gMotorTimer && (gMotorTimer = Bench_TimerOpen()) == NULL) { SetFloppyMotor(unit, FALSE); return; }
+  gMotorOff[unit] = StampTicks() + (ULONG)gProf[unit].motorOff * 50;
+  if (!gMotorOff[unit]) gMotorOff[unit] = 1;
+  Motor_Arm();
+}
+
+static void Motor_Tick(BOOL all) {
+  ULONG now = StampTicks();
+  for (UBYTE u=0; u<4; ++u) {
+    if (!gMotorOff[u] || (!all && (LONG)(now - gMotorOff[u]) < 0)) continue;
+    SetFloppyMotor(u, FALSE);                  /* clears gMotorOff[u] */
+  }
+}
+
+static ULONG Motor_Signal(void) {
+  return gMotorTimer ? 1UL << gMotorTimer->tr_node.io_Message.mn_ReplyPort->mp_SigBit : 0;
+}
+
+/* After each second: expired motor-offs, then re-arm while any is left */
+static void Motor_Poll(void) {
+  if (!gMotorArmed || !CheckIO((struct IORequest*)gMotorTimer)) return;
+  WaitIO((struct IORequest*)gMotorTimer);
+  gMotorArmed = FALSE;
+  Motor_Tick(FALSE);
+  for (UBYTE u=0; u<4; ++u)
+    if (gMotorOff[u]) { Motor_Arm(); break; }
+}
+
+static void Motor_Close(void) {
+  struct timerequest *tr = gMotorTimer;
+  if (!tr) return;
+  if (gMotorArmed) { AbortIO((struct IORequest*)tr); WaitIO((struct IORequest*)tr); }
+  gMotorArmed = FALSE;
+  gMotorTimer = NULL;
+  Bench_TimerClose(tr);
+}
+
+/* Calibration on a scratch disk: only the last cylinder is written */
+static BOOL Prof_Calibrate(UBYTE unit) {
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (!OpenTD(unit, &p, &io)) { LogAdd("Open trackdisk failed"); return FALSE; }
+  UBYTE *buf = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_CLEAR);
+  UBYTE *chk = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_CLEAR);
+  struct DriveProfile dp = gProf[unit];
+  BOOL ok = (buf && chk);
+  if (!ok) LogAdd("No memory");
+
+  if (ok) {
+    io->iotd_Req.io_Command = TD_CHANGESTATE;
+    Trace_DoIO((struct IORequest*)io);
+    if (io->iotd_Req.io_Actual != 0) { LogAdd("No disk in drive"); ok = FALSE; }
+  }
+  if (ok) {
+    io->iotd_Req.io_Command = TD_PROTSTATUS;
+    Trace_DoIO((struct IORequest*)io);
+    if (io->iotd_Req.io_Actual != 0) { LogAdd("Disk is write-protected"); ok = FALSE; }
+  }
+  if (ok) SetFloppyMotor(unit, TRUE);
+
+  /* 1. Does CMD_FORMAT work on this unit? */
+  if (ok) {
+    DrawStatus("Calibrate: CMD_FORMAT...");
+    for (ULONG i=0; i<TRACK_SIZE; ++i) buf[i] = (UBYTE)(i * 7);
+    io->iotd_Req.io_Command = CMD_FORMAT;
+    io->iotd_Req.io_Data    = (APTR)buf;
+    io->iotd_Req.io_Length  = TRACK_SIZE;
+    io->iotd_Req.io_Offset  = PROF_CAL_TRACK * TRACK_SIZE;
+    BOOL fmt = (Trace_DoIO((struct IORequest*)io) == 0);
+    io->iotd_Req.io_Command = CMD_CLEAR;
+    Trace_DoIO((struct IORequest*)io);
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)chk;
+    io->iotd_Req.io_Offset  = PROF_CAL_TRACK * TRACK_SIZE;
+    fmt = fmt && Trace_DoIO((struct IORequest*)io) == 0 && kern_equal(buf, chk, TRACK_SIZE);
+    dp.format = fmt ? PROF_FMT_YES : PROF_FMT_NO;
+  }
+
+  /* 2. Write+verify failures decide how many attempts a track gets */
+  ULONG fails = 0;
+  for (ULONG i=0; ok && i<PROF_CAL_WRITES; ++i) {
+    DrawProgress(i+1, PROF_CAL_WRITES);
+    memset(buf, (int)(0x11 * (i + 1)), TRACK_SIZE);
+    io->iotd_Req.io_Command = CMD_WRITE;
+    io->iotd_Req.io_Data    = (APTR)buf;
+    io->iotd_Req.io_Length  = TRACK_SIZE;
+    io->iotd_Req.io_Offset  = PROF_CAL_TRACK * TRACK_SIZE;
+    BOOL good = (Trace_DoIO((struct IORequest*)io) == 0);
+    io->iotd_Req.io_Command = CMD_UPDATE;
+    good = good && Trace_DoIO((struct IORequest*)io) == 0;
+    io->iotd_Req.io_Command = CMD_CLEAR;
+    Trace_DoIO((struct IORequest*)io);
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)chk;
+    good = good && Trace_DoIO((struct IORequest*)io) == 0 && kern_equal(buf, chk, TRACK_SIZE);
+    if (!good) fails++;
+  }
+  dp.retry  = (UBYTE)(2 + fails > PROF_MAX_RETRY ? PROF_MAX_RETRY : 2 + fails);
+  dp.retry0 = (UBYTE)(dp.retry + 3 > PROF_MAX_RETRY ? PROF_MAX_RETRY : dp.retry + 3);
+
+  /* 3. Track or cylinder per read request, whichever streams faster. A read
+     error means retries were timed, not transfers: xfer stays as it was. */
+  ULONG ticks[3] = { 0, 0, 0 };
+  BOOL timed = ok;
+  for (ULONG x=1; timed && x<=2; ++x) {
+    DrawStatus(x == 1 ? "Calibrate: reads by track..." : "Calibrate: reads by cylinder...");
+    io->iotd_Req.io_Command = CMD_CLEAR;
+    Trace_DoIO((struct IORequest*)io);
+    ULONG t0 = StampTicks();
+    for (ULONG t=0; timed && t<PROF_CAL_READ; t += x) {
+      io->iotd_Req.io_Command = CMD_READ;
+      io->iotd_Req.io_Data    = (APTR)buf;
+      io->iotd_Req.io_Length  = x * TRACK_SIZE;
+      io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)io) != 0) {
+        char m[100];
+        sprintf(m, "Calibrate: read error at track %lu, transfer size kept (needs a formatted disk)", (unsigned long)t);
+        LogAdd(m);
+        timed = FALSE;
+      }
+      DrawProgress(t+x, PROF_CAL_READ);
+    }
+    ticks[x] = StampTicks() - t0;
+  }
+  if (timed) dp.xfer = (UBYTE)(ticks[1] < ticks[2] ? 1 : 2);
+
+  if (buf) FreeVec(buf);
+  if (chk) FreeVec(chk);
+  CloseTD(p, io);
+  if (ok) SetFloppyMotor(unit, FALSE);
+  ClearProgress();
+  if (!ok) return FALSE;
+
+  struct DateStamp ds;
+  DateStamp(&ds);
+  dp.calDays = (ULONG)ds.ds_Days;
+  gProf[unit] = dp;
+  char m[100];
+  if (timed) sprintf(m, "DF%u: %lu/%u write failures, reads %lu vs %lu ticks", (unsigned)unit, (unsigned long)fails,
+                     (unsigned)PROF_CAL_WRITES, (unsigned long)ticks[1], (unsigned long)ticks[2]);
+  else       sprintf(m, "DF%u: %lu/%u write failures, reads not timed", (unsigned)unit, (unsigned long)fails,
+                     (unsigned)PROF_CAL_WRITES);
+  LogAdd(m);
+  return Prof_Save(unit);
+}
+
+/* Export/import: one "DF<n> key=value ..." line per unit */
+static BOOL Prof_Export(CONST_STRPTR path) {
+  BPTR fh = Open((STRPTR)path, MODE_NEWFILE);
+  if (!fh) return FALSE;
+  BOOL ok = TRUE;
+  for (UBYTE u=0; u<4 && ok; ++u) {
+    char line[PROF_TEXT_MAX + 8];
+    sprintf(line, "DF%u ", (unsigned)u);
+    Prof_Format(&gProf[u], line + 4);
+    strcat(line, "\n");
+    LONG len = (LONG)strlen(line);
+    ok = (Trace_Write(fh, line, len) == len);
+  }
+  Close(fh);
+  return ok;
+}
+
+static ULONG Prof_Import(CONST_STRPTR path) {
+  BPTR fh = Open((STRPTR)path, MODE_OLDFILE);
+  if (!fh) return 0;
+  char buf[4 * (PROF_TEXT_MAX + 8) + 1];
+  LONG n = Trace_Read(fh, buf, sizeof(buf) - 1);
+  Close(fh);
+  buf[n > 0 ? n : 0] = '\0';
+
+  ULONG count = 0;
+  char *line = buf;
+  while (*line) {
+    char *eol = strchr(line, '\n');
+    if (eol) *eol = '\0';
+    unsigned u; int off = 0;
+    if (sscanf(line, "DF%u %n", &u, &off) == 1 && off > 0 && u < 4) {
+      gProf[u] = profDefault;
+      Prof_Parse(line + off, &gProf[u]);
+      if (Prof_Save((UBYTE)u)) count++;
+    }
+    if (!eol) break;
+    line = eol + 1;
+  }
+  return count;
+}
+
+static void DoProfiles(void) {
+  static const char *const fmtState[3] = { "?", "yes", "no" };
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  static char text[520];
+  char *q = text;
+  q += sprintf(q, "Drive profiles (ENVARC:FloppyTool/DFn)\n\n");
+  for (UBYTE u=0; u<4; ++u) {
+    const struct DriveProfile *dp = &gProf[u];
+    q += sprintf(q, "DF%u: retries %u/%u, read %s, motor-off %u s, CMD_FORMAT %s",
+                 (unsigned)u, (unsigned)dp->retry0, (unsigned)dp->retry, dp->xfer == 2 ? "by cyl" : "by track",
+                 (unsigned)dp->motorOff, fmtState[dp->format]);
+    if (dp->rpm10) q += sprintf(q, ", %lu.%lu rpm", (unsigned long)(dp->rpm10 / 10), (unsigned long)(dp->rpm10 % 10));
+    q += sprintf(q, "%s\n", dp->calDays ? "" : " (not calibrated)");
+  }
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, (UBYTE*)text,
+                           (UBYTE*)"Calibrate...|Export...|Import...|Close" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+
+  if (sel == 1) {
+    UBYTE unit;
+    if (!AskFloppyUnit(&unit, "CALIBRATE (scratch disk in DFx:)")) { DrawStatus("Calibration canceled."); return; }
+    struct EasyStruct warn = { sizeof(struct EasyStruct), 0, title,
+                               (UBYTE*)"Calibration overwrites the last cylinder\nof the disk in the drive. Use a scratch disk,\nformatted: the read timing reads tracks 0-39.",
+                               (UBYTE*)"Calibrate|Cancel" };
+    LONG go = Trace_EasyRequest(ui.win, &warn, NULL, NULL);
+    PumpRefresh();
+    if (go != 1) { DrawStatus("Calibration canceled."); return; }
+    LogClear();
+    DrawStatus(Prof_Calibrate(unit) ? "Drive calibrated, profile saved." : "Calibration failed.");
+  } else if (sel == 2 || sel == 3) {
+    char path[300];
+    if (!ASL_OpenFile(path, sizeof(path), sel == 2 ? "Export profiles to..." : "Import profiles from...",
+                      "RAM:FloppyTool.profiles")) { DrawStatus("Profiles unchanged."); return; }
+    if (sel == 2) DrawStatus(Prof_Export(path) ? "Profiles exported." : "Profile export failed.");
+    else {
+      char m[64];
+      sprintf(m, "%lu profile(s) imported.", (unsigned long)Prof_Import(path));
+      DrawStatus(m);
+    }
+  }
+}
+
+/* ====== Raw ops via trackdisk.device ====== */
+
+static BOOL OpenTD(UBYTE unit, struct MsgPort **pp, struct IOExtTD **pio) {
+  if (!pp || !pio) return FALSE;
+  *pp = NULL; *pio = NULL;
+
+  struct MsgPort *port = CreateMsgPort();
+  if (!port) return FALSE;
+  struct IOExtTD *io = (struct IOExtTD*)CreateIORequest(port, sizeof(struct IOExtTD));
+  if (!io) { DeleteMsgPort(port); return FALSE; }
+
+  if (OpenDevice("trackdisk.device", unit, (struct IORequest*)io, 0) != 0) {
+    DeleteIORequest((struct IORequest*)io);
+    DeleteMsgPort(port);
+    return FALSE;
+  }
+  *pp = port; *pio = io;
+  return TRUE;
+}
+
+static void CloseTD(struct MsgPort *p, struct IOExtTD *io) {
+  if (io) { CloseDevice((struct IORequest*)io); DeleteIORequest((struct IORequest*)io); }
+  if (p)  { DeleteMsgPort(p); }
+}
+
+static void SetFloppyMotor(UBYTE unit, BOOL on) {
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (unit < 4) gMotorOff[unit] = 0;           /* supersedes a delayed motor-off */
+  if (!OpenTD(unit, &p, &io)) return;
+  io->iotd_Req.io_Command = TD_MOTOR;
+  io->iotd_Req.io_Length  = on ? 1 : 0;
+  (void)Trace_DoIO((struct IORequest*)io);
+  CloseTD(p, io);
+}
+
+/* ====== Recovery engine ======
+ * First pass: every op reads each track once with CMD_READ; failures are
+ * only marked in the BadMap so good tracks stream at full speed.
+ * Second pass (deferred): failed tracks are re-read up to N times with
+ * CMD_CLEAR + recalibration; each attempt also grabs the raw MFM track so
+ * single sectors can be salvaged (checksum OK) or voted bit by bit.
+ */
+
+static void BadMap_Init(struct BadMap *bm) {
+  memset(bm, 0, sizeof(*bm));
+}
+
+static void BadMap_FailTrack(struct BadMap *bm, ULONG t) {
+  if (t >= TRACKS || bm->failed[t]) return;
+  bm->failed[t] = 1;
+  bm->nFailed++;
+}
+
+/* Writes "<adf>.bad" listing every sector not read cleanly on first pass */
+static BOOL BadMap_Save(const struct BadMap *bm, CONST_STRPTR adfPath) {
+  static const char *names[] = { "OK", "REREAD", "VOTED", "WEAK", "DEAD" };
+  char path[320];
+  snprintf(path, sizeof(path), "%s.bad", adfPath);
+  BPTR fh = Open((STRPTR)path, MODE_NEWFILE);
+  if (!fh) return FALSE;
+
+  char line[80];
+  sprintf(line, "; %s bad-sector map\n; track sector state\n", APP_NAME);
+  Trace_Write(fh, line, strlen(line));
+  for (ULONG i=0; i<TOTAL_SECTORS; ++i) {
+    if (bm->state[i] == SEC_OK) continue;
+    sprintf(line, "%03lu %02lu %s\n", (unsigned long)(i / SECTORS), (unsigned long)(i % SECTORS), names[bm->state[i]]);
+    Trace_Write(fh, line, strlen(line));
+  }
+  sprintf(line, "; failed tracks %lu, bad sectors %lu\n", (unsigned long)bm->nFailed, (unsigned long)bm->nBad);
+  Trace_Write(fh, line, strlen(line));
+  Close(fh);
+  return TRUE;
+}
+
+/* Reads back the sector states of a "<adf>.bad" map; FALSE if there is none */
+static BOOL BadMap_Load(struct BadMap *bm, CONST_STRPTR adfPath) {
+  static const char *names[] = { "OK", "REREAD", "VOTED", "WEAK", "DEAD" };
+  BadMap_Init(bm);
+  char path[320];
+  snprintf(path, sizeof(path), "%s.bad", adfPath);
+  BPTR fh = Open((STRPTR)path, MODE_OLDFILE);
+  if (!fh) return FALSE;
+  LONG size = Seek(fh, 0, OFFSET_END);
+  size = Seek(fh, 0, OFFSET_BEGINNING);
+  char *buf = (size > 0) ? (char*)AllocVec(size + 1, MEMF_ANY) : NULL;
+  LONG n = buf ? Trace_Read(fh, buf, size) : 0;
+  Close(fh);
+  if (!buf) return FALSE;
+  buf[n > 0 ? n : 0] = '\0';
+
+  char *line = buf;
+  while (*line) {
+    char *eol = strchr(line, '\n');
+    if (eol) *eol = '\0';
+    unsigned long t, sec; char st[8];
+    if (line[0] != ';' && sscanf(line, "%lu %lu %7s", &t, &sec, st) == 3 && t < TRACKS && sec < SECTORS)
+      for (UBYTE k=1; k<5; ++k) if (strcmp(st, names[k]) == 0) bm->state[t*SECTORS + sec] = k;
+    if (!eol) break;
+    line = eol + 1;
+  }
+  FreeVec(buf);
+  return TRUE;
+}
+
+/* Returns re-reads per failed track, 0 = skip recovery */
+static UBYTE Recover_AskRereads(ULONG nTracks) {
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  if (gQueueRunning) return 3;         /* queued jobs run unattended */
+  UBYTE body[96];
+  sprintf((char*)body, "%lu track(s) failed on first pass.\nRecovery re-reads per track:", (unsigned long)nTracks);
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, body, (UBYTE*)"3|6|10|Skip" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel == 1) return 3;
+  if (sel == 2) return 6;
+  if (sel == 3) return 10;
+  return 0;
+}
+
+/* Asks for the re-read count and allocates buffers. FALSE = nothing to
+ * recover (or skipped / no memory): failed tracks are then marked DEAD. */
+static BOOL Recover_Start(struct RecoverCtx *rc, struct BadMap *bm) {
+  memset(rc, 0, sizeof(*rc));
+  if (bm->nFailed == 0) return FALSE;
+
+  UBYTE rereads = Recover_AskRereads(bm->nFailed);
+  if (rereads > MAX_REREADS) rereads = MAX_REREADS;
+  rc->rereads = rereads;
+  if (rereads) {
+    rc->raw  = (UBYTE*)AllocVec(RAW_TRACK_SIZE, MEMF_CHIP | MEMF_CLEAR);
+    rc->cand = (UBYTE*)AllocVec((ULONG)rereads * TRACK_SIZE, MEMF_CLEAR);
+    if (rc->raw && rc->cand) return TRUE;
+    LogAdd("No memory for recovery");
+    Recover_Close(rc);
+  }
+
+  for (ULONG t=0; t<TRACKS; ++t) {
+    if (!bm->failed[t]) continue;
+    for (ULONG s=0; s<SECTORS; ++s) bm->state[t*SECTORS + s] = SEC_DEAD;
+    bm->nBad += SECTORS;
+  }
+  return FALSE;
+}
+
+static void Recover_Close(struct RecoverCtx *rc) {
+  if (rc->raw)  FreeVec(rc->raw);
+  if (rc->cand) FreeVec(rc->cand);
+  rc->raw = rc->cand = NULL;
+}
+
+/* Odd/even MFM pair -> data long */
+static ULONG MFM_Long(const UWORD *odd, const UWORD *even) {
+  ULONG o = ((ULONG)odd[0] << 16) | odd[1];
+  ULONG e = ((ULONG)even[0] << 16) | even[1];
+  return ((o & 0x55555555UL) << 1) | (e & 0x55555555UL);
+}
+
+/* XOR of raw MFM longs masked to data bits (AmigaDOS header/data checksum) */
+static ULONG MFM_Sum(const UWORD *w, ULONG nlongs) {
+  ULONG s = 0;
+  while (nlongs--) { s ^= ((ULONG)w[0] << 16) | w[1]; w += 2; }
+  return s & 0x55555555UL;
+}
+
+/* Same checksum computed on decoded data (used to validate a voted sector) */
+static ULONG Data_Sum(const UBYTE *d) {
+  ULONG s = 0;
+  for (ULONG i=0; i<BYTES_PER_SECTOR; i+=4) {
+    ULONG v = ((ULONG)d[i] << 24) | ((ULONG)d[i+1] << 16) | ((ULONG)d[i+2] << 8) | d[i+3];
+    s ^= (v >> 1) ^ v;
+  }
+  return s & 0x55555555UL;
+}
+
+/* Decode every sector found in rc->raw into copy 'a'; returns sectors with good data sum */
+static ULONG Recover_DecodeRaw(struct RecoverCtx *rc, ULONG a, ULONG t) {
+  const UWORD *w   = (const UWORD*)rc->raw;
+  const ULONG nw   = RAW_TRACK_SIZE / 2;
+  UBYTE *copy      = rc->cand + a * TRACK_SIZE;
+  ULONG good       = 0;
+
+  for (ULONG i=0; i + RAW_SECTOR_LONGS*2 < nw; ++i) {
+    if (w[i] != 0x4489) continue;
+    while (i < nw && w[i] == 0x4489) ++i;
+    if (i + RAW_SECTOR_LONGS*2 >= nw) break;
+    const UWORD *s = w + i;
+
+    ULONG info = MFM_Long(s, s+2);
+    if (MFM_Sum(s, 10) != MFM_Long(s+20, s+22)) continue;   /* header sum */
+    ULONG trk = (info >> 16) & 0xFF, sec = (info >> 8) & 0xFF;
+    if ((info >> 24) != 0xFF || trk != t || sec >= SECTORS) continue;
+
+    UBYTE *d = copy + sec * BYTES_PER_SECTOR;
+    for (ULONG k=0; k<BYTES_PER_SECTOR/4; ++k) {
+      ULONG v = MFM_Long(s + 28 + 2*k, s + 28 + 256 + 2*k);
+      d[4*k] = (UBYTE)(v >> 24); d[4*k+1] = (UBYTE)(v >> 16);
+      d[4*k+2] = (UBYTE)(v >> 8); d[4*k+3] = (UBYTE)v;
+    }
+    rc->have[a][sec] = 1;
+    rc->dsum[a][sec] = MFM_Long(s+24, s+26);
+    if (MFM_Sum(s + 28, 256) == rc->dsum[a][sec]) { rc->have[a][sec] = 2; good++; }
+    i += RAW_SECTOR_LONGS*2 - 1;
+  }
+  return good;
+}
+
+/* Bitwise majority over the copies of one sector; returns TRUE if the vote passes its checksum */
+static BOOL Recover_Vote(struct RecoverCtx *rc, ULONG sec, ULONG n, UBYTE *out) {
+  ULONG idx[MAX_REREADS]; ULONG k = 0;
+  for (ULONG a=0; a<n; ++a) if (rc->have[a][sec]) idx[k++] = a;
+  if (k == 0) return FALSE;
+
+  for (ULONG b=0; b<BYTES_PER_SECTOR; ++b) {
+    UBYTE v = 0;
+    for (int bit=0; bit<8; ++bit) {
+      ULONG ones = 0;
+      for (ULONG j=0; j<k; ++j)
+        ones += (rc->cand[idx[j]*TRACK_SIZE + sec*BYTES_PER_SECTOR + b] >> bit) & 1;
+      if (ones * 2 > k) v |= (UBYTE)(1 << bit);
+    }
+    out[b] = v;
+  }
+
+  /* The stored checksum can be hit too: accept any copy's value that matches */
+  ULONG sum = Data_Sum(out);
+  for (ULONG j=0; j<k; ++j) if (rc->dsum[idx[j]][sec] == sum) return TRUE;
+  return FALSE;
+}
+
+static void Recover_Recal(struct IOExtTD *io, ULONG t) {
+  /* Seek to the opposite end of the disk and back to re-seat the head */
+  ULONG away = (t < TRACKS/2) ? (TRACKS-1) : 0;
+  io->iotd_Req.io_Flags   = 0;
+  io->iotd_Req.io_Command = TD_SEEK;
+  io->iotd_Req.io_Offset  = away * TRACK_SIZE;
+  Trace_DoIO((struct IORequest*)io);
+  io->iotd_Req.io_Command = TD_SEEK;
+  io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+  Trace_DoIO((struct IORequest*)io);
+}
+
+/* Re-reads track t into dst, records its sectors in bm; returns sectors still WEAK/DEAD */
+static ULONG Recover_Track(struct RecoverCtx *rc, struct IOExtTD *io, ULONG t, UBYTE *dst, struct BadMap *bm) {
+  UBYTE *state = &bm->state[t * SECTORS];
+  ULONG resolved = 0;
+  for (ULONG s=0; s<SECTORS; ++s) state[s] = SEC_DEAD;
+  memset(rc->have, 0, sizeof(rc->have));
+  memset(dst, 0, TRACK_SIZE);
+
+  ULONG a;
+  for (a=0; a<rc->rereads && resolved < SECTORS; ++a) {
+    if (a > 0 && (a % 2) == 0) Recover_Recal(io, t);
+
+    /* Drop trackdisk's cached copy so the next read hits the media */
+    io->iotd_Req.io_Flags   = 0;
+    io->iotd_Req.io_Command = CMD_CLEAR;
+    Trace_DoIO((struct IORequest*)io);
+
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)(rc->cand + a * TRACK_SIZE);
+    io->iotd_Req.io_Length  = TRACK_SIZE;
+    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+    if (Trace_DoIO((struct IORequest*)io) == 0) {
+      for (ULONG s=0; s<SECTORS; ++s) {
+        if (state[s] != SEC_REREAD) {
+          memcpy(dst + s*BYTES_PER_SECTOR, rc->cand + a*TRACK_SIZE + s*BYTES_PER_SECTOR, BYTES_PER_SECTOR);
+          state[s] = SEC_REREAD;
+        }
+      }
+      resolved = SECTORS;
+      break;
+    }
+
+    io->iotd_Req.io_Command = TD_RAWREAD;
+    io->iotd_Req.io_Flags   = IOTDF_WORDSYNC;
+    io->iotd_Req.io_Data    = (APTR)rc->raw;
+    io->iotd_Req.io_Length  = RAW_TRACK_SIZE;
+    io->iotd_Req.io_Offset  = t;
+    LONG err = Trace_DoIO((struct IORequest*)io);
+    io->iotd_Req.io_Flags   = 0;
+    if (err != 0) continue;
+
+    memset(rc->cand + a * TRACK_SIZE, 0, TRACK_SIZE);
+    Recover_DecodeRaw(rc, a, t);
+    for (ULONG s=0; s<SECTORS; ++s) {
+      if (state[s] == SEC_REREAD || rc->have[a][s] != 2) continue;
+      memcpy(dst + s*BYTES_PER_SECTOR, rc->cand + a*TRACK_SIZE + s*BYTES_PER_SECTOR, BYTES_PER_SECTOR);
+      state[s] = SEC_REREAD;
+      resolved++;
+    }
+  }
+
+  /* Sectors that never passed their checksum: majority vote over all copies */
+  ULONG bad = 0;
+  for (ULONG s=0; s<SECTORS && resolved < SECTORS; ++s) {
+    if (state[s] == SEC_REREAD) continue;
+    UBYTE *out = dst + s*BYTES_PER_SECTOR;
+    BOOL any = FALSE;
+    for (ULONG j=0; j<a; ++j) if (rc->have[j][s]) any = TRUE;
+    if (!any)                        { state[s] = SEC_DEAD;  bad++; }
+    else if (Recover_Vote(rc, s, a, out)) state[s] = SEC_VOTED;
+    else                             { state[s] = SEC_WEAK;  bad++; }
+  }
+
+  bm->nBad += bad;
+  char m[80];
+  if (bad) sprintf(m, "Track %lu: %lu bad sector(s) after %lu reads", (unsigned long)t, (unsigned long)bad, (unsigned long)a);
+  else     sprintf(m, "Track %lu recovered", (unsigned long)t);
+  LogAdd(m);
+  return bad;
+}
+
+static BOOL RawWritePass(UBYTE unit) {
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (!OpenTD(unit, &p, &io)) return FALSE;
+
+  SetFloppyMotor(unit, TRUE);
+
+  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
+  UBYTE *verifyBuf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
+  if (!buf || !verifyBuf) {
+    if (buf) FreeVec(buf);
+    if (verifyBuf) FreeVec(verifyBuf);
+    CloseTD(p, io);
+    return FALSE;
+  }
+  memset(buf, 0, TRACK_SIZE);
+
+  BOOL ok = TRUE;
+  BOOL useFormat = (gProf[unit].format != PROF_FMT_NO);   // per drive profile
+  for (ULONG t=0; t<TRACKS; ++t) {
+    int maxRetry = (t == 0) ? gProf[unit].retry0 : gProf[unit].retry;  // More retries on track 0
+    BOOL success = FALSE;
+
+    if (t == 0) {
+      // Pre-scrub with pattern A5
+      memset(buf, 0xA5, TRACK_SIZE);
+      io->iotd_Req.io_Command = CMD_WRITE;
+      io->iotd_Req.io_Data    = (APTR)buf;
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = 0;
+      Trace_DoIO((struct IORequest*)io); // Ignore result
+
+      // Pre-scrub with pattern 00
+      memset(buf, 0x00, TRACK_SIZE);
+      io->iotd_Req.io_Command = CMD_WRITE;
+      io->iotd_Req.io_Data    = (APTR)buf;
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = 0;
+      Trace_DoIO((struct IORequest*)io); // Ignore result
+    }
+
+    while (maxRetry-- > 0 && !success) {
+
+    // Try CMD_FORMAT if supported
+    io->iotd_Req.io_Command = CMD_FORMAT;
+    io->iotd_Req.io_Data    = (APTR)buf;
     io->iotd_Req.io_Length  = TRACK_SIZE;
     io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)io) == 0) {
+    if (!useFormat) {
+      // Profile or an earlier track said no: straight to CMD_WRITE
+    } else if (Trace_DoIO((struct IORequest*)io) == 0) {
       // Format success, now verify
       io->iotd_Req.io_Command = CMD_READ;
-      io->iotd_Req.io_Data    = (APTR)verifyBuf;
+      io->iotd_Req.io_Data    = (APTR)verifyBuf;
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)io) == 0 &&
+          kern_zero(verifyBuf, TRACK_SIZE)) {   // buf is all zeros
+        success = TRUE;
+        goto track_done;
+      } else {
+        LogAdd("CMD_FORMAT verify failed; fallback to CMD_WRITE.");
+      }
+    } else {
+      LogAdd("CMD_FORMAT failed; CMD_WRITE for the rest of the pass.");
+      useFormat = FALSE;
+    }
+
+      io->iotd_Req.io_Command = CMD_WRITE;
+      io->iotd_Req.io_Data    = (APTR)buf;
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)io) == 0) {
+        // Verify immediately after write
+        io->iotd_Req.io_Command = CMD_READ;
+        io->iotd_Req.io_Data    = (APTR)verifyBuf;
+        io->iotd_Req.io_Length  = TRACK_SIZE;
+        io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+        if (Trace_DoIO((struct IORequest*)io) == 0 &&
+            kern_zero(verifyBuf, TRACK_SIZE)) {
+          success = TRUE;
+        } else {
+          LogAdd("Verify failed after write.");
+        }
+      } else {
+        LogAdd("Write failed, retrying...");
+      }
+      WaitTOF();
+    }
+
+    if (!success) {
+      char m[80]; sprintf(m, "Track %lu failed after retries.", (unsigned long)t);
+      LogAdd(m);
+      // Don't abort; continue with next track (format even if error)
+    }
+
+    track_done:
+    DrawProgress(t+1, TRACKS);
+    if ((t % 4) == 0 || t == TRACKS-1) {
+      char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS);
+      LogAdd(m);
+    }
+  }
+
+  FreeVec(buf);
+  FreeVec(verifyBuf);
+  CloseTD(p, io);
+  return ok;
+}
+
+static BOOL RawVerify(UBYTE unit) {
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (!OpenTD(unit, &p, &io)) return FALSE;
+
+  SetFloppyMotor(unit, TRUE);
+
+  ULONG xfer = gProf[unit].xfer;               /* tracks per request, from the profile */
+  UBYTE *buf = (UBYTE*)AllocVec(xfer * TRACK_SIZE, MEMF_CLEAR);
+  if (!buf) { CloseTD(p, io); return FALSE; }
+
+  ULONG doneSectors = 0;
+  BadMap_Init(&gBad);
+
+  for (ULONG t=0; t<TRACKS; t += xfer) {
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)buf;
+    io->iotd_Req.io_Length  = xfer * TRACK_SIZE;
+    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+    LONG err = Trace_DoIO((struct IORequest*)io);
+    if (err != 0) {
+      char m[80]; sprintf(m, "Read error at track %lu (io_Error=%ld)", (unsigned long)t, (long)io->iotd_Req.io_Error);
+      LogAdd(m);
+      for (ULONG k=0; k<xfer; ++k) BadMap_FailTrack(&gBad, t + k);
+    }
+    doneSectors += xfer * SECTORS;
+    DrawProgress(doneSectors, TOTAL_SECTORS);
+    if ((t % 8) == 0 || t + xfer >= TRACKS) { char m[80]; sprintf(m, "Track %lu/%u, sectors %lu/%u", (unsigned long)(t+xfer), TRACKS, (unsigned long)doneSectors, (unsigned)TOTAL_SECTORS); LogAdd(m); }
+  }
+
+  struct RecoverCtx rc;
+  if (Recover_Start(&rc, &gBad)) {
+    DrawStatus("Verify: recovering failed tracks...");
+    ULONG n = 0;
+    for (ULONG t=0; t<TRACKS; ++t) {
+      if (!gBad.failed[t]) continue;
+      Recover_Track(&rc, io, t, buf, &gBad);
+      DrawProgress(++n, gBad.nFailed);
+    }
+    Recover_Close(&rc);
+  }
+
+  FreeVec(buf);
+  CloseTD(p, io);
+  return gBad.nBad == 0;
+}
+
+/* ====== Quick triage ======
+ * Sorting a box of unknown disks does not need every track. Triage reads
+ * the bootblock, the root block, the bitmap blocks the root lists and a
+ * random sample of other tracks (TRIAGE_VAR, default TRIAGE_DEF), in one
+ * sweep out and, for bitmap tracks found behind the head, one sweep back.
+ * A clean disk's confidence is the chance that a disk with TRIAGE_BAD_PCT%
+ * bad tracks would have failed at least one of these reads; otherwise it
+ * is the share of reads that agree with the verdict.
+ */
+#define TRIAGE_VAR     "FloppyTool/TriageTracks"
+#define TRIAGE_DEF     12
+#define TRIAGE_BAD_PCT 10
+#define BM_PAGES_OFS   316                      /* root: 25 bitmap block pointers */
+#define BM_PAGES       25
+
+enum { TRI_READABLE=0, TRI_RECOVER, TRI_DEAD };
+static const char *const triName[3] = { "readable", "needs recovery", "dead" };
+
+static ULONG Blk_Long(const UBYTE *b, ULONG ofs) {
+  return ((ULONG)b[ofs] << 24) | ((ULONG)b[ofs+1] << 16) | ((ULONG)b[ofs+2] << 8) | b[ofs+3];
+}
+
+/* OFS/FFS header and bitmap blocks: all longs, checksum included, sum to 0 */
+static BOOL Blk_SumOk(const UBYTE *b) {
+  ULONG s = 0;
+  for (ULONG i=0; i<BYTES_PER_SECTOR; i+=4) s += Blk_Long(b, i);
+  return s == 0;
+}
+
+static ULONG Triage_Samples(void) {
+  char text[16];
+  ULONG n = TRIAGE_DEF;
+  if (GetVar((STRPTR)TRIAGE_VAR, (STRPTR)text, sizeof(text), 0) > 0) sscanf(text, "%lu", &n);
+  if (n < 1) n = 1;
+  if (n > TRACKS - 2) n = TRACKS - 2;
+  return n;
+}
+
+/* Chance in % that `reads` distinct clean tracks would include a bad one
+ * if TRIAGE_BAD_PCT% of the disk were bad (hypergeometric, 16.16 fixed) */
+static ULONG Triage_Confidence(ULONG reads) {
+  ULONG bad = TRACKS * TRIAGE_BAD_PCT / 100, q = 65536;
+  for (ULONG i=0; i<reads && q; ++i) q = q * (TRACKS - bad - i) / (TRACKS - i);
+  return 100 - (q * 100 + 32768) / 65536;
+}
+
+static BOOL RunTriage(UBYTE unit, UBYTE *verdictOut) {
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (!OpenTD(unit, &p, &io)) { LogAdd("Open trackdisk failed"); return FALSE; }
+  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_ANY);
+  if (!buf) { CloseTD(p, io); LogAdd("No memory"); return FALSE; }
+
+  /* want: 1 sample, 2 filesystem structure; got: 1 read, 2 failed */
+  UBYTE want[TRACKS], got[TRACKS];
+  memset(want, 0, sizeof(want));
+  memset(got, 0, sizeof(got));
+  want[0] = want[ROOT_TRACK] = 2;
+  ULONG n = Triage_Samples(), seed = StampTicks() ^ ((ULONG)unit << 24) ^ 0x9E3779B9UL;
+  for (ULONG k=0; k<n; ) {
+    seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;          /* xorshift32 */
+    ULONG t = seed % TRACKS;
+    if (!want[t]) { want[t] = 1; k++; }
+  }
+  ULONG bmBlk[BM_PAGES], nBm = 0, bmBad = 0;
+  ULONG total = n + 2, reads = 0, fails = 0;
+  BOOL dos = FALSE, rootOk = FALSE;
+  struct BootInfo bi;
+  bi.class = BOOT_NDOS;
+
+  char m[100];
+  ULONG t0 = StampTicks();
+  SetFloppyMotor(unit, TRUE);
+  for (int pass=0; pass<2; ++pass) {
+    for (ULONG k=0; k<TRACKS; ++k) {
+      ULONG t = pass ? TRACKS-1 - k : k;
+      if (!want[t] || got[t]) continue;
+      io->iotd_Req.io_Command = CMD_READ;
+      io->iotd_Req.io_Data    = (APTR)buf;
       io->iotd_Req.io_Length  = TRACK_SIZE;
       io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-      if (DoIO((struct IORequest*)io) == 0 &&
-          memcmp(buf, verifyBuf, TRACK_SIZE) == 0) {
-        success = TRUE;
-        goto track_done;
-      } else {
-        LogAdd("CMD_FORMAT verify failed; fallback to CMD_WRITE.");
+      BOOL ok = (Trace_DoIO((struct IORequest*)io) == 0);
+      got[t] = ok ? 1 : 2;
+      reads++;
+      DrawProgress(reads, total);
+      if (!ok) {
+        fails++;
+        sprintf(m, "Track %lu: read error", (unsigned long)t); LogAdd(m);
+        continue;
+      }
+      if (t == 0) {
+        boot_scan(buf, Boot_Db(), &bi);
+        dos = (bi.class != BOOT_NDOS);
+        Boot_Report(buf);
       }
+      if (t == ROOT_TRACK && dos) {
+        const UBYTE *root = buf + (ROOT_BLOCK % SECTORS) * BYTES_PER_SECTOR;
+        rootOk = (Blk_Long(root, 0) == 2 && Blk_Long(root, BYTES_PER_SECTOR - 4) == 1 && Blk_SumOk(root));
+        if (!rootOk) LogAdd("Root block invalid");
+        for (ULONG i=0; rootOk && i<BM_PAGES; ++i) {
+          ULONG b = Blk_Long(root, BM_PAGES_OFS + 4 * i);
+          if (!b || b >= TOTAL_SECTORS) continue;
+          bmBlk[nBm++] = b;
+          ULONG bt = b / SECTORS;
+          if (bt == t || want[bt] == 2) continue;
+          if (!want[bt] || got[bt] == 1) total++;
+          want[bt] = 2;
+          if (got[bt] == 1) got[bt] = 0;       /* read earlier as a sample: again for the block */
+        }
+      }
+      for (ULONG i=0; i<nBm; ++i)
+        if (bmBlk[i] / SECTORS == t && !Blk_SumOk(buf + (bmBlk[i] % SECTORS) * BYTES_PER_SECTOR)) bmBad++;
+    }
+  }
+  Motor_Release(unit);
+  FreeVec(buf);
+  CloseTD(p, io);
+
+  ULONG clean = 0;
+  for (ULONG t=0; t<TRACKS; ++t) if (got[t] == 1) clean++;
+  UBYTE v;
+  ULONG conf;
+  if ((got[0] != 1 && got[ROOT_TRACK] != 1) || fails * 2 > reads) { v = TRI_DEAD; conf = fails * 100 / reads; }
+  else if (fails)                                                  { v = TRI_RECOVER; conf = (reads - fails) * 100 / reads; }
+  else                                                             { v = TRI_READABLE; conf = Triage_Confidence(clean); }
+
+  if (bi.class == BOOT_NDOS && got[0] == 1) LogAdd("Not a DOS disk (no filesystem checks)");
+  else if (dos && rootOk) {
+    sprintf(m, "Filesystem: root OK, %lu bitmap block(s), %lu bad", (unsigned long)nBm, (unsigned long)bmBad);
+    LogAdd(m);
+  }
+  ULONG ticks = StampTicks() - t0;
+  sprintf(m, "Triage: %lu track(s) read, %lu failed (~%lu of %u bad), %lu.%lu s", (unsigned long)reads,
+          (unsigned long)fails, (unsigned long)(fails * TRACKS / reads), TRACKS,
+          (unsigned long)(ticks / 50), (unsigned long)((ticks % 50) / 5));
+  LogAdd(m);
+  sprintf(m, "DF%u: %s, %lu%% confidence", (unsigned)unit, triName[v], (unsigned long)conf);
+  DrawStatus(m);
+  Boot_Alert();
+  ClearProgress();
+  *verdictOut = v;
+  return TRUE;
+}
+
+static void DoTriage(UBYTE unit) {
+  LogClear();
+  DrawStatus("Triage: sampling tracks...");
+  gBootAlert[0] = '\0';
+  UBYTE v;
+  if (!RunTriage(unit, &v)) { DrawStatus("Triage failed."); return; }
+  if (v == TRI_DEAD) return;
+
+  static UBYTE title[] = APP_NAME " " APP_VER;
+  char body[80];
+  sprintf(body, "DF%u: %s.\nQueue a full capture?", (unsigned)unit, triName[v]);
+  struct EasyStruct es = { sizeof(struct EasyStruct), 0, title, (UBYTE*)body, (UBYTE*)"Queue ADF|Queue ADZ|No" };
+  LONG sel = Trace_EasyRequest(ui.win, &es, NULL, NULL);
+  PumpRefresh();
+  if (sel < 1 || sel > 2) return;
+  Queue_Detach();
+  struct Job *j = Queue_Add(JOB_READ, unit, (UBYTE)(sel == 2), "");
+  Queue_Attach();
+  if (!j) { DrawStatus("No memory for job."); return; }
+  Queue_Save();
+  LogAdd("Full capture queued.");
+}
+
+static BOOL RawCopyTwoDrives(UBYTE srcUnit, UBYTE dstUnit) {
+  struct MsgPort *ps = NULL; struct IOExtTD *is = NULL;
+  struct MsgPort *pd = NULL; struct IOExtTD *id = NULL;
+
+  if (!OpenTD(srcUnit, &ps, &is)) return FALSE;
+  if (!OpenTD(dstUnit, &pd, &id)) { CloseTD(ps, is); return FALSE; }
+
+  SetFloppyMotor(srcUnit, TRUE);
+  SetFloppyMotor(dstUnit, TRUE);
+
+  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
+  if (!buf) { CloseTD(ps, is); CloseTD(pd, id); return FALSE; }
+
+  ULONG done = 0;
+  BOOL ok = TRUE;
+  BadMap_Init(&gBad);
+
+  for (ULONG t=0; t<TRACKS; ++t) {
+    is->iotd_Req.io_Command = CMD_READ;
+    is->iotd_Req.io_Data    = (APTR)buf;
+    is->iotd_Req.io_Length  = TRACK_SIZE;
+    is->iotd_Req.io_Offset  = t * TRACK_SIZE;
+    if (Trace_DoIO((struct IORequest*)is) != 0) {
+      /* Written later by the recovery pass */
+      char m[64]; sprintf(m, "Read error at track %lu, deferred", (unsigned long)t); LogAdd(m);
+      BadMap_FailTrack(&gBad, t);
     } else {
-      LogAdd("CMD_FORMAT failed; fallback to CMD_WRITE.");
+      id->iotd_Req.io_Command = CMD_WRITE;
+      id->iotd_Req.io_Data    = (APTR)buf;
+      id->iotd_Req.io_Length  = TRACK_SIZE;
+      id->iotd_Req.io_Offset  = t * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)id) != 0) { ok = FALSE; LogAdd("Write error"); break; }
+    }
+
+    done += TRACK_SIZE;
+    DrawProgress(done, DISK_SIZE);
+    if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
+  }
+
+  struct RecoverCtx rc;
+  if (ok && Recover_Start(&rc, &gBad)) {
+    DrawStatus("Copy: recovering failed tracks...");
+    ULONG n = 0;
+    for (ULONG t=0; t<TRACKS && ok; ++t) {
+      if (!gBad.failed[t]) continue;
+      Recover_Track(&rc, is, t, buf, &gBad);
+      id->iotd_Req.io_Command = CMD_WRITE;
+      id->iotd_Req.io_Data    = (APTR)buf;
+      id->iotd_Req.io_Length  = TRACK_SIZE;
+      id->iotd_Req.io_Offset  = t * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)id) != 0) { ok = FALSE; LogAdd("Write error"); }
+      DrawProgress(++n, gBad.nFailed);
+    }
+    Recover_Close(&rc);
+  } else if (ok && gBad.nFailed) {
+    /* Skipped: still lay down blank tracks so the copy is complete */
+    memset(buf, 0, TRACK_SIZE);
+    for (ULONG t=0; t<TRACKS && ok; ++t) {
+      if (!gBad.failed[t]) continue;
+      id->iotd_Req.io_Command = CMD_WRITE;
+      id->iotd_Req.io_Data    = (APTR)buf;
+      id->iotd_Req.io_Length  = TRACK_SIZE;
+      id->iotd_Req.io_Offset  = t * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)id) != 0) { ok = FALSE; LogAdd("Write error"); }
+    }
+  }
+  if (ok) {
+    id->iotd_Req.io_Command = CMD_UPDATE;
+    Trace_DoIO((struct IORequest*)id);
+  }
+
+  FreeVec(buf);
+  CloseTD(ps, is);
+  CloseTD(pd, id);
+  return ok;
+}
+
+/* ====== Packed RAM images ======
+ * One-drive copies and the image cache hold disks as struct PackImg. An
+ * empty track takes no memory, a track equal to one already stored shares
+ * its memory (same CRC32, then compared), and the rest is kept ByteRun1-
+ * packed when that is smaller. Tracks are unpacked as they are written.
+ */
+
+/* t must not be stored yet, or be stored empty (a failed read being
+   replaced); FALSE = out of memory, t then reads as zeros */
+static BOOL Pack_Put(struct PackImg *pi, ULONG t, const UBYTE *buf, UBYTE *tmp) {
+  pi->kind[t] = PACK_EMPTY;
+  if (kern_zero(buf, TRACK_SIZE)) return TRUE;
+
+  ULONG crc = crc32_final(crc32_update(crc32_init(), buf, TRACK_SIZE));
+  for (ULONG u=0; u<TRACKS; ++u) {
+    if (pi->kind[u] < PACK_RUN1 || pi->crc[u] != crc) continue;
+    if (!Pack_Get(pi, u, tmp) || !kern_equal(tmp, buf, TRACK_SIZE)) continue;
+    pi->trk[t]  = pi->trk[u];
+    pi->len[t]  = pi->len[u];
+    pi->crc[t]  = crc;
+    pi->kind[t] = PACK_DUP;
+    return TRUE;
+  }
+
+  ULONG n = pack_run1(buf, TRACK_SIZE, tmp, TRACK_SIZE - 1);
+  UWORD len = n ? (UWORD)n : TRACK_SIZE;
+  UBYTE *m = (UBYTE*)AllocVec(len, MEMF_ANY);
+  if (!m) { pi->kind[t] = PACK_NONE; return FALSE; }
+  memcpy(m, n ? tmp : buf, len);
+  pi->trk[t]  = m;
+  pi->len[t]  = len;
+  pi->crc[t]  = crc;
+  pi->kind[t] = n ? PACK_RUN1 : PACK_RAW;
+  pi->used   += len;
+  return TRUE;
+}
+
+static BOOL Pack_Get(const struct PackImg *pi, ULONG t, UBYTE *buf) {
+  if (pi->kind[t] <= PACK_EMPTY) { memset(buf, 0, TRACK_SIZE); return TRUE; }
+  if (pi->len[t] == TRACK_SIZE)  { memcpy(buf, pi->trk[t], TRACK_SIZE); return TRUE; }
+  return unpack_run1(pi->trk[t], pi->len[t], buf, TRACK_SIZE);
+}
+
+static void Pack_Free(struct PackImg *pi) {
+  for (ULONG t=0; t<TRACKS; ++t)
+    if (pi->kind[t] >= PACK_RUN1) FreeVec(pi->trk[t]);
+  memset(pi, 0, sizeof(*pi));
+}
+
+static void Pack_Log(const struct PackImg *pi, CONST_STRPTR what) {
+  ULONG n[PACK_RAW+1] = { 0 };
+  for (ULONG t=0; t<TRACKS; ++t) n[pi->kind[t]]++;
+  ULONG tracks = TRACKS - n[PACK_NONE];
+  char m[128];
+  sprintf(m, "%s: %lu tracks in %lu KB, %lu KB saved (%lu empty, %lu shared, %lu packed)",
+          what, (unsigned long)tracks, (unsigned long)((pi->used + 1023) / 1024),
+          (unsigned long)((tracks * TRACK_SIZE - pi->used) / 1024),
+          (unsigned long)n[PACK_EMPTY], (unsigned long)n[PACK_DUP], (unsigned long)n[PACK_RUN1]);
+  LogAdd(m);
+}
+
+/* The source goes to a packed RAM image, written out after the swap. If
+ * memory runs out first, the disk is copied in parts of as many tracks as
+ * fit, one swap each way per part. */
+static BOOL RawCopyOneDrive(UBYTE unit) {
+  BOOL ok = FALSE;
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (!OpenTD(unit, &p, &io)) return FALSE;
+
+  SetFloppyMotor(unit, TRUE);
+
+  static struct PackImg img;
+  static struct BadMap part;
+  UBYTE *buf = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_CLEAR);   /* track + packing buffer */
+  if (!buf) { CloseTD(p, io); return FALSE; }
+  UBYTE *tmp = buf + TRACK_SIZE;
+  memset(&img, 0, sizeof(img));
+
+  BadMap_Init(&gBad);
+  ULONG first = 0, parts = 0, saved = 0;
+  while (first < TRACKS) {
+    if (parts && !AskSwap("SOURCE")) goto cleanup;
+    parts++;
+    BadMap_Init(&part);
+    DrawStatus(first ? "Reading next part of source to RAM..." : "Reading source to RAM (swap later)...");
+    ClearProgress();
+    ULONG end;
+    for (end=first; end<TRACKS; ++end) {
+      if (end > first && AvailMem(MEMF_ANY) < PACK_RESERVE + TRACK_SIZE) break;
+      io->iotd_Req.io_Command = CMD_READ;
+      io->iotd_Req.io_Data    = (APTR)buf;
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = end * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)io) != 0) {
+        char m[64]; sprintf(m, "Read error at track %lu, deferred", (unsigned long)end); LogAdd(m);
+        memset(buf, 0, TRACK_SIZE);
+        BadMap_FailTrack(&part, end);
+      }
+      if (!Pack_Put(&img, end, buf, tmp)) break;
+      DrawProgress((end+1) * TRACK_SIZE, DISK_SIZE);
+      if ((end % 8) == 0 || end == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(end+1), TRACKS); LogAdd(m); }
+    }
+    if (end == first) { LogAdd("No memory for RAM image"); goto cleanup; }
+    if (end < TRACKS) {
+      char m[80]; sprintf(m, "RAM full after track %lu, copying in parts", (unsigned long)(end-1)); LogAdd(m);
+    }
+
+    struct RecoverCtx rc;
+    if (Recover_Start(&rc, &part)) {
+      DrawStatus("Recovering failed tracks...");
+      ULONG n = 0;
+      for (ULONG t=first; t<end; ++t) {
+        if (!part.failed[t]) continue;
+        Recover_Track(&rc, io, t, buf, &part);
+        if (!Pack_Put(&img, t, buf, tmp)) LogAdd("No memory for a recovered track, written blank");
+        DrawProgress(++n, part.nFailed);
+      }
+      Recover_Close(&rc);
+    }
+    for (ULONG t=first; t<end; ++t) {
+      gBad.failed[t] = part.failed[t];
+      memcpy(&gBad.state[t * SECTORS], &part.state[t * SECTORS], SECTORS);
     }
+    gBad.nFailed += part.nFailed;
+    gBad.nBad    += part.nBad;
+    Pack_Log(&img, "RAM image");
+    saved += (end - first) * TRACK_SIZE - img.used;
+
+    ClearProgress();
+    if (!AskSwap("DESTINATION")) goto cleanup;
 
+    DrawStatus("Writing RAM image to destination...");
+    for (ULONG t=first; t<end; ++t) {
+      Pack_Get(&img, t, buf);
       io->iotd_Req.io_Command = CMD_WRITE;
       io->iotd_Req.io_Data    = (APTR)buf;
       io->iotd_Req.io_Length  = TRACK_SIZE;
       io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-      if (DoIO((struct IORequest*)io) == 0) {
-        // Verify immediately after write
-        io->iotd_Req.io_Command = CMD_READ;
-        io->iotd_Req.io_Data    = (APTR)verifyBuf;
-        io->iotd_Req.io_Length  = TRACK_SIZE;
-        io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-        if (DoIO((struct IORequest*)io) == 0 &&
-            memcmp(buf, verifyBuf, TRACK_SIZE) == 0) {
-          success = TRUE;
-        } else {
-          LogAdd("Verify failed after write.");
+      if (Trace_DoIO((struct IORequest*)io) != 0) { LogAdd("Write error"); goto cleanup; }
+      DrawProgress((t+1) * TRACK_SIZE, DISK_SIZE);
+      if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
+    }
+    Pack_Free(&img);
+    first = end;
+  }
+
+  if (parts > 1) {
+    char m[80]; sprintf(m, "Copied in %lu parts, %lu KB saved in all", (unsigned long)parts, (unsigned long)(saved / 1024));
+    LogAdd(m);
+  }
+  ok = TRUE;
+
+cleanup:
+  Pack_Free(&img);
+  FreeVec(buf);
+  CloseTD(p, io);
+  return ok;
+}
+
+/* ====== ADF I/O ====== */
+
+/* ====== Capture journal ======
+ * "<adf>.ftj" gets one line per track once its final data is in the file,
+ * so an interrupted capture can resume at the first missing track.
+ */
+
+static void Journal_Path(CONST_STRPTR adfPath, char *out, int maxlen) {
+  snprintf(out, maxlen, "%s.ftj", adfPath);
+}
+
+static BOOL Journal_Load(struct Journal *j, CONST_STRPTR adfPath) {
+  memset(j, 0, sizeof(*j));
+  char path[320]; Journal_Path(adfPath, path, sizeof(path));
+  BPTR fh = Open((STRPTR)path, MODE_OLDFILE);
+  if (!fh) return FALSE;
+
+  char *text = (char*)AllocVec(JRN_MAX_SIZE, MEMF_CLEAR);
+  if (!text) { Close(fh); return FALSE; }
+  LONG n = Trace_Read(fh, text, JRN_MAX_SIZE-1);
+  Close(fh);
+  if (n < 0) n = 0;
+  text[n] = '\0';
+
+  /* Later lines win: a BAD track re-read on resume is appended again */
+  char *line = text;
+  while (*line) {
+    char *nl = strchr(line, '\n');
+    if (nl) *nl = '\0';
+    unsigned long t, crc; char st[8];
+    if (line[0] != ';' && sscanf(line, "%lu %lx %7s", &t, &crc, st) == 3 && t < TRACKS) {
+      j->state[t] = (strcmp(st, "BAD") == 0) ? JRN_BAD : JRN_OK;
+      j->crc[t]   = (ULONG)crc;
+    }
+    if (!nl) break;
+    line = nl + 1;
+  }
+  FreeVec(text);
+  return TRUE;
+}
+
+/* (Re)writes the journal with the current entries and keeps it open for appending */
+static BOOL Journal_Create(struct Journal *j, CONST_STRPTR adfPath, UBYTE unit) {
+  char path[320]; Journal_Path(adfPath, path, sizeof(path));
+  j->fh = Open((STRPTR)path, MODE_NEWFILE);
+  if (!j->fh) return FALSE;
+
+  char line[64];
+  sprintf(line, "; %s capture journal DF%u:\n", APP_NAME, (unsigned)unit);
+  Trace_Write(j->fh, line, strlen(line));
+  for (ULONG t=0; t<TRACKS; ++t) {
+    if (j->state[t] == JRN_NONE) continue;
+    sprintf(line, "%03lu %08lx %s\n", (unsigned long)t, (unsigned long)j->crc[t], j->state[t] == JRN_BAD ? "BAD" : "OK");
+    Trace_Write(j->fh, line, strlen(line));
+  }
+  return TRUE;
+}
+
+static void Journal_Add(struct Journal *j, ULONG t, ULONG crc, BOOL bad) {
+  j->state[t] = bad ? JRN_BAD : JRN_OK;
+  j->crc[t]   = crc;
+  if (!j->fh) return;
+  char line[32];
+  sprintf(line, "%03lu %08lx %s\n", (unsigned long)t, (unsigned long)crc, bad ? "BAD" : "OK");
+  Trace_Write(j->fh, line, strlen(line));
+}
+
+static void Journal_Close(struct Journal *j) {
+  if (j->fh) { Close(j->fh); j->fh = 0; }
+}
+
+/* Reads the whole image back: drops journal entries whose data does not
+ * match, returns the number dropped and the CRC32 of the full image. */
+static ULONG Journal_Verify(struct Journal *j, BPTR fh, UBYTE *buf, ULONG *imageCrc) {
+  ULONG bad = 0;
+  ULONG all = crc32_init();
+  Seek(fh, 0, OFFSET_BEGINNING);
+  for (ULONG t=0; t<TRACKS; ++t) {
+    if (Trace_Read(fh, buf, TRACK_SIZE) != TRACK_SIZE) {
+      for (; t<TRACKS; ++t) if (j->state[t] != JRN_NONE) { j->state[t] = JRN_NONE; bad++; }
+      break;
+    }
+    all = crc32_update(all, buf, TRACK_SIZE);
+    Capture_Hash(t, buf);                   /* from the first track recovery filled in */
+    if (j->state[t] == JRN_NONE) continue;
+    ULONG crc = crc32_final(crc32_update(crc32_init(), buf, TRACK_SIZE));
+    if (crc != j->crc[t]) { j->state[t] = JRN_NONE; bad++; }
+  }
+  if (imageCrc) *imageCrc = crc32_final(all);
+  return bad;
+}
+
+/* Extends a partial image with zeros to full disk size so a resumed
+ * capture can write tracks in any order. */
+static BOOL ADF_PadFile(BPTR fh, UBYTE *zero) {
+  Seek(fh, 0, OFFSET_END);
+  LONG size = Seek(fh, 0, OFFSET_CURRENT);
+  if (size < 0) return FALSE;
+  memset(zero, 0, TRACK_SIZE);
+  while (size < (LONG)DISK_SIZE) {
+    LONG n = (LONG)DISK_SIZE - size; if (n > TRACK_SIZE) n = TRACK_SIZE;
+    if (Trace_Write(fh, zero, n) != n) return FALSE;
+    size += n;
+  }
+  return TRUE;
+}
+
+/* Bad sectors of the best effort a resumed file holds for track t; more
+ * than SECTORS when there is none. Without a .bad map only a clean pass
+ * may replace it. */
+static ULONG Resume_PrevBad(const struct Journal *j, const struct BadMap *prev, ULONG t) {
+  if (j->state[t] != JRN_BAD) return SECTORS + 1;
+  if (!prev) return 1;
+  ULONG bad = 0;
+  for (ULONG s=0; s<SECTORS; ++s) if (prev->state[t*SECTORS + s] >= SEC_WEAK) bad++;
+  return bad;
+}
+
+static BOOL ADF_ReadFromDrive(UBYTE unit, CONST_STRPTR path, BOOL resume) {
+  if (IsAdzPath(path)) {
+    if (resume) { LogAdd("Resume needs a raw .adf (no journal for .adz)"); return FALSE; }
+    return ADZ_ReadFromDrive(unit, path);
+  }
+
+  static struct Journal jr;
+  static struct BadMap prevMap;
+  const struct BadMap *prev = NULL;
+  if (resume) {
+    if (!Journal_Load(&jr, path)) { LogAdd("No journal found for this ADF"); return FALSE; }
+    if (BadMap_Load(&prevMap, path)) prev = &prevMap;
+  } else {
+    memset(&jr, 0, sizeof(jr));
+  }
+
+  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
+  if (!OpenTD(unit, &p, &io)) { LogAdd("Open trackdisk failed"); return FALSE; }
+
+  SetFloppyMotor(unit, TRUE);
+
+  BPTR fh = Open((STRPTR)path, resume ? MODE_READWRITE : MODE_NEWFILE);
+  if (!fh) { CloseTD(p, io); LogAdd("Cannot create ADF file"); return FALSE; }
+
+  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
+  if (!buf) { Close(fh); CloseTD(p, io); LogAdd("No memory"); return FALSE; }
+
+  BOOL ok = TRUE;
+  if (resume && !ADF_PadFile(fh, buf)) { ok = FALSE; LogAdd("File write error (pre-size)"); }
+
+  if (ok && resume) {
+    /* Keep only entries the partial file really holds */
+    ULONG dropped = Journal_Verify(&jr, fh, buf, NULL);
+    ULONG have = 0, first = TRACKS;
+    for (ULONG t=0; t<TRACKS; ++t) if (jr.state[t] == JRN_OK) { have++; if (first == TRACKS) first = t; }
+    char m[80]; sprintf(m, "Resume: %lu tracks kept, %lu dropped", (unsigned long)have, (unsigned long)dropped);
+    LogAdd(m);
+
+    /* Wrong disk in the drive would silently merge two images */
+    if (first < TRACKS) {
+      io->iotd_Req.io_Command = CMD_READ;
+      io->iotd_Req.io_Data    = (APTR)buf;
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = first * TRACK_SIZE;
+      if (Trace_DoIO((struct IORequest*)io) == 0 &&
+          crc32_final(crc32_update(crc32_init(), buf, TRACK_SIZE)) != jr.crc[first]) {
+        LogAdd("Disk in drive does not match journal");
+        ok = FALSE;
+      }
+    }
+  }
+
+  if (ok && !Journal_Create(&jr, path, unit)) LogAdd("Cannot write journal (no resume)");
+
+  ULONG done = 0;
+  BadMap_Init(&gBad);
+  LONG filePos = -1;
+
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    if (jr.state[t] == JRN_OK) { done += TRACK_SIZE; continue; }
+
+    io->iotd_Req.io_Command = CMD_READ;
+    io->iotd_Req.io_Data    = (APTR)buf;
+    io->iotd_Req.io_Length  = TRACK_SIZE;
+    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+    BOOL got = (Trace_DoIO((struct IORequest*)io) == 0);
+    if (!got) {
+      char m[64]; sprintf(m, "Read error at track %lu, deferred", (unsigned long)t); LogAdd(m);
+      BadMap_FailTrack(&gBad, t);
+    } else if (t == 0) Boot_Report(buf);
+    /* On a new capture a zero placeholder keeps the layout; on resume the
+     * file already holds zeros or the previous best effort. Either way the
+     * recovery pass patches it. */
+    if (got || !resume) {
+      if (!got) memset(buf, 0, TRACK_SIZE);
+      if (filePos != (LONG)(t * TRACK_SIZE)) Seek(fh, (LONG)(t * TRACK_SIZE), OFFSET_BEGINNING);
+      LONG wr = Trace_Write(fh, buf, TRACK_SIZE);
+      if (wr != TRACK_SIZE) { ok = FALSE; LogAdd("File write error"); break; }
+      filePos = (LONG)((t+1) * TRACK_SIZE);
+      if (got) {
+        Journal_Add(&jr, t, crc32_final(crc32_update(crc32_init(), buf, TRACK_SIZE)), FALSE);
+        Capture_Hash(t, buf);
+      }
+    }
+    done += TRACK_SIZE; DrawProgress(done, DISK_SIZE);
+    if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
+  }
+
+  struct RecoverCtx rc;
+  if (ok && Recover_Start(&rc, &gBad)) {
+    DrawStatus("Recovering failed tracks...");
+    ULONG n = 0;
+    for (ULONG t=0; t<TRACKS && ok; ++t) {
+      if (!gBad.failed[t]) continue;
+      ULONG bad = Recover_Track(&rc, io, t, buf, &gBad);
+      /* The file already holds an earlier best effort for a BAD track:
+       * replace it only if this pass leaves fewer bad sectors */
+      ULONG prevBad = Resume_PrevBad(&jr, prev, t);
+      if (bad >= prevBad) {
+        if (prev) {
+          memcpy(&gBad.state[t * SECTORS], &prev->state[t * SECTORS], SECTORS);
+          gBad.nBad = gBad.nBad - bad + prevBad;
         }
-      } else {
-        LogAdd("Write failed, retrying...");
+        char m[64]; sprintf(m, "Track %lu: earlier pass kept", (unsigned long)t); LogAdd(m);
+      } else if (Seek(fh, (LONG)(t * TRACK_SIZE), OFFSET_BEGINNING) < 0 ||
+          Trace_Write(fh, buf, TRACK_SIZE) != TRACK_SIZE) { ok = FALSE; LogAdd("File write error"); }
+      else Journal_Add(&jr, t, crc32_final(crc32_update(crc32_init(), buf, TRACK_SIZE)), bad != 0);
+      DrawProgress(++n, gBad.nFailed);
+    }
+    Recover_Close(&rc);
+  }
+  Journal_Close(&jr);
+
+  /* Final consistency check: every journaled track must read back intact */
+  if (ok) {
+    DrawStatus("Checking image against journal...");
+    ULONG imageCrc = 0;
+    ULONG dropped = Journal_Verify(&jr, fh, buf, &imageCrc);
+    char m[80];
+    if (dropped) { sprintf(m, "%lu track(s) failed read-back", (unsigned long)dropped); LogAdd(m); }
+    sprintf(m, "Image CRC32: %08lx", (unsigned long)imageCrc); LogAdd(m);
+  }
+  ULONG missing = 0;
+  for (ULONG t=0; t<TRACKS; ++t) if (jr.state[t] != JRN_OK) missing++;
+
+  FreeVec(buf);
+  Close(fh);
+  CloseTD(p, io);
+
+  if (ok && gBad.nFailed) {
+    char m[80];
+    if (BadMap_Save(&gBad, path)) sprintf(m, "Bad sectors: %lu (map in .bad)", (unsigned long)gBad.nBad);
+    else                          sprintf(m, "Bad sectors: %lu (map not saved)", (unsigned long)gBad.nBad);
+    LogAdd(m);
+  }
+
+  char jpath[320]; Journal_Path(path, jpath, sizeof(jpath));
+  if (ok && missing == 0) {
+    DeleteFile((STRPTR)jpath);
+  } else {
+    /* Rewrite so the journal only lists verified tracks */
+    if (ok && Journal_Create(&jr, path, unit)) Journal_Close(&jr);
+    char m[80]; sprintf(m, "Journal kept: %lu track(s) to redo, use Resume", (unsigned long)missing);
+    LogAdd(m);
+  }
+
+  if (ok) {
+    BPTR fh2 = Open((STRPTR)path, MODE_OLDFILE);
+    if (fh2) {
+      struct FileInfoBlock *fib = (struct FileInfoBlock*)AllocVec(sizeof(struct FileInfoBlock), MEMF_CLEAR);
+      if (fib && ExamineFH(fh2, fib)) {
+        char m[100]; sprintf(m, "Saved ADF size: %ld bytes", (long)fib->fib_Size);
+        LogAdd(m);
       }
-      WaitTOF();
+      if (fib) FreeVec(fib);
+      Close(fh2);
+    }
+  }
+
+  return ok;
+}
+
+/* ----- Image source (.adf / .adz) ----- */
+
+static LONG Gz_DosRead(void *h, UBYTE *buf, LONG len)        { return Trace_Read((BPTR)h, buf, len); }
+static LONG Gz_DosWrite(void *h, const UBYTE *buf, LONG len) { return Trace_Write((BPTR)h, (APTR)buf, len); }
+
+static BOOL IsAdzPath(CONST_STRPTR path) {
+  int n = (int)strlen((const char*)path);
+  if (n < 4) return FALSE;
+  const char *e = (const char*)path + n - 4;
+  return e[0] == '.' && (e[1] | 0x20) == 'a' && (e[2] | 0x20) == 'd' && (e[3] | 0x20) == 'z';
+}
+
+/* Raw bytes of the file: first what a stream gave up to the format sniff,
+ * then the handle. A pipe returns what it has, so streams read on until
+ * len or the end. */
+static LONG Img_FileRead(void *h, UBYTE *buf, LONG len) {
+  struct ImgSrc *src = (struct ImgSrc*)h;
+  LONG n = 0;
+  while (n < len && src->peekPos < src->npeek) buf[n++] = src->peek[src->peekPos++];
+  while (n < len) {
+    LONG r = Trace_Read(src->fh, buf + n, len - n);
+    if (r < 0) return -1;
+    if (r == 0) break;
+    n += r;
+    if (!src->stream) break;
+  }
+  return n;
+}
+
+static BOOL Img_Open(struct ImgSrc *src, CONST_STRPTR path) {
+  memset(src, 0, sizeof(*src));
+  src->fh = Open((STRPTR)path, MODE_OLDFILE);
+  if (!src->fh) { LogAdd("Cannot open ADF"); return FALSE; }
+
+  /* PIPE: and the like cannot seek: no size up front and nothing is read
+   * twice. Otherwise size via ExamineFH (fallback Seek). */
+  src->stream = (Seek(src->fh, 0, OFFSET_CURRENT) < 0);
+  if (src->stream) src->packed = -1;
+  else {
+    struct FileInfoBlock *fib = (struct FileInfoBlock*)AllocVec(sizeof(struct FileInfoBlock), MEMF_CLEAR);
+    if (fib && ExamineFH(src->fh, fib)) src->packed = fib->fib_Size;
+    else {
+      Seek(src->fh, 0, OFFSET_END);
+      src->packed = Seek(src->fh, 0, OFFSET_BEGINNING);
     }
+    if (fib) FreeVec(fib);
+  }
+  src->size = src->packed;
 
-    if (!success) {
-      char m[80]; sprintf(m, "Track %lu failed after retries.", (unsigned long)t);
-      LogAdd(m);
-      // Don't abort; continue with next track (format even if error)
-    }
+  UBYTE m[4];
+  LONG got;
+  if (src->stream) {
+    got = Img_FileRead(src, m, 4);
+    if (got > 0) { memcpy(src->peek, m, got); src->npeek = (UBYTE)got; }
+  } else {
+    got = (src->packed >= 18) ? Trace_Read(src->fh, m, 4) : 0;
+    Seek(src->fh, 0, OFFSET_BEGINNING);
+  }
 
-    track_done:
-    DrawProgress(t+1, TRACKS);
-    if ((t % 4) == 0 || t == TRACKS-1) {
-      char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS);
-      LogAdd(m);
+  if (got == 4 && m[0] == 'D' && m[1] == 'M' && m[2] == 'S' && m[3] == '!') {
+    /* DMS: unpacked a cylinder at a time, always a full DD disk */
+    src->size = DISK_SIZE;
+    src->dms = (struct DmsIn*)AllocVec(sizeof(struct DmsIn), MEMF_ANY);
+    if (!src->dms) { LogAdd("No memory for DMS"); Img_Close(src); return FALSE; }
+    int rc = dms_open(src->dms, Img_FileRead, (void*)src);
+    if (rc != DMS_OK) {
+      LogAdd(rc == DMS_ERR_MODE ? "DMS encrypted or unsupported" : "Not a valid .dms file");
+      Img_Close(src);
+      return FALSE;
     }
+    return TRUE;
+  }
+  if (got != 4 || m[0] != 0x1F || m[1] != 0x8B) return TRUE;
+
+  /* gzip: the trailer's ISIZE gives the image size without inflating */
+  src->size = -1;
+  if (!src->stream) {
+    if (Seek(src->fh, -4, OFFSET_END) >= 0 && Trace_Read(src->fh, m, 4) == 4)
+      src->size = (LONG)((ULONG)m[0] | ((ULONG)m[1] << 8) | ((ULONG)m[2] << 16) | ((ULONG)m[3] << 24));
+    Seek(src->fh, 0, OFFSET_BEGINNING);
   }
 
-  FreeVec(buf);
-  FreeVec(verifyBuf);
-  CloseTD(p, io);
-  return ok;
+  src->gz = (struct GzIn*)AllocVec(sizeof(struct GzIn), MEMF_ANY);
+  if (!src->gz) { LogAdd("No memory for ADZ"); Img_Close(src); return FALSE; }
+  if (gzin_open(src->gz, Img_FileRead, (void*)src) != GZ_OK) {
+    LogAdd("Not a valid .adz (gzip) file");
+    Img_Close(src);
+    return FALSE;
+  }
+  return TRUE;
 }
 
-static BOOL RawVerify(UBYTE unit) {
-  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
-  if (!OpenTD(unit, &p, &io)) return FALSE;
+/* Bytes read (< len only at the end), 0 = end, < 0 = error */
+static LONG Img_Read(struct ImgSrc *src, UBYTE *buf, LONG len) {
+  LONG n;
+  if (src->mem) {
+    /* Whole tracks unpack straight into buf */
+    for (n = 0; n < len && src->pos + n < src->size; ) {
+      LONG at = src->pos + n, t = at / TRACK_SIZE, o = at % TRACK_SIZE, k = TRACK_SIZE - o;
+      if (k > len - n) k = len - n;
+      if (k == TRACK_SIZE) Pack_Get(src->mem, t, buf + n);
+      else {
+        if (src->memTrack != t) { Pack_Get(src->mem, t, src->memBuf); src->memTrack = t; }
+        memcpy(buf + n, src->memBuf + o, k);
+      }
+      n += k;
+    }
+  }
+  else if (src->gz)  n = gzin_read(src->gz, buf, len);
+  else if (src->dms) n = dms_read(src->dms, buf, len);
+  else               n = Img_FileRead(src, buf, len);
+  if (n <= 0) return n;
+  if (src->fill) Cache_Fill(src, buf, n);
+  src->pos += n;
+  return n;
+}
 
-  SetFloppyMotor(unit, TRUE);
+/* TRUE if nothing follows; for .adz this also checks the gzip CRC32/length */
+static BOOL Img_End(struct ImgSrc *src) {
+  UBYTE extra;
+  return Img_Read(src, &extra, 1) == 0;
+}
+
+static void Img_Close(struct ImgSrc *src) {
+  if (src->fill) Cache_Discard(src);              /* not kept */
+  if (src->memBuf) { FreeVec(src->memBuf); src->memBuf = NULL; }
+  if (src->gz)  { FreeVec(src->gz); src->gz = NULL; }
+  if (src->dms) { FreeVec(src->dms); src->dms = NULL; }
+  if (src->fh)  { Close(src->fh); src->fh = 0; }
+}
 
+/* CRC32 + MD5 + SHA-1 of the rest of src in one pass (for .adz the stream's
+ * own CRC is checked at the end too); label gets the root block's volume
+ * name and boot the first BOOT_SIZE bytes if wanted. Returns bytes hashed,
+ * -1 on error (logged). */
+static LONG Img_Hash(struct ImgSrc *src, ULONG *crcOut, UBYTE *md5Out, UBYTE *sha1Out, char *label, UBYTE *boot) {
   UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  if (!buf) { CloseTD(p, io); return FALSE; }
+  if (!buf) { LogAdd("No memory for CRC"); return -1; }
 
-  ULONG doneSectors = 0;
-  BOOL ok = TRUE;
+  ULONG crc = crc32_init();
+  struct Md5 md5; struct Sha1 sha1;
+  md5_init(&md5); sha1_init(&sha1);
+  LONG total = 0, size = src->size;
+  if (label) label[0] = '\0';
+  for (;;) {
+    LONG rd = Img_Read(src, buf, TRACK_SIZE);
+    if (rd == 0) break;
+    if (rd < 0) { LogAdd(Img_Error(src)); FreeVec(buf); return -1; }
+    if (label && total == ROOT_TRACK * TRACK_SIZE && rd == TRACK_SIZE) Root_Label(buf, label);
+    if (boot && total == 0 && rd >= BOOT_SIZE) memcpy(boot, buf, BOOT_SIZE);
+    crc = crc32_update(crc, buf, (ULONG)rd);
+    md5_update(&md5, buf, (ULONG)rd);
+    sha1_update(&sha1, buf, (ULONG)rd);
+    total += rd;
+    DrawProgress(total, size > 0 ? (ULONG)size : DISK_SIZE);
+  }
+  *crcOut = crc32_final(crc);
+  md5_final(&md5, md5Out);
+  sha1_final(&sha1, sha1Out);
+  FreeVec(buf);
+  return total;
+}
 
-  for (ULONG t=0; t<TRACKS; ++t) {
-    io->iotd_Req.io_Command = CMD_READ;
-    io->iotd_Req.io_Data    = (APTR)buf;
-    io->iotd_Req.io_Length  = TRACK_SIZE;
-    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    LONG err = DoIO((struct IORequest*)io);
-    if (err != 0) {
-      ok = FALSE;
-      char m[80]; sprintf(m, "Read error at track %lu (io_Error=%ld)", (unsigned long)t, (long)io->iotd_Req.io_Error);
-      LogAdd(m);
-      break;
+static const char *Img_Error(const struct ImgSrc *src) {
+  if (src->gz) return "ADZ stream corrupt (CRC/data)";
+  if (src->dms) {
+    switch (src->dms->error) {
+      case DMS_ERR_CRC:  return "DMS track CRC/checksum error";
+      case DMS_ERR_MODE: return "DMS mode not supported";
+      case DMS_ERR_IO:   return "File read error";
+      default:           return "DMS data corrupt";
     }
-    doneSectors += SECTORS;
-    DrawProgress(doneSectors, TOTAL_SECTORS);
-    if ((t % 8) == 0 || t == TRACKS-1) { char m[80]; sprintf(m, "Track %lu/%u, sectors %lu/%u", (unsigned long)(t+1), TRACKS, (unsigned long)doneSectors, (unsigned)TOTAL_SECTORS); LogAdd(m); }
   }
+  return "File read error";
+}
 
-  FreeVec(buf);
-  CloseTD(p, io);
-  return ok;
+/* After a full pass: what the DMS held (modes, cylinders it lacked) */
+static void Img_Report(const struct ImgSrc *src) {
+  if (!src->dms) return;
+  char m[120]; int len = sprintf(m, "DMS:");
+  for (int i=0; i<DMS_MODES; ++i)
+    if (src->dms->modeCount[i]) len += sprintf(m + len, " %s x%lu", dms_mode_name[i], (unsigned long)src->dms->modeCount[i]);
+  LogAdd(m);
+  if (src->dms->missing) {
+    sprintf(m, "DMS: %lu cylinder(s) missing, zero-filled", (unsigned long)src->dms->missing);
+    LogAdd(m);
+  }
 }
 
-static BOOL RawCopyTwoDrives(UBYTE srcUnit, UBYTE dstUnit) {
-  struct MsgPort *ps = NULL; struct IOExtTD *is = NULL;
-  struct MsgPort *pd = NULL; struct IOExtTD *id = NULL;
+/* ----- Streaming sources (PIPE: and other handles that cannot seek) -----
+ * A raw stream feeds Write ADF through a ring of STREAM_RING tracks filled
+ * by asynchronous ACTION_READ packets, so reading goes on while the drive
+ * writes and bursts from the producer are soaked up ahead of it. Track t
+ * may be written as soon as its last byte arrives; the length is only known
+ * (and checked) when the stream ends. Compressed streams go through the
+ * decoder with ordinary blocking reads. */
+static struct StreamRing *Stream_Open(struct ImgSrc *src) {
+  struct StreamRing *st = (struct StreamRing*)AllocVec(sizeof(struct StreamRing), MEMF_CLEAR);
+  if (!st) return NULL;
+  st->fh   = src->fh;
+  st->buf  = (UBYTE*)AllocVec(STREAM_RING * TRACK_SIZE, MEMF_ANY);
+  st->port = CreateMsgPort();
+  st->dp   = (struct DosPacket*)AllocDosObject(DOS_STDPKT, NULL);
+  if (!st->buf || !st->port || !st->dp) { Stream_Close(st); return NULL; }
+  /* The bytes Img_Open sniffed are the start of track 0 */
+  while (src->peekPos < src->npeek) st->buf[st->in++] = src->peek[src->peekPos++];
+  return st;
+}
 
-  if (!OpenTD(srcUnit, &ps, &is)) return FALSE;
-  if (!OpenTD(dstUnit, &pd, &id)) { CloseTD(ps, is); return FALSE; }
+static void Stream_Close(struct StreamRing *st) {
+  if (!st) return;
+  if (st->pending) { WaitPort(st->port); GetMsg(st->port); TRACE_ASYNC_END("dos", "ACTION_READ", (ULONG)st->dp); }
+  if (st->dp)   FreeDosObject(DOS_STDPKT, st->dp);
+  if (st->port) DeleteMsgPort(st->port);
+  if (st->buf)  FreeVec(st->buf);
+  FreeVec(st);
+}
 
-  SetFloppyMotor(srcUnit, TRUE);
-  SetFloppyMotor(dstUnit, TRUE);
+static UBYTE *Stream_Track(struct StreamRing *st, ULONG t) {
+  return st->buf + (t % STREAM_RING) * TRACK_SIZE;
+}
 
-  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  if (!buf) { CloseTD(ps, is); CloseTD(pd, id); return FALSE; }
+/* Keeps one read in flight into the free part of the ring; the slot of
+ * track `writing` (and its retries) is never overwritten */
+static void Stream_Pump(struct StreamRing *st, ULONG writing) {
+  if (st->pending || st->eof || st->err) return;
+  ULONG limit = (writing + STREAM_RING) * TRACK_SIZE;
+  if (limit > DISK_SIZE) limit = DISK_SIZE;
+  if (st->in >= limit) return;
+  ULONG len = TRACK_SIZE - st->in % TRACK_SIZE;
+  if (len > limit - st->in) len = limit - st->in;
+  struct FileHandle *fh = (struct FileHandle*)BADDR(st->fh);
+  st->dp->dp_Type = ACTION_READ;
+  st->dp->dp_Arg1 = fh->fh_Arg1;
+  st->dp->dp_Arg2 = (LONG)(st->buf + st->in % (STREAM_RING * TRACK_SIZE));
+  st->dp->dp_Arg3 = (LONG)len;
+  TRACE_ASYNC_BEGIN("dos", "ACTION_READ", (ULONG)st->dp);
+  SendPkt(st->dp, fh->fh_Type, st->port);
+  st->pending = TRUE;
+}
 
-  ULONG done = 0;
-  BOOL ok = TRUE;
+/* Returns once the stream holds `need` bytes (or ended) and the drive
+ * request is done; reads ahead while either is still outstanding */
+static void Stream_Wait(struct StreamRing *st, ULONG need, ULONG writing, struct IORequest *drive) {
+  ULONG portSig = 1UL << st->port->mp_SigBit;
+  ULONG driveSig = drive ? 1UL << drive->io_Message.mn_ReplyPort->mp_SigBit : 0;
+  for (;;) {
+    Stream_Pump(st, writing);
+    BOOL have = (st->in >= need || st->eof || st->err);
+    BOOL idle = (!drive || CheckIO(drive) != NULL);
+    if (have && idle) return;
+    ULONG sigs = (idle ? 0 : driveSig) | (st->pending ? portSig : 0);
+    if (!sigs) return;
+    Wait(sigs);
+    if (st->pending && GetMsg(st->port)) {
+      TRACE_ASYNC_END("dos", "ACTION_READ", (ULONG)st->dp);
+      st->pending = FALSE;
+      if (st->dp->dp_Res1 < 0)       st->err = TRUE;
+      else if (st->dp->dp_Res1 == 0) st->eof = TRUE;
+      else                           st->in += (ULONG)st->dp->dp_Res1;
+    }
+  }
+}
 
-  for (ULONG t=0; t<TRACKS; ++t) {
-    is->iotd_Req.io_Command = CMD_READ;
-    is->iotd_Req.io_Data    = (APTR)buf;
-    is->iotd_Req.io_Length  = TRACK_SIZE;
-    is->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)is) != 0) { ok = FALSE; LogAdd("Read error"); break; }
+/* After the last track: the stream must end exactly there */
+static BOOL Stream_End(struct StreamRing *st, ULONG writing, struct IORequest *drive) {
+  Stream_Wait(st, DISK_SIZE, writing, drive);
+  if (st->err || st->in < DISK_SIZE) return FALSE;
+  UBYTE extra;
+  LONG n = st->eof ? 0 : Trace_Read(st->fh, &extra, 1);
+  if (n < 0) st->err = TRUE;
+  else if (n > 0) st->more = TRUE;
+  else st->eof = TRUE;
+  return n == 0;
+}
 
-    id->iotd_Req.io_Command = CMD_WRITE;
-    id->iotd_Req.io_Data    = (APTR)buf;
-    id->iotd_Req.io_Length  = TRACK_SIZE;
-    id->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)id) != 0) { ok = FALSE; LogAdd("Write error"); break; }
+static const char *Stream_Error(const struct StreamRing *st) {
+  static char m[64];
+  if (st->err)  return "Stream read error";
+  if (st->more) return "Stream longer than 901,120 bytes";
+  sprintf(m, "Stream ended at %lu bytes (need 901,120)", (unsigned long)st->in);
+  return m;
+}
 
-    done += TRACK_SIZE;
-    DrawProgress(done, DISK_SIZE);
-    if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
-  }
+/* ----- Resident image cache ----- */
 
-  FreeVec(buf);
-  CloseTD(ps, is);
-  CloseTD(pd, id);
-  return ok;
+static void Cache_Log(void) {
+  ULONG used = 0;
+  for (struct Node *nd = gCache.lru.lh_Head; nd->ln_Succ; nd = nd->ln_Succ) used += ((struct CacheEnt*)nd)->img.used;
+  char m[128];
+  sprintf(m, "Image cache: %lu hit(s), %lu miss(es), %lu KB in %lu image(s), %lu KB saved by packing",
+          (unsigned long)gCache.hits, (unsigned long)gCache.misses, (unsigned long)(used / 1024),
+          (unsigned long)gCache.count, (unsigned long)((gCache.count * DISK_SIZE - used) / 1024));
+  LogAdd(m);
 }
 
-static BOOL RawCopyOneDrive(UBYTE unit) {
-  BOOL ok = FALSE;
-  struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
-  if (!OpenTD(unit, &p, &io)) return FALSE;
-
-  SetFloppyMotor(unit, TRUE);
+static void Cache_Drop(struct CacheEnt *ce) {
+  Remove(&ce->node);
+  gCache.count--;
+  Pack_Free(&ce->img);
+  FreeVec(ce);
+}
 
-  UBYTE *image = (UBYTE*)AllocVec(DISK_SIZE, MEMF_CLEAR);
-  if (!image) { CloseTD(p, io); return FALSE; }
+static void Cache_DropOldest(void) {
+  struct CacheEnt *old = (struct CacheEnt*)gCache.lru.lh_TailPred;
+  char m[300]; sprintf(m, "Image cache: dropped %s", old->path);
+  LogAdd(m);
+  Cache_Drop(old);
+}
 
-  ULONG done = 0;
-  DrawStatus("Reading source to RAM (swap later)...");
-  ClearProgress();
-  for (ULONG t=0; t<TRACKS; ++t) {
-    io->iotd_Req.io_Command = CMD_READ;
-    io->iotd_Req.io_Data    = (APTR)(image + t*TRACK_SIZE);
-    io->iotd_Req.io_Length  = TRACK_SIZE;
-    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)io) != 0) { LogAdd("Read error"); goto cleanup; }
-    done += TRACK_SIZE; DrawProgress(done, DISK_SIZE);
-    if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
+/* Room for one more packed track: least recently used images go until
+   CACHE_RESERVE bytes would still be free afterwards */
+static BOOL Cache_Room(void) {
+  while (AvailMem(MEMF_ANY) < CACHE_RESERVE + TRACK_SIZE) {
+    if (!gCache.count) return FALSE;
+    Cache_DropOldest();
   }
+  return TRUE;
+}
 
-  ClearProgress();
-  done = 0;
+/* An empty entry, filled track by track; NULL if even an empty cache
+   leaves no room */
+static struct CacheEnt *Cache_New(void) {
+  while (gCache.count >= CACHE_MAX) Cache_DropOldest();
+  if (!Cache_Room()) return NULL;
+  struct CacheEnt *ce = (struct CacheEnt*)AllocVec(sizeof(struct CacheEnt), MEMF_CLEAR);
+  if (ce) ce->stage = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_ANY);
+  if (ce && !ce->stage) { FreeVec(ce); ce = NULL; }
+  return ce;
+}
 
-  struct EasyStruct es = { sizeof(struct EasyStruct), 0, (UBYTE*)APP_NAME,
-                           (UBYTE*)"Insert DESTINATION disk and click Continue",
-                           (UBYTE*)"Continue|Cancel" };
-  LONG sel = EasyRequestArgs(ui.win, &es, NULL, NULL);
-  PumpRefresh();
-  if (sel != 1) goto cleanup;
+/* Img_Open through the cache. A hit costs a Lock and an Examine, no reads;
+   on a miss the file is opened as usual and, memory permitting, an entry is
+   filled as Img_Read goes, to be kept by Cache_Keep after a clean pass. */
+static BOOL Cache_Open(struct ImgSrc *src, CONST_STRPTR path) {
+  char full[256];
+  struct DateStamp date;
+  LONG size = -1;
+  BPTR lock = Lock((STRPTR)path, ACCESS_READ);
+  struct FileInfoBlock *fib = (struct FileInfoBlock*)AllocVec(sizeof(struct FileInfoBlock), MEMF_CLEAR);
+  if (lock && fib && Examine(lock, fib) && NameFromLock(lock, (STRPTR)full, sizeof(full))) {
+    size = fib->fib_Size;
+    date = fib->fib_Date;
+  }
+  if (fib) FreeVec(fib);
+  if (lock) UnLock(lock);
+  if (size < 0) return Img_Open(src, path);       /* let Img_Open report it */
+
+  for (struct Node *nd = gCache.lru.lh_Head; nd->ln_Succ; nd = nd->ln_Succ) {
+    struct CacheEnt *ce = (struct CacheEnt*)nd;
+    if (ce->packed != size || ce->date.ds_Days != date.ds_Days || ce->date.ds_Minute != date.ds_Minute ||
+        ce->date.ds_Tick != date.ds_Tick || strcmp(ce->path, full) != 0) continue;
+    UBYTE *tb = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_ANY);
+    if (!tb) break;                                 /* read the file instead */
+    Remove(nd);
+    AddHead(&gCache.lru, nd);
+    gCache.hits++;
+    memset(src, 0, sizeof(*src));
+    src->mem      = &ce->img;
+    src->memBuf   = tb;
+    src->memTrack = -1;
+    src->size     = DISK_SIZE;
+    src->packed   = ce->packed;
+    LogAdd("Image cache hit, writing from RAM");
+    return TRUE;
+  }
 
-  DrawStatus("Writing RAM image to destination...");
-  for (ULONG t=0; t<TRACKS; ++t) {
-    io->iotd_Req.io_Command = CMD_WRITE;
-    io->iotd_Req.io_Data    = (APTR)(image + t*TRACK_SIZE);
-    io->iotd_Req.io_Length  = TRACK_SIZE;
-    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)io) != 0) { LogAdd("Write error"); goto cleanup; }
-    done += TRACK_SIZE; DrawProgress(done, DISK_SIZE);
-    if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
+  gCache.misses++;
+  if (!Img_Open(src, path)) return FALSE;
+  if (src->size == (LONG)DISK_SIZE && (src->fill = Cache_New()) != NULL) {
+    strcpy(src->fill->path, full);
+    src->fill->node.ln_Name = src->fill->path;
+    src->fill->packed = size;
+    src->fill->date   = date;
   }
+  return TRUE;
+}
 
-  ok = TRUE;
+/* Packs each track of the entry being filled as Img_Read completes it;
+   gives the entry up when memory runs out */
+static void Cache_Fill(struct ImgSrc *src, const UBYTE *buf, LONG n) {
+  struct CacheEnt *ce = src->fill;
+  LONG at = src->pos;
+  while (n > 0 && at < (LONG)DISK_SIZE) {
+    LONG o = at % TRACK_SIZE, k = TRACK_SIZE - o;
+    if (k > n) k = n;
+    memcpy(ce->stage + o, buf, k);
+    buf += k; n -= k; at += k;
+    if (o + k < TRACK_SIZE) break;
+    if (!Cache_Room() || !Pack_Put(&ce->img, at / TRACK_SIZE - 1, ce->stage, ce->stage + TRACK_SIZE)) {
+      LogAdd("Image cache: out of memory, image not kept");
+      Cache_Discard(src);
+      return;
+    }
+  }
+}
 
-cleanup:
-  FreeVec(image);
-  CloseTD(p, io);
-  return ok;
+static void Cache_Discard(struct ImgSrc *src) {
+  Pack_Free(&src->fill->img);
+  FreeVec(src->fill->stage);
+  FreeVec(src->fill);
+  src->fill = NULL;
 }
 
-/* ====== ADF I/O ====== */
+/* After a pass that read (and for .adz/.dms checked) the whole image */
+static void Cache_Keep(struct ImgSrc *src) {
+  struct CacheEnt *ce = src->fill;
+  if (!ce || src->pos < (LONG)DISK_SIZE) return;
+  src->fill = NULL;
+  FreeVec(ce->stage);
+  ce->stage = NULL;
+  AddHead(&gCache.lru, &ce->node);
+  gCache.count++;
+  Pack_Log(&ce->img, "Image cache");
+}
+
+static void Cache_Free(void) {
+  while (gCache.count) Cache_Drop((struct CacheEnt*)gCache.lru.lh_Head);
+}
+
+/* Re-encodes an .adz with the failed tracks recovered as the stream
+ * reaches them, so only one extra track is held however many failed:
+ * old stream -> <path>.tmp -> renamed over the original. buf holds two
+ * tracks. */
+static BOOL ADZ_Patch(CONST_STRPTR path, struct RecoverCtx *rc, struct IOExtTD *io,
+                      struct BadMap *bm, struct GzOut *gz, UBYTE *buf) {
+  char tmp[320];
+  sprintf(tmp, "%s.tmp", (const char*)path);
+
+  struct ImgSrc src;
+  if (!Img_Open(&src, path)) return FALSE;
+  BPTR out = Open((STRPTR)tmp, MODE_NEWFILE);
+  if (!out) { Img_Close(&src); LogAdd("Cannot create ADZ temp file"); return FALSE; }
+
+  BOOL ok = (gzout_open(gz, Gz_DosWrite, (void*)out, ADZ_LEVEL) == GZ_OK);
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    if (Img_Read(&src, buf, TRACK_SIZE) != TRACK_SIZE) { ok = FALSE; break; }
+    const UBYTE *trk = buf;
+    if (bm->failed[t]) {
+      trk = buf + TRACK_SIZE;
+      Recover_Track(rc, io, t, buf + TRACK_SIZE, bm);
+    }
+    if (gzout_write(gz, trk, TRACK_SIZE) != GZ_OK) ok = FALSE;
+    else Capture_Hash(t, trk);
+    DrawProgress(t+1, TRACKS);
+  }
+  ok = ok && Img_End(&src) && gzout_close(gz) == GZ_OK;
+  Img_Close(&src);
+  Close(out);
+
+  if (ok) {
+    DeleteFile((STRPTR)path);
+    ok = Rename((STRPTR)tmp, (STRPTR)path);
+  }
+  if (!ok) { DeleteFile((STRPTR)tmp); LogAdd("ADZ re-encode failed (zeros kept)"); }
+  return ok;
+}
 
-static BOOL ADF_ReadFromDrive(UBYTE unit, CONST_STRPTR path) {
+/* Capture to .adz: the CMD_READ of track t+1 runs (SendIO) while track t
+ * is deflated. No journal: failed tracks go in as zeros and, if the
+ * recovery pass runs, the stream is re-encoded once with the results. */
+static BOOL ADZ_ReadFromDrive(UBYTE unit, CONST_STRPTR path) {
   struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
   if (!OpenTD(unit, &p, &io)) { LogAdd("Open trackdisk failed"); return FALSE; }
 
   SetFloppyMotor(unit, TRUE);
 
   BPTR fh = Open((STRPTR)path, MODE_NEWFILE);
-  if (!fh) { CloseTD(p, io); LogAdd("Cannot create ADF file"); return FALSE; }
+  if (!fh) { CloseTD(p, io); LogAdd("Cannot create ADZ file"); return FALSE; }
 
-  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  if (!buf) { Close(fh); CloseTD(p, io); LogAdd("No memory"); return FALSE; }
+  UBYTE *buf = (UBYTE*)AllocVec(2 * TRACK_SIZE, MEMF_CLEAR);
+  struct GzOut *gz = (struct GzOut*)AllocVec(sizeof(struct GzOut), MEMF_ANY);
+  if (!buf || !gz) {
+    if (buf) FreeVec(buf);
+    if (gz) FreeVec(gz);
+    Close(fh); CloseTD(p, io); LogAdd("No memory");
+    return FALSE;
+  }
 
-  ULONG done = 0;
-  BOOL ok = TRUE;
+  BOOL ok = (gzout_open(gz, Gz_DosWrite, (void*)fh, ADZ_LEVEL) == GZ_OK);
+  BadMap_Init(&gBad);
 
-  for (ULONG t=0; t<TRACKS; ++t) {
-    io->iotd_Req.io_Command = CMD_READ;
-    io->iotd_Req.io_Data    = (APTR)buf;
-    io->iotd_Req.io_Length  = TRACK_SIZE;
-    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)io) != 0) { ok = FALSE; LogAdd("Read error"); break; }
-    LONG wr = Write(fh, buf, TRACK_SIZE);
-    if (wr != TRACK_SIZE) { ok = FALSE; LogAdd("File write error"); break; }
-    done += TRACK_SIZE; DrawProgress(done, DISK_SIZE);
+  io->iotd_Req.io_Command = CMD_READ;
+  io->iotd_Req.io_Data    = (APTR)buf;
+  io->iotd_Req.io_Length  = TRACK_SIZE;
+  io->iotd_Req.io_Offset  = 0;
+  Trace_SendIO((struct IORequest*)io);
+  BOOL pending = TRUE;
+
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    UBYTE *cur = buf + (t & 1) * TRACK_SIZE;
+    BOOL got = (Trace_WaitIO((struct IORequest*)io) == 0);
+    pending = FALSE;
+
+    if (t+1 < TRACKS) {
+      io->iotd_Req.io_Command = CMD_READ;
+      io->iotd_Req.io_Data    = (APTR)(buf + ((t+1) & 1) * TRACK_SIZE);
+      io->iotd_Req.io_Length  = TRACK_SIZE;
+      io->iotd_Req.io_Offset  = (t+1) * TRACK_SIZE;
+      Trace_SendIO((struct IORequest*)io);
+      pending = TRUE;
+    }
+
+    if (!got) {
+      char m[64]; sprintf(m, "Read error at track %lu, deferred", (unsigned long)t); LogAdd(m);
+      BadMap_FailTrack(&gBad, t);
+      memset(cur, 0, TRACK_SIZE);
+    } else if (t == 0) Boot_Report(cur);
+    if (gzout_write(gz, cur, TRACK_SIZE) != GZ_OK) { ok = FALSE; LogAdd("File write error"); break; }
+    if (got) Capture_Hash(t, cur);
+    DrawProgress((t+1) * TRACK_SIZE, DISK_SIZE);
     if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
   }
+  if (pending) { AbortIO((struct IORequest*)io); Trace_WaitIO((struct IORequest*)io); }
 
-  FreeVec(buf);
+  if (ok && gzout_close(gz) != GZ_OK) { ok = FALSE; LogAdd("File write error"); }
+  ULONG imageCrc = crc32_final(gz->crc);
+  ULONG packed = gz->outTotal;
   Close(fh);
-  CloseTD(p, io);
 
-  if (ok) {
-    BPTR fh2 = Open((STRPTR)path, MODE_OLDFILE);
-    if (fh2) {
-      struct FileInfoBlock *fib = (struct FileInfoBlock*)AllocVec(sizeof(struct FileInfoBlock), MEMF_CLEAR);
-      if (fib && ExamineFH(fh2, fib)) {
-        char m[100]; sprintf(m, "Saved ADF size: %ld bytes", (long)fib->fib_Size);
-        LogAdd(m);
-      }
-      if (fib) FreeVec(fib);
-      Close(fh2);
+  struct RecoverCtx rc;
+  if (ok && Recover_Start(&rc, &gBad)) {
+    DrawStatus("Recovering failed tracks, re-encoding ADZ...");
+    if (ADZ_Patch(path, &rc, io, &gBad, gz, buf)) {
+      imageCrc = crc32_final(gz->crc);
+      packed   = gz->outTotal;
+    } else {
+      /* The file kept its zeros, whatever the pass recovered */
+      for (ULONG t=0; t<TRACKS; ++t)
+        if (gBad.failed[t]) memset(&gBad.state[t * SECTORS], SEC_DEAD, SECTORS);
+      gBad.nBad = gBad.nFailed * SECTORS;
     }
+    Recover_Close(&rc);
   }
 
+  FreeVec(gz);
+  FreeVec(buf);
+  CloseTD(p, io);
+
+  if (ok && gBad.nFailed) {
+    char m[80];
+    if (BadMap_Save(&gBad, path)) sprintf(m, "Bad sectors: %lu (map in .bad)", (unsigned long)gBad.nBad);
+    else                          sprintf(m, "Bad sectors: %lu (map not saved)", (unsigned long)gBad.nBad);
+    LogAdd(m);
+  }
+  if (ok) {
+    char m[100];
+    sprintf(m, "Image CRC32: %08lx", (unsigned long)imageCrc); LogAdd(m);
+    sprintf(m, "Saved ADZ size: %lu bytes (%lu%% of ADF)", (unsigned long)packed,
+            (unsigned long)(packed / (DISK_SIZE / 100)));
+    LogAdd(m);
+  }
   return ok;
 }
 
-static BOOL ADF_WriteToDrive(UBYTE unit, CONST_STRPTR path) {
+/* Verify mode: CMD_UPDATE, CMD_CLEAR and a CMD_READ into rb are queued on
+ * the unit right behind the CMD_WRITE (or TD_FORMAT), so the drive writes
+ * and reads the track back in one go while the next track is read and
+ * checksummed. */
+static void Write_Send(struct IOExtTD *io, struct IOExtTD **vio, UWORD cmd0, UBYTE *data, UBYTE *rb, ULONG t) {
+  io->iotd_Req.io_Command = cmd0;
+  io->iotd_Req.io_Data    = (APTR)data;
+  io->iotd_Req.io_Length  = TRACK_SIZE;
+  io->iotd_Req.io_Offset  = t * TRACK_SIZE;
+  Trace_SendIO((struct IORequest*)io);
+  if (!vio) return;
+  static const UWORD cmd[3] = { CMD_UPDATE, CMD_CLEAR, CMD_READ };
+  for (int i=0; i<3; ++i) {
+    vio[i]->iotd_Req.io_Command = cmd[i];
+    vio[i]->iotd_Req.io_Data    = (APTR)rb;
+    vio[i]->iotd_Req.io_Length  = TRACK_SIZE;
+    vio[i]->iotd_Req.io_Offset  = t * TRACK_SIZE;
+    Trace_SendIO((struct IORequest*)vio[i]);
+  }
+}
+
+/* TRUE if the write (and in verify mode the read-back) succeeded and the
+ * track read back has the source's CRC */
+static BOOL Write_Wait(struct IOExtTD *io, struct IOExtTD **vio, const UBYTE *rb, ULONG crc) {
+  BOOL ok = (Trace_WaitIO((struct IORequest*)io) == 0);
+  if (!vio) return ok;
+  for (int i=0; i<3; ++i) if (Trace_WaitIO((struct IORequest*)vio[i]) != 0 && i != 1) ok = FALSE;
+  return ok && TrackCrc(rb) == crc;
+}
+
+/* Track t goes to the drive (SendIO) while track t+1 is read or inflated
+ * into the other buffer, so an .adz writes as fast as a raw .adf. With
+ * verify, each track is read back and its CRC compared with the source
+ * track's (computed meanwhile); a mismatch is rewritten up to the drive
+ * profile's retry count.
+ * WRITE_FORMAT sends TD_FORMAT with the image data instead of CMD_WRITE:
+ * trackdisk then lays down the whole track, gaps, headers and data, in one
+ * revolution without first trying to read what is on it, so a blank or
+ * badly formatted disk is formatted and written in a single pass. A track
+ * the drive rejects goes again with CMD_WRITE; after FMT_GIVEUP rejections
+ * in a row the rest of the pass uses CMD_WRITE. */
+#define FMT_GIVEUP 3
+static BOOL ADF_WriteToDrive(UBYTE unit, CONST_STRPTR path, UBYTE mode) {
+  BOOL verify = (mode & WRITE_VERIFY) != 0;
   struct MsgPort *p = NULL; struct IOExtTD *io = NULL;
   if (!OpenTD(unit, &p, &io)) { LogAdd("Open trackdisk failed"); return FALSE; }
 
   SetFloppyMotor(unit, TRUE);
 
-  BPTR fh = Open((STRPTR)path, MODE_OLDFILE);
-  if (!fh) { CloseTD(p, io); LogAdd("Cannot open ADF"); return FALSE; }
-
-  LONG size = -1;
-  struct FileInfoBlock *fib = (struct FileInfoBlock*)AllocVec(sizeof(struct FileInfoBlock), MEMF_CLEAR);
-  if (fib && ExamineFH(fh, fib)) {
-    size = fib->fib_Size;
-  } else {
-    LONG end = Seek(fh, 0, OFFSET_END);
-    if (end >= 0) size = end;
-    Seek(fh, 0, OFFSET_BEGINNING);
-  }
-  if (fib) FreeVec(fib);
+  struct ImgSrc src;
+  if (!Cache_Open(&src, path)) { CloseTD(p, io); return FALSE; }
 
-  char smsg[96]; sprintf(smsg, "Detected ADF size: %ld bytes", (long)size); LogAdd(smsg);
+  char smsg[96];
+  if (src.mem)         sprintf(smsg, "Cached image: %ld bytes", (long)src.size);
+  else if (src.stream) sprintf(smsg, "Streaming %s source, length checked at the end", src.gz ? "ADZ" : src.dms ? "DMS" : "ADF");
+  else if (src.gz)  sprintf(smsg, "Detected ADZ: %ld -> %ld bytes", (long)src.packed, (long)src.size);
+  else if (src.dms) sprintf(smsg, "Detected DMS: %ld bytes", (long)src.packed);
+  else              sprintf(smsg, "Detected ADF size: %ld bytes", (long)src.size);
+  LogAdd(smsg);
 
-  if (size != (LONG)DISK_SIZE) {
-    Close(fh); CloseTD(p, io);
+  if (src.size != (LONG)DISK_SIZE && !(src.stream && src.size < 0)) {
+    Img_Close(&src); CloseTD(p, io);
     LogAdd("Invalid ADF size (need 901,120 bytes)");
     return FALSE;
   }
-  Seek(fh, 0, OFFSET_BEGINNING);
-
-  UBYTE *buf = (UBYTE*)AllocVec(TRACK_SIZE, MEMF_CLEAR);
-  if (!buf) { Close(fh); CloseTD(p, io); LogAdd("No memory"); return FALSE; }
 
-  ULONG done = 0;
-  BOOL ok = TRUE;
+  /* Two source tracks, the read-back track, and the requests queued behind each write */
+  UBYTE *buf = (UBYTE*)AllocVec(3 * TRACK_SIZE, MEMF_CLEAR);
+  UBYTE *rb = buf ? buf + 2 * TRACK_SIZE : NULL;
+  struct IOExtTD *vreq[3] = { NULL, NULL, NULL };
+  struct IOExtTD **vio = verify ? vreq : NULL;
+  BOOL ok = (buf != NULL);
+  for (int i=0; i<3 && verify && ok; ++i) {
+    vreq[i] = (struct IOExtTD*)CreateIORequest(p, sizeof(struct IOExtTD));
+    if (vreq[i]) *vreq[i] = *io;               /* same unit, same reply port */
+    else ok = FALSE;
+  }
+  if (!ok) LogAdd("No memory");
+  /* Raw stream: tracks come from the ring (without one, blocking reads) */
+  struct StreamRing *st = (ok && src.stream && !src.gz && !src.dms) ? Stream_Open(&src) : NULL;
+
+  ULONG done = 0, crc[2] = { 0, 0 }, rewrites = 0, fallbacks = 0, rejects = 0;
+  UWORD cmd = CMD_WRITE;
+  if (mode & WRITE_FORMAT) {
+    if (gProf[unit].format == PROF_FMT_NO) LogAdd("Drive profile: no TD_FORMAT, writing with CMD_WRITE");
+    else cmd = TD_FORMAT;
+  }
+  if (ok) {
+    UBYTE *first = st ? Stream_Track(st, 0) : buf;
+    if (st) {
+      Stream_Wait(st, TRACK_SIZE, 0, NULL);
+      ok = (st->in >= TRACK_SIZE);
+    } else ok = (Img_Read(&src, first, TRACK_SIZE) == TRACK_SIZE);
+    if (!ok) LogAdd(st ? Stream_Error(st) : Img_Error(&src));
+    else {
+      Boot_Report(first);
+      if (!Boot_Confirm()) { ok = FALSE; LogAdd("Write canceled: virus in bootblock"); }
+      else if (verify) crc[0] = TrackCrc(first);
+    }
+  }
 
-  for (ULONG t=0; t<TRACKS; ++t) {
-    LONG rd = Read(fh, buf, TRACK_SIZE);
-    if (rd != TRACK_SIZE) { ok = FALSE; LogAdd("File read error"); break; }
-    io->iotd_Req.io_Command = CMD_WRITE;
-    io->iotd_Req.io_Data    = (APTR)buf;
-    io->iotd_Req.io_Length  = TRACK_SIZE;
-    io->iotd_Req.io_Offset  = t * TRACK_SIZE;
-    if (DoIO((struct IORequest*)io) != 0) { ok = FALSE; LogAdd("Write error"); break; }
+  for (ULONG t=0; t<TRACKS && ok; ++t) {
+    UBYTE *cur = st ? Stream_Track(st, t)   : buf + (t & 1) * TRACK_SIZE;
+    UBYTE *nxt = st ? Stream_Track(st, t+1) : buf + ((t+1) & 1) * TRACK_SIZE;
+    Write_Send(io, vio, cmd, cur, rb, t);
+
+    /* Meanwhile: next track, or after the last one the .adz trailer (or
+     * end of stream) check. The ring reads on until the drive is done. */
+    BOOL next;
+    if (st) {
+      struct IORequest *last = (struct IORequest*)(vio ? vio[2] : io);
+      if (t+1 < TRACKS) {
+        Stream_Wait(st, (t+2) * TRACK_SIZE, t, last);
+        next = (st->in >= (t+2) * TRACK_SIZE);
+      } else next = Stream_End(st, t, last);
+    } else next = (t+1 < TRACKS) ? (Img_Read(&src, nxt, TRACK_SIZE) == TRACK_SIZE) : Img_End(&src);
+    if (verify && next && t+1 < TRACKS) crc[(t+1) & 1] = TrackCrc(nxt);
+
+    BOOL good = Write_Wait(io, vio, rb, crc[t & 1]);
+    if (cmd == TD_FORMAT) {
+      if (io->iotd_Req.io_Error != 0) {
+        char m[64]; sprintf(m, "Track %lu: TD_FORMAT rejected, CMD_WRITE", (unsigned long)t); LogAdd(m);
+        fallbacks++;
+        Write_Send(io, vio, CMD_WRITE, cur, rb, t);
+        good = Write_Wait(io, vio, rb, crc[t & 1]);
+        if (++rejects == FMT_GIVEUP) { cmd = CMD_WRITE; LogAdd("TD_FORMAT refused, CMD_WRITE for the rest"); }
+      } else rejects = 0;
+    }
+    for (int retry = gProf[unit].retry; verify && !good && retry > 0; --retry) {
+      char m[64]; sprintf(m, "Track %lu: verify failed, rewriting", (unsigned long)t); LogAdd(m);
+      rewrites++;
+      Write_Send(io, vio, cmd, cur, rb, t);
+      good = Write_Wait(io, vio, rb, crc[t & 1]);
+    }
+    if (!good) {
+      char m[64];
+      if (verify) sprintf(m, "Track %lu: verify failed after rewrites", (unsigned long)t);
+      else        strcpy(m, "Write error");
+      ok = FALSE; LogAdd(m); break;
+    }
+    if (!next) { ok = FALSE; LogAdd(st ? Stream_Error(st) : Img_Error(&src)); break; }
     done += TRACK_SIZE; DrawProgress(done, DISK_SIZE);
     if ((t % 8) == 0 || t == TRACKS-1) { char m[64]; sprintf(m, "Track %lu/%u", (unsigned long)(t+1), TRACKS); LogAdd(m); }
   }
+  if (ok) { Img_Report(&src); Cache_Keep(&src); }
+  if (ok && verify) {
+    char m[64]; sprintf(m, "All tracks verified, %lu rewrite(s)", (unsigned long)rewrites);
+    LogAdd(m);
+  }
+  if (ok && fallbacks) {
+    char m[64]; sprintf(m, "%lu track(s) written with CMD_WRITE", (unsigned long)fallbacks);
+    LogAdd(m);
+  }
+  Cache_Log();
 
-  FreeVec(buf);
-  Close(fh);
+  for (int i=0; i<3; ++i) if (vreq[i]) DeleteIORequest((struct IORequest*)vreq[i]);
+  if (buf) FreeVec(buf);
+  Stream_Close(st);
+  Img_Close(&src);
   CloseTD(p, io);
   return ok;
 }
@@ -1204,7 +5340,14 @@ static void CloseUI(void) {
 }
 
 static void CloseAll(void) {
+  Trace_Stop();
+  Motor_Tick(TRUE);
+  Motor_Close();
   CloseUI();
+  Queue_Free();
+  Session_Free();
+  Cache_Free();
+  Boot_Free();
   if (GadToolsBase) CloseLibrary(GadToolsBase);
   if (AslBase)      CloseLibrary(AslBase);
   if (GfxBase)      CloseLibrary((struct Library*)GfxBase);
@@ -1212,43 +5355,119 @@ static void CloseAll(void) {
   if (DOSBase)      CloseLibrary((struct Library*)DOSBase);
 }
 
-/* ----- Helpers ----- */
+/* ====== Trace ======
+ * With ENV:FloppyTool/Trace holding a file name, trackdisk requests, DOS
+ * Read/Write, requesters, window redraws and button actions are recorded
+ * with their E-clock time in a fixed ring (fttrace.c). On exit the last
+ * TRACE_EVENTS of them go to that file as Chrome trace JSON, for
+ * chrome://tracing or ui.perfetto.dev. Untraced, each wrapper costs one test.
+ */
+#define TRACE_VAR "FloppyTool/Trace"
+static char gTracePath[256];
 
-static BOOL HasFile(CONST_STRPTR path) {
-  BPTR lock = Lock((STRPTR)path, ACCESS_READ);
-  if (lock) { UnLock(lock); return TRUE; }
-  return FALSE;
+static ULONG Trace_Clock(void) {
+  struct EClockVal ev;
+  ReadEClock(&ev);
+  return ev.ev_lo;
 }
 
-/* Generate RAM:DF<unit>_<n>.adf with n from 0..999 ensuring file doesn't exist */
-static BOOL GenUniqueAdfPath(UBYTE unit, char *out, int maxlen) {
-  if (!out || maxlen < 10) return FALSE;
-  for (int i=0; i<1000; ++i) {
-    char name[64];
-    sprintf(name, "RAM:DF%u_%03d.adf", (unsigned)unit, i);
-    BPTR lock = Lock(name, ACCESS_READ);
-    if (lock) { UnLock(lock); continue; }
-    strncpy(out, name, maxlen-1);
-    out[maxlen-1] = '\0';
-    return TRUE;
-  }
-  return FALSE;
+static const char *const tdCmdName[] = {
+  "CMD_INVALID", "CMD_RESET", "CMD_READ", "CMD_WRITE", "CMD_UPDATE", "CMD_CLEAR",
+  "CMD_STOP", "CMD_START", "CMD_FLUSH", "TD_MOTOR", "TD_SEEK", "TD_FORMAT",
+  "TD_REMOVE", "TD_CHANGENUM", "TD_CHANGESTATE", "TD_PROTSTATUS", "TD_RAWREAD",
+  "TD_RAWWRITE", "TD_GETDRIVETYPE", "TD_GETNUMTRACKS", "TD_ADDCHANGEINT",
+  "TD_REMCHANGEINT", "TD_GETGEOMETRY", "TD_EJECT"
+};
+
+static const char *Trace_CmdName(UWORD cmd) {
+  cmd &= ~TDF_EXTCOM;                          /* ETD_ variants share the name */
+  return (cmd < sizeof(tdCmdName)/sizeof(tdCmdName[0])) ? tdCmdName[cmd] : "TD_?";
 }
 
-/* ----- CRC32 (poly 0xEDB88320) ----- */
+static void Trace_Start(void) {
+  if (GetVar((STRPTR)TRACE_VAR, (STRPTR)gTracePath, sizeof(gTracePath), 0) <= 0 || !gTracePath[0]) return;
+  struct TraceRing *r = (struct TraceRing*)AllocVec(sizeof(struct TraceRing), MEMF_ANY);
+  struct timerequest *tr = r ? Bench_TimerOpen() : NULL;
+  if (!tr) { if (r) FreeVec(r); LogAdd("Trace: not enough memory or no timer"); return; }
+  gTraceTimer = tr;
+  trace_init(r, Trace_Clock, gEFreq);
+  gTrace = r;
+  char m[300]; snprintf(m, sizeof(m), "Tracing to %s", gTracePath);
+  LogAdd(m);
+}
 
-static ULONG crc32_init(void) { return 0xFFFFFFFFUL; }
+static LONG Trace_DosWrite(void *h, const UBYTE *buf, LONG len) { return Write((BPTR)h, (APTR)buf, len); }
+
+static void Trace_Stop(void) {
+  struct TraceRing *r = gTrace;
+  if (!r) return;
+  gTrace = NULL;                               /* the dump itself is not traced */
+  BPTR fh = Open((STRPTR)gTracePath, MODE_NEWFILE);
+  if (fh) {
+    if (trace_json(r, Trace_DosWrite, (void*)fh) != 0) LogAdd("Trace: write error");
+    Close(fh);
+  } else LogAdd("Trace: cannot open output file");
+  struct timerequest *tr = gTraceTimer;
+  gTraceTimer = NULL;
+  Bench_TimerClose(tr);
+  FreeVec(r);
+}
 
-static ULONG crc32_update(ULONG crc, const UBYTE *buf, ULONG len) {
-  ULONG c = crc;
-  while (len--) {
-    c ^= (ULONG)(*buf++);
-    for (int k=0; k<8; ++k) {
-      if (c & 1) c = (c >> 1) ^ 0xEDB88320UL;
-      else       c = (c >> 1);
-    }
-  }
-  return c;
+static BYTE Trace_DoIO(struct IORequest *r) {
+  if (!gTrace) return DoIO(r);
+  const char *n = Trace_CmdName(r->io_Command);
+  trace_add(gTrace, 'B', "td", n, 0);
+  BYTE err = DoIO(r);
+  trace_add(gTrace, 'E', "td", n, 0);
+  return err;
+}
+
+/* Queued requests overlap the caller: async events keyed by the request */
+static void Trace_SendIO(struct IORequest *r) {
+  TRACE_ASYNC_BEGIN("td", Trace_CmdName(r->io_Command), (ULONG)r);
+  SendIO(r);
+}
+
+static BYTE Trace_WaitIO(struct IORequest *r) {
+  BYTE err = WaitIO(r);
+  TRACE_ASYNC_END("td", Trace_CmdName(r->io_Command), (ULONG)r);
+  return err;
 }
 
-static ULONG crc32_final(ULONG crc) { return crc ^ 0xFFFFFFFFUL; }
+static LONG Trace_Read(BPTR fh, APTR buf, LONG len) {
+  if (!gTrace) return Read(fh, buf, len);
+  trace_add(gTrace, 'B', "dos", "Read", 0);
+  LONG n = Read(fh, buf, len);
+  trace_add(gTrace, 'E', "dos", "Read", 0);
+  return n;
+}
+
+static LONG Trace_Write(BPTR fh, APTR buf, LONG len) {
+  if (!gTrace) return Write(fh, buf, len);
+  trace_add(gTrace, 'B', "dos", "Write", 0);
+  LONG n = Write(fh, buf, len);
+  trace_add(gTrace, 'E', "dos", "Write", 0);
+  return n;
+}
+
+static LONG Trace_EasyRequest(struct Window *w, struct EasyStruct *es, ULONG *idcmp, APTR args) {
+  TRACE_BEGIN("ui", "EasyRequest");
+  LONG sel = EasyRequestArgs(w, es, idcmp, args);
+  TRACE_END("ui", "EasyRequest");
+  return sel;
+}
+
+static BOOL Trace_AslRequest(struct FileRequester *fr) {
+  TRACE_BEGIN("ui", "AslRequest");
+  BOOL ok = AslRequest(fr, NULL) ? TRUE : FALSE;
+  TRACE_END("ui", "AslRequest");
+  return ok;
+}
+
+/* ----- Helpers ----- */
+
+static BOOL HasFile(CONST_STRPTR path) {
+  BPTR lock = Lock((STRPTR)path, ACCESS_READ);
+  if (lock) { UnLock(lock); return TRUE; }
+  return FALSE;
+}
@@ -0,0 +1,173 @@
+/*
+ * ftboot.c - bootblock analysis and signature matching (see ftboot.h).
+ * No allocation, no OS calls.
+ */
+#include <string.h>
+#include "ftboot.h"
+#include "fthash.h"
+
+static ULONG get32(const UBYTE *p) {
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+
+static UWORD get16(const UBYTE *p) {
+  return (UWORD)((p[0] << 8) | p[1]);
+}
+
+/* Add-with-carry over the block with the checksum long taken as 0, complemented */
+ULONG boot_checksum(const UBYTE *bb) {
+  ULONG sum = 0;
+  for (int i = 0; i < BOOT_SIZE / 4; ++i) {
+    ULONG v = (i == 1) ? 0 : get32(bb + 4 * i), s = sum + v;
+    if (s < sum) s++;
+    sum = s;
+  }
+  return ~sum;
+}
+
+struct Db {
+  ULONG states, edges, pats, crcs, names, size;
+  const UBYTE *st, *ed, *pt, *cr, *nm;
+};
+
+static int db_open(const UBYTE *db, ULONG len, struct Db *d) {
+  if (len < BOOT_HEAD_SIZE || get32(db) != BOOT_MAGIC || get32(db + 4) != BOOT_VERSION) return BOOT_ERR_DATA;
+  d->states = get32(db + 8);  d->edges = get32(db + 12);
+  d->pats   = get32(db + 16); d->crcs  = get32(db + 20);
+  d->names  = get32(db + 24); d->size  = get32(db + 28);
+  if (d->size != len || d->states < 1 || d->states >= BOOT_NONE || d->pats >= BOOT_NONE || d->edges > 0x1000000UL || d->crcs > 0x1000000UL)
+    return BOOT_ERR_DATA;
+  ULONG ofs = BOOT_HEAD_SIZE;
+  d->st = db + ofs; ofs += d->states * BOOT_STATE_SIZE;
+  d->ed = db + ofs; ofs += d->edges * BOOT_EDGE_SIZE;
+  d->pt = db + ofs; ofs += d->pats * BOOT_PAT_SIZE;
+  d->cr = db + ofs; ofs += d->crcs * BOOT_CRC_SIZE;
+  if (ofs != d->names || ofs > len) return BOOT_ERR_DATA;
+  d->nm = db + ofs;
+  return BOOT_OK;
+}
+
+static BOOL name_ok(const struct Db *d, ULONG ofs) {
+  ULONG n = d->size - d->names;
+  return ofs < n && memchr(d->nm + ofs, 0, n - ofs) != NULL;
+}
+
+/* Fail and dictionary links point to earlier (shallower) states and pattern
+ * chains run forwards, so no scan can loop or leave the buffer. */
+int boot_db_check(const UBYTE *db, ULONG len) {
+  struct Db d;
+  if (db_open(db, len, &d) != BOOT_OK) return BOOT_ERR_DATA;
+  for (ULONG s = 0; s < d.states; ++s) {
+    const UBYTE *p = d.st + s * BOOT_STATE_SIZE;
+    UWORD fail = get16(p), dict = get16(p + 2), out = get16(p + 4), n = get16(p + 6);
+    ULONG first = get32(p + 8);
+    if ((s ? fail >= s : fail != 0) || (dict != BOOT_NONE && dict >= s) || (out != BOOT_NONE && out >= d.pats)) return BOOT_ERR_DATA;
+    if (first > d.edges || n > d.edges - first) return BOOT_ERR_DATA;
+    for (ULONG e = first; e < first + n; ++e) {
+      const UBYTE *q = d.ed + e * BOOT_EDGE_SIZE;
+      if (get16(q + 2) >= d.states || get16(q + 2) == 0) return BOOT_ERR_DATA;
+      if (e > first && q[0] <= q[-BOOT_EDGE_SIZE]) return BOOT_ERR_DATA;
+    }
+  }
+  for (ULONG i = 0; i < d.pats; ++i) {
+    const UBYTE *p = d.pt + i * BOOT_PAT_SIZE;
+    UWORD next = get16(p + 4);
+    if ((next != BOOT_NONE && (next <= i || next >= d.pats)) || !name_ok(&d, get32(p + 8))) return BOOT_ERR_DATA;
+  }
+  for (ULONG i = 0; i < d.crcs; ++i) {
+    const UBYTE *p = d.cr + i * BOOT_CRC_SIZE;
+    if ((i && get32(p) < get32(p - BOOT_CRC_SIZE)) || !name_ok(&d, get32(p + 8))) return BOOT_ERR_DATA;
+  }
+  return BOOT_OK;
+}
+
+static void add_hit(struct BootInfo *bi, UBYTE kind, const char *name) {
+  for (UWORD i = 0; i < bi->nHits; ++i)
+    if (bi->hit[i].name == name) return;       /* same signature, matched again */
+  if (bi->nHits == BOOT_HITS_MAX) { bi->more = TRUE; return; }
+  bi->hit[bi->nHits].kind = kind;
+  bi->hit[bi->nHits].name = name;
+  bi->nHits++;
+}
+
+static UWORD step(const struct Db *d, UWORD s, UBYTE c) {
+  for (;;) {
+    const UBYTE *p = d->st + (ULONG)s * BOOT_STATE_SIZE;
+    const UBYTE *e = d->ed + get32(p + 8) * BOOT_EDGE_SIZE;
+    LONG lo = 0, hi = (LONG)get16(p + 6) - 1;
+    while (lo <= hi) {
+      LONG mid = (lo + hi) >> 1;
+      UBYTE b = e[mid * BOOT_EDGE_SIZE];
+      if (b == c) return get16(e + mid * BOOT_EDGE_SIZE + 2);
+      if (b < c) lo = mid + 1; else hi = mid - 1;
+    }
+    if (!s) return 0;
+    s = get16(p);
+  }
+}
+
+/* Every pattern ending at byte `end` in state s and along its dictionary chain */
+static void emit(const struct Db *d, UWORD s, ULONG end, struct BootInfo *bi) {
+  for (UWORD x = s; x != BOOT_NONE; x = get16(d->st + (ULONG)x * BOOT_STATE_SIZE + 2)) {
+    for (UWORD i = get16(d->st + (ULONG)x * BOOT_STATE_SIZE + 4); i != BOOT_NONE; ) {
+      const UBYTE *p = d->pt + (ULONG)i * BOOT_PAT_SIZE;
+      UWORD ofs = get16(p);
+      if (ofs == BOOT_ANY || (ULONG)ofs + get16(p + 2) == end + 1)
+        add_hit(bi, p[6], (const char *)d->nm + get32(p + 8));
+      i = get16(p + 4);
+    }
+  }
+}
+
+void boot_scan(const UBYTE *bb, const UBYTE *db, struct BootInfo *bi) {
+  memset(bi, 0, sizeof(*bi));
+  bi->codeCrc = crc32_final(crc32_update(crc32_init(), bb + BOOT_CODE, BOOT_SIZE - BOOT_CODE));
+  bi->sumOk   = (get32(bb + 4) == boot_checksum(bb));
+  bi->dosType = bb[3];
+  if (memcmp(bb, "DOS", 3) != 0 || bb[3] > 7) bi->class = BOOT_NDOS;
+  else if (bi->codeCrc == BOOT_STD_CRC)         bi->class = BOOT_STANDARD;
+  else {
+    ULONG i = BOOT_CODE;
+    while (i < BOOT_SIZE && !bb[i]) i++;
+    bi->class = (i == BOOT_SIZE) ? BOOT_EMPTY : BOOT_CUSTOM;
+  }
+  if (!db) return;
+
+  struct Db d;
+  if (db_open(db, get32(db + 28), &d) != BOOT_OK) return;
+  /* Whole-code CRCs: binary search */
+  LONG lo = 0, hi = (LONG)d.crcs - 1;
+  while (lo <= hi) {
+    LONG mid = (lo + hi) >> 1;
+    const UBYTE *p = d.cr + (ULONG)mid * BOOT_CRC_SIZE;
+    ULONG c = get32(p);
+    if (c == bi->codeCrc) {
+      while (mid > 0 && get32(p - BOOT_CRC_SIZE) == c) { mid--; p -= BOOT_CRC_SIZE; }
+      for (; (ULONG)mid < d.crcs && get32(p) == c; ++mid, p += BOOT_CRC_SIZE) add_hit(bi, p[4], (const char *)d.nm + get32(p + 8));
+      break;
+    }
+    if (c < bi->codeCrc) lo = mid + 1; else hi = mid - 1;
+  }
+  /* Byte patterns: one pass of the automaton */
+  if (!d.pats) return;
+  UWORD s = 0;
+  for (ULONG i = 0; i < BOOT_SIZE; ++i) {
+    s = step(&d, s, bb[i]);
+    if (s) emit(&d, s, i, bi);
+  }
+}
+
+const char *boot_kind_name(UBYTE kind) {
+  switch (kind) {
+    case BOOT_KIND_VIRUS:  return "virus";
+    case BOOT_KIND_LOADER: return "loader";
+    case BOOT_KIND_OS:     return "os";
+    case BOOT_KIND_UTIL:   return "util";
+    default:               return "other";
+  }
+}
+
+const char *boot_class_name(UBYTE cls) {
+  static const char *const names[] = { "ndos", "empty", "standard", "custom" };
+  return cls <= BOOT_CUSTOM ? names[cls] : "?";
+}
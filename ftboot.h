@@ -0,0 +1,86 @@
+/*
+ * ftboot.h - bootblock analysis: checksum, DOS type, boot code class and
+ * known viruses/loaders from a signature database built on the host by
+ * host/bootsig.c and matched in one pass over the 1,024 bytes.
+ *
+ * Database layout (all integers big-endian):
+ *   0     "FTBB", version, states, edges, patterns, code CRCs, offset of
+ *         the name table, total size
+ *   32    states, BOOT_STATE_SIZE each, in breadth-first order:
+ *         fail state, dictionary state (nearest fail-chain state that ends
+ *         a pattern, BOOT_NONE if none), first pattern ending here,
+ *         edge count, first edge
+ *   ...   edges, 4 bytes each, sorted by byte within a state: byte, 0,
+ *         target state
+ *   ...   patterns, BOOT_PAT_SIZE each: offset (BOOT_ANY = anywhere),
+ *         length, next pattern ending in the same state, kind, 0, name
+ *   ...   code CRCs, BOOT_CRC_SIZE each, sorted: CRC32 of bytes 12-1023,
+ *         kind, 0, 0, 0, name
+ *   ...   names, NUL-terminated
+ *
+ * The states and edges are an Aho-Corasick automaton over all byte
+ * patterns, so the scan costs the same for 10 signatures or 10,000.
+ */
+#ifndef FTBOOT_H
+#define FTBOOT_H
+
+#include "ftport.h"
+
+#define BOOT_SIZE       1024
+#define BOOT_CODE       12                     /* boot code starts here */
+#define BOOT_STD_CRC    0xFD791AE7UL           /* Install's code (ftofs.c stdBoot), zero-padded */
+
+#define BOOT_MAGIC      0x46544242UL           /* "FTBB" */
+#define BOOT_VERSION    1
+#define BOOT_HEAD_SIZE  32
+#define BOOT_STATE_SIZE 12
+#define BOOT_EDGE_SIZE  4
+#define BOOT_PAT_SIZE   12
+#define BOOT_CRC_SIZE   12
+#define BOOT_NONE       0xFFFF
+#define BOOT_ANY        0xFFFF
+
+/* Signature kinds */
+#define BOOT_KIND_VIRUS  'V'
+#define BOOT_KIND_LOADER 'L'
+#define BOOT_KIND_OS     'O'                   /* stock install code */
+#define BOOT_KIND_UTIL   'U'
+
+/* Class of a bootblock */
+#define BOOT_NDOS       0                      /* no "DOS" type */
+#define BOOT_EMPTY      1                      /* DOS, no boot code */
+#define BOOT_STANDARD   2
+#define BOOT_CUSTOM     3
+
+#ifndef BOOT_HITS_MAX
+#define BOOT_HITS_MAX   4
+#endif
+
+#define BOOT_OK         0
+#define BOOT_ERR_DATA  -2                      /* not a database / bad version / out of range */
+
+struct BootHit {
+  UBYTE kind;
+  const char *name;                            /* points into the database */
+};
+
+struct BootInfo {
+  UBYTE class;                                 /* BOOT_NDOS .. BOOT_CUSTOM */
+  UBYTE dosType;                               /* 0..7 for DOS\n */
+  BOOL  sumOk;
+  ULONG codeCrc;                               /* CRC32 of bytes 12-1023 */
+  UWORD nHits;
+  BOOL  more;                                  /* further signatures matched, not kept */
+  struct BootHit hit[BOOT_HITS_MAX];
+};
+
+/* Value for the checksum long at offset 4 */
+ULONG boot_checksum(const UBYTE *bb);
+/* Validates every index in a database (it may come from anywhere) */
+int   boot_db_check(const UBYTE *db, ULONG len);
+/* db may be NULL (class and checksum only); must have passed boot_db_check */
+void  boot_scan(const UBYTE *bb, const UBYTE *db, struct BootInfo *bi);
+const char *boot_kind_name(UBYTE kind);
+const char *boot_class_name(UBYTE cls);
+
+#endif
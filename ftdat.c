@@ -0,0 +1,44 @@
+/*
+ * ftdat.c - DAT index lookup (see ftdat.h). No allocation, no OS calls.
+ */
+#include <string.h>
+#include "ftdat.h"
+
+static ULONG get32(const UBYTE *p) {
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+
+static int read_exact(DatReadAtFn rd, void *h, ULONG off, UBYTE *buf, LONG len) {
+  return rd(h, off, buf, len) == len;
+}
+
+int dat_lookup(DatReadAtFn rd, void *h, const UBYTE sha1[SHA1_LEN], struct DatHit *hit) {
+  UBYTE head[DAT_HEAD_SIZE], fan[8], e[DAT_ENTRY_SIZE];
+  if (!read_exact(rd, h, 0, head, DAT_HEAD_SIZE)) return DAT_ERR_IO;
+  if (get32(head) != DAT_MAGIC || get32(head + 4) != DAT_VERSION) return DAT_ERR_DATA;
+  ULONG count = get32(head + 8), names = get32(head + 12);
+
+  if (!read_exact(rd, h, DAT_HEAD_SIZE + 4 * (ULONG)sha1[0], fan, 8)) return DAT_ERR_IO;
+  ULONG lo = get32(fan), hi = get32(fan + 4);     /* entries [lo, hi) */
+  if (hi > count || lo > hi) return DAT_ERR_DATA;
+
+  while (lo < hi) {
+    ULONG mid = lo + (hi - lo) / 2;
+    if (!read_exact(rd, h, DAT_ENTRY_OFS + mid * DAT_ENTRY_SIZE, e, DAT_ENTRY_SIZE)) return DAT_ERR_IO;
+    int c = memcmp(e, sha1, SHA1_LEN);
+    if (c < 0) lo = mid + 1;
+    else if (c > 0) hi = mid;
+    else {
+      if (hit) {
+        memcpy(hit->md5, e + SHA1_LEN, MD5_LEN);
+        hit->crc  = get32(e + SHA1_LEN + MD5_LEN);
+        hit->size = get32(e + SHA1_LEN + MD5_LEN + 4);
+        LONG n = rd(h, names + get32(e + SHA1_LEN + MD5_LEN + 8), (UBYTE *)hit->name, DAT_NAME_MAX - 1);
+        if (n < 0) return DAT_ERR_IO;
+        hit->name[n] = '\0';                     /* stops at the first NUL anyway */
+      }
+      return DAT_FOUND;
+    }
+  }
+  return DAT_NOT_FOUND;
+}
@@ -0,0 +1,47 @@
+/*
+ * ftdat.h - sorted binary index of DAT (TOSEC/WHDLoad/No-Intro style)
+ * entries, built on the host by host/datindex.c and searched by FloppyTool.
+ *
+ * Layout (all integers big-endian):
+ *   0     "FTDX", version, entry count, offset of the name table
+ *   16    fan-out: DAT_FAN+1 entry indices, fan[b] = first entry whose
+ *         SHA-1 starts with a byte >= b (fan[256] = count)
+ *   1044  entries, DAT_ENTRY_SIZE each, sorted by SHA-1:
+ *         SHA-1, MD5 (zeros if the DAT has none), CRC32, size, name offset
+ *   ...   names, NUL-terminated: the rom name, as "game/rom" when the
+ *         rom name does not already start with the game name
+ *
+ * A lookup is two fan-out reads plus a binary search over the entries that
+ * share the first SHA-1 byte: ~9 small reads for a 100,000-entry index.
+ */
+#ifndef FTDAT_H
+#define FTDAT_H
+
+#include "ftport.h"
+#include "fthash.h"
+
+#define DAT_MAGIC      0x46544458UL              /* "FTDX" */
+#define DAT_VERSION    1
+#define DAT_FAN        256
+#define DAT_HEAD_SIZE  16
+#define DAT_ENTRY_OFS  (DAT_HEAD_SIZE + 4*(DAT_FAN+1))    /* 1044 */
+#define DAT_ENTRY_SIZE (SHA1_LEN + MD5_LEN + 4 + 4 + 4)   /* 48 */
+#define DAT_NAME_MAX   128                       /* longer names are cut on lookup */
+
+#define DAT_FOUND      1
+#define DAT_NOT_FOUND  0
+#define DAT_ERR_IO    -1
+#define DAT_ERR_DATA  -2                         /* not an index / bad version */
+
+/* Read len bytes at offset off; returns bytes read, < 0 on error */
+typedef LONG (*DatReadAtFn)(void *handle, ULONG off, UBYTE *buf, LONG len);
+
+struct DatHit {
+  UBYTE md5[MD5_LEN];
+  ULONG crc, size;
+  char  name[DAT_NAME_MAX];
+};
+
+int dat_lookup(DatReadAtFn rd, void *h, const UBYTE sha1[SHA1_LEN], struct DatHit *hit);
+
+#endif
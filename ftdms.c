@@ -0,0 +1,470 @@
+/*
+ * ftdms.c - streaming DMS unpacker, see ftdms.h.
+ *
+ * File: 56-byte header "DMS!" ... CRC16, then records of a 20-byte
+ * "TR" header (cylinder, lengths, flags, mode, checksum, CRC16) plus the
+ * packed data. Modes QUICK/MEDIUM/DEEP are followed by an RLE pass,
+ * HEAVY only when flag 4 is set. The dictionaries and Huffman trees carry
+ * over to the next record unless its flag 1 is clear.
+ */
+#include <string.h>
+#include "ftdms.h"
+
+#define DMS_HEAD_LEN   56
+#define DMS_TR_LEN     20
+#define DMS_INFO_CRYPT 0x02
+
+const char *const dms_mode_name[DMS_MODES] = {
+  "NONE", "SIMPLE", "QUICK", "MEDIUM", "DEEP", "HEAVY1", "HEAVY2"
+};
+
+static UWORD get16(const UBYTE *p) { return (UWORD)((p[0] << 8) | p[1]); }
+
+/* CRC-16 (poly 0xA001 reflected, init 0) as used in DMS headers */
+static UWORD crc16(const UBYTE *p, ULONG n) {
+  static UWORD table[256];
+  static BOOL  tableReady = FALSE;
+  if (!tableReady) {
+    for (ULONG i=0; i<256; ++i) {
+      UWORD c = (UWORD)i;
+      for (int k=0; k<8; ++k) c = (c & 1) ? (UWORD)((c >> 1) ^ 0xA001) : (UWORD)(c >> 1);
+      table[i] = c;
+    }
+    tableReady = TRUE;
+  }
+  UWORD crc = 0;
+  while (n--) crc = (UWORD)(table[(crc ^ *p++) & 0xFF] ^ (crc >> 8));
+  return crc;
+}
+
+static BOOL read_full(struct DmsIn *d, UBYTE *buf, ULONG len) {
+  while (len) {
+    LONG n = d->rd(d->h, buf, (LONG)len);
+    if (n < 0) { d->error = DMS_ERR_IO; return FALSE; }
+    if (n == 0) return FALSE;
+    buf += n; len -= (ULONG)n;
+  }
+  return TRUE;
+}
+
+/* ----- Bit reader: peek n <= 16 bits, at least 16 always buffered ----- */
+
+static void bits_drop(struct DmsIn *d, int n) {
+  d->bitCnt -= n;
+  d->bitBuf &= (1UL << d->bitCnt) - 1;
+  while (d->bitCnt < 16) {
+    d->bitBuf = (d->bitBuf << 8) | (d->bp < d->bend ? *d->bp++ : 0);
+    d->bitCnt += 8;
+  }
+}
+
+static void bits_init(struct DmsIn *d, const UBYTE *in, ULONG len) {
+  d->bp = in; d->bend = in + len;
+  d->bitBuf = 0; d->bitCnt = 0;
+  bits_drop(d, 0);
+}
+
+static UWORD bits_peek(struct DmsIn *d, int n) { return (UWORD)(d->bitBuf >> (d->bitCnt - n)); }
+
+static UWORD bits_get(struct DmsIn *d, int n) {
+  UWORD v = bits_peek(d, n);
+  bits_drop(d, n);
+  return v;
+}
+
+/* Static position code shared by MEDIUM and DEEP (LZHUF d_code/d_len) */
+static UBYTE dCode[256], dLen[256];
+
+static void pos_tables(void) {
+  static const UBYTE runs[6] = { 1, 3, 8, 12, 24, 16 };   /* codes per length 3..8 */
+  static const UBYTE span[6] = { 32, 16, 8, 4, 2, 1 };    /* table entries per code */
+  int i = 0, code = 0;
+  if (dLen[0]) return;
+  for (int k=0; k<6; ++k)
+    for (int c=0; c<runs[k]; ++c, ++code)
+      for (int s=0; s<span[k]; ++s, ++i) { dCode[i] = (UBYTE)code; dLen[i] = (UBYTE)(3 + k); }
+}
+
+static void init_decrunchers(struct DmsIn *d) {
+  d->quickLoc  = 251;
+  d->mediumLoc = 0x3FBE;
+  d->heavyLoc  = 0;
+  d->deepLoc   = 0x3FC4;
+  d->deepInit  = 1;
+  memset(d->text, 0, sizeof(d->text));
+}
+
+/* ----- SIMPLE: 0x90 run-length ----- */
+
+static BOOL unpack_rle(const UBYTE *in, ULONG inLen, UBYTE *out, ULONG outLen) {
+  const UBYTE *inEnd = in + inLen;
+  UBYTE *outEnd = out + outLen;
+  while (out < outEnd) {
+    if (in >= inEnd) return FALSE;
+    UBYTE a = *in++;
+    if (a != 0x90) { *out++ = a; continue; }
+    if (in >= inEnd) return FALSE;
+    UBYTE b = *in++;
+    if (!b) { *out++ = a; continue; }
+    if (in >= inEnd) return FALSE;
+    a = *in++;
+    ULONG n = b;
+    if (b == 0xFF) {
+      if (in + 2 > inEnd) return FALSE;
+      n = ((ULONG)in[0] << 8) | in[1];
+      in += 2;
+    }
+    if (out + n > outEnd) return FALSE;
+    memset(out, a, n);
+    out += n;
+  }
+  return TRUE;
+}
+
+/* ----- QUICK: 256-byte window, 2-bit lengths ----- */
+
+static void unpack_quick(struct DmsIn *d, const UBYTE *in, ULONG inLen, UBYTE *out, ULONG outLen) {
+  UBYTE *outEnd = out + outLen;
+  bits_init(d, in, inLen);
+  while (out < outEnd) {
+    if (bits_get(d, 1)) {
+      *out++ = d->text[d->quickLoc++ & 0xFF] = (UBYTE)bits_get(d, 8);
+    } else {
+      UWORD j = (UWORD)(bits_get(d, 2) + 2);
+      UWORD i = (UWORD)(d->quickLoc - bits_get(d, 8) - 1);
+      while (j-- && out < outEnd) *out++ = d->text[d->quickLoc++ & 0xFF] = d->text[i++ & 0xFF];
+    }
+  }
+  d->quickLoc = (UWORD)((d->quickLoc + 5) & 0xFF);
+}
+
+/* ----- MEDIUM: 16 KB window, static length and position codes ----- */
+
+static void unpack_medium(struct DmsIn *d, const UBYTE *in, ULONG inLen, UBYTE *out, ULONG outLen) {
+  UBYTE *outEnd = out + outLen;
+  bits_init(d, in, inLen);
+  while (out < outEnd) {
+    if (bits_get(d, 1)) {
+      *out++ = d->text[d->mediumLoc++ & 0x3FFF] = (UBYTE)bits_get(d, 8);
+      continue;
+    }
+    UWORD c = bits_get(d, 8);
+    UWORD j = (UWORD)(dCode[c] + 3);
+    int u = dLen[c];
+    c = (UWORD)(((c << u) | bits_get(d, u)) & 0xFF);
+    u = dLen[c];
+    c = (UWORD)((dCode[c] << 8) | (((c << u) | bits_get(d, u)) & 0xFF));
+    UWORD i = (UWORD)(d->mediumLoc - c - 1);
+    while (j-- && out < outEnd) *out++ = d->text[d->mediumLoc++ & 0x3FFF] = d->text[i++ & 0x3FFF];
+  }
+  d->mediumLoc = (UWORD)((d->mediumLoc + 66) & 0x3FFF);
+}
+
+/* ----- DEEP: adaptive Huffman (LZHUF), 16 KB window ----- */
+
+#define DEEP_F      60
+#define DEEP_NCHAR  (256 - 2 + DEEP_F)           /* 314 */
+#define DEEP_T      (DEEP_NCHAR * 2 - 1)         /* 627 */
+#define DEEP_R      (DEEP_T - 1)
+#define DEEP_MAXF   0x8000
+
+static void deep_init(struct DmsIn *d) {
+  UWORD i, j;
+  for (i=0; i<DEEP_NCHAR; ++i) {
+    d->freq[i] = 1;
+    d->son[i] = (UWORD)(i + DEEP_T);
+    d->prnt[i + DEEP_T] = i;
+  }
+  for (i=0, j=DEEP_NCHAR; j<=DEEP_R; i+=2, ++j) {
+    d->freq[j] = (UWORD)(d->freq[i] + d->freq[i+1]);
+    d->son[j] = i;
+    d->prnt[i] = d->prnt[i+1] = j;
+  }
+  d->freq[DEEP_T] = 0xFFFF;
+  d->prnt[DEEP_R] = 0;
+  d->deepInit = 0;
+}
+
+/* Halve the frequencies and rebuild the tree */
+static void deep_reconst(struct DmsIn *d) {
+  UWORD i, j, k, f;
+  for (i=0, j=0; i<DEEP_T; ++i)
+    if (d->son[i] >= DEEP_T) {
+      d->freq[j] = (UWORD)((d->freq[i] + 1) / 2);
+      d->son[j] = d->son[i];
+      j++;
+    }
+  for (i=0, j=DEEP_NCHAR; j<DEEP_T; i+=2, ++j) {
+    f = d->freq[j] = (UWORD)(d->freq[i] + d->freq[i+1]);
+    for (k=(UWORD)(j-1); f < d->freq[k]; --k) ;
+    k++;
+    memmove(&d->freq[k+1], &d->freq[k], (size_t)(j - k) * sizeof(UWORD));
+    d->freq[k] = f;
+    memmove(&d->son[k+1], &d->son[k], (size_t)(j - k) * sizeof(UWORD));
+    d->son[k] = i;
+  }
+  for (i=0; i<DEEP_T; ++i) {
+    if ((k = d->son[i]) >= DEEP_T) d->prnt[k] = i;
+    else d->prnt[k] = d->prnt[k+1] = i;
+  }
+}
+
+static void deep_update(struct DmsIn *d, UWORD c) {
+  if (d->freq[DEEP_R] == DEEP_MAXF) deep_reconst(d);
+  c = d->prnt[c + DEEP_T];
+  do {
+    UWORD k = ++d->freq[c];
+    UWORD l = (UWORD)(c + 1);
+    if (k > d->freq[l]) {
+      /* Order disturbed: swap with the last node of lower frequency */
+      while (k > d->freq[++l]) ;
+      l--;
+      d->freq[c] = d->freq[l];
+      d->freq[l] = k;
+      UWORD i = d->son[c];
+      d->prnt[i] = l;
+      if (i < DEEP_T) d->prnt[i+1] = l;
+      UWORD j = d->son[l];
+      d->son[l] = i;
+      d->prnt[j] = c;
+      if (j < DEEP_T) d->prnt[j+1] = c;
+      d->son[c] = j;
+      c = l;
+    }
+  } while ((c = d->prnt[c]) != 0);
+}
+
+static void unpack_deep(struct DmsIn *d, const UBYTE *in, ULONG inLen, UBYTE *out, ULONG outLen) {
+  UBYTE *outEnd = out + outLen;
+  bits_init(d, in, inLen);
+  if (d->deepInit) deep_init(d);
+  while (out < outEnd) {
+    UWORD c = d->son[DEEP_R];
+    while (c < DEEP_T) c = d->son[c + bits_get(d, 1)];
+    c -= DEEP_T;
+    deep_update(d, c);
+    if (c < 256) {
+      *out++ = d->text[d->deepLoc++ & 0x3FFF] = (UBYTE)c;
+      continue;
+    }
+    UWORD j = (UWORD)(c - 253);
+    UWORD p = bits_get(d, 8);
+    UWORD hi = (UWORD)(dCode[p] << 8);
+    int u = dLen[p];
+    p = (UWORD)(hi | (((p << u) | bits_get(d, u)) & 0xFF));
+    UWORD i = (UWORD)(d->deepLoc - p - 1);
+    while (j-- && out < outEnd) *out++ = d->text[d->deepLoc++ & 0x3FFF] = d->text[i++ & 0x3FFF];
+  }
+  d->deepLoc = (UWORD)((d->deepLoc + 60) & 0x3FFF);
+}
+
+/* ----- HEAVY: LZH with per-record (or inherited) static Huffman codes ----- */
+
+#define HEAVY_NC      510
+#define HEAVY_LONG    0xFFFF                     /* table miss: code longer than table */
+
+/* Canonical MSB-first code: table entries are (len << shift) | sym */
+static BOOL heavy_table(const UBYTE *len, int n, int bits, int shift, UWORD *table, UWORD *sym, UWORD *count) {
+  UWORD offs[32];
+  memset(count, 0, 32 * sizeof(UWORD));
+  for (int i=0; i<n; ++i) count[len[i]]++;
+  count[0] = 0;
+  LONG left = 1;
+  for (int l=1; l<25; ++l) { left <<= 1; left -= count[l]; if (left < 0) return FALSE; }
+  for (int l=25; l<32; ++l) if (count[l]) return FALSE;
+  if (left != 0) return FALSE;                   /* DMS codes are always complete */
+
+  offs[1] = 0;
+  for (int l=1; l<31; ++l) offs[l+1] = (UWORD)(offs[l] + count[l]);
+  for (int i=0; i<n; ++i) if (len[i]) sym[offs[len[i]]++] = (UWORD)i;
+
+  for (ULONG i=0; i<(1UL << bits); ++i) table[i] = HEAVY_LONG;
+  ULONG code = 0; int idx = 0;
+  for (int l=1; l<=bits; ++l) {
+    for (int k=0; k<count[l]; ++k, ++idx, ++code) {
+      ULONG first = code << (bits - l), span = 1UL << (bits - l);
+      for (ULONG f=0; f<span; ++f) table[first + f] = (UWORD)((l << shift) | sym[idx]);
+    }
+    code <<= 1;
+  }
+  return TRUE;
+}
+
+static int heavy_decode(struct DmsIn *d, const UWORD *table, int bits, int shift,
+                        const UWORD *sym, const UWORD *count) {
+  UWORD e = table[bits_peek(d, bits)];
+  if (e != HEAVY_LONG) {
+    bits_drop(d, e >> shift);
+    return e & ((1 << shift) - 1);
+  }
+  /* Long code: canonical walk one bit at a time */
+  LONG code = 0, first = 0, index = 0;
+  for (int l=1; l<25; ++l) {
+    code |= bits_get(d, 1);
+    LONG c = count[l];
+    if (code - first < c) return sym[index + (code - first)];
+    index += c; first += c;
+    first <<= 1; code <<= 1;
+  }
+  return -1;
+}
+
+static BOOL heavy_trees(struct DmsIn *d, int np) {
+  UWORD n = bits_get(d, 9);
+  if (n > HEAVY_NC) return FALSE;
+  if (n > 0) {
+    for (int i=0; i<n; ++i) d->cLen[i] = (UBYTE)bits_get(d, 5);
+    memset(d->cLen + n, 0, HEAVY_NC - n);
+    if (!heavy_table(d->cLen, HEAVY_NC, 12, 9, d->cTable, d->cSym, d->cCount)) return FALSE;
+  } else {
+    n = bits_get(d, 9);                          /* single symbol, zero-length code */
+    if (n >= HEAVY_NC) return FALSE;
+    for (int i=0; i<4096; ++i) d->cTable[i] = n;
+  }
+
+  n = bits_get(d, 5);
+  if (n > np) return FALSE;
+  if (n > 0) {
+    for (int i=0; i<n; ++i) d->ptLen[i] = (UBYTE)bits_get(d, 4);
+    memset(d->ptLen + n, 0, (size_t)(np - n));
+    if (!heavy_table(d->ptLen, np, 8, 5, d->ptTable, d->ptSym, d->ptCount)) return FALSE;
+  } else {
+    n = bits_get(d, 5);
+    if (n >= np) return FALSE;
+    for (int i=0; i<256; ++i) d->ptTable[i] = n;
+  }
+  d->heavyTrees = 1;
+  return TRUE;
+}
+
+static BOOL unpack_heavy(struct DmsIn *d, const UBYTE *in, ULONG inLen, UBYTE *out, ULONG outLen, UBYTE flags) {
+  /* HEAVY1: 4 KB window, 14 position codes; HEAVY2: 8 KB, 15 */
+  int   np   = (flags & 8) ? 15 : 14;
+  UWORD mask = (flags & 8) ? 0x1FFF : 0x0FFF;
+  UBYTE *outEnd = out + outLen;
+
+  bits_init(d, in, inLen);
+  if (flags & 2) { if (!heavy_trees(d, np)) return FALSE; }
+  else if (!d->heavyTrees) return FALSE;
+
+  while (out < outEnd) {
+    int c = heavy_decode(d, d->cTable, 12, 9, d->cSym, d->cCount);
+    if (c < 0) return FALSE;
+    if (c < 256) { *out++ = d->text[d->heavyLoc++ & mask] = (UBYTE)c; continue; }
+
+    UWORD j = (UWORD)(c - 253);
+    int p = heavy_decode(d, d->ptTable, 8, 5, d->ptSym, d->ptCount);
+    if (p < 0 || p >= np) return FALSE;
+    if (p != np - 1) {                           /* np-1 repeats the last offset */
+      if (p > 0) p = (int)(bits_get(d, p - 1) | (1U << (p - 1)));
+      d->lastLen = (UWORD)p;
+    }
+    UWORD i = (UWORD)(d->heavyLoc - d->lastLen - 1);
+    while (j-- && out < outEnd) *out++ = d->text[d->heavyLoc++ & mask] = d->text[i++ & mask];
+  }
+  return TRUE;
+}
+
+/* ----- Records ----- */
+
+/* Next data record into cyl[]; FALSE at end of file or on error */
+static BOOL next_record(struct DmsIn *d) {
+  UBYTE h[DMS_TR_LEN];
+  for (;;) {
+    if (!read_full(d, h, DMS_TR_LEN)) return FALSE;
+    if (h[0] != 'T' || h[1] != 'R') { d->error = DMS_ERR_DATA; return FALSE; }
+    if (crc16(h, DMS_TR_LEN - 2) != get16(h + 18)) { d->error = DMS_ERR_CRC; return FALSE; }
+
+    UWORD number = get16(h + 2);
+    UWORD pkLen  = get16(h + 6);
+    UWORD midLen = get16(h + 8);
+    UWORD len    = get16(h + 10);
+    UBYTE flags  = h[12];
+    UBYTE mode   = h[13];
+    if (pkLen > DMS_PACK_MAX || midLen > DMS_PACK_MAX) { d->error = DMS_ERR_DATA; return FALSE; }
+    if (!read_full(d, d->pk, pkLen)) { if (!d->error) d->error = DMS_ERR_DATA; return FALSE; }
+    if (crc16(d->pk, pkLen) != get16(h + 16)) { d->error = DMS_ERR_CRC; return FALSE; }
+
+    /* Banner (0xFFFF), FILE_ID.DIZ (80) and the 1 KB fake bootblock carry no disk data */
+    if (number >= DMS_CYLINDERS || len <= 2048) continue;
+    if (len != DMS_CYL_SIZE || mode >= DMS_MODES) { d->error = DMS_ERR_MODE; return FALSE; }
+
+    BOOL ok = TRUE;
+    switch (mode) {
+      case 0:
+        ok = (pkLen >= len);
+        if (ok) memcpy(d->cyl, d->pk, len);
+        break;
+      case 1:
+        ok = unpack_rle(d->pk, pkLen, d->cyl, len);
+        break;
+      case 2: case 3: case 4:
+        if (mode == 2)      unpack_quick(d, d->pk, pkLen, d->tmp, midLen);
+        else if (mode == 3) unpack_medium(d, d->pk, pkLen, d->tmp, midLen);
+        else                unpack_deep(d, d->pk, pkLen, d->tmp, midLen);
+        ok = unpack_rle(d->tmp, midLen, d->cyl, len);
+        break;
+      default:
+        ok = unpack_heavy(d, d->pk, pkLen, d->tmp, midLen, mode == 5 ? (UBYTE)(flags & 7) : (UBYTE)(flags | 8));
+        if (ok && (flags & 4)) ok = unpack_rle(d->tmp, midLen, d->cyl, len);
+        else if (ok) { ok = (midLen >= len); if (ok) memcpy(d->cyl, d->tmp, len); }
+        break;
+    }
+    if (!(flags & 1)) init_decrunchers(d);
+    if (!ok) { d->error = DMS_ERR_DATA; return FALSE; }
+
+    UWORD sum = 0;
+    for (ULONG i=0; i<len; ++i) sum = (UWORD)(sum + d->cyl[i]);
+    if (sum != get16(h + 14)) { d->error = DMS_ERR_CRC; return FALSE; }
+
+    d->modeCount[mode]++;
+    d->recCyl = number;
+    return TRUE;
+  }
+}
+
+int dms_open(struct DmsIn *d, DmsReadFn rd, void *h) {
+  UBYTE b[DMS_HEAD_LEN];
+  memset(d, 0, sizeof(*d));
+  d->rd = rd; d->h = h;
+  d->outCyl = -1; d->recCyl = -1;
+  d->cylPos = DMS_CYL_SIZE;
+  pos_tables();
+  init_decrunchers(d);
+
+  if (!read_full(d, b, DMS_HEAD_LEN)) return d->error ? d->error : (d->error = DMS_ERR_DATA);
+  if (memcmp(b, "DMS!", 4)) return d->error = DMS_ERR_DATA;
+  if (crc16(b + 4, DMS_HEAD_LEN - 6) != get16(b + DMS_HEAD_LEN - 2)) return d->error = DMS_ERR_CRC;
+
+  d->info     = get16(b + 10);
+  d->from     = get16(b + 16);
+  d->to       = get16(b + 18);
+  d->version  = get16(b + 46);
+  d->diskType = get16(b + 50);
+  d->mode     = get16(b + 52);
+  if (d->info & DMS_INFO_CRYPT) return d->error = DMS_ERR_MODE;
+  return DMS_OK;
+}
+
+LONG dms_read(struct DmsIn *d, UBYTE *out, LONG len) {
+  LONG n = 0;
+  while (n < len && !d->error) {
+    if (d->cylPos < DMS_CYL_SIZE) {
+      ULONG k = DMS_CYL_SIZE - d->cylPos;
+      if (k > (ULONG)(len - n)) k = (ULONG)(len - n);
+      if (d->recCyl == d->outCyl) memcpy(out + n, d->cyl + d->cylPos, k);
+      else memset(out + n, 0, k);
+      d->cylPos += k; n += (LONG)k;
+      continue;
+    }
+    if (d->outCyl + 1 >= DMS_CYLINDERS) break;
+    d->outCyl++;
+    d->cylPos = 0;
+    while (!d->eof && d->recCyl < d->outCyl) {
+      if (!next_record(d)) { d->eof = 1; break; }
+      if (d->recCyl < d->outCyl) d->skipped++;   /* duplicate or out of order */
+    }
+    if (d->recCyl != d->outCyl) d->missing++;
+  }
+  return d->error ? d->error : n;
+}
@@ -0,0 +1,72 @@
+/*
+ * ftdms.h - streaming DMS (DiskMasher) unpacker for FloppyTool and the
+ * host tools. Decodes one cylinder (two ADF tracks) at a time into the
+ * caller's reads, so a .dms writes to disk without an 880 KB ADF in RAM.
+ *
+ * Modes: NONE, SIMPLE (RLE), QUICK, MEDIUM, DEEP, HEAVY1, HEAVY2.
+ * Encrypted archives and non-DD disks are rejected (DMS_ERR_MODE).
+ * Cylinders missing from the archive read back as zeros (see 'missing').
+ *
+ * Memory: DmsIn ~85 KB, caller-owned (AllocVec on Amiga, malloc on host).
+ */
+#ifndef FTDMS_H
+#define FTDMS_H
+
+#include "ftport.h"
+
+#define DMS_OK         0
+#define DMS_ERR_IO    -1
+#define DMS_ERR_DATA  -2               /* not DMS / corrupt packed data */
+#define DMS_ERR_CRC   -3               /* header/track CRC or checksum mismatch */
+#define DMS_ERR_MODE  -4               /* encrypted, unknown mode or not DD */
+
+#define DMS_CYLINDERS 80
+#define DMS_CYL_SIZE  (2 * FT_TRACK_SIZE)        /* 11,264 bytes per record */
+#define DMS_PACK_MAX  24000                      /* packed / intermediate data */
+#define DMS_MODES     7
+
+typedef LONG (*DmsReadFn)(void *handle, UBYTE *buf, LONG len);   /* 0 = end */
+
+struct DmsIn {
+  DmsReadFn rd;
+  void     *h;
+  int       error;
+
+  /* Archive header */
+  UWORD     info, from, to, version, diskType, mode;
+
+  /* Output position: cylinder outCyl, byte cylPos of it */
+  LONG      outCyl, recCyl;            /* recCyl = cylinder held in cyl[] */
+  ULONG     cylPos;
+  int       eof;
+  ULONG     missing, skipped;          /* zero-filled / out-of-order records */
+  ULONG     modeCount[DMS_MODES];      /* records unpacked per mode */
+
+  UBYTE     pk[DMS_PACK_MAX];
+  UBYTE     tmp[DMS_PACK_MAX];
+  UBYTE     cyl[DMS_CYL_SIZE];
+
+  /* Bit reader (MSB first) */
+  const UBYTE *bp, *bend;
+  ULONG     bitBuf;
+  int       bitCnt;
+
+  /* Decruncher state, carried across records unless a record resets it */
+  UBYTE     text[0x4000];
+  UWORD     quickLoc, mediumLoc, heavyLoc, deepLoc;
+  int       deepInit;
+  UWORD     freq[628], prnt[941], son[627];      /* DEEP adaptive Huffman tree */
+  UBYTE     cLen[510], ptLen[20];                /* HEAVY code lengths */
+  UWORD     cTable[4096], ptTable[256];          /* HEAVY lookup, short codes */
+  UWORD     cSym[510], ptSym[20];                /* HEAVY canonical symbol order */
+  UWORD     cCount[32], ptCount[32];
+  int       heavyTrees;
+  UWORD     lastLen;
+};
+
+int  dms_open(struct DmsIn *d, DmsReadFn rd, void *h);   /* reads the file header */
+LONG dms_read(struct DmsIn *d, UBYTE *out, LONG len);    /* ADF bytes, 0 = end */
+
+extern const char *const dms_mode_name[DMS_MODES];
+
+#endif
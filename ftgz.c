@@ -0,0 +1,642 @@
+/*
+ * ftgz.c - streaming gzip reader/writer (RFC 1951/1952), see ftgz.h.
+ *
+ * Inflate decodes Huffman codes up to GZ_FAST_BITS with one table lookup
+ * and falls back to a canonical bit-by-bit walk for longer codes.
+ * Deflate is greedy LZ77 over hash chains; each block is emitted with
+ * fixed or dynamic codes, whichever is smaller.
+ */
+#include <string.h>
+#include "ftgz.h"
+#include "fthash.h"
+
+static const UWORD lenBase[29] = {
+  3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258
+};
+static const UBYTE lenExtra[29] = {
+  0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+static const UWORD distBase[30] = {
+  1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,
+  1025,1537,2049,3073,4097,6145,8193,12289,16385,24577
+};
+static const UBYTE distExtra[30] = {
+  0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+static const UBYTE clOrder[19] = {
+  16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15
+};
+
+static void fixed_lengths(UBYTE *lit, UBYTE *dist) {
+  int i;
+  for (i=0;   i<144; ++i) lit[i] = 8;
+  for (;      i<256; ++i) lit[i] = 9;
+  for (;      i<280; ++i) lit[i] = 7;
+  for (;      i<288; ++i) lit[i] = 8;
+  for (i=0;   i<30;  ++i) dist[i] = 5;
+}
+
+static ULONG bit_reverse(ULONG code, int len) {
+  ULONG r = 0;
+  while (len--) { r = (r << 1) | (code & 1); code >>= 1; }
+  return r;
+}
+
+/* ========================= INFLATE ========================= */
+
+/* Builds decode tables; FALSE if the lengths are over-subscribed or (except
+ * for a single code) incomplete. */
+static BOOL huff_build(struct GzHuff *hf, const UBYTE *len, int n) {
+  UWORD offs[16];
+  memset(hf->count, 0, sizeof(hf->count));
+  for (int i=0; i<n; ++i) hf->count[len[i]]++;
+  hf->count[0] = 0;
+
+  LONG left = 1;
+  for (int l=1; l<16; ++l) { left <<= 1; left -= hf->count[l]; if (left < 0) return FALSE; }
+  int used = 0;
+  for (int i=0; i<n; ++i) if (len[i]) used++;
+  if (left > 0 && used > 1) return FALSE;
+
+  offs[1] = 0;
+  for (int l=1; l<15; ++l) offs[l+1] = offs[l] + hf->count[l];
+  for (int i=0; i<n; ++i) if (len[i]) hf->symbol[offs[len[i]]++] = (UWORD)i;
+
+  /* Fast table: canonical codes up to GZ_FAST_BITS, stored bit-reversed */
+  memset(hf->fast, 0, sizeof(hf->fast));
+  ULONG code = 0; int idx = 0;
+  for (int l=1; l<16; ++l) {
+    for (int k=0; k<hf->count[l]; ++k, ++idx, ++code) {
+      if (l > GZ_FAST_BITS) continue;
+      ULONG r = bit_reverse(code, l);
+      for (ULONG f=r; f < (1UL << GZ_FAST_BITS); f += (1UL << l))
+        hf->fast[f] = (UWORD)((hf->symbol[idx] << 4) | l);
+    }
+    code <<= 1;
+  }
+  return TRUE;
+}
+
+static void in_fill(struct GzIn *g) {
+  if (g->eof) return;
+  LONG n = g->rd(g->h, g->in, GZ_IN_BUF);
+  if (n < 0) { g->error = GZ_ERR_IO; n = 0; }
+  if (n == 0) g->eof = 1;
+  g->inPos = 0; g->inLen = (ULONG)n;
+}
+
+/* Refill so at least 'need' bits (<= 25) are buffered; past the end zeros
+ * are fed and flagged as overrun. */
+static void bits_need(struct GzIn *g, int need) {
+  while (g->bitCnt < need) {
+    ULONG b = 0;
+    if (g->inPos >= g->inLen) in_fill(g);
+    if (g->inPos < g->inLen) { b = g->in[g->inPos++]; g->inTotal++; }
+    else g->overrun++;
+    g->bitBuf |= b << g->bitCnt;
+    g->bitCnt += 8;
+  }
+}
+
+static ULONG bits_get(struct GzIn *g, int n) {
+  if (n == 0) return 0;
+  bits_need(g, n);
+  ULONG v = g->bitBuf & ((1UL << n) - 1);
+  g->bitBuf >>= n; g->bitCnt -= n;
+  return v;
+}
+
+static void bits_align(struct GzIn *g) {
+  int drop = g->bitCnt & 7;
+  g->bitBuf >>= drop; g->bitCnt -= drop;
+}
+
+static int huff_decode(struct GzIn *g, const struct GzHuff *hf) {
+  bits_need(g, GZ_FAST_BITS);
+  UWORD e = hf->fast[g->bitBuf & ((1UL << GZ_FAST_BITS) - 1)];
+  if (e) {
+    int l = e & 15;
+    g->bitBuf >>= l; g->bitCnt -= l;
+    return e >> 4;
+  }
+  /* Slow path: walk the canonical code one bit at a time */
+  LONG code = 0, first = 0, index = 0;
+  for (int l=1; l<16; ++l) {
+    code |= (LONG)bits_get(g, 1);
+    LONG count = hf->count[l];
+    if (code - count < first) return hf->symbol[index + (code - first)];
+    index += count; first += count;
+    first <<= 1; code <<= 1;
+  }
+  return -1;
+}
+
+static int read_dynamic(struct GzIn *g) {
+  UBYTE lens[320];
+  UBYTE cl[19];
+  int nlen  = (int)bits_get(g, 5) + 257;
+  int ndist = (int)bits_get(g, 5) + 1;
+  int ncode = (int)bits_get(g, 4) + 4;
+  if (nlen > 286 || ndist > 30) return GZ_ERR_DATA;
+
+  memset(cl, 0, sizeof(cl));
+  for (int i=0; i<ncode; ++i) cl[clOrder[i]] = (UBYTE)bits_get(g, 3);
+  if (!huff_build(&g->lit, cl, 19)) return GZ_ERR_DATA;
+
+  int i = 0;
+  while (i < nlen + ndist) {
+    int sym = huff_decode(g, &g->lit);
+    if (sym < 0) return GZ_ERR_DATA;
+    if (sym < 16) { lens[i++] = (UBYTE)sym; continue; }
+    UBYTE v = 0; int rep;
+    if (sym == 16) { if (i == 0) return GZ_ERR_DATA; v = lens[i-1]; rep = 3 + (int)bits_get(g, 2); }
+    else if (sym == 17) rep = 3  + (int)bits_get(g, 3);
+    else                rep = 11 + (int)bits_get(g, 7);
+    if (i + rep > nlen + ndist) return GZ_ERR_DATA;
+    while (rep--) lens[i++] = v;
+  }
+  if (lens[256] == 0) return GZ_ERR_DATA;
+  if (!huff_build(&g->lit, lens, nlen) || !huff_build(&g->dist, lens + nlen, ndist)) return GZ_ERR_DATA;
+  return GZ_OK;
+}
+
+static int read_header_byte(struct GzIn *g) {
+  if (g->inPos >= g->inLen) in_fill(g);
+  if (g->inPos >= g->inLen) return -1;
+  g->inTotal++;
+  return g->in[g->inPos++];
+}
+
+int gzin_open(struct GzIn *g, GzReadFn rd, void *h) {
+  memset(g, 0, sizeof(*g));
+  g->rd = rd; g->h = h;
+  g->crc = crc32_init();
+
+  int b[10];
+  for (int i=0; i<10; ++i) if ((b[i] = read_header_byte(g)) < 0) return g->error = GZ_ERR_DATA;
+  if (b[0] != 0x1F || b[1] != 0x8B || b[2] != 8) return g->error = GZ_ERR_DATA;
+  int flg = b[3];
+  if (flg & 4) {                                  /* FEXTRA */
+    int lo = read_header_byte(g), hi = read_header_byte(g);
+    if (lo < 0 || hi < 0) return g->error = GZ_ERR_DATA;
+    for (int n = lo | (hi << 8); n > 0; --n) if (read_header_byte(g) < 0) return g->error = GZ_ERR_DATA;
+  }
+  for (int f=8; f<=16; f<<=1) {                   /* FNAME, FCOMMENT */
+    if (!(flg & f)) continue;
+    int c;
+    do { c = read_header_byte(g); } while (c > 0);
+    if (c < 0) return g->error = GZ_ERR_DATA;
+  }
+  if (flg & 2) { read_header_byte(g); read_header_byte(g); }   /* FHCRC */
+  return g->error;
+}
+
+LONG gzin_read(struct GzIn *g, UBYTE *out, LONG len) {
+  LONG n = 0;
+  while (n < len && !g->error) {
+    if (g->matchLeft) {
+      UBYTE c = g->window[(g->wpos - g->matchDist) & (GZ_IN_WSIZE-1)];
+      g->window[g->wpos++ & (GZ_IN_WSIZE-1)] = c;
+      out[n++] = c;
+      g->matchLeft--;
+      continue;
+    }
+    if (g->done) break;
+
+    if (!g->inBlock) {
+      if (g->lastBlock) {
+        /* Trailer: CRC32 and length of the uncompressed data, little-endian */
+        bits_align(g);
+        ULONG v[2];
+        for (int k=0; k<2; ++k) {
+          ULONG lo = bits_get(g, 16), hi = bits_get(g, 16);
+          v[k] = lo | (hi << 16);
+        }
+        g->crc = crc32_update(g->crc, out, (ULONG)n);
+        g->total += (ULONG)n;
+        if (g->overrun) g->error = GZ_ERR_DATA;
+        else if (v[0] != crc32_final(g->crc) || v[1] != g->total) g->error = GZ_ERR_CRC;
+        g->done = 1;
+        return g->error ? g->error : n;
+      }
+      g->lastBlock = (int)bits_get(g, 1);
+      g->type      = (int)bits_get(g, 2);
+      if (g->type == 0) {
+        bits_align(g);
+        ULONG l = bits_get(g, 16), nl = bits_get(g, 16);
+        if ((l ^ 0xFFFF) != nl) { g->error = GZ_ERR_DATA; break; }
+        g->storedLeft = l;
+      } else if (g->type == 1) {
+        /* Fixed codes: 32 five-bit distances make the code complete, 30/31 never occur */
+        UBYTE lit[288], dist[32];
+        fixed_lengths(lit, dist);
+        dist[30] = dist[31] = 5;
+        huff_build(&g->lit, lit, 288);
+        huff_build(&g->dist, dist, 32);
+      } else if (g->type == 2) {
+        int rc = read_dynamic(g);
+        if (rc) { g->error = rc; break; }
+      } else { g->error = GZ_ERR_DATA; break; }
+      g->inBlock = 1;
+    }
+
+    if (g->type == 0) {
+      if (g->storedLeft == 0) { g->inBlock = 0; continue; }
+      UBYTE c = (UBYTE)bits_get(g, 8);
+      g->window[g->wpos++ & (GZ_IN_WSIZE-1)] = c;
+      out[n++] = c;
+      g->storedLeft--;
+      continue;
+    }
+
+    int sym = huff_decode(g, &g->lit);
+    if (sym < 0 || g->overrun > 4) { g->error = GZ_ERR_DATA; break; }
+    if (sym < 256) {
+      g->window[g->wpos++ & (GZ_IN_WSIZE-1)] = (UBYTE)sym;
+      out[n++] = (UBYTE)sym;
+    } else if (sym == 256) {
+      g->inBlock = 0;
+    } else {
+      sym -= 257;
+      if (sym >= 29) { g->error = GZ_ERR_DATA; break; }
+      ULONG l = lenBase[sym] + bits_get(g, lenExtra[sym]);
+      int ds = huff_decode(g, &g->dist);
+      if (ds < 0 || ds >= 30) { g->error = GZ_ERR_DATA; break; }
+      ULONG d = distBase[ds] + bits_get(g, distExtra[ds]);
+      if (d > g->total + (ULONG)n || d > GZ_IN_WSIZE) { g->error = GZ_ERR_DATA; break; }
+      g->matchLeft = l; g->matchDist = d;
+    }
+  }
+
+  if (g->error) return g->error;
+  g->crc = crc32_update(g->crc, out, (ULONG)n);
+  g->total += (ULONG)n;
+  return n;
+}
+
+/* ========================= DEFLATE ========================= */
+
+static UBYTE lenCode[256];                  /* match length - 3 -> code 0..28 */
+static UBYTE distCodeLo[256];               /* dist - 1 < 256 */
+static UBYTE distCodeHi[256];               /* (dist - 1) >> 7 */
+static BOOL  tablesReady = FALSE;
+
+static void deflate_tables(void) {
+  if (tablesReady) return;
+  for (int c=0; c<29; ++c)
+    for (int l=lenBase[c]; l < (c == 28 ? 259 : lenBase[c+1]); ++l) lenCode[l-3] = (UBYTE)c;
+  lenCode[255] = 28;
+  for (int c=0; c<30; ++c) {
+    ULONG lo = distBase[c] - 1, hi = lo + (1UL << distExtra[c]);
+    for (ULONG d=lo; d<hi; ++d) {
+      if (d < 256) distCodeLo[d] = (UBYTE)c;
+      else         distCodeHi[d >> 7] = (UBYTE)c;
+    }
+  }
+  tablesReady = TRUE;
+}
+
+static int dist_code(ULONG d) { return (d <= 256) ? distCodeLo[d-1] : distCodeHi[(d-1) >> 7]; }
+
+static void out_flush(struct GzOut *g) {
+  if (g->outLen && !g->error) {
+    if (g->wr(g->h, g->out, (LONG)g->outLen) != (LONG)g->outLen) g->error = GZ_ERR_IO;
+    g->outTotal += g->outLen;
+  }
+  g->outLen = 0;
+}
+
+static void put_bits(struct GzOut *g, ULONG v, int n) {
+  g->bitBuf |= v << g->bitCnt;
+  g->bitCnt += n;
+  while (g->bitCnt >= 8) {
+    if (g->outLen == GZ_OUT_BUF) out_flush(g);
+    g->out[g->outLen++] = (UBYTE)g->bitBuf;
+    g->bitBuf >>= 8; g->bitCnt -= 8;
+  }
+}
+
+static void put_byte(struct GzOut *g, UBYTE b) {
+  if (g->outLen == GZ_OUT_BUF) out_flush(g);
+  g->out[g->outLen++] = b;
+}
+
+/* Huffman code lengths (limited to maxBits) for freq[0..n) */
+static void build_lengths(const ULONG *freq, int n, int maxBits, UBYTE *len) {
+  ULONG nf[2*288];                          /* node frequencies */
+  UWORD parent[2*288];
+  UWORD heap[288];
+  UWORD depth[2*288];
+  UWORD order[288];
+  UWORD blCount[2*288];
+  int hn = 0, nodes = n;
+
+  memset(len, 0, (size_t)n);
+  for (int i=0; i<n; ++i) {
+    nf[i] = freq[i];
+    if (!freq[i]) continue;
+    /* sift up */
+    int k = hn++;
+    while (k > 0 && nf[heap[(k-1)/2]] > nf[i]) { heap[k] = heap[(k-1)/2]; k = (k-1)/2; }
+    heap[k] = (UWORD)i;
+  }
+  if (hn == 0) return;
+  if (hn == 1) { len[heap[0]] = 1; return; }
+
+  int leaves = hn;
+  while (hn > 1) {
+    UWORD a = 0, b = 0;
+    for (int pick=0; pick<2; ++pick) {
+      UWORD top = heap[0];
+      UWORD last = heap[--hn];
+      int k = 0;
+      for (;;) {
+        int c = 2*k + 1;
+        if (c >= hn) break;
+        if (c + 1 < hn && nf[heap[c+1]] < nf[heap[c]]) c++;
+        if (nf[heap[c]] >= nf[last]) break;
+        heap[k] = heap[c]; k = c;
+      }
+      if (hn) heap[k] = last;
+      if (pick == 0) a = top; else b = top;
+    }
+    UWORD m = (UWORD)nodes++;
+    nf[m] = nf[a] + nf[b];
+    parent[a] = parent[b] = m;
+    int k = hn++;
+    while (k > 0 && nf[heap[(k-1)/2]] > nf[m]) { heap[k] = heap[(k-1)/2]; k = (k-1)/2; }
+    heap[k] = m;
+  }
+
+  /* Depths top-down: internal nodes were created in increasing order */
+  UWORD root = (UWORD)(nodes - 1);
+  depth[root] = 0;
+  for (int i=nodes-2; i>=n; --i) depth[i] = depth[parent[i]] + 1;
+  memset(blCount, 0, sizeof(blCount));
+  int maxLen = 0;
+  for (int i=0; i<n; ++i) if (freq[i]) {
+    int d = depth[parent[i]] + 1;
+    blCount[d]++;
+    if (d > maxLen) maxLen = d;
+  }
+
+  /* Limit lengths (JPEG Annex K.3 style): move pairs of deepest leaves up */
+  for (int i=maxLen; i>maxBits; --i) {
+    while (blCount[i] > 0) {
+      int j = i - 2;
+      while (blCount[j] == 0) j--;
+      blCount[i] -= 2;
+      blCount[i-1] += 1;
+      blCount[j+1] += 2;
+      blCount[j]   -= 1;
+    }
+  }
+
+  /* Hand out lengths: most frequent symbols get the shortest codes */
+  int cnt = 0;
+  for (int i=0; i<n; ++i) if (freq[i]) order[cnt++] = (UWORD)i;
+  for (int i=1; i<cnt; ++i) {
+    UWORD v = order[i]; int j = i;
+    while (j > 0 && freq[order[j-1]] < freq[v]) { order[j] = order[j-1]; j--; }
+    order[j] = v;
+  }
+  int k = 0;
+  for (int l=1; l<=maxBits && k<leaves; ++l)
+    for (int c=0; c<blCount[l]; ++c) len[order[k++]] = (UBYTE)l;
+}
+
+/* Canonical codes, bit-reversed for LSB-first output */
+static void build_codes(const UBYTE *len, int n, UWORD *code) {
+  UWORD blCount[16], next[16];
+  memset(blCount, 0, sizeof(blCount));
+  for (int i=0; i<n; ++i) blCount[len[i]]++;
+  blCount[0] = 0;
+  ULONG c = 0;
+  for (int l=1; l<16; ++l) { c = (c + blCount[l-1]) << 1; next[l] = (UWORD)c; }
+  for (int i=0; i<n; ++i) if (len[i]) code[i] = (UWORD)bit_reverse(next[len[i]]++, len[i]);
+}
+
+/* Code-length sequence with run-length symbols 16/17/18; returns entries */
+static int rle_lengths(const UBYTE *lens, int n, UBYTE *sym, UBYTE *extra) {
+  int out = 0;
+  for (int i=0; i<n; ) {
+    UBYTE v = lens[i];
+    int run = 1;
+    while (i + run < n && lens[i+run] == v) run++;
+    if (v == 0 && run >= 3) {
+      int r = run > 138 ? 138 : run;
+      if (r >= 11) { sym[out] = 18; extra[out++] = (UBYTE)(r - 11); }
+      else         { sym[out] = 17; extra[out++] = (UBYTE)(r - 3); }
+      i += r;
+    } else if (v != 0 && run >= 4) {
+      sym[out] = v; extra[out++] = 0;
+      int r = run - 1; if (r > 6) r = 6;
+      sym[out] = 16; extra[out++] = (UBYTE)(r - 3);
+      i += 1 + r;
+    } else {
+      sym[out] = v; extra[out++] = 0;
+      i++;
+    }
+  }
+  return out;
+}
+
+/* Emits the pending symbols, which encode win[blockStart..end) */
+static void flush_block(struct GzOut *g, ULONG end, int last) {
+  ULONG fl[286], fd[30];
+  UBYTE ll[288], dl[30], fll[288], fdl[30];
+  UWORD lc[288], dc[30];
+  memset(fl, 0, sizeof(fl)); memset(fd, 0, sizeof(fd));
+
+  for (ULONG i=0; i<g->nSym; ++i) {
+    if (g->symDist[i] == 0) fl[g->symLit[i]]++;
+    else { fl[257 + lenCode[g->symLit[i]]]++; fd[dist_code(g->symDist[i])]++; }
+  }
+  fl[256] = 1;
+
+  /* Cost of the symbols with fixed codes */
+  fixed_lengths(fll, fdl);
+  ULONG fixedBits = 3, dynBits = 3;
+  for (int i=0; i<286; ++i) fixedBits += fl[i] * fll[i];
+  for (int i=0; i<29; ++i)  fixedBits += fl[257+i] * lenExtra[i];
+  for (int i=0; i<30; ++i)  fixedBits += fd[i] * (5 + distExtra[i]);
+
+  /* Dynamic codes */
+  int hasDist = 0;
+  for (int i=0; i<30; ++i) if (fd[i]) hasDist = 1;
+  if (!hasDist) fd[0] = 1;                  /* one unused code keeps inflaters happy */
+  build_lengths(fl, 286, 15, ll);
+  build_lengths(fd, 30, 15, dl);
+  if (!hasDist) fd[0] = 0;
+
+  int nlen = 286;  while (nlen > 257 && ll[nlen-1] == 0) nlen--;
+  int ndist = 30;  while (ndist > 1 && dl[ndist-1] == 0) ndist--;
+  UBYTE all[286+30], rs[286+30], rx[286+30];
+  memcpy(all, ll, (size_t)nlen); memcpy(all + nlen, dl, (size_t)ndist);
+  int nrs = rle_lengths(all, nlen + ndist, rs, rx);
+  ULONG fc[19]; UBYTE cl[19]; UWORD cc[19];
+  memset(fc, 0, sizeof(fc));
+  for (int i=0; i<nrs; ++i) fc[rs[i]]++;
+  build_lengths(fc, 19, 7, cl);
+  int ncode = 19; while (ncode > 4 && cl[clOrder[ncode-1]] == 0) ncode--;
+
+  dynBits += 5 + 5 + 4 + 3 * (ULONG)ncode;
+  for (int i=0; i<nrs; ++i) dynBits += cl[rs[i]] + (rs[i] == 16 ? 2 : rs[i] == 17 ? 3 : rs[i] == 18 ? 7 : 0);
+  for (int i=0; i<286; ++i) dynBits += fl[i] * ll[i];
+  for (int i=0; i<29; ++i)  dynBits += fl[257+i] * lenExtra[i];
+  for (int i=0; i<30; ++i)  dynBits += fd[i] * (dl[i] + distExtra[i]);
+
+  /* Incompressible data (crunched tracks): stored block, no expansion */
+  ULONG raw = end - g->blockStart;
+  ULONG storedBits = 3 + 7 + 32 + 8 * raw;
+  if (g->nSym > 0 && storedBits < fixedBits && storedBits < dynBits) {
+    put_bits(g, (ULONG)last, 1);
+    put_bits(g, 0, 2);
+    put_bits(g, 0, 7);                      /* pad to a byte boundary */
+    g->bitCnt = 0; g->bitBuf = 0;
+    put_bits(g, raw, 16);
+    put_bits(g, raw ^ 0xFFFF, 16);
+    for (ULONG i=g->blockStart; i<end; ++i) put_byte(g, g->win[i]);
+    g->nSym = 0;
+    g->blockStart = end;
+    return;
+  }
+
+  BOOL dynamic = (g->nSym > 0 && dynBits < fixedBits);
+  put_bits(g, (ULONG)last, 1);
+  if (dynamic) {
+    put_bits(g, 2, 2);
+    put_bits(g, (ULONG)(nlen - 257), 5);
+    put_bits(g, (ULONG)(ndist - 1), 5);
+    put_bits(g, (ULONG)(ncode - 4), 4);
+    for (int i=0; i<ncode; ++i) put_bits(g, cl[clOrder[i]], 3);
+    build_codes(cl, 19, cc);
+    for (int i=0; i<nrs; ++i) {
+      put_bits(g, cc[rs[i]], cl[rs[i]]);
+      if (rs[i] == 16) put_bits(g, rx[i], 2);
+      else if (rs[i] == 17) put_bits(g, rx[i], 3);
+      else if (rs[i] == 18) put_bits(g, rx[i], 7);
+    }
+  } else {
+    put_bits(g, 1, 2);
+    memcpy(ll, fll, sizeof(fll));
+    memcpy(dl, fdl, sizeof(fdl));
+  }
+  build_codes(ll, dynamic ? 286 : 288, lc);
+  build_codes(dl, 30, dc);
+
+  for (ULONG i=0; i<g->nSym; ++i) {
+    if (g->symDist[i] == 0) { put_bits(g, lc[g->symLit[i]], ll[g->symLit[i]]); continue; }
+    int c = lenCode[g->symLit[i]];
+    put_bits(g, lc[257+c], ll[257+c]);
+    put_bits(g, (ULONG)(g->symLit[i] + 3 - lenBase[c]), lenExtra[c]);
+    ULONG d = g->symDist[i];
+    int dcode = dist_code(d);
+    put_bits(g, dc[dcode], dl[dcode]);
+    put_bits(g, d - distBase[dcode], distExtra[dcode]);
+  }
+  put_bits(g, lc[256], ll[256]);
+  g->nSym = 0;
+  g->blockStart = end;
+}
+
+static ULONG hash3(const UBYTE *p) {
+  return (((ULONG)p[0] << 10) ^ ((ULONG)p[1] << 5) ^ p[2]) & ((1UL << GZ_HASH_BITS) - 1);
+}
+
+static void hash_insert(struct GzOut *g, ULONG pos) {
+  ULONG h = hash3(g->win + pos);
+  g->prev[pos & (GZ_WSIZE-1)] = g->head[h];
+  g->head[h] = (UWORD)(pos + 1);
+}
+
+/* Encodes win[from..winLen) completely (matches never cross the end) */
+static void deflate_range(struct GzOut *g, ULONG pos) {
+  const ULONG end = g->winLen;
+  while (pos < end) {
+    ULONG bestLen = 0, bestDist = 0;
+    ULONG avail = end - pos; if (avail > 258) avail = 258;
+
+    if (avail >= 3) {
+      const UBYTE *cur = g->win + pos;
+      ULONG cand = g->head[hash3(cur)];
+      int chain = g->maxChain;
+      while (cand && chain-- > 0) {
+        ULONG cp = cand - 1;
+        if (cp >= pos || pos - cp > GZ_WSIZE) break;
+        const UBYTE *m = g->win + cp;
+        if (m[bestLen] == cur[bestLen] && m[0] == cur[0] && m[1] == cur[1]) {
+          ULONG l = 2;
+          while (l < avail && m[l] == cur[l]) l++;
+          if (l > bestLen) { bestLen = l; bestDist = pos - cp; if (l >= (ULONG)g->niceLen) break; }
+        }
+        cand = g->prev[cp & (GZ_WSIZE-1)];
+      }
+      hash_insert(g, pos);
+    }
+
+    if (bestLen >= 3) {
+      g->symLit[g->nSym]  = (UBYTE)(bestLen - 3);
+      g->symDist[g->nSym] = (UWORD)bestDist;
+      for (ULONG k=1; k<bestLen; ++k) if (pos + k + 3 <= end) hash_insert(g, pos + k);
+      pos += bestLen;
+    } else {
+      g->symLit[g->nSym]  = g->win[pos];
+      g->symDist[g->nSym] = 0;
+      pos++;
+    }
+    if (++g->nSym == GZ_SYM_MAX) flush_block(g, pos, 0);
+  }
+}
+
+int gzout_open(struct GzOut *g, GzWriteFn wr, void *h, int level) {
+  static const UWORD chains[10] = { 4, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+  static const UWORD nices[10]  = { 16, 16, 32, 64, 128, 258, 258, 258, 258, 258 };
+  deflate_tables();
+  memset(g, 0, sizeof(*g));
+  g->wr = wr; g->h = h;
+  if (level < 1) level = 1;
+  if (level > 9) level = 9;
+  g->maxChain = chains[level];
+  g->niceLen  = nices[level];
+  g->crc = crc32_init();
+
+  static const UBYTE hdr[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+  for (int i=0; i<10; ++i) put_byte(g, hdr[i]);
+  return g->error;
+}
+
+int gzout_write(struct GzOut *g, const UBYTE *buf, ULONG len) {
+  g->crc = crc32_update(g->crc, buf, len);
+  g->total += len;
+  while (len && !g->error) {
+    ULONG n = len > GZ_WSIZE ? GZ_WSIZE : len;
+    if (g->winLen + n > 2 * GZ_WSIZE) {
+      /* Slide by exactly GZ_WSIZE so prev[] indexing stays valid; a block
+         that started in the dropped half is flushed first (stored needs it) */
+      if (g->nSym && g->blockStart < GZ_WSIZE) flush_block(g, g->winLen, 0);
+      g->blockStart -= GZ_WSIZE;
+      memmove(g->win, g->win + GZ_WSIZE, g->winLen - GZ_WSIZE);
+      g->winLen -= GZ_WSIZE;
+      for (ULONG i=0; i<(1UL << GZ_HASH_BITS); ++i) g->head[i] = g->head[i] > GZ_WSIZE ? (UWORD)(g->head[i] - GZ_WSIZE) : 0;
+      for (ULONG i=0; i<GZ_WSIZE; ++i)             g->prev[i] = g->prev[i] > GZ_WSIZE ? (UWORD)(g->prev[i] - GZ_WSIZE) : 0;
+    }
+    ULONG from = g->winLen;
+    memcpy(g->win + g->winLen, buf, n);
+    g->winLen += n;
+    deflate_range(g, from);
+    buf += n; len -= n;
+  }
+  return g->error;
+}
+
+int gzout_close(struct GzOut *g) {
+  flush_block(g, g->winLen, 1);
+  put_bits(g, 0, 7);                        /* pad to a byte boundary */
+  g->bitCnt = 0; g->bitBuf = 0;
+  ULONG crc = crc32_final(g->crc);
+  for (int i=0; i<4; ++i) put_byte(g, (UBYTE)(crc >> (8*i)));
+  for (int i=0; i<4; ++i) put_byte(g, (UBYTE)(g->total >> (8*i)));
+  out_flush(g);
+  return g->error;
+}
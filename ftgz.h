@@ -0,0 +1,98 @@
+/*
+ * ftgz.h - streaming gzip (.adz) reader/writer for FloppyTool and the
+ * host tools. Self-contained deflate/inflate: no zlib, no allocation;
+ * the caller owns the state structs (AllocVec on Amiga, malloc on host)
+ * and supplies the byte I/O callbacks.
+ *
+ * Memory: GzIn ~36 KB (32 KB window, decodes any gzip file),
+ *         GzOut ~100 KB (16 KB deflate window).
+ */
+#ifndef FTGZ_H
+#define FTGZ_H
+
+#include "ftport.h"
+
+#define GZ_OK         0
+#define GZ_ERR_IO    -1
+#define GZ_ERR_DATA  -2                /* not gzip / corrupt stream */
+#define GZ_ERR_CRC   -3                /* trailer CRC32 or length mismatch */
+
+/* Return bytes transferred; < 0 on error (read: 0 = end of input) */
+typedef LONG (*GzReadFn)(void *handle, UBYTE *buf, LONG len);
+typedef LONG (*GzWriteFn)(void *handle, const UBYTE *buf, LONG len);
+
+/* ----- Inflate ----- */
+
+#define GZ_IN_BUF     4096
+#define GZ_IN_WSIZE   32768
+#define GZ_FAST_BITS  9
+
+struct GzHuff {
+  UWORD count[16];                     /* codes per bit length */
+  UWORD symbol[288];                   /* symbols in canonical order */
+  UWORD fast[1 << GZ_FAST_BITS];       /* (sym << 4) | len, 0 = longer code */
+};
+
+struct GzIn {
+  GzReadFn rd;
+  void    *h;
+  UBYTE    in[GZ_IN_BUF];
+  ULONG    inPos, inLen;
+  ULONG    inTotal;                    /* compressed bytes consumed so far */
+  ULONG    bitBuf;
+  int      bitCnt;
+  int      eof, overrun;
+
+  UBYTE    window[GZ_IN_WSIZE];
+  ULONG    wpos;
+
+  int      inBlock, lastBlock, type;
+  ULONG    storedLeft;
+  ULONG    matchLeft, matchDist;
+  struct GzHuff lit, dist;
+
+  ULONG    crc, total;                 /* of the uncompressed data */
+  int      done, error;
+};
+
+int  gzin_open(struct GzIn *g, GzReadFn rd, void *h);     /* parses the gzip header */
+LONG gzin_read(struct GzIn *g, UBYTE *out, LONG len);     /* 0 = end (trailer verified) */
+
+/* ----- Deflate ----- */
+
+#define GZ_WBITS      14
+#define GZ_WSIZE      (1 << GZ_WBITS)
+#define GZ_HASH_BITS  13
+#define GZ_SYM_MAX    4096             /* symbols per deflate block */
+#define GZ_OUT_BUF    4096
+
+struct GzOut {
+  GzWriteFn wr;
+  void     *h;
+  UBYTE     win[2 * GZ_WSIZE];
+  ULONG     winLen;
+  ULONG     blockStart;                /* window offset of the pending block */
+  UWORD     head[1 << GZ_HASH_BITS];   /* window position + 1, 0 = empty */
+  UWORD     prev[GZ_WSIZE];
+  int       maxChain, niceLen;
+
+  UBYTE     symLit[GZ_SYM_MAX];        /* literal, or match length - 3 */
+  UWORD     symDist[GZ_SYM_MAX];       /* 0 = literal */
+  ULONG     nSym;
+
+  UBYTE     out[GZ_OUT_BUF];
+  ULONG     outLen;
+  ULONG     bitBuf;
+  int       bitCnt;
+
+  ULONG     crc, total;
+  ULONG     outTotal;                  /* compressed bytes written so far */
+  int       error;
+};
+
+/* level 1 (fast) .. 9 (best); writes the gzip header */
+int  gzout_open(struct GzOut *g, GzWriteFn wr, void *h, int level);
+int  gzout_write(struct GzOut *g, const UBYTE *buf, ULONG len);
+int  gzout_close(struct GzOut *g);     /* final block + trailer */
+
+#endif
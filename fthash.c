@@ -0,0 +1,242 @@
+/*
+ * fthash.c - portable hashes (see fthash.h). No allocation, no OS calls.
+ */
+#include <string.h>
+#include "fthash.h"
+#include "ftkern.h"
+
+/* ----- CRC32 ----- */
+
+ULONG crc32_init(void) { return 0xFFFFFFFFUL; }
+
+/* Table-driven loop picked for the CPU, see ftkern.h */
+ULONG crc32_update(ULONG crc, const UBYTE *buf, ULONG len) {
+  return kern_get()->crc(crc, buf, len);
+}
+
+ULONG crc32_final(ULONG crc) { return crc ^ 0xFFFFFFFFUL; }
+
+/* ----- Block buffering shared by MD5 and SHA-1 ----- */
+
+#define ROL32(x,n) ((((x) << (n)) | ((x) >> (32-(n)))) & 0xFFFFFFFFUL)
+
+static void block_feed(ULONG *lenLo, ULONG *lenHi, UBYTE *buf, ULONG *used,
+                       const UBYTE *data, ULONG len, void (*block)(ULONG *h, const UBYTE *p), ULONG *h) {
+  ULONG lo = (*lenLo + len) & 0xFFFFFFFFUL;
+  if (lo < *lenLo) (*lenHi)++;
+  *lenLo = lo;
+
+  if (*used) {
+    ULONG n = 64 - *used; if (n > len) n = len;
+    memcpy(buf + *used, data, n);
+    *used += n; data += n; len -= n;
+    if (*used < 64) return;
+    block(h, buf);
+    *used = 0;
+  }
+  while (len >= 64) { block(h, data); data += 64; len -= 64; }
+  if (len) { memcpy(buf, data, len); *used = len; }
+}
+
+/* 0x80, zeros, 64-bit bit length; big-endian for SHA-1, little for MD5 */
+static ULONG block_pad(UBYTE pad[72], ULONG used, ULONG lenLo, ULONG lenHi, BOOL bigEndian) {
+  ULONG hi = (lenHi << 3) | (lenLo >> 29);
+  ULONG lo = (lenLo << 3) & 0xFFFFFFFFUL;
+  ULONG n = (used < 56) ? 56 - used : 120 - used;
+  memset(pad, 0, 72);
+  pad[0] = 0x80;
+  for (int i=0; i<4; ++i) {
+    if (bigEndian) { pad[n+i] = (UBYTE)(hi >> (24 - 8*i)); pad[n+4+i] = (UBYTE)(lo >> (24 - 8*i)); }
+    else           { pad[n+i] = (UBYTE)(lo >> (8*i));      pad[n+4+i] = (UBYTE)(hi >> (8*i)); }
+  }
+  return n + 8;
+}
+
+/* ----- MD5 (RFC 1321) ----- */
+
+static const ULONG KMD5[64] = {
+  0xd76aa478UL,0xe8c7b756UL,0x242070dbUL,0xc1bdceeeUL,0xf57c0fafUL,0x4787c62aUL,0xa8304613UL,0xfd469501UL,
+  0x698098d8UL,0x8b44f7afUL,0xffff5bb1UL,0x895cd7beUL,0x6b901122UL,0xfd987193UL,0xa679438eUL,0x49b40821UL,
+  0xf61e2562UL,0xc040b340UL,0x265e5a51UL,0xe9b6c7aaUL,0xd62f105dUL,0x02441453UL,0xd8a1e681UL,0xe7d3fbc8UL,
+  0x21e1cde6UL,0xc33707d6UL,0xf4d50d87UL,0x455a14edUL,0xa9e3e905UL,0xfcefa3f8UL,0x676f02d9UL,0x8d2a4c8aUL,
+  0xfffa3942UL,0x8771f681UL,0x6d9d6122UL,0xfde5380cUL,0xa4beea44UL,0x4bdecfa9UL,0xf6bb4b60UL,0xbebfbc70UL,
+  0x289b7ec6UL,0xeaa127faUL,0xd4ef3085UL,0x04881d05UL,0xd9d4d039UL,0xe6db99e5UL,0x1fa27cf8UL,0xc4ac5665UL,
+  0xf4292244UL,0x432aff97UL,0xab9423a7UL,0xfc93a039UL,0x655b59c3UL,0x8f0ccc92UL,0xffeff47dUL,0x85845dd1UL,
+  0x6fa87e4fUL,0xfe2ce6e0UL,0xa3014314UL,0x4e0811a1UL,0xf7537e82UL,0xbd3af235UL,0x2ad7d2bbUL,0xeb86d391UL
+};
+static const UBYTE RMD5[16] = { 7,12,17,22, 5,9,14,20, 4,11,16,23, 6,10,15,21 };
+
+static void md5_block(ULONG *h, const UBYTE *p) {
+  ULONG w[16];
+  for (int i=0; i<16; ++i)
+    w[i] = (ULONG)p[4*i] | ((ULONG)p[4*i+1] << 8) | ((ULONG)p[4*i+2] << 16) | ((ULONG)p[4*i+3] << 24);
+
+  /* One loop per round function: no branching inside the rounds */
+  ULONG a=h[0], b=h[1], c=h[2], d=h[3], t, x;
+#define MD5_STEP(f, g) \
+    x = (a + (f) + KMD5[i] + w[g]) & 0xFFFFFFFFUL; \
+    t = d; d = c; c = b; b = (b + ROL32(x, RMD5[((i >> 4) << 2) | (i & 3)])) & 0xFFFFFFFFUL; a = t;
+  int i;
+  for (i=0;  i<16; ++i) { MD5_STEP(d ^ (b & (c ^ d)),            i) }
+  for (;     i<32; ++i) { MD5_STEP(c ^ (d & (b ^ c)),            (5*i + 1) & 15) }
+  for (;     i<48; ++i) { MD5_STEP(b ^ c ^ d,                    (3*i + 5) & 15) }
+  for (;     i<64; ++i) { MD5_STEP(c ^ ((b | ~d) & 0xFFFFFFFFUL), (7*i) & 15) }
+#undef MD5_STEP
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+}
+
+void md5_init(struct Md5 *s) {
+  s->h[0] = 0x67452301UL; s->h[1] = 0xefcdab89UL; s->h[2] = 0x98badcfeUL; s->h[3] = 0x10325476UL;
+  s->lenLo = s->lenHi = 0;
+  s->used = 0;
+}
+
+void md5_update(struct Md5 *s, const UBYTE *data, ULONG len) {
+  block_feed(&s->lenLo, &s->lenHi, s->buf, &s->used, data, len, md5_block, s->h);
+}
+
+void md5_final(struct Md5 *s, UBYTE out[MD5_LEN]) {
+  UBYTE pad[72];
+  ULONG n = block_pad(pad, s->used, s->lenLo, s->lenHi, FALSE);
+  md5_update(s, pad, n);
+  for (int i=0; i<4; ++i) {
+    out[4*i]   = (UBYTE)s->h[i];         out[4*i+1] = (UBYTE)(s->h[i] >> 8);
+    out[4*i+2] = (UBYTE)(s->h[i] >> 16); out[4*i+3] = (UBYTE)(s->h[i] >> 24);
+  }
+}
+
+/* ----- SHA-1 (FIPS 180-4) ----- */
+
+static void sha1_block(ULONG *h, const UBYTE *p) {
+  ULONG w[80];
+  for (int i=0; i<16; ++i)
+    w[i] = ((ULONG)p[4*i] << 24) | ((ULONG)p[4*i+1] << 16) | ((ULONG)p[4*i+2] << 8) | p[4*i+3];
+  for (int i=16; i<80; ++i) w[i] = ROL32(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+
+  /* One loop per round function: no branching inside the rounds */
+  ULONG a=h[0], b=h[1], c=h[2], d=h[3], e=h[4], t;
+#define SHA1_STEP(f, k) \
+    t = (ROL32(a, 5) + (f) + e + (k) + w[i]) & 0xFFFFFFFFUL; \
+    e = d; d = c; c = ROL32(b, 30); b = a; a = t;
+  int i;
+  for (i=0;  i<20; ++i) { SHA1_STEP(d ^ (b & (c ^ d)),       0x5a827999UL) }
+  for (;     i<40; ++i) { SHA1_STEP(b ^ c ^ d,               0x6ed9eba1UL) }
+  for (;     i<60; ++i) { SHA1_STEP((b & c) | (d & (b | c)), 0x8f1bbcdcUL) }
+  for (;     i<80; ++i) { SHA1_STEP(b ^ c ^ d,               0xca62c1d6UL) }
+#undef SHA1_STEP
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+void sha1_init(struct Sha1 *s) {
+  s->h[0] = 0x67452301UL; s->h[1] = 0xefcdab89UL; s->h[2] = 0x98badcfeUL; s->h[3] = 0x10325476UL;
+  s->h[4] = 0xc3d2e1f0UL;
+  s->lenLo = s->lenHi = 0;
+  s->used = 0;
+}
+
+void sha1_update(struct Sha1 *s, const UBYTE *data, ULONG len) {
+  block_feed(&s->lenLo, &s->lenHi, s->buf, &s->used, data, len, sha1_block, s->h);
+}
+
+void sha1_final(struct Sha1 *s, UBYTE out[SHA1_LEN]) {
+  UBYTE pad[72];
+  ULONG n = block_pad(pad, s->used, s->lenLo, s->lenHi, TRUE);
+  sha1_update(s, pad, n);
+  for (int i=0; i<5; ++i) {
+    out[4*i]   = (UBYTE)(s->h[i] >> 24); out[4*i+1] = (UBYTE)(s->h[i] >> 16);
+    out[4*i+2] = (UBYTE)(s->h[i] >> 8);  out[4*i+3] = (UBYTE)s->h[i];
+  }
+}
+
+/* ----- SHA-256 (FIPS 180-4) ----- */
+
+static const ULONG K256[64] = {
+  0x428a2f98UL,0x71374491UL,0xb5c0fbcfUL,0xe9b5dba5UL,0x3956c25bUL,0x59f111f1UL,0x923f82a4UL,0xab1c5ed5UL,
+  0xd807aa98UL,0x12835b01UL,0x243185beUL,0x550c7dc3UL,0x72be5d74UL,0x80deb1feUL,0x9bdc06a7UL,0xc19bf174UL,
+  0xe49b69c1UL,0xefbe4786UL,0x0fc19dc6UL,0x240ca1ccUL,0x2de92c6fUL,0x4a7484aaUL,0x5cb0a9dcUL,0x76f988daUL,
+  0x983e5152UL,0xa831c66dUL,0xb00327c8UL,0xbf597fc7UL,0xc6e00bf3UL,0xd5a79147UL,0x06ca6351UL,0x14292967UL,
+  0x27b70a85UL,0x2e1b2138UL,0x4d2c6dfcUL,0x53380d13UL,0x650a7354UL,0x766a0abbUL,0x81c2c92eUL,0x92722c85UL,
+  0xa2bfe8a1UL,0xa81a664bUL,0xc24b8b70UL,0xc76c51a3UL,0xd192e819UL,0xd6990624UL,0xf40e3585UL,0x106aa070UL,
+  0x19a4c116UL,0x1e376c08UL,0x2748774cUL,0x34b0bcb5UL,0x391c0cb3UL,0x4ed8aa4aUL,0x5b9cca4fUL,0x682e6ff3UL,
+  0x748f82eeUL,0x78a5636fUL,0x84c87814UL,0x8cc70208UL,0x90befffaUL,0xa4506cebUL,0xbef9a3f7UL,0xc67178f2UL
+};
+
+#define ROR32(x,n) ((((x) >> (n)) | ((x) << (32-(n)))) & 0xFFFFFFFFUL)
+
+static void sha256_block(struct Sha256 *s, const UBYTE *p) {
+  ULONG w[64];
+  for (int i=0; i<16; ++i)
+    w[i] = ((ULONG)p[4*i] << 24) | ((ULONG)p[4*i+1] << 16) | ((ULONG)p[4*i+2] << 8) | p[4*i+3];
+  for (int i=16; i<64; ++i) {
+    ULONG s0 = ROR32(w[i-15], 7) ^ ROR32(w[i-15], 18) ^ (w[i-15] >> 3);
+    ULONG s1 = ROR32(w[i-2], 17) ^ ROR32(w[i-2], 19)  ^ (w[i-2] >> 10);
+    w[i] = (w[i-16] + s0 + w[i-7] + s1) & 0xFFFFFFFFUL;
+  }
+
+  ULONG a=s->h[0], b=s->h[1], c=s->h[2], d=s->h[3], e=s->h[4], f=s->h[5], g=s->h[6], h=s->h[7];
+  for (int i=0; i<64; ++i) {
+    ULONG t1 = h + (ROR32(e,6) ^ ROR32(e,11) ^ ROR32(e,25)) + ((e & f) ^ (~e & g)) + K256[i] + w[i];
+    ULONG t2 = (ROR32(a,2) ^ ROR32(a,13) ^ ROR32(a,22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = (d + t1) & 0xFFFFFFFFUL;
+    d = c; c = b; b = a; a = (t1 + t2) & 0xFFFFFFFFUL;
+  }
+  s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d;
+  s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
+}
+
+void sha256_init(struct Sha256 *s) {
+  static const ULONG iv[8] = {
+    0x6a09e667UL,0xbb67ae85UL,0x3c6ef372UL,0xa54ff53aUL,0x510e527fUL,0x9b05688cUL,0x1f83d9abUL,0x5be0cd19UL
+  };
+  memcpy(s->h, iv, sizeof(iv));
+  s->lenLo = s->lenHi = 0;
+  s->used = 0;
+}
+
+void sha256_update(struct Sha256 *s, const UBYTE *data, ULONG len) {
+  ULONG lo = (s->lenLo + len) & 0xFFFFFFFFUL;
+  if (lo < s->lenLo) s->lenHi++;
+  s->lenLo = lo;
+
+  if (s->used) {
+    ULONG n = 64 - s->used; if (n > len) n = len;
+    memcpy(s->buf + s->used, data, n);
+    s->used += n; data += n; len -= n;
+    if (s->used < 64) return;
+    sha256_block(s, s->buf);
+    s->used = 0;
+  }
+  while (len >= 64) { sha256_block(s, data); data += 64; len -= 64; }
+  if (len) { memcpy(s->buf, data, len); s->used = len; }
+}
+
+void sha256_final(struct Sha256 *s, UBYTE out[SHA256_LEN]) {
+  ULONG hi = (s->lenHi << 3) | (s->lenLo >> 29);
+  ULONG lo = (s->lenLo << 3) & 0xFFFFFFFFUL;
+  UBYTE pad[72];
+  ULONG n = (s->used < 56) ? 56 - s->used : 120 - s->used;
+  memset(pad, 0, sizeof(pad));
+  pad[0] = 0x80;
+  pad[n]   = (UBYTE)(hi >> 24); pad[n+1] = (UBYTE)(hi >> 16); pad[n+2] = (UBYTE)(hi >> 8); pad[n+3] = (UBYTE)hi;
+  pad[n+4] = (UBYTE)(lo >> 24); pad[n+5] = (UBYTE)(lo >> 16); pad[n+6] = (UBYTE)(lo >> 8); pad[n+7] = (UBYTE)lo;
+  ULONG keepLo = s->lenLo, keepHi = s->lenHi;
+  sha256_update(s, pad, n + 8);
+  s->lenLo = keepLo; s->lenHi = keepHi;
+  for (int i=0; i<8; ++i) {
+    out[4*i]   = (UBYTE)(s->h[i] >> 24); out[4*i+1] = (UBYTE)(s->h[i] >> 16);
+    out[4*i+2] = (UBYTE)(s->h[i] >> 8);  out[4*i+3] = (UBYTE)s->h[i];
+  }
+}
+
+void sha256(const UBYTE *data, ULONG len, UBYTE out[SHA256_LEN]) {
+  struct Sha256 s;
+  sha256_init(&s);
+  sha256_update(&s, data, len);
+  sha256_final(&s, out);
+}
+
+void hash_hex(const UBYTE *digest, ULONG len, char *out) {
+  static const char hx[] = "0123456789abcdef";
+  for (ULONG i=0; i<len; ++i) { out[2*i] = hx[digest[i] >> 4]; out[2*i+1] = hx[digest[i] & 15]; }
+  out[2*len] = '\0';
+}
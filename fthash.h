@@ -0,0 +1,58 @@
+/*
+ * fthash.h - portable hashes for FloppyTool and the host tools.
+ *   CRC32:   ADF verify, capture journal and the gzip (.adz) trailer
+ *   MD5/SHA-1: dump identification against DAT files (ftdat.h)
+ *   SHA-256: content key of the deduplicating track store (host/adfstore.c)
+ */
+#ifndef FTHASH_H
+#define FTHASH_H
+
+#include "ftport.h"
+
+/* CRC32 (poly 0xEDB88320): crc32_final(crc32_update(crc32_init(), p, n)) */
+ULONG crc32_init(void);
+ULONG crc32_update(ULONG crc, const UBYTE *buf, ULONG len);
+ULONG crc32_final(ULONG crc);
+
+#define MD5_LEN    16
+#define SHA1_LEN   20
+#define SHA256_LEN 32
+
+struct Md5 {
+  ULONG h[4];
+  ULONG lenLo, lenHi;
+  UBYTE buf[64];
+  ULONG used;
+};
+
+void md5_init(struct Md5 *s);
+void md5_update(struct Md5 *s, const UBYTE *data, ULONG len);
+void md5_final(struct Md5 *s, UBYTE out[MD5_LEN]);
+
+struct Sha1 {
+  ULONG h[5];
+  ULONG lenLo, lenHi;
+  UBYTE buf[64];
+  ULONG used;
+};
+
+void sha1_init(struct Sha1 *s);
+void sha1_update(struct Sha1 *s, const UBYTE *data, ULONG len);
+void sha1_final(struct Sha1 *s, UBYTE out[SHA1_LEN]);
+
+struct Sha256 {
+  ULONG h[8];
+  ULONG lenLo, lenHi;                  /* message length in bytes */
+  UBYTE buf[64];
+  ULONG used;
+};
+
+void sha256_init(struct Sha256 *s);
+void sha256_update(struct Sha256 *s, const UBYTE *data, ULONG len);
+void sha256_final(struct Sha256 *s, UBYTE out[SHA256_LEN]);
+void sha256(const UBYTE *data, ULONG len, UBYTE out[SHA256_LEN]);
+
+/* Lower-case hex, out must hold 2*len+1 chars */
+void hash_hex(const UBYTE *digest, ULONG len, char *out);
+
+#endif
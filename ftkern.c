@@ -0,0 +1,264 @@
+/*
+ * ftkern.c - CPU-dispatched compare/zero/sum/CRC loops (see ftkern.h).
+ * No allocation; the only OS access is SysBase->AttnFlags on the Amiga.
+ */
+#include <string.h>
+#include "ftkern.h"
+
+#if defined(__amigaos__) || defined(AMIGA) || defined(__AMIGA__)
+#define KERN_AMIGA
+#include <exec/execbase.h>
+extern struct ExecBase *SysBase;
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KERN_X86
+#include <immintrin.h>
+#endif
+
+/* Big-endian long at p. The 68000 needs p even: its loops check first */
+#ifdef KERN_AMIGA
+#define LD32(p) (*(const ULONG *)(p))
+#define LDN(p)  LD32(p)
+#define CRC_SLICES 4
+#else
+static ULONG LD32(const UBYTE *p) {
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+static ULONG LDN(const UBYTE *p) { ULONG v; memcpy(&v, p, 4); return v; }   /* any order: compare/zero */
+#define CRC_SLICES 8
+#endif
+
+#define ODD(p) (((unsigned long)(p)) & 1)
+
+/* ----- CRC32 tables: crcTab[0] is the byte table, [k] advances k bytes more ----- */
+
+static ULONG crcTab[CRC_SLICES][256];
+
+static void crc_tables(void) {
+  for (ULONG n=0; n<256; ++n) {
+    ULONG c = n;
+    for (int k=0; k<8; ++k) c = (c & 1) ? (c >> 1) ^ 0xEDB88320UL : (c >> 1);
+    crcTab[0][n] = c;
+  }
+  for (ULONG n=0; n<256; ++n)
+    for (int k=1; k<CRC_SLICES; ++k) crcTab[k][n] = crcTab[0][crcTab[k-1][n] & 0xFF] ^ (crcTab[k-1][n] >> 8);
+}
+
+static ULONG crc_byte(ULONG c, const UBYTE *p, ULONG len) {
+  while (len--) c = crcTab[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+  return c;
+}
+
+#if CRC_SLICES == 4
+/* Four bytes per step; w is loaded big-endian, so p[0] is its top byte */
+static ULONG crc_slice4(ULONG c, const UBYTE *p, ULONG len) {
+  if (ODD(p) && len) { c = crc_byte(c, p, 1); p++; len--; }   /* even is faster */
+  for (; len >= 4; p += 4, len -= 4) {
+    ULONG w = LD32(p);
+    c = crcTab[3][(c ^ (w >> 24)) & 0xFF] ^ crcTab[2][((c >> 8) ^ (w >> 16)) & 0xFF] ^
+        crcTab[1][((c >> 16) ^ (w >> 8)) & 0xFF] ^ crcTab[0][((c >> 24) ^ w) & 0xFF];
+  }
+  return crc_byte(c, p, len);
+}
+#else
+static ULONG crc_slice8(ULONG c, const UBYTE *p, ULONG len) {
+  for (; len >= 8; p += 8, len -= 8) {
+    ULONG w = LD32(p), v = LD32(p + 4);
+    c = crcTab[7][(c ^ (w >> 24)) & 0xFF] ^ crcTab[6][((c >> 8) ^ (w >> 16)) & 0xFF] ^
+        crcTab[5][((c >> 16) ^ (w >> 8)) & 0xFF] ^ crcTab[4][((c >> 24) ^ w) & 0xFF] ^
+        crcTab[3][(v >> 24) & 0xFF] ^ crcTab[2][(v >> 16) & 0xFF] ^
+        crcTab[1][(v >> 8) & 0xFF] ^ crcTab[0][v & 0xFF];
+  }
+  return crc_byte(c, p, len);
+}
+#endif
+
+/* ----- 68000 / plain: one long per step ----- */
+
+static BOOL equal_plain(const UBYTE *a, const UBYTE *b, ULONG len) {
+  if (ODD(a) || ODD(b)) return memcmp(a, b, len) == 0;
+  for (; len >= 4; a += 4, b += 4, len -= 4) if (LDN(a) != LDN(b)) return FALSE;
+  while (len--) if (*a++ != *b++) return FALSE;
+  return TRUE;
+}
+
+static BOOL zero_plain(const UBYTE *p, ULONG len) {
+  if (ODD(p)) { while (len--) if (*p++) return FALSE; return TRUE; }
+  for (; len >= 4; p += 4, len -= 4) if (LDN(p)) return FALSE;
+  while (len--) if (*p++) return FALSE;
+  return TRUE;
+}
+
+static ULONG sum_plain(const UBYTE *p, ULONG len) {
+  ULONG s = 0;
+  if (ODD(p)) {
+    for (; len >= 4; p += 4, len -= 4)
+      s += ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+    return s;
+  }
+  for (; len >= 4; p += 4, len -= 4) s += LD32(p);
+  return s;
+}
+
+/* ----- 68020+ / generic: eight longs per step (what MOVEM.L would fetch);
+   the 68020 reads longs at any address, so no alignment checks ----- */
+
+static BOOL equal_unroll(const UBYTE *a, const UBYTE *b, ULONG len) {
+  for (; len >= 32; a += 32, b += 32, len -= 32)
+    if ((LDN(a)      ^ LDN(b))      | (LDN(a + 4)  ^ LDN(b + 4))  |
+        (LDN(a + 8)  ^ LDN(b + 8))  | (LDN(a + 12) ^ LDN(b + 12)) |
+        (LDN(a + 16) ^ LDN(b + 16)) | (LDN(a + 20) ^ LDN(b + 20)) |
+        (LDN(a + 24) ^ LDN(b + 24)) | (LDN(a + 28) ^ LDN(b + 28))) return FALSE;
+  while (len--) if (*a++ != *b++) return FALSE;
+  return TRUE;
+}
+
+static BOOL zero_unroll(const UBYTE *p, ULONG len) {
+  for (; len >= 32; p += 32, len -= 32)
+    if (LDN(p) | LDN(p + 4) | LDN(p + 8) | LDN(p + 12) |
+        LDN(p + 16) | LDN(p + 20) | LDN(p + 24) | LDN(p + 28)) return FALSE;
+  while (len--) if (*p++) return FALSE;
+  return TRUE;
+}
+
+static ULONG sum_unroll(const UBYTE *p, ULONG len) {
+  ULONG s = 0;
+  for (; len >= 32; p += 32, len -= 32)
+    s += LD32(p) + LD32(p + 4) + LD32(p + 8) + LD32(p + 12) +
+         LD32(p + 16) + LD32(p + 20) + LD32(p + 24) + LD32(p + 28);
+  for (; len >= 4; p += 4, len -= 4) s += LD32(p);
+  return s;
+}
+
+/* ----- x86 SIMD (host) ----- */
+
+#ifdef KERN_X86
+__attribute__((target("sse2")))
+static BOOL equal_sse2(const UBYTE *a, const UBYTE *b, ULONG len) {
+  for (; len >= 64; a += 64, b += 64, len -= 64) {
+    __m128i e = _mm_and_si128(
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a),        _mm_loadu_si128((const __m128i *)b)),
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 16)), _mm_loadu_si128((const __m128i *)(b + 16)))),
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 32)), _mm_loadu_si128((const __m128i *)(b + 32))),
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 48)), _mm_loadu_si128((const __m128i *)(b + 48)))));
+    if (_mm_movemask_epi8(e) != 0xFFFF) return FALSE;
+  }
+  return memcmp(a, b, len) == 0;
+}
+
+__attribute__((target("sse2")))
+static BOOL zero_sse2(const UBYTE *p, ULONG len) {
+  for (; len >= 64; p += 64, len -= 64) {
+    __m128i o = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)p),        _mm_loadu_si128((const __m128i *)(p + 16))),
+                             _mm_or_si128(_mm_loadu_si128((const __m128i *)(p + 32)), _mm_loadu_si128((const __m128i *)(p + 48))));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(o, _mm_setzero_si128())) != 0xFFFF) return FALSE;
+  }
+  while (len--) if (*p++) return FALSE;
+  return TRUE;
+}
+
+/* Byte swap of each 32-bit lane without SSSE3: bytes within words, then words */
+__attribute__((target("sse2")))
+static __m128i bswap_sse2(__m128i v) {
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+}
+
+__attribute__((target("sse2")))
+static ULONG sum_sse2(const UBYTE *p, ULONG len) {
+  __m128i s = _mm_setzero_si128();
+  for (; len >= 16; p += 16, len -= 16) s = _mm_add_epi32(s, bswap_sse2(_mm_loadu_si128((const __m128i *)p)));
+  ULONG lane[4];
+  _mm_storeu_si128((__m128i *)lane, s);
+  return lane[0] + lane[1] + lane[2] + lane[3] + sum_plain(p, len);
+}
+
+__attribute__((target("avx2")))
+static BOOL equal_avx2(const UBYTE *a, const UBYTE *b, ULONG len) {
+  for (; len >= 64; a += 64, b += 64, len -= 64) {
+    __m256i x = _mm256_or_si256(
+      _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a),        _mm256_loadu_si256((const __m256i *)b)),
+      _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 32)), _mm256_loadu_si256((const __m256i *)(b + 32))));
+    if (!_mm256_testz_si256(x, x)) return FALSE;
+  }
+  return memcmp(a, b, len) == 0;
+}
+
+__attribute__((target("avx2")))
+static BOOL zero_avx2(const UBYTE *p, ULONG len) {
+  for (; len >= 128; p += 128, len -= 128) {
+    __m256i o = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i *)p),        _mm256_loadu_si256((const __m256i *)(p + 32))),
+                                _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(p + 64)), _mm256_loadu_si256((const __m256i *)(p + 96))));
+    if (!_mm256_testz_si256(o, o)) return FALSE;
+  }
+  while (len--) if (*p++) return FALSE;
+  return TRUE;
+}
+
+__attribute__((target("avx2")))
+static ULONG sum_avx2(const UBYTE *p, ULONG len) {
+  const __m256i swap = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12,
+                                        3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+  __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+  for (; len >= 64; p += 64, len -= 64) {
+    s0 = _mm256_add_epi32(s0, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)p), swap));
+    s1 = _mm256_add_epi32(s1, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), swap));
+  }
+  ULONG lane[8], s = 0;
+  _mm256_storeu_si256((__m256i *)lane, _mm256_add_epi32(s0, s1));
+  for (int i=0; i<8; ++i) s += lane[i];
+  return s + sum_unroll(p, len);
+}
+#endif
+
+/* ----- Dispatch ----- */
+
+struct KernEntry {
+  struct FtKern k;
+  BOOL (*usable)(void);
+};
+
+static BOOL cpu_any(void) { return TRUE; }
+
+#ifdef KERN_AMIGA
+static BOOL cpu_68020(void) { return (SysBase->AttnFlags & AFF_68020) != 0; }
+
+static const struct KernEntry kernels[] = {
+  { { "68000", equal_plain,  zero_plain,  sum_plain,  crc_byte   }, cpu_any },
+  { { "68020", equal_unroll, zero_unroll, sum_unroll, crc_slice4 }, cpu_68020 },
+};
+#else
+#ifdef KERN_X86
+static BOOL cpu_sse2(void) { __builtin_cpu_init(); return __builtin_cpu_supports("sse2") != 0; }
+static BOOL cpu_avx2(void) { __builtin_cpu_init(); return __builtin_cpu_supports("avx2") != 0; }
+#endif
+
+static const struct KernEntry kernels[] = {
+  { { "plain",   equal_plain,  zero_plain,  sum_plain,  crc_byte   }, cpu_any },
+  { { "generic", equal_unroll, zero_unroll, sum_unroll, crc_slice8 }, cpu_any },
+#ifdef KERN_X86
+  { { "sse2",    equal_sse2,   zero_sse2,   sum_sse2,   crc_slice8 }, cpu_sse2 },
+  { { "avx2",    equal_avx2,   zero_avx2,   sum_avx2,   crc_slice8 }, cpu_avx2 },
+#endif
+};
+#endif
+
+#define KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static const struct FtKern *best = NULL;
+
+const struct FtKern *kern_variant(int i) {
+  if (!best) kern_get();
+  for (int n=0; n<KERNELS; ++n)
+    if (kernels[n].usable() && i-- == 0) return &kernels[n].k;
+  return NULL;
+}
+
+/* The table order is slowest first, so the last usable entry wins */
+const struct FtKern *kern_get(void) {
+  if (best) return best;
+  crc_tables();
+  const struct FtKern *k = &kernels[0].k;
+  for (int n=1; n<KERNELS; ++n) if (kernels[n].usable()) k = &kernels[n].k;
+  best = k;
+  return best;
+}
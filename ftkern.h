@@ -0,0 +1,39 @@
+/*
+ * ftkern.h - CPU-dispatched inner loops for verification and checksums:
+ * buffer compare, zero check, Amiga block sum and CRC32.
+ *
+ * Variants (kern_variant):
+ *   Amiga: 68000   word/long loops, byte-table CRC
+ *          68020   8x unrolled longs, slicing-by-4 CRC (AttnFlags 68020+)
+ *   host:  plain   as 68000, for comparison
+ *          generic 8x unrolled longs, slicing-by-8 CRC
+ *          sse2    128-bit compare/zero/sum (CPUID)
+ *          avx2    256-bit compare/zero/sum (CPUID)
+ * The x86 variants keep the slicing-by-8 CRC: CRC32 has no SSE2/AVX2
+ * shortcut short of PCLMUL folding.
+ *
+ * kern_get() picks the fastest variant this CPU runs and builds the CRC
+ * tables on its first call. Host tools that hash from several threads
+ * must call it once before starting them.
+ */
+#ifndef FTKERN_H
+#define FTKERN_H
+
+#include "ftport.h"
+
+struct FtKern {
+  const char *name;
+  BOOL  (*equal)(const UBYTE *a, const UBYTE *b, ULONG len);
+  BOOL  (*zero)(const UBYTE *p, ULONG len);
+  ULONG (*sum)(const UBYTE *p, ULONG len);              /* big-endian longs, len a multiple of 4 */
+  ULONG (*crc)(ULONG crc, const UBYTE *p, ULONG len);   /* as crc32_update() */
+};
+
+const struct FtKern *kern_get(void);
+const struct FtKern *kern_variant(int i);               /* i-th variant this CPU runs, NULL = no more */
+
+#define kern_equal(a,b,n) (kern_get()->equal((a), (b), (n)))
+#define kern_zero(p,n)    (kern_get()->zero((p), (n)))
+#define kern_sum(p,n)     (kern_get()->sum((p), (n)))
+
+#endif
@@ -0,0 +1,481 @@
+/*
+ * ftofs.c - OFS/FFS image builder and reader (see ftofs.h). No allocation,
+ * no OS calls.
+ */
+#include <string.h>
+#include "ftofs.h"
+
+#define T_HEADER   2
+#define T_DATA     8
+#define T_LIST     16
+#define ST_ROOT    1
+#define ST_USERDIR 2
+#define ST_FILE    0xFFFFFFFDUL                /* -3 */
+
+/* Byte offsets inside a 512-byte header block */
+#define B_TYPE     0
+#define B_KEY      4
+#define B_HIGHSEQ  8
+#define B_DATASIZE 12
+#define B_FIRST    16
+#define B_SUM      20
+#define B_TABLE    24                          /* hash table or data block pointers */
+#define B_BMFLAG   312
+#define B_BMPAGES  316
+#define B_PROTECT  320
+#define B_SIZE     324
+#define B_DATE     420
+#define B_NAME     432
+#define B_VDATE    472                         /* root: last disk change */
+#define B_CDATE    484                         /* root: creation */
+#define B_CHAIN    496
+#define B_PARENT   500
+#define B_EXT      504
+#define B_SECTYPE  508
+
+/* The boot code Install writes: FindResident("dos.library"), return its init */
+static const UBYTE stdBoot[] = {
+  0x43,0xFA,0x00,0x18, 0x4E,0xAE,0xFF,0xA0, 0x4A,0x80, 0x67,0x0A, 0x20,0x40,
+  0x20,0x68,0x00,0x16, 0x70,0x00, 0x4E,0x75, 0x70,0xFF, 0x4E,0x75,
+  'd','o','s','.','l','i','b','r','a','r','y',0
+};
+
+static ULONG get32(const UBYTE *p) {
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+
+static void put32(UBYTE *p, ULONG v) {
+  p[0] = (UBYTE)(v >> 24); p[1] = (UBYTE)(v >> 16); p[2] = (UBYTE)(v >> 8); p[3] = (UBYTE)v;
+}
+
+static UBYTE *blk(const struct OfsVol *v, ULONG b) { return v->img + b * OFS_BLOCK_SIZE; }
+
+static BOOL is_used(const struct OfsVol *v, ULONG b) { return (v->map[b >> 3] >> (b & 7)) & 1; }
+
+static void take(struct OfsVol *v, ULONG b) {
+  v->map[b >> 3] |= (UBYTE)(1 << (b & 7));
+  v->used++;
+}
+
+static void want_sum(struct OfsVol *v, ULONG b) { v->sum[b >> 3] |= (UBYTE)(1 << (b & 7)); }
+
+/* AmigaDOS toupper: a-z, and for the international modes Latin-1 too */
+static int upper(int c, BOOL intl) {
+  if (c >= 'a' && c <= 'z') return c - 32;
+  if (intl && c >= 224 && c <= 254 && c != 247) return c - 32;
+  return c;
+}
+
+static ULONG hash_name(const char *name, BOOL intl) {
+  ULONG h = (ULONG)strlen(name);
+  for (const UBYTE *p = (const UBYTE *)name; *p; ++p) h = (h * 13 + (ULONG)upper(*p, intl)) & 0x7FF;
+  return h % OFS_HT_SIZE;
+}
+
+static BOOL same_name(const UBYTE *hdr, const char *name, BOOL intl) {
+  ULONG n = hdr[B_NAME];
+  if (n != strlen(name)) return FALSE;
+  for (ULONG i = 0; i < n; ++i)
+    if (upper(hdr[B_NAME + 1 + i], intl) != upper((UBYTE)name[i], intl)) return FALSE;
+  return TRUE;
+}
+
+static int name_ok(const char *name) {
+  size_t n = strlen(name);
+  if (!n || n > OFS_NAME_MAX || strchr(name, ':') || strchr(name, '/')) return OFS_ERR_NAME;
+  return OFS_OK;
+}
+
+static void put_date(UBYTE *p, const struct OfsDate *d) {
+  put32(p, d->days); put32(p + 4, d->mins); put32(p + 8, d->ticks);
+}
+
+static void put_name(UBYTE *hdr, const char *name) {
+  size_t n = strlen(name);
+  hdr[B_NAME] = (UBYTE)n;
+  memcpy(hdr + B_NAME + 1, name, n);
+}
+
+static BOOL is_dir(const struct OfsVol *v, ULONG b) {
+  if (b < 2 || b >= OFS_BLOCKS || !is_used(v, b)) return FALSE;
+  const UBYTE *h = blk(v, b);
+  ULONG st = get32(h + B_SECTYPE);
+  return get32(h + B_TYPE) == T_HEADER && (st == ST_ROOT || st == ST_USERDIR);
+}
+
+/* Name free in the parent? */
+static int check_name(const struct OfsVol *v, ULONG parent, const char *name) {
+  int rc = name_ok(name);
+  if (rc) return rc;
+  if (!is_dir(v, parent)) return OFS_ERR_PARENT;
+  BOOL intl = (v->dosType & OFS_INTL) != 0;
+  ULONG b = get32(blk(v, parent) + B_TABLE + 4 * hash_name(name, intl));
+  for (; b; b = get32(blk(v, b) + B_CHAIN))
+    if (same_name(blk(v, b), name, intl)) return OFS_ERR_EXISTS;
+  return OFS_OK;
+}
+
+/* Into the parent's hash chain, kept in ascending block order */
+static void link_entry(struct OfsVol *v, ULONG parent, ULONG b, const char *name) {
+  UBYTE *slot = blk(v, parent) + B_TABLE + 4 * hash_name(name, (v->dosType & OFS_INTL) != 0);
+  while (get32(slot) && get32(slot) < b) slot = blk(v, get32(slot)) + B_CHAIN;
+  put32(blk(v, b) + B_CHAIN, get32(slot));
+  put32(slot, b);
+  put32(blk(v, b) + B_PARENT, parent);
+}
+
+/* n free blocks into v->run: one contiguous run from the cursor if there is
+   one (wrapping to block 2 once), else the first free blocks anywhere */
+static BOOL alloc_run(struct OfsVol *v, ULONG n) {
+  if (n > ofs_free(v)) return FALSE;
+  ULONG start = v->cursor;
+  for (int pass = 0; pass < 2; ++pass) {
+    ULONG len = 0;
+    for (ULONG b = start; b < OFS_BLOCKS; ++b) {
+      len = is_used(v, b) ? 0 : len + 1;
+      if (len == n) {
+        for (ULONG i = 0; i < n; ++i) { v->run[i] = b + 1 - n + i; take(v, v->run[i]); }
+        v->cursor = b + 1;
+        return TRUE;
+      }
+    }
+    start = 2;
+  }
+  ULONG k = 0;
+  for (ULONG b = 2; b < OFS_BLOCKS && k < n; ++b)
+    if (!is_used(v, b)) { v->run[k++] = b; take(v, b); }
+  v->cursor = v->run[n - 1] + 1;
+  v->split++;
+  return TRUE;
+}
+
+ULONG ofs_free(const struct OfsVol *v) { return OFS_BLOCKS - v->used; }
+
+ULONG ofs_file_blocks(const struct OfsVol *v, ULONG len) {
+  ULONG per = (v->dosType & OFS_FFS) ? OFS_BLOCK_SIZE : OFS_DATA_SIZE;
+  ULONG nd = (len + per - 1) / per;
+  ULONG next = nd > OFS_HT_SIZE ? (nd - 1) / OFS_HT_SIZE : 0;
+  return 1 + next + nd;
+}
+
+int ofs_format(struct OfsVol *v, UBYTE *img, UBYTE dosType, const char *label, const struct OfsDate *d) {
+  memset(v, 0, sizeof(*v));
+  v->img = img;
+  v->dosType = (UBYTE)(dosType & 3);
+  memset(img, 0, FT_DISK_SIZE);
+  size_t n = strlen(label);
+  if (!n || n > OFS_NAME_MAX || strchr(label, ':') || strchr(label, '/')) return OFS_ERR_NAME;
+
+  img[0] = 'D'; img[1] = 'O'; img[2] = 'S'; img[3] = v->dosType;
+  put32(img + 8, OFS_ROOT);
+  take(v, 0); take(v, 1);
+
+  UBYTE *r = blk(v, OFS_ROOT);
+  put32(r + B_TYPE, T_HEADER);
+  put32(r + B_DATASIZE, OFS_HT_SIZE);          /* ht_size */
+  put32(r + B_BMFLAG, 0xFFFFFFFFUL);
+  put32(r + B_BMPAGES, OFS_BITMAP);
+  put_date(r + B_DATE, d);
+  put_date(r + B_VDATE, d);
+  put_date(r + B_CDATE, d);
+  put_name(r, label);
+  put32(r + B_SECTYPE, ST_ROOT);
+  take(v, OFS_ROOT); want_sum(v, OFS_ROOT);
+  take(v, OFS_BITMAP);
+  v->cursor = OFS_BITMAP + 1;
+  return OFS_OK;
+}
+
+LONG ofs_mkdir(struct OfsVol *v, ULONG parent, const char *name, const struct OfsDate *d) {
+  int rc = check_name(v, parent, name);
+  if (rc) return rc;
+  if (!alloc_run(v, 1)) return OFS_ERR_FULL;
+  ULONG b = v->run[0];
+  UBYTE *h = blk(v, b);
+  put32(h + B_TYPE, T_HEADER);
+  put32(h + B_KEY, b);
+  put_date(h + B_DATE, d);
+  put_name(h, name);
+  put32(h + B_SECTYPE, ST_USERDIR);
+  want_sum(v, b);
+  link_entry(v, parent, b, name);
+  return (LONG)b;
+}
+
+LONG ofs_add_file(struct OfsVol *v, ULONG parent, const char *name, const UBYTE *data, ULONG len,
+                  const struct OfsDate *d, ULONG protect) {
+  int rc = check_name(v, parent, name);
+  if (rc) return rc;
+  BOOL ffs = (v->dosType & OFS_FFS) != 0;
+  ULONG per = ffs ? OFS_BLOCK_SIZE : OFS_DATA_SIZE;
+  ULONG nd = (len + per - 1) / per, total = ofs_file_blocks(v, len);
+  if (!alloc_run(v, total)) return OFS_ERR_FULL;
+
+  /* run: header, 72 data, extension, 72 data, ... ; table slots fill downwards */
+  ULONG hdr = v->run[0], list = hdr, k = 1, prevData = 0;
+  UBYTE *h = blk(v, hdr);
+  put32(h + B_TYPE, T_HEADER);
+  put32(h + B_KEY, hdr);
+  put32(h + B_PROTECT, protect);
+  put32(h + B_SIZE, len);
+  put_date(h + B_DATE, d);
+  put_name(h, name);
+  put32(h + B_SECTYPE, ST_FILE);
+  want_sum(v, hdr);
+
+  for (ULONG i = 0; i < nd; ++i) {
+    if (i && i % OFS_HT_SIZE == 0) {
+      ULONG ext = v->run[k++];
+      UBYTE *e = blk(v, ext);
+      put32(e + B_TYPE, T_LIST);
+      put32(e + B_KEY, ext);
+      put32(e + B_PARENT, hdr);
+      put32(e + B_SECTYPE, ST_FILE);
+      put32(blk(v, list) + B_EXT, ext);
+      want_sum(v, ext);
+      list = ext;
+    }
+    ULONG db = v->run[k++], slot = i % OFS_HT_SIZE;
+    UBYTE *lb = blk(v, list);
+    put32(lb + B_TABLE + 4 * (OFS_HT_SIZE - 1 - slot), db);
+    put32(lb + B_HIGHSEQ, slot + 1);
+    if (i == 0) put32(h + B_FIRST, db);
+
+    ULONG n = len - i * per < per ? len - i * per : per;
+    UBYTE *p = blk(v, db);
+    if (ffs) memcpy(p, data + i * per, n);
+    else {
+      put32(p + B_TYPE, T_DATA);
+      put32(p + B_KEY, hdr);
+      put32(p + 8, i + 1);                     /* sequence number */
+      put32(p + B_DATASIZE, n);
+      memcpy(p + B_TABLE, data + i * per, n);
+      if (prevData) put32(blk(v, prevData) + B_FIRST, db);   /* next_data */
+      want_sum(v, db);
+      prevData = db;
+    }
+  }
+  link_entry(v, parent, hdr, name);
+  return (LONG)hdr;
+}
+
+void ofs_bootblock(struct OfsVol *v, const UBYTE *code, ULONG len) {
+  if (!code) { code = stdBoot; len = sizeof(stdBoot); }
+  if (len > OFS_BOOT_SIZE - 12) len = OFS_BOOT_SIZE - 12;
+  memset(v->img + 12, 0, OFS_BOOT_SIZE - 12);
+  memcpy(v->img + 12, code, len);
+  v->boot = TRUE;
+}
+
+void ofs_finish(struct OfsVol *v) {
+  /* Bitmap: bit set = free, from block 2 on, LSB first in each long */
+  UBYTE *bm = blk(v, OFS_BITMAP);
+  memset(bm, 0, OFS_BLOCK_SIZE);
+  for (ULONG b = 2; b < OFS_BLOCKS; ++b) {
+    if (is_used(v, b)) continue;
+    UBYTE *l = bm + 4 + 4 * ((b - 2) / 32);
+    put32(l, get32(l) | (1UL << ((b - 2) % 32)));
+  }
+  ULONG s = 0;
+  for (int i = 1; i < 128; ++i) s += get32(bm + 4 * i);
+  put32(bm, (ULONG)0 - s);
+
+  for (ULONG b = 2; b < OFS_BLOCKS; ++b) {
+    if (!((v->sum[b >> 3] >> (b & 7)) & 1)) continue;
+    UBYTE *p = blk(v, b);
+    put32(p + B_SUM, 0);
+    s = 0;
+    for (int i = 0; i < 128; ++i) s += get32(p + 4 * i);
+    put32(p + B_SUM, (ULONG)0 - s);
+  }
+
+  /* Boot block: add-with-carry over 1024 bytes must give ~0 */
+  if (v->boot) {
+    put32(v->img + 4, 0);
+    s = 0;
+    for (int i = 0; i < OFS_BOOT_SIZE / 4; ++i) {
+      ULONG w = get32(v->img + 4 * i), t = s + w;
+      if (t < s) t++;
+      s = t;
+    }
+    put32(v->img + 4, ~s);
+  }
+}
+
+/* ====== Reading ====== */
+
+#define ST_SOFTLINK 3
+#define ST_LINKDIR  4
+#define ST_LINKFILE 0xFFFFFFFCUL               /* -4 */
+#define B_REAL      468                        /* hard link: the linked entry */
+
+static const UBYTE *rblk(struct OfsRd *r, ULONG b) {
+  if (!((r->touched[b >> 3] >> (b & 7)) & 1)) {
+    r->touched[b >> 3] |= (UBYTE)(1 << (b & 7));
+    r->nTouched++;
+  }
+  return r->img + b * OFS_BLOCK_SIZE;
+}
+
+static BOOL in_range(ULONG b) { return b >= 2 && b < OFS_BLOCKS; }
+
+static BOOL rd_intl(const struct OfsRd *r) { return r->dosType >= 2; }   /* 2-5 */
+
+static BOOL rd_sum_ok(const UBYTE *p) {
+  ULONG s = 0;
+  for (int i = 0; i < 128; ++i) s += get32(p + 4 * i);
+  return s == 0;
+}
+
+int ofs_rd_open(struct OfsRd *r, const UBYTE *img) {
+  memset(r, 0, sizeof(*r));
+  r->img = img;
+  if (img[0] != 'D' || img[1] != 'O' || img[2] != 'S' || img[3] > 5) return OFS_ERR_NDOS;
+  r->dosType = img[3];
+  const UBYTE *root = rblk(r, OFS_ROOT);
+  if (get32(root + B_TYPE) != T_HEADER || get32(root + B_SECTYPE) != ST_ROOT || !rd_sum_ok(root)) return OFS_ERR_NDOS;
+  return OFS_OK;
+}
+
+/* Header b as an entry; hard links take size, kind and data from the
+   linked entry but keep their own name */
+static int rd_ent(struct OfsRd *r, ULONG b, struct OfsEnt *e) {
+  if (b != OFS_ROOT && !in_range(b)) return OFS_ERR_CORRUPT;
+  const UBYTE *h = rblk(r, b);
+  if (get32(h + B_TYPE) != T_HEADER) return OFS_ERR_CORRUPT;
+  ULONG n = h[B_NAME] <= OFS_NAME_MAX ? h[B_NAME] : OFS_NAME_MAX;
+  memcpy(e->name, h + B_NAME + 1, n);
+  e->name[n] = '\0';
+  ULONG st = get32(h + B_SECTYPE);
+  if (st == ST_LINKFILE || st == ST_LINKDIR) {
+    b = get32(h + B_REAL);
+    if (!in_range(b)) return OFS_ERR_CORRUPT;
+    h = rblk(r, b);
+    st = get32(h + B_SECTYPE);
+    if (get32(h + B_TYPE) != T_HEADER || st == ST_LINKFILE || st == ST_LINKDIR) return OFS_ERR_CORRUPT;
+  }
+  e->block   = b;
+  e->protect = get32(h + B_PROTECT);
+  e->date.days = get32(h + B_DATE); e->date.mins = get32(h + B_DATE + 4); e->date.ticks = get32(h + B_DATE + 8);
+  e->size = 0;
+  if (st == ST_FILE)                          { e->kind = OFS_ENT_FILE; e->size = get32(h + B_SIZE); }
+  else if (st == ST_ROOT || st == ST_USERDIR) e->kind = OFS_ENT_DIR;
+  else if (st == ST_SOFTLINK)                 e->kind = OFS_ENT_SOFTLINK;
+  else return OFS_ERR_CORRUPT;
+  return OFS_OK;
+}
+
+static struct OfsDent *rd_dent(struct OfsRd *r, ULONG parent, const char *name) {
+  return &r->dent[(parent * 31 + hash_name(name, rd_intl(r))) % OFS_DCACHE];
+}
+
+/* One path component: dentry cache, else the parent's hash chain */
+static int rd_find(struct OfsRd *r, ULONG dir, const char *name, ULONG *out) {
+  struct OfsDent *d = rd_dent(r, dir, name);
+  if (d->block && d->parent == dir && strlen(d->name) == strlen(name)) {
+    ULONG i = 0;
+    while (name[i] && upper((UBYTE)d->name[i], rd_intl(r)) == upper((UBYTE)name[i], rd_intl(r))) ++i;
+    if (!name[i]) { *out = d->block; return OFS_OK; }
+  }
+  ULONG b = get32(rblk(r, dir) + B_TABLE + 4 * hash_name(name, rd_intl(r)));
+  for (ULONG steps = 0; b; ++steps) {
+    if (!in_range(b) || steps == OFS_BLOCKS) return OFS_ERR_CORRUPT;
+    const UBYTE *h = rblk(r, b);
+    if (same_name(h, name, rd_intl(r))) {
+      d->parent = dir; d->block = b;
+      strcpy(d->name, name);
+      *out = b;
+      return OFS_OK;
+    }
+    b = get32(h + B_CHAIN);
+  }
+  return OFS_ERR_NOENT;
+}
+
+int ofs_rd_lookup(struct OfsRd *r, const char *path, struct OfsEnt *e) {
+  int rc = rd_ent(r, OFS_ROOT, e);
+  char part[OFS_NAME_MAX + 1];
+  while (rc == OFS_OK) {
+    while (*path == '/') ++path;
+    if (!*path) break;
+    size_t n = strcspn(path, "/");
+    if (n > OFS_NAME_MAX) return OFS_ERR_NOENT;
+    if (e->kind != OFS_ENT_DIR) return OFS_ERR_NOTDIR;
+    memcpy(part, path, n);
+    part[n] = '\0';
+    path += n;
+    ULONG b;
+    rc = rd_find(r, e->block, part, &b);
+    if (rc == OFS_OK) rc = rd_ent(r, b, e);
+  }
+  return rc;
+}
+
+int ofs_rd_readdir(struct OfsRd *r, ULONG dir, ULONG *cursor, struct OfsEnt *e) {
+  ULONG slot = *cursor >> 16, b = *cursor & 0xFFFF;
+  const UBYTE *d = rblk(r, dir);
+  for (;;) {
+    if (!b) {
+      if (slot >= OFS_HT_SIZE) return OFS_END;
+      b = get32(d + B_TABLE + 4 * slot);
+      if (!b) { ++slot; continue; }
+    }
+    if (!in_range(b)) return OFS_ERR_CORRUPT;
+    ULONG next = get32(rblk(r, b) + B_CHAIN);
+    if (next && !in_range(next)) return OFS_ERR_CORRUPT;
+    *cursor = next ? (slot << 16) | next : (slot + 1) << 16;
+    return rd_ent(r, b, e);
+  }
+}
+
+/* Block i of file hdr: its list blocks are decoded only up to i */
+static ULONG rd_data_block(struct OfsRd *r, ULONG hdr, ULONG i) {
+  struct OfsChain *c = &r->chain[0];
+  for (int k = 0; k < OFS_CHAINS; ++k) {
+    if (r->chain[k].hdr == hdr) { c = &r->chain[k]; break; }
+    if (r->chain[k].stamp < c->stamp) c = &r->chain[k];
+  }
+  if (c->hdr != hdr) { c->hdr = hdr; c->n = 0; c->next = hdr; }
+  c->stamp = ++r->stamp;
+  while (i >= c->n && c->next) {
+    const UBYTE *l = rblk(r, c->next);
+    ULONG cnt = get32(l + B_HIGHSEQ);
+    if (get32(l + B_TYPE) != (c->next == hdr ? T_HEADER : T_LIST) || get32(l + B_SECTYPE) != ST_FILE ||
+        cnt > OFS_HT_SIZE) { c->next = 0; break; }
+    for (ULONG k = 0; k < cnt && c->n < OFS_BLOCKS; ++k) {
+      ULONG p = get32(l + B_TABLE + 4 * (OFS_HT_SIZE - 1 - k));
+      if (!in_range(p)) { cnt = 0; break; }
+      c->blk[c->n++] = (UWORD)p;
+    }
+    ULONG ext = get32(l + B_EXT);
+    c->next = (cnt && c->n < OFS_BLOCKS && in_range(ext)) ? ext : 0;
+  }
+  return i < c->n ? c->blk[i] : 0;
+}
+
+LONG ofs_rd_read(struct OfsRd *r, const struct OfsEnt *e, ULONG off, UBYTE *buf, ULONG len) {
+  if (e->kind != OFS_ENT_FILE || off >= e->size) return 0;
+  if (len > e->size - off) len = e->size - off;
+  BOOL ffs = (r->dosType & OFS_FFS) != 0;
+  ULONG per = ffs ? OFS_BLOCK_SIZE : OFS_DATA_SIZE, done = 0;
+  while (done < len) {
+    ULONG pos = off + done, in = pos % per, n = per - in;
+    if (n > len - done) n = len - done;
+    ULONG db = rd_data_block(r, e->block, pos / per);
+    if (!db) return OFS_ERR_CORRUPT;
+    const UBYTE *p = rblk(r, db);
+    if (!ffs && (get32(p + B_TYPE) != T_DATA || get32(p + B_DATASIZE) < in + n)) return OFS_ERR_CORRUPT;
+    memcpy(buf + done, p + (ffs ? 0 : B_TABLE) + in, n);
+    done += n;
+  }
+  return (LONG)done;
+}
+
+int ofs_rd_readlink(struct OfsRd *r, const struct OfsEnt *e, char *out, ULONG max) {
+  if (e->kind != OFS_ENT_SOFTLINK || !max) return OFS_ERR_CORRUPT;
+  const UBYTE *h = rblk(r, e->block) + B_TABLE;
+  ULONG n = 0;
+  while (n + 1 < max && n < B_CHAIN - B_TABLE && h[n]) { out[n] = (char)h[n]; ++n; }
+  out[n] = '\0';
+  return OFS_OK;
+}
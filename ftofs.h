@@ -0,0 +1,127 @@
+/*
+ * ftofs.h - builds an AmigaDOS OFS/FFS floppy image in memory: root and
+ * bitmap blocks, user directories, file headers with extension blocks,
+ * hash chains, OFS or FFS data blocks and an optional boot block.
+ * Used by host/adfmake.c to pack a directory tree into an ADF.
+ *
+ * Each file gets one contiguous run of blocks in the order AmigaDOS reads
+ * them: header, its first 72 data blocks, extension block, next 72 data
+ * blocks, ... Runs are handed out upwards from the root block and wrap to
+ * block 2 only when the rest of the disk cannot hold the whole file.
+ *
+ * Usage:
+ *   ofs_format(&v, img, OFS_FFS, "Label", &now);
+ *   d = ofs_mkdir(&v, OFS_ROOT, "c", &date);
+ *   ofs_add_file(&v, d, "Dir", data, len, &date, 0);
+ *   ofs_bootblock(&v, NULL, 0);                 optional, NULL = standard code
+ *   ofs_finish(&v);                             bitmap and checksums
+ *
+ * The reading half (ofs_rd_*) gives read-only access to any DOS\0..DOS\5
+ * image in memory, for host/adfmount.c. It touches only the blocks a call
+ * needs: a path lookup reads the hash chains on the way, a read decodes a
+ * file's block list only as far as the offset asked for. Recent lookups
+ * and block lists are kept in struct OfsRd, which records every block
+ * touched. Every block number is range- and type-checked, so a damaged
+ * image gives OFS_ERR_CORRUPT, not a crash.
+ */
+#ifndef FTOFS_H
+#define FTOFS_H
+
+#include "ftport.h"
+
+#define OFS_BLOCK_SIZE  FT_SECTOR_SIZE
+#define OFS_BLOCKS      (FT_DISK_SIZE / OFS_BLOCK_SIZE)   /* 1760 */
+#define OFS_ROOT        (OFS_BLOCKS / 2)                  /* 880 */
+#define OFS_BITMAP      (OFS_ROOT + 1)
+#define OFS_HT_SIZE     72                                /* hash slots / block pointers per block */
+#define OFS_NAME_MAX    30
+#define OFS_DATA_SIZE   488                               /* payload of an OFS data block */
+#define OFS_BOOT_SIZE   1024
+
+/* dosType bits: "DOS\0" + type */
+#define OFS_FFS         1
+#define OFS_INTL        2
+
+#define OFS_OK          0
+#define OFS_ERR_FULL   -1
+#define OFS_ERR_NAME   -2                  /* empty, longer than 30, or ':' '/' */
+#define OFS_ERR_EXISTS -3                  /* same name (case-insensitive) in the directory */
+#define OFS_ERR_PARENT -4                  /* not a directory block */
+#define OFS_ERR_NDOS   -5                  /* reading: not DOS\0..DOS\5, or no valid root */
+#define OFS_ERR_NOENT  -6
+#define OFS_ERR_NOTDIR -7
+#define OFS_ERR_CORRUPT -8                 /* block out of range or of the wrong type */
+#define OFS_END         1                  /* ofs_rd_readdir: no more entries */
+
+struct OfsDate { ULONG days, mins, ticks; };   /* since 1.1.1978; minutes; 1/50 s */
+
+struct OfsVol {
+  UBYTE *img;                              /* FT_DISK_SIZE bytes */
+  UBYTE  dosType;
+  BOOL   boot;                             /* boot code installed */
+  ULONG  cursor;                           /* where the next run is looked for */
+  ULONG  used;                             /* blocks, including boot, root and bitmap */
+  ULONG  split;                            /* files that did not fit in one run */
+  UBYTE  map[OFS_BLOCKS / 8];              /* bit set = block in use */
+  UBYTE  sum[OFS_BLOCKS / 8];              /* bit set = checksum at byte 20 */
+  ULONG  run[OFS_BLOCKS];                  /* blocks of the file being added */
+};
+
+int   ofs_format(struct OfsVol *v, UBYTE *img, UBYTE dosType, const char *label, const struct OfsDate *d);
+/* Return the new header block, or OFS_ERR_* */
+LONG  ofs_mkdir(struct OfsVol *v, ULONG parent, const char *name, const struct OfsDate *d);
+LONG  ofs_add_file(struct OfsVol *v, ULONG parent, const char *name, const UBYTE *data, ULONG len,
+                   const struct OfsDate *d, ULONG protect);
+/* Boot code from byte 12 on (len <= 1012); NULL = the standard OS boot code */
+void  ofs_bootblock(struct OfsVol *v, const UBYTE *code, ULONG len);
+void  ofs_finish(struct OfsVol *v);
+ULONG ofs_free(const struct OfsVol *v);    /* blocks */
+ULONG ofs_file_blocks(const struct OfsVol *v, ULONG len);   /* header + extension + data */
+
+/* ----- Reading ----- */
+#define OFS_CHAINS      8                  /* files whose block lists are kept */
+#define OFS_DCACHE      128                /* looked-up names, direct-mapped */
+
+#define OFS_ENT_FILE    0
+#define OFS_ENT_DIR     1
+#define OFS_ENT_SOFTLINK 2
+
+struct OfsEnt {
+  ULONG block;                             /* header (for a hard link: the linked entry) */
+  UBYTE kind;                              /* OFS_ENT_* */
+  ULONG size, protect;
+  struct OfsDate date;
+  char  name[OFS_NAME_MAX + 1];
+};
+
+struct OfsChain {                          /* data blocks of one file, decoded on demand */
+  ULONG hdr, n, next, stamp;               /* next: list block to decode, 0 = done */
+  UWORD blk[OFS_BLOCKS];
+};
+
+struct OfsDent {
+  ULONG parent, block;
+  char  name[OFS_NAME_MAX + 1];
+};
+
+struct OfsRd {
+  const UBYTE *img;                        /* FT_DISK_SIZE bytes, not written */
+  UBYTE  dosType;
+  ULONG  stamp;
+  struct OfsChain chain[OFS_CHAINS];
+  struct OfsDent  dent[OFS_DCACHE];
+  UBYTE  touched[OFS_BLOCKS / 8];          /* bit set = block read */
+  ULONG  nTouched;
+};
+
+int   ofs_rd_open(struct OfsRd *r, const UBYTE *img);
+/* "/a/b" or "a/b", case-insensitive as AmigaDOS; "" or "/" is the root */
+int   ofs_rd_lookup(struct OfsRd *r, const char *path, struct OfsEnt *e);
+/* *cursor = 0 to start; OFS_OK per entry, OFS_END after the last. A damaged
+   hash chain can repeat: stop after OFS_BLOCKS entries. */
+int   ofs_rd_readdir(struct OfsRd *r, ULONG dir, ULONG *cursor, struct OfsEnt *e);
+/* Bytes read (0 at or past the end), or OFS_ERR_CORRUPT */
+LONG  ofs_rd_read(struct OfsRd *r, const struct OfsEnt *e, ULONG off, UBYTE *buf, ULONG len);
+int   ofs_rd_readlink(struct OfsRd *r, const struct OfsEnt *e, char *out, ULONG max);
+
+#endif
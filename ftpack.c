@@ -0,0 +1,61 @@
+/*
+ * ftpack.c - ByteRun1 run-length coding (see ftpack.h).
+ * No allocation, no OS calls.
+ */
+#include <string.h>
+#include "ftpack.h"
+
+#define RUN_MAX 128
+
+/* Literals in[from..from+n) in chunks of up to RUN_MAX; FALSE if out is full */
+static BOOL put_lit(const UBYTE *in, ULONG from, ULONG n, UBYTE *out, ULONG *o, ULONG max) {
+  while (n) {
+    ULONG k = n < RUN_MAX ? n : RUN_MAX;
+    if (*o + 1 + k > max) return FALSE;
+    out[(*o)++] = (UBYTE)(k - 1);
+    memcpy(out + *o, in + from, k);
+    *o += k; from += k; n -= k;
+  }
+  return TRUE;
+}
+
+ULONG pack_run1(const UBYTE *in, ULONG len, UBYTE *out, ULONG max) {
+  ULONG i = 0, o = 0, lit = 0;            /* literals pending before in[i] */
+  while (i < len) {
+    ULONG r = 1;
+    while (i + r < len && r < RUN_MAX && in[i + r] == in[i]) r++;
+    if (r < 3) {                           /* shorter runs are cheaper as literals */
+      lit += r; i += r;
+      if (lit >= RUN_MAX) {
+        if (!put_lit(in, i - lit, RUN_MAX, out, &o, max)) return 0;
+        lit -= RUN_MAX;
+      }
+      continue;
+    }
+    if (!put_lit(in, i - lit, lit, out, &o, max) || o + 2 > max) return 0;
+    lit = 0;
+    out[o++] = (UBYTE)(257 - r);
+    out[o++] = in[i];
+    i += r;
+  }
+  return put_lit(in, i - lit, lit, out, &o, max) ? o : 0;
+}
+
+BOOL unpack_run1(const UBYTE *in, ULONG inLen, UBYTE *out, ULONG len) {
+  ULONG i = 0, o = 0;
+  while (i < inLen) {
+    UBYTE c = in[i++];
+    if (c < 128) {
+      ULONG n = (ULONG)c + 1;
+      if (n > inLen - i || n > len - o) return FALSE;
+      memcpy(out + o, in + i, n);
+      i += n; o += n;
+    } else if (c > 128) {
+      ULONG n = 257 - (ULONG)c;
+      if (i == inLen || n > len - o) return FALSE;
+      memset(out + o, in[i++], n);
+      o += n;
+    }
+  }
+  return o == len;
+}
@@ -0,0 +1,23 @@
+/*
+ * ftpack.h - ByteRun1 run-length coding (the IFF ILBM compression) for
+ * tracks held in RAM: one-drive copies and the resident image cache.
+ *
+ * Control byte n, then:
+ *   0..127     n+1 literal bytes
+ *   -1..-127   one byte, repeated -n+1 times
+ *   -128       nothing (never written)
+ *
+ * Empty and repeated blocks, the bulk of most game and data disks, shrink
+ * 64:1; data that does not pack costs one byte in 128 more.
+ */
+#ifndef FTPACK_H
+#define FTPACK_H
+
+#include "ftport.h"
+
+/* Bytes written to out, 0 if they would exceed max */
+ULONG pack_run1(const UBYTE *in, ULONG len, UBYTE *out, ULONG max);
+/* TRUE if in decodes to exactly len bytes */
+BOOL  unpack_run1(const UBYTE *in, ULONG inLen, UBYTE *out, ULONG len);
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * ftpatch.c - ADF patch records (see ftpatch.h). No allocation, no OS calls.
+ */
+#include <string.h>
+#include "ftpatch.h"
+#include "fthash.h"
+
+static ULONG get32(const UBYTE *p) {
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+
+static void put32(UBYTE *p, ULONG v) {
+  p[0] = (UBYTE)(v >> 24); p[1] = (UBYTE)(v >> 16); p[2] = (UBYTE)(v >> 8); p[3] = (UBYTE)v;
+}
+
+static int read_exact(struct PatchIn *pi, UBYTE *buf, LONG len) {
+  while (len > 0) {
+    LONG n = pi->rd(pi->h, buf, len);
+    if (n < 0) return PATCH_ERR_IO;
+    if (n == 0) return PATCH_ERR_DATA;            /* truncated */
+    buf += n; len -= n;
+  }
+  return PATCH_OK;
+}
+
+ULONG patch_sectors(UWORD mask) {
+  ULONG n = 0;
+  for (; mask; mask &= (UWORD)(mask - 1)) n++;
+  return n;
+}
+
+ULONG patch_rec_len(const struct PatchRec *r) {
+  return PATCH_REC_SIZE + patch_sectors(r->mask) * FT_SECTOR_SIZE;
+}
+
+UWORD patch_diff(struct PatchRec *r, UWORD t, const UBYTE *base, const UBYTE *next) {
+  UBYTE *q = r->data;
+  r->track = t;
+  r->mask  = 0;
+  for (ULONG s = 0; s < FT_SECTORS; ++s) {
+    ULONG o = s * FT_SECTOR_SIZE;
+    if (memcmp(base + o, next + o, FT_SECTOR_SIZE)) {
+      r->mask |= (UWORD)(1U << s);
+      memcpy(q, next + o, FT_SECTOR_SIZE);
+      q += FT_SECTOR_SIZE;
+    }
+  }
+  if (r->mask) r->baseCrc = crc32_final(crc32_update(crc32_init(), base, FT_TRACK_SIZE));
+  return r->mask;
+}
+
+void patch_put_head(UBYTE out[PATCH_HEAD_SIZE], const struct PatchHead *ph) {
+  put32(out, PATCH_MAGIC);
+  put32(out + 4, ph->baseCrc);
+  put32(out + 8, ph->newCrc);
+  put32(out + 12, ph->count);
+}
+
+void patch_put_rec(UBYTE out[PATCH_REC_SIZE], const struct PatchRec *r) {
+  out[0] = (UBYTE)(r->track >> 8); out[1] = (UBYTE)r->track;
+  out[2] = (UBYTE)(r->mask >> 8);  out[3] = (UBYTE)r->mask;
+  put32(out + 4, r->baseCrc);
+}
+
+int patch_open(struct PatchIn *pi, struct PatchHead *ph, PatchReadFn rd, void *h) {
+  UBYTE head[PATCH_HEAD_SIZE];
+  pi->rd = rd; pi->h = h; pi->left = 0; pi->last = -1;
+  int rc = read_exact(pi, head, PATCH_HEAD_SIZE);
+  if (rc) return rc;
+  if (get32(head) != PATCH_MAGIC) return PATCH_ERR_DATA;
+  ph->baseCrc = get32(head + 4);
+  ph->newCrc  = get32(head + 8);
+  ph->count   = get32(head + 12);
+  if (ph->count > FT_TRACKS) return PATCH_ERR_DATA;
+  pi->left = ph->count;
+  return PATCH_OK;
+}
+
+int patch_read_rec(struct PatchIn *pi, struct PatchRec *r) {
+  UBYTE h[PATCH_REC_SIZE];
+  if (!pi->left) return PATCH_END;
+  int rc = read_exact(pi, h, PATCH_REC_SIZE);
+  if (rc) return rc;
+  r->track   = (UWORD)((h[0] << 8) | h[1]);
+  r->mask    = (UWORD)((h[2] << 8) | h[3]);
+  r->baseCrc = get32(h + 4);
+  if (r->track >= FT_TRACKS || (LONG)r->track <= pi->last ||
+      !r->mask || (r->mask & ~PATCH_ALL_SECTORS)) return PATCH_ERR_DATA;
+  rc = read_exact(pi, r->data, (LONG)(patch_sectors(r->mask) * FT_SECTOR_SIZE));
+  if (rc) return rc;
+  pi->last = r->track;
+  pi->left--;
+  return PATCH_OK;
+}
+
+void patch_apply(const struct PatchRec *r, UBYTE *track) {
+  const UBYTE *p = r->data;
+  for (ULONG s = 0; s < FT_SECTORS; ++s) {
+    if (!(r->mask & (1U << s))) continue;
+    memcpy(track + s * FT_SECTOR_SIZE, p, FT_SECTOR_SIZE);
+    p += FT_SECTOR_SIZE;
+  }
+}
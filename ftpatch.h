@@ -0,0 +1,65 @@
+/*
+ * ftpatch.h - track/sector ADF patches (.adp): the sectors that differ
+ * between two DD images, made and applied by FloppyTool (file or disk)
+ * and host/adfpatch.c.
+ *
+ * Layout (all integers big-endian):
+ *   0   "FTP1", CRC32 of the base image, CRC32 of the result, record count
+ *   16  records in ascending track order:
+ *         track (UWORD), sector mask (UWORD, bit s = sector s),
+ *         CRC32 of the base track,
+ *         the new contents of each sector in the mask, in sector order
+ *
+ * The whole-image CRCs make sure a patch only lands on its own base; the
+ * per-track CRC catches a disk swapped between the check and the write.
+ */
+#ifndef FTPATCH_H
+#define FTPATCH_H
+
+#include "ftport.h"
+
+#define PATCH_MAGIC     0x46545031UL              /* "FTP1" */
+#define PATCH_HEAD_SIZE 16
+#define PATCH_REC_SIZE  8
+#define PATCH_ALL_SECTORS ((1U << FT_SECTORS) - 1)
+
+#define PATCH_OK        0
+#define PATCH_END       1                         /* patch_read_rec: no more records */
+#define PATCH_ERR_IO   -1
+#define PATCH_ERR_DATA -2                         /* not a patch / corrupt record */
+
+/* Return bytes read, < 0 on error, 0 = end of input */
+typedef LONG (*PatchReadFn)(void *handle, UBYTE *buf, LONG len);
+
+struct PatchHead {
+  ULONG baseCrc, newCrc;                          /* whole image */
+  ULONG count;                                    /* records */
+};
+
+struct PatchRec {
+  UWORD track, mask;
+  ULONG baseCrc;                                  /* track before patching */
+  UBYTE data[FT_TRACK_SIZE];                      /* sectors in mask, packed */
+};
+
+struct PatchIn {
+  PatchReadFn rd;
+  void       *h;
+  ULONG       left;                               /* records still to read */
+  LONG        last;                               /* last track read, -1 = none */
+};
+
+ULONG patch_sectors(UWORD mask);                  /* sectors in a mask */
+ULONG patch_rec_len(const struct PatchRec *r);    /* bytes of the record on file */
+
+/* Make: record for track t if base and next differ; 0 = identical */
+UWORD patch_diff(struct PatchRec *r, UWORD t, const UBYTE *base, const UBYTE *next);
+void  patch_put_head(UBYTE out[PATCH_HEAD_SIZE], const struct PatchHead *ph);
+void  patch_put_rec(UBYTE out[PATCH_REC_SIZE], const struct PatchRec *r);   /* data follows */
+
+/* Apply: records come out in ascending track order */
+int   patch_open(struct PatchIn *pi, struct PatchHead *ph, PatchReadFn rd, void *h);
+int   patch_read_rec(struct PatchIn *pi, struct PatchRec *r);
+void  patch_apply(const struct PatchRec *r, UBYTE *track);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * ftport.h - types and floppy geometry shared by FloppyTool (AmigaOS)
+ * and the host-side tools in host/ (Linux).
+ *
+ * Modules that include only this header (fthash.c, ...) build on both:
+ *   vc +aos68k -c fthash.c
+ *   cc -O2 -I. -c fthash.c
+ */
+#ifndef FTPORT_H
+#define FTPORT_H
+
+#if defined(__amigaos__) || defined(AMIGA) || defined(__AMIGA__)
+#include <exec/types.h>
+#else
+#include <stdint.h>
+typedef uint8_t  UBYTE;
+typedef int8_t   BYTE;
+typedef uint16_t UWORD;
+typedef int16_t  WORD;
+typedef uint32_t ULONG;
+typedef int32_t  LONG;
+typedef short    BOOL;
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+#endif
+
+/* Floppy geometry (DD), same values as floppytool.c */
+#define FT_TRACKS       160
+#define FT_SECTORS      11
+#define FT_SECTOR_SIZE  512
+#define FT_TRACK_SIZE   (FT_SECTORS*FT_SECTOR_SIZE)   /* 5632 bytes */
+#define FT_DISK_SIZE    (FT_TRACKS*FT_TRACK_SIZE)     /* 901120 bytes */
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * fttrace.c - event trace ring and Chrome trace JSON (see fttrace.h).
+ * No allocation; the host clock is the only OS call.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "fttrace.h"
+
+#if !defined(__amigaos__) && !defined(AMIGA) && !defined(__AMIGA__)
+#include <time.h>
+
+ULONG trace_host_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ULONG)ts.tv_sec * 1000000UL + (ULONG)(ts.tv_nsec / 1000);
+}
+#endif
+
+#define OPEN_MAX 16                        /* async ids tracked during export */
+
+struct TraceRing *gTrace = NULL;
+
+void trace_init(struct TraceRing *r, TraceClockFn clock, ULONG freq) {
+  r->clock = clock;
+  r->freq  = freq ? freq : 1;
+  r->head  = 0;
+}
+
+void trace_add(struct TraceRing *r, UBYTE ph, const char *cat, const char *name, ULONG id) {
+  struct TraceEv *e = &r->ev[r->head & (TRACE_EVENTS - 1)];
+  e->ts   = r->clock();
+  e->cat  = cat;
+  e->name = name;
+  e->id   = id;
+  e->ph   = ph;
+  r->head++;
+}
+
+/* ticks -> microseconds without 32-bit overflow (f up to ~4 MHz) */
+static ULONG ticks_us(ULONG t, ULONG f) {
+  ULONG r = (t % f) * 1000;
+  return (t / f) * 1000000UL + (r / f) * 1000 + (r % f) * 1000 / f;
+}
+
+static int put(TraceWriteFn wr, void *h, const char *s) {
+  LONG n = (LONG)strlen(s);
+  return wr(h, (const UBYTE *)s, n) == n ? 0 : -1;
+}
+
+/* Names are literals from our own call sites; still keep the JSON valid */
+static void json_str(char *out, const char *s, size_t max) {
+  size_t n = 0;
+  for (; *s && n + 3 < max; ++s) {
+    if (*s == '"' || *s == '\\') out[n++] = '\\';
+    out[n++] = (*s < ' ') ? ' ' : *s;
+  }
+  out[n] = '\0';
+}
+
+int trace_json(const struct TraceRing *r, TraceWriteFn wr, void *h) {
+  ULONG n = r->head < TRACE_EVENTS ? r->head : TRACE_EVENTS;
+  ULONG first = r->head - n;
+  ULONG t0 = n ? r->ev[first & (TRACE_EVENTS - 1)].ts : 0;
+  ULONG depth = 0, open[OPEN_MAX], nOpen = 0;
+  BOOL comma = FALSE;
+  char line[200], cat[40], name[60];
+
+  if (put(wr, h, "{\"traceEvents\":[\n")) return -1;
+  for (ULONG i = first; i != r->head; ++i) {
+    const struct TraceEv *e = &r->ev[i & (TRACE_EVENTS - 1)];
+    /* The ring may have dropped the start of a pair: skip its unmatched end */
+    if (e->ph == 'B') depth++;
+    else if (e->ph == 'E') { if (!depth) continue; depth--; }
+    else if (e->ph == 'b') { if (nOpen < OPEN_MAX) open[nOpen++] = e->id; }
+    else if (e->ph == 'e') {
+      ULONG k = 0;
+      while (k < nOpen && open[k] != e->id) k++;
+      if (k == nOpen) continue;
+      open[k] = open[--nOpen];
+    }
+    json_str(cat, e->cat, sizeof(cat));
+    json_str(name, e->name, sizeof(name));
+    sprintf(line, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%lu,\"pid\":1,\"tid\":1",
+            comma ? ",\n" : "", name, cat, (char)e->ph, (unsigned long)ticks_us(e->ts - t0, r->freq));
+    if (e->ph == 'b' || e->ph == 'e') sprintf(line + strlen(line), ",\"id\":\"0x%lx\"", (unsigned long)e->id);
+    if (e->ph == 'i') strcat(line, ",\"s\":\"t\"");
+    strcat(line, "}");
+    if (put(wr, h, line)) return -1;
+    comma = TRUE;
+  }
+  sprintf(line, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"events\":%lu,\"dropped\":%lu}}\n",
+          (unsigned long)n, (unsigned long)first);
+  return put(wr, h, line);
+}
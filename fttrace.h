@@ -0,0 +1,62 @@
+/*
+ * fttrace.h - fixed-size event trace ring with Chrome trace export.
+ *
+ * Call sites record begin/end pairs (or async begin/end by id) with a
+ * timestamp from the ring's clock: the E-clock of timer.device in
+ * FloppyTool, CLOCK_MONOTONIC on the host. Recording never allocates; the
+ * ring keeps the last TRACE_EVENTS events. trace_json() writes them in the
+ * Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+ *
+ * gTrace is NULL while tracing is off, so the TRACE_* macros cost one
+ * pointer test; built with -DFT_NOTRACE they compile to nothing.
+ * Not thread-safe: one ring per thread.
+ */
+#ifndef FTTRACE_H
+#define FTTRACE_H
+
+#include "ftport.h"
+
+#define TRACE_EVENTS 4096                  /* power of two */
+
+typedef ULONG (*TraceClockFn)(void);
+typedef LONG  (*TraceWriteFn)(void *handle, const UBYTE *buf, LONG len);
+
+struct TraceEv {
+  const char *cat, *name;                  /* string literals, not copied */
+  ULONG ts;                                /* clock ticks */
+  ULONG id;                                /* async events */
+  UBYTE ph;                                /* 'B' 'E' begin/end, 'b' 'e' async, 'i' instant */
+};
+
+struct TraceRing {
+  TraceClockFn clock;
+  ULONG freq;                              /* clock ticks per second */
+  ULONG head;                              /* events recorded so far */
+  struct TraceEv ev[TRACE_EVENTS];
+};
+
+extern struct TraceRing *gTrace;           /* NULL = off */
+
+void  trace_init(struct TraceRing *r, TraceClockFn clock, ULONG freq);
+void  trace_add(struct TraceRing *r, UBYTE ph, const char *cat, const char *name, ULONG id);
+/* 0 ok, -1 write error. Timestamps are relative to the oldest event kept
+   and must span less than 2^32 ticks (about 100 min of E-clock). */
+int   trace_json(const struct TraceRing *r, TraceWriteFn wr, void *h);
+
+#if !defined(__amigaos__) && !defined(AMIGA) && !defined(__AMIGA__)
+ULONG trace_host_clock(void);              /* microseconds, freq 1000000 */
+#endif
+
+#ifdef FT_NOTRACE
+#define TRACE_BEGIN(cat,name)
+#define TRACE_END(cat,name)
+#define TRACE_ASYNC_BEGIN(cat,name,id)
+#define TRACE_ASYNC_END(cat,name,id)
+#else
+#define TRACE_BEGIN(cat,name)          do { if (gTrace) trace_add(gTrace, 'B', (cat), (name), 0); } while (0)
+#define TRACE_END(cat,name)            do { if (gTrace) trace_add(gTrace, 'E', (cat), (name), 0); } while (0)
+#define TRACE_ASYNC_BEGIN(cat,name,id) do { if (gTrace) trace_add(gTrace, 'b', (cat), (name), (id)); } while (0)
+#define TRACE_ASYNC_END(cat,name,id)   do { if (gTrace) trace_add(gTrace, 'e', (cat), (name), (id)); } while (0)
+#endif
+
+#endif
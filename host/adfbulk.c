@@ -0,0 +1,548 @@
+/*
+ * adfbulk - parallel bulk verification of ADF archives (Linux host tool)
+ *
+ * Walks directory trees for .adf/.adz/.dms images and checks each one the
+ * way Verify ADF does, plus a structural check of the filesystem:
+ *   size    901,120 (DD) or 1,802,240 (HD) bytes after unpacking
+ *   boot    DOS\n type; bootblock checksum when there is boot code
+ *   root    root block type/secondary type/checksum, bitmap flag and
+ *           bitmap block checksums
+ *   hashes  CRC32, MD5, SHA-1 (and a DAT name with -d index.fdx)
+ * Raw images are memory-mapped; .adz/.dms are unpacked with ftgz.c/ftdms.c.
+ *
+ * Files are spread over per-thread deques; a thread that runs dry steals
+ * the back half of the fullest deque, so a few huge or slow files do not
+ * leave the other cores idle.
+ *
+ * Results are cached by path + mtime + size (default .adfbulk.cache in the
+ * current directory): re-runs only open new or changed files.
+ *
+ *   adfbulk [-j threads] [-f csv|json] [-o report] [-c cache] [-d index.fdx] DIR|FILE ...
+ *
+ * Status per image: ok, warn (bitmap invalid/bad bitmap checksum), bad
+ * (size, unpack or root block error), error (cannot open/read).
+ * Throughput (images/s, GB/s of image data) goes to stderr.
+ *
+ * Build: cc -O2 -pthread -I. -o adfbulk host/adfbulk.c fthash.c ftkern.c ftgz.c ftdms.c ftdat.c
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ftport.h"
+#include "fthash.h"
+#include "ftkern.h"
+#include "ftgz.h"
+#include "ftdms.h"
+#include "ftdat.h"
+
+#define BLOCK_SIZE   512
+#define MAX_IMAGE    (2 * FT_DISK_SIZE)                  /* HD */
+#define MAX_THREADS  64
+#define CACHE_MAGIC  "adfbulk-cache 1"
+
+struct Result {
+  char  status[8];                     /* ok / warn / bad / error */
+  char  fmt[4];                        /* adf / adz / dms */
+  char  fs[8];                         /* DOS0..DOS7, NDOS, - */
+  ULONG size, crc;
+  UBYTE md5[MD5_LEN], sha1[SHA1_LEN];
+  char  note[96];
+};
+
+struct Item {
+  char  *path;
+  long long mtime;                     /* ns */
+  long long fsize;
+  int    cached;
+  struct Result r;
+  char   name[DAT_NAME_MAX];           /* DAT name, not cached */
+};
+
+static struct Item *items;
+static size_t nItems, capItems;
+
+static void *xrealloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (!p) { fprintf(stderr, "out of memory\n"); exit(1); }
+  return p;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* ----- Directory walk ----- */
+
+static int is_image(const char *name) {
+  const char *dot = strrchr(name, '.');
+  return dot && (!strcasecmp(dot, ".adf") || !strcasecmp(dot, ".adz") || !strcasecmp(dot, ".dms"));
+}
+
+static void add_file(const char *path, const struct stat *st) {
+  if (nItems == capItems) { capItems = capItems ? capItems * 2 : 1024; items = xrealloc(items, capItems * sizeof(*items)); }
+  struct Item *it = &items[nItems++];
+  memset(it, 0, sizeof(*it));
+  it->path  = strdup(path);
+  it->mtime = (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+  it->fsize = (long long)st->st_size;
+}
+
+static void walk(const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0) { perror(path); return; }
+  if (S_ISREG(st.st_mode)) { add_file(path, &st); return; }
+  if (!S_ISDIR(st.st_mode)) return;
+  DIR *d = opendir(path);
+  if (!d) { perror(path); return; }
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2]))) continue;
+    char *sub = xrealloc(NULL, strlen(path) + strlen(de->d_name) + 2);
+    sprintf(sub, "%s/%s", path, de->d_name);
+    if (de->d_type == DT_DIR) walk(sub);
+    else if ((de->d_type == DT_REG || de->d_type == DT_LNK || de->d_type == DT_UNKNOWN) && is_image(de->d_name)) {
+      if (stat(sub, &st) == 0 && S_ISREG(st.st_mode)) add_file(sub, &st);
+      else if (S_ISDIR(st.st_mode)) walk(sub);
+    }
+    free(sub);
+  }
+  closedir(d);
+}
+
+/* ----- Result cache: path \t mtime \t size \t result fields ----- */
+
+static int cmp_path(const void *a, const void *b) {
+  return strcmp(((const struct Item *)a)->path, ((const struct Item *)b)->path);
+}
+
+static int parse_hex(const char *s, UBYTE *out, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    unsigned v;
+    if (sscanf(s + 2 * i, "%2x", &v) != 1) return 0;
+    out[i] = (UBYTE)v;
+  }
+  return 1;
+}
+
+/* items must be sorted by path */
+static size_t cache_load(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) return 0;
+  char line[8192];
+  size_t hits = 0;
+  if (!fgets(line, sizeof(line), f) || strncmp(line, CACHE_MAGIC, strlen(CACHE_MAGIC))) { fclose(f); return 0; }
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\n")] = '\0';
+    char *field[11];
+    int n = 0;
+    for (char *p = line; n < 11; ) {
+      field[n++] = p;
+      char *tab = strchr(p, '\t');
+      if (!tab) break;
+      *tab = '\0';
+      p = tab + 1;
+    }
+    if (n != 11) continue;
+
+    struct Item key;
+    key.path = field[0];
+    struct Item *it = bsearch(&key, items, nItems, sizeof(*items), cmp_path);
+    if (!it || it->mtime != atoll(field[1]) || it->fsize != atoll(field[2])) continue;
+
+    struct Result r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.status, sizeof(r.status), "%s", field[3]);
+    snprintf(r.fmt, sizeof(r.fmt), "%s", field[4]);
+    snprintf(r.fs, sizeof(r.fs), "%s", field[5]);
+    r.size = (ULONG)strtoul(field[6], NULL, 10);
+    r.crc  = (ULONG)strtoul(field[7], NULL, 16);
+    if (strlen(field[8]) != 2 * MD5_LEN || !parse_hex(field[8], r.md5, MD5_LEN)) continue;
+    if (strlen(field[9]) != 2 * SHA1_LEN || !parse_hex(field[9], r.sha1, SHA1_LEN)) continue;
+    snprintf(r.note, sizeof(r.note), "%s", field[10]);
+    it->r = r;
+    it->cached = 1;
+    hits++;
+  }
+  fclose(f);
+  return hits;
+}
+
+static void cache_save(const char *path) {
+  char tmp[4096];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *f = fopen(tmp, "w");
+  if (!f) { perror(tmp); return; }
+  fprintf(f, "%s\n", CACHE_MAGIC);
+  for (size_t i = 0; i < nItems; ++i) {
+    const struct Item *it = &items[i];
+    if (!strcmp(it->r.status, "error") || strchr(it->path, '\t') || strchr(it->path, '\n')) continue;
+    char md5[2 * MD5_LEN + 1], sha1[2 * SHA1_LEN + 1];
+    hash_hex(it->r.md5, MD5_LEN, md5);
+    hash_hex(it->r.sha1, SHA1_LEN, sha1);
+    fprintf(f, "%s\t%lld\t%lld\t%s\t%s\t%s\t%lu\t%08lx\t%s\t%s\t%s\n", it->path, it->mtime, it->fsize,
+            it->r.status, it->r.fmt, it->r.fs, (unsigned long)it->r.size, (unsigned long)it->r.crc, md5, sha1, it->r.note);
+  }
+  if (fclose(f) != 0 || rename(tmp, path) != 0) perror(path);
+}
+
+/* ----- Checks ----- */
+
+static ULONG get32(const UBYTE *p) {
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+
+/* Bootblock: add-with-carry over 1024 bytes, valid when it ends as ~0 */
+static int boot_sum_ok(const UBYTE *b) {
+  ULONG sum = 0;
+  for (int i = 0; i < 256; ++i) {
+    ULONG v = get32(b + 4 * i), s = sum + v;
+    if (s < sum) s++;
+    sum = s;
+  }
+  return sum == 0xFFFFFFFFUL;
+}
+
+/* Header/bitmap blocks: plain sum of the 128 longs is 0 */
+static int block_sum_ok(const UBYTE *b) {
+  return kern_sum(b, BLOCK_SIZE) == 0;
+}
+
+static void note_add(struct Result *r, const char *msg) {
+  size_t n = strlen(r->note);
+  snprintf(r->note + n, sizeof(r->note) - n, "%s%s", n ? "; " : "", msg);
+}
+
+static void check_structure(const UBYTE *img, ULONG size, struct Result *r) {
+  if (size != FT_DISK_SIZE && size != 2 * FT_DISK_SIZE) {
+    char m[48]; snprintf(m, sizeof(m), "size %lu", (unsigned long)size);
+    strcpy(r->status, "bad"); strcpy(r->fs, "-"); note_add(r, m);
+    return;
+  }
+  ULONG blocks = size / BLOCK_SIZE;
+  if (memcmp(img, "DOS", 3) != 0 || img[3] > 7) { strcpy(r->fs, "NDOS"); note_add(r, "non-DOS bootblock"); return; }
+  snprintf(r->fs, sizeof(r->fs), "DOS%u", (unsigned)img[3]);
+  int bootCode = 0;
+  for (int i = 12; i < 1024 && !bootCode; ++i) bootCode = img[i] != 0;
+  if (bootCode && !boot_sum_ok(img)) note_add(r, "boot code, bad checksum");
+
+  const UBYTE *root = img + (blocks / 2) * BLOCK_SIZE;
+  if (get32(root) != 2 || get32(root + 508) != 1 || !block_sum_ok(root)) {
+    strcpy(r->status, "bad"); note_add(r, "root block invalid");
+    return;
+  }
+  if (get32(root + 312) != 0xFFFFFFFFUL) { strcpy(r->status, "warn"); note_add(r, "bitmap invalid"); }
+  for (int i = 0; i < 25; ++i) {
+    ULONG bm = get32(root + 316 + 4 * i);
+    if (!bm) break;
+    if (bm >= blocks || !block_sum_ok(img + bm * BLOCK_SIZE)) {
+      strcpy(r->status, "warn"); note_add(r, "bad bitmap block");
+      break;
+    }
+  }
+}
+
+struct MemSrc { const UBYTE *p; ULONG len, pos; };
+
+static LONG mem_read(void *h, UBYTE *buf, LONG len) {
+  struct MemSrc *m = (struct MemSrc *)h;
+  ULONG n = m->len - m->pos;
+  if (n > (ULONG)len) n = (ULONG)len;
+  memcpy(buf, m->p + m->pos, n);
+  m->pos += n;
+  return (LONG)n;
+}
+
+struct Worker {
+  struct GzIn  gz;
+  struct DmsIn dms;
+  UBYTE        img[MAX_IMAGE + 1];
+  unsigned long long bytes;            /* image bytes hashed */
+};
+
+/* One read's worth of room left in Worker.img; the last byte only shows
+ * that an image runs past MAX_IMAGE */
+static LONG read_room(LONG got) {
+  LONG room = MAX_IMAGE + 1 - got;
+  return room < FT_TRACK_SIZE ? room : FT_TRACK_SIZE;
+}
+
+static void check_file(struct Worker *w, struct Item *it) {
+  struct Result *r = &it->r;
+  memset(r, 0, sizeof(*r));
+  strcpy(r->status, "ok");
+  strcpy(r->fs, "-");
+
+  int fd = open(it->path, O_RDONLY);
+  if (fd < 0) { strcpy(r->status, "error"); snprintf(r->note, sizeof(r->note), "%s", strerror(errno)); return; }
+  const UBYTE *map = NULL;
+  if (it->fsize > 0) {
+    map = mmap(NULL, (size_t)it->fsize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd); strcpy(r->status, "error"); snprintf(r->note, sizeof(r->note), "%s", strerror(errno)); return;
+    }
+    madvise((void *)map, (size_t)it->fsize, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  const UBYTE *img = map;
+  ULONG size = (ULONG)it->fsize;
+  struct MemSrc src = { map, (ULONG)it->fsize, 0 };
+  if (it->fsize >= 4 && !memcmp(map, "DMS!", 4)) {
+    strcpy(r->fmt, "dms");
+    int rc = dms_open(&w->dms, mem_read, &src);
+    LONG n = 0, got = 0;
+    while (!rc && got <= MAX_IMAGE && (n = dms_read(&w->dms, w->img + got, read_room(got))) > 0) got += n;
+    if (rc || n < 0) { strcpy(r->status, "bad"); note_add(r, "DMS unpack error"); }
+    else if (got > MAX_IMAGE) { strcpy(r->status, "bad"); note_add(r, "oversize"); got = MAX_IMAGE; }
+    else if (w->dms.missing) note_add(r, "DMS cylinders missing");
+    img = w->img; size = (ULONG)got;
+  } else if (it->fsize >= 2 && map[0] == 0x1F && map[1] == 0x8B) {
+    strcpy(r->fmt, "adz");
+    int rc = gzin_open(&w->gz, mem_read, &src);
+    LONG n = 0, got = 0;
+    while (!rc && got <= MAX_IMAGE && (n = gzin_read(&w->gz, w->img + got, read_room(got))) > 0) got += n;
+    if (rc || n < 0) { strcpy(r->status, "bad"); note_add(r, "gzip error or CRC mismatch"); }
+    else if (got > MAX_IMAGE) { strcpy(r->status, "bad"); note_add(r, "oversize"); got = MAX_IMAGE; }
+    img = w->img; size = (ULONG)got;
+  } else {
+    strcpy(r->fmt, "adf");
+  }
+
+  struct Md5 m; struct Sha1 s;
+  md5_init(&m); sha1_init(&s);
+  r->crc = crc32_final(crc32_update(crc32_init(), img, size));
+  md5_update(&m, img, size);
+  sha1_update(&s, img, size);
+  md5_final(&m, r->md5);
+  sha1_final(&s, r->sha1);
+  r->size = size;
+  w->bytes += size;
+
+  if (strcmp(r->status, "bad")) check_structure(img, size, r);
+  if (map) munmap((void *)map, (size_t)it->fsize);
+}
+
+/* ----- Work-stealing pool ----- */
+
+struct Deque {
+  pthread_mutex_t lock;
+  size_t *idx;                         /* item indices; owner takes head, thieves the tail */
+  size_t  head, tail;
+};
+
+static struct Deque deques[MAX_THREADS];
+static int nThreads;
+
+static int deque_pop(struct Deque *d, size_t *out) {
+  int ok = 0;
+  pthread_mutex_lock(&d->lock);
+  if (d->head < d->tail) { *out = d->idx[d->head]; __atomic_store_n(&d->head, d->head + 1, __ATOMIC_RELAXED); ok = 1; }
+  pthread_mutex_unlock(&d->lock);
+  return ok;
+}
+
+/* Move the back half of the fullest other deque into ours */
+static int steal(int self) {
+  int victim = -1;
+  size_t best = 0;
+  for (int i = 0; i < nThreads; ++i) {
+    if (i == self) continue;
+    size_t n = __atomic_load_n(&deques[i].tail, __ATOMIC_RELAXED) - __atomic_load_n(&deques[i].head, __ATOMIC_RELAXED);
+    if (n > ((size_t)-1) / 2) n = 0;               /* unlocked read, only a hint */
+    if (n > best) { best = n; victim = i; }
+  }
+  if (victim < 0) return 0;
+
+  struct Deque *v = &deques[victim], *me = &deques[self];
+  size_t buf[4096], n = 0;
+  pthread_mutex_lock(&v->lock);
+  size_t avail = v->tail - v->head;
+  n = avail > 1 ? avail / 2 : avail;
+  if (n > 4096) n = 4096;
+  memcpy(buf, v->idx + v->tail - n, n * sizeof(size_t));
+  __atomic_store_n(&v->tail, v->tail - n, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&v->lock);
+  if (!n) return 0;
+
+  pthread_mutex_lock(&me->lock);
+  memcpy(me->idx, buf, n * sizeof(size_t));      /* our deque is empty: reuse from 0 */
+  __atomic_store_n(&me->head, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&me->tail, n, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&me->lock);
+  return 1;
+}
+
+static void *worker_main(void *arg) {
+  int self = (int)(long)arg;
+  struct Worker *w = malloc(sizeof(*w));
+  if (!w) { fprintf(stderr, "out of memory\n"); exit(1); }
+  w->bytes = 0;
+  for (;;) {
+    size_t i;
+    if (deque_pop(&deques[self], &i)) { check_file(w, &items[i]); continue; }
+    int any = 0;
+    for (int tries = 0; tries < 3 && !any; ++tries) any = steal(self);
+    if (!any) {
+      /* everything drained? hints can miss a deque mid-steal, so re-check under the locks */
+      int left = 0;
+      for (int k = 0; k < nThreads && !left; ++k) {
+        pthread_mutex_lock(&deques[k].lock);
+        left = deques[k].head < deques[k].tail;
+        pthread_mutex_unlock(&deques[k].lock);
+      }
+      if (!left) break;
+    }
+  }
+  unsigned long long *bytes = malloc(sizeof(*bytes));
+  *bytes = w->bytes;
+  free(w);
+  return bytes;
+}
+
+/* ----- Report ----- */
+
+static void json_str(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+    else if ((UBYTE)*s < 0x20) fprintf(f, "\\u%04x", (unsigned)(UBYTE)*s);
+    else fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static void csv_str(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s; ++s) { if (*s == '"') fputc('"', f); fputc(*s, f); }
+  fputc('"', f);
+}
+
+static void report(FILE *f, int json) {
+  if (json) fprintf(f, "[\n");
+  else fprintf(f, "path,status,format,fs,size,crc32,md5,sha1,dat_name,note\n");
+  for (size_t i = 0; i < nItems; ++i) {
+    const struct Item *it = &items[i];
+    char md5[2 * MD5_LEN + 1], sha1[2 * SHA1_LEN + 1];
+    hash_hex(it->r.md5, MD5_LEN, md5);
+    hash_hex(it->r.sha1, SHA1_LEN, sha1);
+    if (json) {
+      fprintf(f, "  {\"path\": "); json_str(f, it->path);
+      fprintf(f, ", \"status\": \"%s\", \"format\": \"%s\", \"fs\": \"%s\", \"size\": %lu, \"crc32\": \"%08lx\", "
+                 "\"md5\": \"%s\", \"sha1\": \"%s\", \"dat_name\": ",
+              it->r.status, it->r.fmt, it->r.fs, (unsigned long)it->r.size, (unsigned long)it->r.crc, md5, sha1);
+      json_str(f, it->name);
+      fprintf(f, ", \"note\": "); json_str(f, it->r.note);
+      fprintf(f, "}%s\n", i + 1 < nItems ? "," : "");
+    } else {
+      csv_str(f, it->path);
+      fprintf(f, ",%s,%s,%s,%lu,%08lx,%s,%s,", it->r.status, it->r.fmt, it->r.fs,
+              (unsigned long)it->r.size, (unsigned long)it->r.crc, md5, sha1);
+      csv_str(f, it->name); fputc(',', f); csv_str(f, it->r.note); fputc('\n', f);
+    }
+  }
+  if (json) fprintf(f, "]\n");
+}
+
+static LONG file_read_at(void *h, ULONG off, UBYTE *buf, LONG len) {
+  if (fseek((FILE *)h, (long)off, SEEK_SET) != 0) return -1;
+  size_t n = fread(buf, 1, (size_t)len, (FILE *)h);
+  return (n == 0 && ferror((FILE *)h)) ? -1 : (LONG)n;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: adfbulk [-j threads] [-f csv|json] [-o report] [-c cache] [-d index.fdx] DIR|FILE ...\n");
+}
+
+int main(int argc, char **argv) {
+  const char *outPath = NULL, *cachePath = ".adfbulk.cache", *datPath = NULL;
+  int json = 0, opt;
+  nThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while ((opt = getopt(argc, argv, "j:f:o:c:d:")) != -1) {
+    switch (opt) {
+      case 'j': nThreads = atoi(optarg); break;
+      case 'f': if (!strcmp(optarg, "json")) json = 1; else if (strcmp(optarg, "csv")) { usage(); return 2; } break;
+      case 'o': outPath = optarg; break;
+      case 'c': cachePath = optarg; break;
+      case 'd': datPath = optarg; break;
+      default: usage(); return 2;
+    }
+  }
+  if (optind >= argc) { usage(); return 2; }
+  if (nThreads < 1) nThreads = 1;
+  if (nThreads > MAX_THREADS) nThreads = MAX_THREADS;
+
+  double t0 = now_sec();
+  for (int i = optind; i < argc; ++i) walk(argv[i]);
+  qsort(items, nItems, sizeof(*items), cmp_path);
+  size_t hits = cache_load(cachePath);
+
+  /* Uncached files, dealt to the deques in contiguous runs */
+  size_t todo = 0;
+  for (size_t i = 0; i < nItems; ++i) if (!items[i].cached) todo++;
+  size_t per = (todo + (size_t)nThreads - 1) / (size_t)nThreads, k = 0;
+  for (int t = 0; t < nThreads; ++t) {
+    pthread_mutex_init(&deques[t].lock, NULL);
+    deques[t].idx = xrealloc(NULL, (per > 4096 ? per : 4096) * sizeof(size_t));
+    deques[t].head = deques[t].tail = 0;
+  }
+  for (size_t i = 0; i < nItems; ++i) {
+    if (items[i].cached) continue;
+    struct Deque *d = &deques[k++ / (per ? per : 1)];
+    d->idx[d->tail++] = i;
+  }
+
+  (void)kern_get();                     /* pick the kernels and build the CRC tables before the threads */
+  double t1 = now_sec();
+  pthread_t tid[MAX_THREADS];
+  for (int t = 0; t < nThreads; ++t) pthread_create(&tid[t], NULL, worker_main, (void *)(long)t);
+  unsigned long long bytes = 0;
+  for (int t = 0; t < nThreads; ++t) {
+    void *ret;
+    pthread_join(tid[t], &ret);
+    bytes += *(unsigned long long *)ret;
+    free(ret);
+  }
+  double t2 = now_sec();
+
+  if (datPath) {
+    FILE *idx = fopen(datPath, "rb");
+    if (!idx) perror(datPath);
+    for (size_t i = 0; idx && i < nItems; ++i) {
+      struct DatHit hit;
+      if (dat_lookup(file_read_at, idx, items[i].r.sha1, &hit) == DAT_FOUND) snprintf(items[i].name, sizeof(items[i].name), "%s", hit.name);
+    }
+    if (idx) fclose(idx);
+  }
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) { perror(outPath); return 1; }
+  report(out, json);
+  if (outPath) fclose(out);
+  cache_save(cachePath);
+
+  size_t nOk = 0, nWarn = 0, nBad = 0, nErr = 0;
+  for (size_t i = 0; i < nItems; ++i) {
+    const char *s = items[i].r.status;
+    if (!strcmp(s, "ok")) nOk++; else if (!strcmp(s, "warn")) nWarn++; else if (!strcmp(s, "bad")) nBad++; else nErr++;
+  }
+  double dt = t2 - t1 > 1e-9 ? t2 - t1 : 1e-9;
+  fprintf(stderr, "%lu image(s): %lu ok, %lu warn, %lu bad, %lu error; %lu from cache\n",
+          (unsigned long)nItems, (unsigned long)nOk, (unsigned long)nWarn, (unsigned long)nBad,
+          (unsigned long)nErr, (unsigned long)hits);
+  fprintf(stderr, "checked %lu in %.2f s on %d thread(s): %.0f images/s, %.2f GB/s (walk+cache %.2f s)\n",
+          (unsigned long)todo, dt, nThreads, todo / dt, bytes / dt / 1e9, t1 - t0);
+  return (nBad || nErr) ? 1 : 0;
+}
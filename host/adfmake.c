@@ -0,0 +1,174 @@
+/*
+ * adfmake - packs a directory tree into a new DD ADF (OFS or FFS) on a
+ * Linux host, for build pipelines: the result goes straight to Write ADF,
+ * Station or a queued write.
+ *
+ *   adfmake [-f] [-i] [-b | -B boot.bin] [-n label] out.adf dir
+ *
+ *   -f   FFS (DOS\1) instead of OFS (DOS\0)
+ *   -i   international mode (DOS\2 / DOS\3)
+ *   -b   install the standard boot block
+ *   -B   install the boot code of a 1,024-byte boot block file
+ *   -n   volume name (default: the directory's name)
+ *
+ * Entries are added in name order and each file is one contiguous run of
+ * blocks (see ftofs.h), so the image is reproducible: with SOURCE_DATE_EPOCH
+ * set, the volume gets that date and no file is dated later. A file not
+ * writable by its owner gets the W and D protection bits. Symlinks are
+ * followed; other special files are skipped.
+ *
+ * Exit status: 0 ok, 1 error (name, disk full, I/O), 2 usage.
+ *
+ * Build: cc -O2 -I. -o adfmake host/adfmake.c ftofs.c
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "ftport.h"
+#include "ftofs.h"
+
+#define AMIGA_EPOCH 252460800L                    /* 1978-01-01 in Unix time */
+#define PROT_W      0x04
+#define PROT_D      0x01
+
+static struct OfsVol vol;
+static UBYTE img[FT_DISK_SIZE];
+static time_t clampTime = 0;                      /* SOURCE_DATE_EPOCH, 0 = none */
+static unsigned long nFiles, nDirs;
+
+static struct OfsDate amiga_date(time_t t) {
+  struct OfsDate d = { 0, 0, 0 };
+  if (clampTime && t > clampTime) t = clampTime;
+  if (t < AMIGA_EPOCH) return d;
+  t -= AMIGA_EPOCH;
+  d.days  = (ULONG)(t / 86400);
+  d.mins  = (ULONG)(t % 86400 / 60);
+  d.ticks = (ULONG)(t % 60 * 50);
+  return d;
+}
+
+static const char *ofs_error(LONG rc) {
+  switch (rc) {
+    case OFS_ERR_FULL:   return "disk full";
+    case OFS_ERR_NAME:   return "name not valid on AmigaDOS (1-30 chars, no ':' or '/')";
+    case OFS_ERR_EXISTS: return "name clashes (AmigaDOS names ignore case)";
+    default:             return "internal error";
+  }
+}
+
+static UBYTE *load_file(const char *path, ULONG *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) { perror(path); return NULL; }
+  UBYTE *buf = (UBYTE *)malloc(FT_DISK_SIZE + 1);
+  size_t n = buf ? fread(buf, 1, FT_DISK_SIZE + 1, f) : 0;
+  int err = ferror(f);
+  fclose(f);
+  if (!buf || err) { fprintf(stderr, "%s: read error\n", path); free(buf); return NULL; }
+  if (n > FT_DISK_SIZE) { fprintf(stderr, "%s: larger than a floppy\n", path); free(buf); return NULL; }
+  *len = (ULONG)n;
+  return buf;
+}
+
+static int add_tree(const char *path, ULONG parent) {
+  struct dirent **ents;
+  int n = scandir(path, &ents, NULL, alphasort);
+  if (n < 0) { perror(path); return 1; }
+  int status = 0;
+  for (int i = 0; i < n; ++i) {
+    const char *name = ents[i]->d_name;
+    char sub[4096];
+    struct stat st;
+    if (status || !strcmp(name, ".") || !strcmp(name, "..")) continue;
+    snprintf(sub, sizeof(sub), "%s/%s", path, name);
+    if (stat(sub, &st)) { perror(sub); status = 1; continue; }
+
+    struct OfsDate d = amiga_date(st.st_mtime);
+    LONG rc;
+    if (S_ISDIR(st.st_mode)) {
+      rc = ofs_mkdir(&vol, parent, name, &d);
+      if (rc > 0) { nDirs++; status = add_tree(sub, (ULONG)rc); }
+    } else if (S_ISREG(st.st_mode)) {
+      ULONG len;
+      UBYTE *data = load_file(sub, &len);
+      if (!data) { status = 1; continue; }
+      rc = ofs_add_file(&vol, parent, name, data, len, &d, (st.st_mode & S_IWUSR) ? 0 : PROT_W | PROT_D);
+      free(data);
+      if (rc > 0) nFiles++;
+    } else {
+      fprintf(stderr, "%s: not a file or directory, skipped\n", sub);
+      continue;
+    }
+    if (rc < 0) { fprintf(stderr, "%s: %s\n", sub, ofs_error(rc)); status = 1; }
+  }
+  for (int i = 0; i < n; ++i) free(ents[i]);
+  free(ents);
+  return status;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: adfmake [-f] [-i] [-b | -B boot.bin] [-n label] out.adf dir\n");
+}
+
+int main(int argc, char **argv) {
+  UBYTE dosType = 0;
+  int stdBoot = 0;
+  const char *bootPath = NULL, *label = NULL;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strcmp(argv[i], "-f")) dosType |= OFS_FFS;
+    else if (!strcmp(argv[i], "-i")) dosType |= OFS_INTL;
+    else if (!strcmp(argv[i], "-b")) stdBoot = 1;
+    else if (!strcmp(argv[i], "-B") && i + 1 < argc) bootPath = argv[++i];
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc) label = argv[++i];
+    else { usage(); return 2; }
+  }
+  if (argc - i != 2 || (stdBoot && bootPath)) { usage(); return 2; }
+  const char *outPath = argv[i], *dir = argv[i + 1];
+
+  struct stat st;
+  if (stat(dir, &st) || !S_ISDIR(st.st_mode)) { fprintf(stderr, "%s: not a directory\n", dir); return 1; }
+  if (!label) {
+    char *slash = strrchr(dir, '/');
+    label = (slash && slash[1]) ? slash + 1 : dir;
+  }
+
+  const char *sde = getenv("SOURCE_DATE_EPOCH");
+  time_t now = time(NULL);
+  if (sde && *sde) now = clampTime = (time_t)strtoll(sde, NULL, 10);
+  struct OfsDate d = amiga_date(now);
+  if (ofs_format(&vol, img, dosType, label, &d)) { fprintf(stderr, "%s: %s\n", label, ofs_error(OFS_ERR_NAME)); return 1; }
+
+  if (stdBoot) ofs_bootblock(&vol, NULL, 0);
+  if (bootPath) {
+    ULONG len;
+    UBYTE *bb = load_file(bootPath, &len);
+    if (!bb) return 1;
+    if (len != OFS_BOOT_SIZE || memcmp(bb, "DOS", 3)) {
+      fprintf(stderr, "%s: not a 1,024-byte DOS boot block\n", bootPath);
+      free(bb);
+      return 1;
+    }
+    ofs_bootblock(&vol, bb + 12, OFS_BOOT_SIZE - 12);
+    free(bb);
+  }
+
+  if (add_tree(dir, OFS_ROOT)) return 1;
+  ofs_finish(&vol);
+
+  FILE *f = fopen(outPath, "wb");
+  if (!f) { perror(outPath); return 1; }
+  int status = fwrite(img, 1, FT_DISK_SIZE, f) != FT_DISK_SIZE;
+  if (fclose(f)) status = 1;
+  if (status) { perror(outPath); return 1; }
+
+  printf("%s: DOS%u \"%s\", %lu file(s), %lu dir(s), %lu/%u blocks used (%lu KB free), %lu file(s) fragmented\n",
+         outPath, (unsigned)dosType, label, nFiles, nDirs, (unsigned long)vol.used, (unsigned)OFS_BLOCKS,
+         (unsigned long)ofs_free(&vol) * ((dosType & OFS_FFS) ? OFS_BLOCK_SIZE : OFS_DATA_SIZE) / 1024,
+         (unsigned long)vol.split);
+  return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * adfmount - mounts a DD ADF (OFS or FFS) read-only on a Linux host, so
+ * the files inside images can be searched and copied without unpacking
+ * each one first.
+ *
+ *   adfmount image.adf mountpoint [FUSE options]   needs a -DFT_FUSE build
+ *   adfmount -l image.adf                          list the tree
+ *   adfmount -c image.adf path                     file to stdout
+ *   adfmount -g text image.adf...                  files containing text
+ *
+ * The image is memory-mapped and read with ftofs.c (see ftofs.h): a
+ * lookup follows only the hash chains on its way, a read decodes the
+ * file's block list only as far as the offset asked for, and recent names
+ * and block lists stay cached, so grep -r over a mount reads the
+ * directory blocks plus the blocks of the files it opens. -l, -c and -g
+ * drive the same getattr/readdir/read/readlink functions the FUSE
+ * callbacks use, with no kernel mount (a stand-in for CI and for hosts
+ * without FUSE); -g works like grep -rl and reports on stderr how many of
+ * the 1,760 blocks each image needed.
+ *
+ * Protection: RWED bits map to the owner's r/x, as AmigaDOS stores them
+ * inverted; nothing is writable. Hard links appear as the entry they
+ * point to, soft links as symlinks to their AmigaDOS target.
+ *
+ * host/fixtures/adfmount/check.sh runs -l, -c and -g over adfmake images
+ * of a generated tree (DOS0 to DOS3) and compares them with the source.
+ *
+ * Exit status: 0 ok (-g: a match), 1 error (-g: no match), 2 usage.
+ *
+ * Build: cc -O2 -I. -o adfmount host/adfmount.c ftofs.c
+ *   with FUSE: cc -O2 -DFT_FUSE -I. -o adfmount host/adfmount.c ftofs.c $(pkg-config --cflags --libs fuse3)
+ */
+#define _GNU_SOURCE
+#ifdef FT_FUSE
+#define FUSE_USE_VERSION 31
+#include <fuse.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ftport.h"
+#include "ftofs.h"
+
+#define AMIGA_EPOCH 252460800L                    /* 1978-01-01 in Unix time */
+#define PROT_R      0x08
+#define PROT_E      0x02
+#define CHUNK       32768
+
+static struct OfsRd rd;                           /* one image at a time; not thread-safe */
+static const UBYTE *map;
+
+static int map_image(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { perror(path); return 1; }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size != FT_DISK_SIZE) {
+    fprintf(stderr, "%s: not a %d-byte ADF\n", path, FT_DISK_SIZE);
+    close(fd);
+    return 1;
+  }
+  void *p = mmap(NULL, FT_DISK_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) { perror(path); return 1; }
+  map = p;
+  if (ofs_rd_open(&rd, map)) {
+    fprintf(stderr, "%s: no OFS/FFS filesystem\n", path);
+    munmap(p, FT_DISK_SIZE);
+    map = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+static void unmap_image(void) {
+  if (map) munmap((void *)map, FT_DISK_SIZE);
+  map = NULL;
+}
+
+static int fs_errno(int rc) {
+  switch (rc) {
+    case OFS_ERR_NOENT:  return -ENOENT;
+    case OFS_ERR_NOTDIR: return -ENOTDIR;
+    default:             return -EIO;
+  }
+}
+
+static void ent_stat(const struct OfsEnt *e, struct stat *st) {
+  memset(st, 0, sizeof(*st));
+  mode_t m = 0;
+  if (!(e->protect & PROT_R)) m |= 0444;
+  if (!(e->protect & PROT_E) || e->kind == OFS_ENT_DIR) m |= 0111;
+  switch (e->kind) {
+    case OFS_ENT_DIR:      st->st_mode = S_IFDIR | (m & 0555); st->st_nlink = 2; break;
+    case OFS_ENT_SOFTLINK: st->st_mode = S_IFLNK | 0777; st->st_nlink = 1; break;
+    default:               st->st_mode = S_IFREG | (m & 0555); st->st_nlink = 1; break;
+  }
+  st->st_ino  = e->block;
+  st->st_size = e->size;
+  st->st_blocks = (e->size + 511) / 512;
+  st->st_uid  = getuid();
+  st->st_gid  = getgid();
+  st->st_mtime = st->st_ctime = st->st_atime =
+    AMIGA_EPOCH + (time_t)e->date.days * 86400 + e->date.mins * 60 + e->date.ticks / 50;
+}
+
+/* ====== Filesystem operations (FUSE and the harness) ====== */
+
+typedef int (*FillFn)(void *h, const char *name, const struct stat *st);
+
+static int fs_getattr(const char *path, struct stat *st) {
+  struct OfsEnt e;
+  int rc = ofs_rd_lookup(&rd, path, &e);
+  if (rc) return fs_errno(rc);
+  ent_stat(&e, st);
+  return 0;
+}
+
+static int fs_readdir(const char *path, FillFn fill, void *h) {
+  struct OfsEnt e;
+  int rc = ofs_rd_lookup(&rd, path, &e);
+  if (rc) return fs_errno(rc);
+  if (e.kind != OFS_ENT_DIR) return -ENOTDIR;
+  ULONG dir = e.block, cursor = 0;
+  struct stat st;
+  for (ULONG n = 0; n < OFS_BLOCKS; ++n) {
+    rc = ofs_rd_readdir(&rd, dir, &cursor, &e);
+    if (rc == OFS_END) return 0;
+    if (rc) return fs_errno(rc);
+    ent_stat(&e, &st);
+    if (fill(h, e.name, &st)) return 0;
+  }
+  return -EIO;                                    /* looping hash chain */
+}
+
+static int fs_read(const char *path, char *buf, size_t size, off_t off) {
+  struct OfsEnt e;
+  int rc = ofs_rd_lookup(&rd, path, &e);
+  if (rc) return fs_errno(rc);
+  if (e.kind == OFS_ENT_DIR) return -EISDIR;
+  if (off < 0 || off >= (off_t)e.size) return 0;
+  LONG n = ofs_rd_read(&rd, &e, (ULONG)off, (UBYTE *)buf, size > CHUNK ? CHUNK : (ULONG)size);
+  return n < 0 ? -EIO : (int)n;
+}
+
+static int fs_readlink(const char *path, char *buf, size_t size) {
+  struct OfsEnt e;
+  int rc = ofs_rd_lookup(&rd, path, &e);
+  if (rc) return fs_errno(rc);
+  if (e.kind != OFS_ENT_SOFTLINK) return -EINVAL;
+  return ofs_rd_readlink(&rd, &e, buf, (ULONG)size) ? -EIO : 0;
+}
+
+#ifdef FT_FUSE
+/* ====== FUSE ====== */
+
+static int fu_getattr(const char *path, struct stat *st, struct fuse_file_info *fi) {
+  (void)fi;
+  return fs_getattr(path, st);
+}
+
+struct FuFill { void *buf; fuse_fill_dir_t filler; };
+
+static int fu_fill(void *h, const char *name, const struct stat *st) {
+  struct FuFill *f = h;
+  return f->filler(f->buf, name, st, 0, 0);
+}
+
+static int fu_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t off,
+                      struct fuse_file_info *fi, enum fuse_readdir_flags flags) {
+  (void)off; (void)fi; (void)flags;
+  struct FuFill f = { buf, filler };
+  filler(buf, ".", NULL, 0, 0);
+  filler(buf, "..", NULL, 0, 0);
+  return fs_readdir(path, fu_fill, &f);
+}
+
+static int fu_open(const char *path, struct fuse_file_info *fi) {
+  struct stat st;
+  int rc = fs_getattr(path, &st);
+  if (rc) return rc;
+  if ((fi->flags & O_ACCMODE) != O_RDONLY) return -EROFS;
+  fi->keep_cache = 1;                             /* the image never changes under us */
+  return 0;
+}
+
+static int fu_read(const char *path, char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+  (void)fi;
+  size_t done = 0;
+  while (done < size) {                           /* FUSE wants the whole request */
+    int n = fs_read(path, buf + done, size - done, off + (off_t)done);
+    if (n < 0) return done ? (int)done : n;
+    if (!n) break;
+    done += (size_t)n;
+  }
+  return (int)done;
+}
+
+static int fu_readlink(const char *path, char *buf, size_t size) {
+  return fs_readlink(path, buf, size);
+}
+
+static const struct fuse_operations ops = {
+  .getattr  = fu_getattr,
+  .readdir  = fu_readdir,
+  .open     = fu_open,
+  .read     = fu_read,
+  .readlink = fu_readlink,
+};
+#endif
+
+/* ====== Stand-in harness ====== */
+
+struct Walk {
+  char path[1024];
+  const char *img, *text;                         /* -g */
+  size_t textLen;
+  ULONG hits;
+  int status;
+};
+
+static int walk_dir(struct Walk *w);
+
+static int grep_file(struct Walk *w) {
+  static char buf[CHUNK + 256];
+  size_t keep = 0;
+  off_t off = 0;
+  for (;;) {
+    int n = fs_read(w->path, buf + keep, CHUNK, off);
+    if (n < 0) { fprintf(stderr, "%s:%s: %s\n", w->img, w->path, strerror(-n)); w->status = 1; return 0; }
+    if (!n) return 0;
+    off += n;
+    size_t have = keep + (size_t)n;
+    if (memmem(buf, have, w->text, w->textLen)) {
+      printf("%s:%s\n", w->img, w->path);
+      w->hits++;
+      return 0;
+    }
+    keep = w->textLen - 1 < have ? w->textLen - 1 : have;   /* a match may straddle chunks */
+    memmove(buf, buf + have - keep, keep);
+  }
+}
+
+static int walk_fill(void *h, const char *name, const struct stat *st) {
+  struct Walk *w = h;
+  size_t len = strlen(w->path);
+  if (len + 1 + strlen(name) >= sizeof(w->path)) { w->status = 1; return 0; }
+  if (len > 1) w->path[len++] = '/';
+  strcpy(w->path + len, name);
+  if (S_ISDIR(st->st_mode)) {
+    if (!w->text) printf("%s/\n", w->path);
+    walk_dir(w);
+  } else if (!w->text) {
+    if (S_ISLNK(st->st_mode)) {
+      char to[OFS_BLOCK_SIZE];
+      fs_readlink(w->path, to, sizeof(to));
+      printf("%s -> %s\n", w->path, to);
+    } else printf("%s  %lu\n", w->path, (unsigned long)st->st_size);
+  } else if (S_ISREG(st->st_mode)) grep_file(w);
+  w->path[len > 1 ? len - 1 : len] = '\0';
+  return 0;
+}
+
+static int walk_dir(struct Walk *w) {
+  int rc = fs_readdir(w->path, walk_fill, w);
+  if (rc) { fprintf(stderr, "%s: %s\n", w->path, strerror(-rc)); w->status = 1; }
+  return rc;
+}
+
+static int cat_file(const char *path) {
+  static char buf[CHUNK];
+  struct stat st;
+  off_t off = 0;
+  int rc = fs_getattr(path, &st);
+  if (!rc && !S_ISREG(st.st_mode)) rc = S_ISDIR(st.st_mode) ? -EISDIR : -EINVAL;
+  if (rc) { fprintf(stderr, "%s: %s\n", path, strerror(-rc)); return 1; }
+  for (;;) {
+    int n = fs_read(path, buf, sizeof(buf), off);
+    if (n < 0) { fprintf(stderr, "%s: %s\n", path, strerror(-n)); return 1; }
+    if (!n) return 0;
+    if (fwrite(buf, 1, (size_t)n, stdout) != (size_t)n) { perror("stdout"); return 1; }
+    off += n;
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: adfmount image.adf mountpoint [FUSE options]\n"
+                  "       adfmount -l image.adf | -c image.adf path | -g text image.adf...\n");
+}
+
+int main(int argc, char **argv) {
+  struct Walk w;
+  memset(&w, 0, sizeof(w));
+  strcpy(w.path, "/");
+  if (argc == 3 && !strcmp(argv[1], "-l")) {
+    if (map_image(argv[2])) return 1;
+    walk_dir(&w);
+    unmap_image();
+    return w.status;
+  }
+  if (argc == 4 && !strcmp(argv[1], "-c")) {
+    if (map_image(argv[2])) return 1;
+    int status = cat_file(argv[3]);
+    unmap_image();
+    return status;
+  }
+  if (argc >= 4 && !strcmp(argv[1], "-g")) {
+    w.text = argv[2];
+    w.textLen = strlen(w.text);
+    if (!w.textLen || w.textLen > 256) { usage(); return 2; }
+    for (int i = 3; i < argc; ++i) {
+      if (map_image(argv[i])) { w.status = 1; continue; }
+      w.img = argv[i];
+      walk_dir(&w);
+      fflush(stdout);
+      fprintf(stderr, "%s: %lu of %d blocks read\n", argv[i], (unsigned long)rd.nTouched, OFS_BLOCKS);
+      unmap_image();
+    }
+    fflush(stdout);
+    return w.hits ? 0 : 1;
+  }
+  if (argc < 3 || argv[1][0] == '-') { usage(); return 2; }
+#ifdef FT_FUSE
+  if (map_image(argv[1])) return 1;
+  /* argv without the image; -s as the caches are not thread-safe, ro for the kernel */
+  char **fa = calloc((size_t)argc + 3, sizeof(char *));
+  if (!fa) return 1;
+  int n = 0;
+  fa[n++] = argv[0];
+  for (int i = 2; i < argc; ++i) fa[n++] = argv[i];
+  fa[n++] = "-s";
+  fa[n++] = "-oro";
+  int status = fuse_main(n, fa, &ops, NULL) ? 1 : 0;
+  free(fa);
+  unmap_image();
+  return status;
+#else
+  fprintf(stderr, "adfmount: built without FUSE; rebuild with -DFT_FUSE (see the header) or use -l/-c/-g\n");
+  return 1;
+#endif
+}
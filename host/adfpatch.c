@@ -0,0 +1,168 @@
+/*
+ * adfpatch - make, inspect and apply FloppyTool ADF patches (.adp) on a
+ * Linux host, with the same code as the Amiga side (ftpatch.c).
+ *
+ *   adfpatch diff base.adf new.adf out.adp   sectors of new.adf that differ
+ *   adfpatch info patch.adp                  list the patched tracks
+ *   adfpatch apply patch.adp image.adf       patch image.adf in place
+ *
+ * apply checks the image against the patch's base CRC32 first and the
+ * result CRC32 before anything is written; only changed tracks are
+ * rewritten. Exit status: 0 ok, 1 error or wrong base, 2 usage.
+ *
+ * Build: cc -O2 -I. -o adfpatch host/adfpatch.c ftpatch.c fthash.c ftkern.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftport.h"
+#include "fthash.h"
+#include "ftpatch.h"
+
+static struct PatchRec rec;
+
+static LONG file_read(void *h, UBYTE *buf, LONG len) {
+  size_t n = fread(buf, 1, (size_t)len, (FILE *)h);
+  return (n == 0 && ferror((FILE *)h)) ? -1 : (LONG)n;
+}
+
+static const char *patch_error(int rc) {
+  return rc == PATCH_ERR_IO ? "read error" : "not a patch or corrupt";
+}
+
+static UBYTE *load_adf(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) { perror(path); return NULL; }
+  UBYTE *img = (UBYTE *)malloc(FT_DISK_SIZE + 1);
+  size_t n = img ? fread(img, 1, FT_DISK_SIZE + 1, f) : 0;
+  fclose(f);
+  if (n != FT_DISK_SIZE) {
+    fprintf(stderr, "%s: not a %u-byte DD ADF\n", path, (unsigned)FT_DISK_SIZE);
+    free(img);
+    return NULL;
+  }
+  return img;
+}
+
+static ULONG image_crc(const UBYTE *img) {
+  return crc32_final(crc32_update(crc32_init(), img, FT_DISK_SIZE));
+}
+
+static int do_diff(const char *basePath, const char *newPath, const char *outPath) {
+  UBYTE *a = load_adf(basePath), *b = load_adf(newPath);
+  if (!a || !b) { free(a); free(b); return 1; }
+  FILE *out = fopen(outPath, "wb");
+  if (!out) { perror(outPath); free(a); free(b); return 1; }
+
+  struct PatchHead ph = { image_crc(a), image_crc(b), 0 };
+  UBYTE hb[PATCH_HEAD_SIZE], rb[PATCH_REC_SIZE];
+  ULONG sectors = 0;
+  int status = 0;
+  patch_put_head(hb, &ph);                        /* count patched in below */
+  if (fwrite(hb, 1, PATCH_HEAD_SIZE, out) != PATCH_HEAD_SIZE) status = 1;
+  for (UWORD t = 0; t < FT_TRACKS && !status; ++t) {
+    ULONG o = (ULONG)t * FT_TRACK_SIZE;
+    if (!patch_diff(&rec, t, a + o, b + o)) continue;
+    size_t dl = patch_rec_len(&rec) - PATCH_REC_SIZE;
+    patch_put_rec(rb, &rec);
+    if (fwrite(rb, 1, PATCH_REC_SIZE, out) != PATCH_REC_SIZE || fwrite(rec.data, 1, dl, out) != dl) status = 1;
+    ph.count++;
+    sectors += patch_sectors(rec.mask);
+  }
+  patch_put_head(hb, &ph);
+  if (!status && (fseek(out, 0, SEEK_SET) || fwrite(hb, 1, PATCH_HEAD_SIZE, out) != PATCH_HEAD_SIZE)) status = 1;
+  if (fclose(out)) status = 1;
+  if (status) perror(outPath);
+  else printf("%s: %lu track(s), %lu sector(s) changed, base %08lx -> %08lx\n", outPath,
+              (unsigned long)ph.count, (unsigned long)sectors, (unsigned long)ph.baseCrc, (unsigned long)ph.newCrc);
+  free(a); free(b);
+  return status;
+}
+
+static int do_info(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) { perror(path); return 1; }
+  struct PatchIn pi; struct PatchHead ph;
+  int rc = patch_open(&pi, &ph, file_read, f);
+  if (!rc) {
+    printf("%s: base %08lx -> result %08lx, %lu track(s)\n", path,
+           (unsigned long)ph.baseCrc, (unsigned long)ph.newCrc, (unsigned long)ph.count);
+    while ((rc = patch_read_rec(&pi, &rec)) == PATCH_OK) {
+      printf("  track %3u (cyl %2u head %u): sectors", (unsigned)rec.track, (unsigned)rec.track / 2, (unsigned)rec.track & 1);
+      for (unsigned s = 0; s < FT_SECTORS; ++s) if (rec.mask & (1U << s)) printf(" %u", s);
+      printf("\n");
+    }
+    if (rc == PATCH_END) rc = PATCH_OK;
+  }
+  fclose(f);
+  if (rc) fprintf(stderr, "%s: %s\n", path, patch_error(rc));
+  return rc ? 1 : 0;
+}
+
+static int do_apply(const char *patchPath, const char *imgPath) {
+  UBYTE *img = load_adf(imgPath);
+  if (!img) return 1;
+  FILE *pf = fopen(patchPath, "rb");
+  if (!pf) { perror(patchPath); free(img); return 1; }
+
+  struct PatchIn pi; struct PatchHead ph;
+  int rc = patch_open(&pi, &ph, file_read, pf);
+  ULONG crc = image_crc(img);
+  if (!rc && crc != ph.baseCrc) {
+    fprintf(stderr, "%s: %s (CRC32 %08lx, patch wants %08lx)\n", imgPath,
+            crc == ph.newCrc ? "patch already applied" : "wrong base image",
+            (unsigned long)crc, (unsigned long)ph.baseCrc);
+    fclose(pf); free(img);
+    return 1;
+  }
+
+  /* Patch in memory first: nothing reaches the file unless the result CRC matches */
+  UBYTE done[FT_TRACKS] = { 0 };
+  while (!rc && (rc = patch_read_rec(&pi, &rec)) == PATCH_OK) {
+    UBYTE *t = img + (ULONG)rec.track * FT_TRACK_SIZE;
+    if (crc32_final(crc32_update(crc32_init(), t, FT_TRACK_SIZE)) != rec.baseCrc) rc = PATCH_ERR_DATA;
+    else { patch_apply(&rec, t); done[rec.track] = 1; }
+  }
+  if (rc == PATCH_END) rc = PATCH_OK;
+  fclose(pf);
+  if (rc) {
+    fprintf(stderr, "%s: %s\n", patchPath, patch_error(rc));
+    free(img);
+    return 1;
+  }
+  crc = image_crc(img);
+  if (crc != ph.newCrc) {
+    fprintf(stderr, "%s: result CRC32 %08lx, patch expects %08lx; image left unchanged\n",
+            imgPath, (unsigned long)crc, (unsigned long)ph.newCrc);
+    free(img);
+    return 1;
+  }
+
+  FILE *f = fopen(imgPath, "r+b");
+  int status = f ? 0 : 1;
+  for (ULONG t = 0; t < FT_TRACKS && !status; ++t) {
+    if (!done[t]) continue;
+    if (fseek(f, (long)(t * FT_TRACK_SIZE), SEEK_SET) ||
+        fwrite(img + t * FT_TRACK_SIZE, 1, FT_TRACK_SIZE, f) != FT_TRACK_SIZE) status = 1;
+  }
+  if (f && fclose(f)) status = 1;
+  if (status) perror(imgPath);
+  else printf("%s: %lu track(s) patched, CRC32 %08lx\n", imgPath, (unsigned long)ph.count, (unsigned long)crc);
+  free(img);
+  return status;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: adfpatch diff base.adf new.adf out.adp\n"
+                  "       adfpatch info patch.adp\n"
+                  "       adfpatch apply patch.adp image.adf\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc == 5 && !strcmp(argv[1], "diff"))  return do_diff(argv[2], argv[3], argv[4]);
+  if (argc == 3 && !strcmp(argv[1], "info"))  return do_info(argv[2]);
+  if (argc == 4 && !strcmp(argv[1], "apply")) return do_apply(argv[2], argv[3]);
+  usage();
+  return 2;
+}
@@ -0,0 +1,467 @@
+/*
+ * adfstore - deduplicating ADF archive (Linux host tool)
+ *
+ * Every unique 5,632-byte track is stored once, keyed by its SHA-256;
+ * an image is a catalogue record of 160 track numbers.
+ *
+ *   adfstore init   STORE
+ *   adfstore import [-j threads] STORE file.adf ...
+ *   adfstore export STORE NAME|SHA256-PREFIX out.adf
+ *   adfstore list   STORE
+ *   adfstore stats  STORE
+ *
+ * STORE/ layout (all integers big-endian):
+ *   tracks.dat   unique tracks, appended; track n at offset n*5632
+ *   tracks.key   SHA-256 of each track in tracks.dat, same order
+ *   images.cat   CAT_REC_SIZE bytes per image: name, image SHA-256,
+ *                160 track numbers
+ * Writes go data -> key -> catalogue, so a crash never leaves a record
+ * pointing at a missing track; a torn tail is trimmed on open.
+ *
+ * Build: cc -O2 -pthread -I. -o adfstore host/adfstore.c fthash.c ftkern.c
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ftport.h"
+#include "fthash.h"
+
+#define CAT_NAME_LEN  96
+#define CAT_HEAD_SIZE (CAT_NAME_LEN + SHA256_LEN)                 /* name + image key */
+#define CAT_REC_SIZE  (CAT_HEAD_SIZE + 4*FT_TRACKS)               /* 768 */
+#define BATCH_FILES   64
+
+/* Open-addressing index over an array of SHA-256 keys; slot = entry + 1, 0 = empty */
+struct KeyIndex {
+  const UBYTE *keys;                   /* entry i at keys + i*stride + offset */
+  ULONG        stride, offset;
+  ULONG       *slot;
+  ULONG        mask;
+};
+
+struct Store {
+  char   dir[4096];
+  int    fdData, fdKey, fdCat;
+  ULONG  nTracks;                      /* unique tracks in tracks.dat */
+  ULONG  nImages;
+  UBYTE *keys;                         /* nTracks * SHA256_LEN, in memory */
+  ULONG  keysCap;
+  UBYTE *heads;                        /* nImages * CAT_HEAD_SIZE, in memory */
+  ULONG  headsCap;
+  struct KeyIndex trackIdx, imageIdx;
+};
+
+/* One file of an import batch, filled by a worker thread */
+struct Slot {
+  const char *path;
+  UBYTE      *image;                   /* FT_DISK_SIZE */
+  UBYTE       trackKey[FT_TRACKS][SHA256_LEN];
+  UBYTE       imageKey[SHA256_LEN];
+  const char *error;
+};
+
+struct Batch {
+  struct Slot *slot;
+  ULONG        n;
+  ULONG        next;                   /* atomically claimed by workers */
+};
+
+static void put32(UBYTE *p, ULONG v) { p[0]=(UBYTE)(v>>24); p[1]=(UBYTE)(v>>16); p[2]=(UBYTE)(v>>8); p[3]=(UBYTE)v; }
+static ULONG get32(const UBYTE *p) { return ((ULONG)p[0]<<24) | ((ULONG)p[1]<<16) | ((ULONG)p[2]<<8) | p[3]; }
+
+static double now_sec(void) {
+  struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static BOOL write_all(int fd, const void *buf, size_t len) {
+  const UBYTE *p = (const UBYTE*)buf;
+  while (len) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) { if (errno == EINTR) continue; return FALSE; }
+    p += n; len -= (size_t)n;
+  }
+  return TRUE;
+}
+
+static BOOL read_all(int fd, void *buf, size_t len, off_t off) {
+  UBYTE *p = (UBYTE*)buf;
+  while (len) {
+    ssize_t n = pread(fd, p, len, off);
+    if (n < 0) { if (errno == EINTR) continue; return FALSE; }
+    if (n == 0) return FALSE;
+    p += n; len -= (size_t)n; off += n;
+  }
+  return TRUE;
+}
+
+/* ----- Key index ----- */
+
+static ULONG key_hash(const UBYTE *key) { return get32(key) ^ get32(key + 4); }
+
+static const UBYTE *key_at(const struct KeyIndex *ki, ULONG i) { return ki->keys + (size_t)i * ki->stride + ki->offset; }
+
+static void key_insert(struct KeyIndex *ki, ULONG i) {
+  ULONG h = key_hash(key_at(ki, i)) & ki->mask;
+  while (ki->slot[h]) h = (h + 1) & ki->mask;
+  ki->slot[h] = i + 1;
+}
+
+/* Indexes entries 0..n-1 from scratch, sized for a load factor below 1/2 */
+static BOOL key_build(struct KeyIndex *ki, const UBYTE *keys, ULONG n) {
+  ULONG size = 1024;
+  while (size < n * 2) size *= 2;
+  ULONG *t = (ULONG*)calloc(size, sizeof(ULONG));
+  if (!t) return FALSE;
+  free(ki->slot);
+  ki->keys = keys;
+  ki->slot = t;
+  ki->mask = size - 1;
+  for (ULONG i=0; i<n; ++i) key_insert(ki, i);
+  return TRUE;
+}
+
+/* Entry n-1 was just appended (keys may have moved) */
+static BOOL key_add(struct KeyIndex *ki, const UBYTE *keys, ULONG n) {
+  if (n * 2 > ki->mask + 1) return key_build(ki, keys, n);
+  ki->keys = keys;
+  key_insert(ki, n - 1);
+  return TRUE;
+}
+
+/* Returns entry + 1, or 0 if absent */
+static ULONG key_find(const struct KeyIndex *ki, const UBYTE *key) {
+  if (!ki->slot) return 0;
+  ULONG h = key_hash(key) & ki->mask;
+  while (ki->slot[h]) {
+    ULONG i = ki->slot[h] - 1;
+    if (memcmp(key_at(ki, i), key, SHA256_LEN) == 0) return i + 1;
+    h = (h + 1) & ki->mask;
+  }
+  return 0;
+}
+
+/* ----- Store open/close ----- */
+
+static void store_path(const struct Store *st, const char *file, char *out, size_t max) {
+  snprintf(out, max, "%s/%s", st->dir, file);
+}
+
+static void store_close(struct Store *st) {
+  if (st->fdData >= 0) close(st->fdData);
+  if (st->fdKey  >= 0) close(st->fdKey);
+  if (st->fdCat  >= 0) close(st->fdCat);
+  free(st->keys);
+  free(st->heads);
+  free(st->trackIdx.slot);
+  free(st->imageIdx.slot);
+  memset(st, 0, sizeof(*st));
+  st->fdData = st->fdKey = st->fdCat = -1;
+}
+
+static BOOL store_open(struct Store *st, const char *dir, BOOL create) {
+  memset(st, 0, sizeof(*st));
+  st->fdData = st->fdKey = st->fdCat = -1;
+  snprintf(st->dir, sizeof(st->dir), "%s", dir);
+  if (create && mkdir(dir, 0777) != 0 && errno != EEXIST) { perror(dir); return FALSE; }
+
+  char path[4200];
+  int flags = O_RDWR | O_APPEND | (create ? O_CREAT : 0);
+  store_path(st, "tracks.dat", path, sizeof(path)); st->fdData = open(path, flags, 0666);
+  store_path(st, "tracks.key", path, sizeof(path)); st->fdKey  = open(path, flags, 0666);
+  store_path(st, "images.cat", path, sizeof(path)); st->fdCat  = open(path, flags, 0666);
+  if (st->fdData < 0 || st->fdKey < 0 || st->fdCat < 0) {
+    fprintf(stderr, "%s: not a track store (%s)\n", dir, strerror(errno));
+    store_close(st);
+    return FALSE;
+  }
+
+  /* Trim torn tails left by an interrupted import */
+  struct stat sd, sk, sc;
+  fstat(st->fdData, &sd); fstat(st->fdKey, &sk); fstat(st->fdCat, &sc);
+  ULONG nd = (ULONG)(sd.st_size / FT_TRACK_SIZE), nk = (ULONG)(sk.st_size / SHA256_LEN);
+  st->nTracks = nd < nk ? nd : nk;
+  st->nImages = (ULONG)(sc.st_size / CAT_REC_SIZE);
+  if (ftruncate(st->fdData, (off_t)st->nTracks * FT_TRACK_SIZE) != 0 ||
+      ftruncate(st->fdKey,  (off_t)st->nTracks * SHA256_LEN) != 0 ||
+      ftruncate(st->fdCat,  (off_t)st->nImages * CAT_REC_SIZE) != 0) {
+    perror("ftruncate");
+    store_close(st);
+    return FALSE;
+  }
+
+  st->keysCap = st->nTracks + 4096;
+  st->keys = (UBYTE*)malloc((size_t)st->keysCap * SHA256_LEN);
+  st->trackIdx.stride = SHA256_LEN;
+  if (!st->keys || (st->nTracks && !read_all(st->fdKey, st->keys, (size_t)st->nTracks * SHA256_LEN, 0)) ||
+      !key_build(&st->trackIdx, st->keys, st->nTracks)) {
+    fprintf(stderr, "%s: cannot load track keys\n", dir);
+    store_close(st);
+    return FALSE;
+  }
+
+  /* Catalogue heads (name + image key) stay in memory for lookups */
+  st->headsCap = st->nImages + 1024;
+  st->heads = (UBYTE*)malloc((size_t)st->headsCap * CAT_HEAD_SIZE);
+  st->imageIdx.stride = CAT_HEAD_SIZE;
+  st->imageIdx.offset = CAT_NAME_LEN;
+  UBYTE rec[CAT_REC_SIZE];
+  for (ULONG i=0; st->heads && i<st->nImages; ++i) {
+    if (!read_all(st->fdCat, rec, CAT_REC_SIZE, (off_t)i * CAT_REC_SIZE)) { free(st->heads); st->heads = NULL; break; }
+    memcpy(st->heads + (size_t)i * CAT_HEAD_SIZE, rec, CAT_HEAD_SIZE);
+  }
+  if (!st->heads || !key_build(&st->imageIdx, st->heads, st->nImages)) {
+    fprintf(stderr, "%s: cannot load catalogue\n", dir);
+    store_close(st);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Appends a new unique track; returns its index */
+static BOOL store_add_track(struct Store *st, const UBYTE *data, const UBYTE *key, ULONG *index) {
+  if (st->nTracks == st->keysCap) {
+    ULONG cap = st->keysCap * 2;
+    UBYTE *k = (UBYTE*)realloc(st->keys, (size_t)cap * SHA256_LEN);
+    if (!k) return FALSE;
+    st->keys = k; st->keysCap = cap;
+  }
+  if (!write_all(st->fdData, data, FT_TRACK_SIZE) || !write_all(st->fdKey, key, SHA256_LEN)) return FALSE;
+  memcpy(st->keys + (size_t)st->nTracks * SHA256_LEN, key, SHA256_LEN);
+  *index = st->nTracks++;
+  return key_add(&st->trackIdx, st->keys, st->nTracks);
+}
+
+static BOOL store_add_image(struct Store *st, const UBYTE *rec) {
+  if (st->nImages == st->headsCap) {
+    ULONG cap = st->headsCap * 2;
+    UBYTE *h = (UBYTE*)realloc(st->heads, (size_t)cap * CAT_HEAD_SIZE);
+    if (!h) return FALSE;
+    st->heads = h; st->headsCap = cap;
+  }
+  if (!write_all(st->fdCat, rec, CAT_REC_SIZE)) return FALSE;
+  memcpy(st->heads + (size_t)st->nImages * CAT_HEAD_SIZE, rec, CAT_HEAD_SIZE);
+  st->nImages++;
+  return key_add(&st->imageIdx, st->heads, st->nImages);
+}
+
+/* Finds a catalogue record by exact name or SHA-256 hex prefix (last match wins) */
+static BOOL store_find_image(const struct Store *st, const char *what, UBYTE *rec) {
+  size_t wl = strlen(what);
+  for (ULONG i=st->nImages; i-- > 0; ) {
+    const UBYTE *h = st->heads + (size_t)i * CAT_HEAD_SIZE;
+    char hx[2*SHA256_LEN+1]; hash_hex(h + CAT_NAME_LEN, SHA256_LEN, hx);
+    if (strncmp((const char*)h, what, CAT_NAME_LEN) == 0 ||
+        (wl >= 8 && wl <= 2*SHA256_LEN && strncmp(hx, what, wl) == 0))
+      return read_all(st->fdCat, rec, CAT_REC_SIZE, (off_t)i * CAT_REC_SIZE);
+  }
+  return FALSE;
+}
+
+/* ----- Import ----- */
+
+static void hash_slot(struct Slot *s) {
+  s->error = NULL;
+  int fd = open(s->path, O_RDONLY);
+  if (fd < 0) { s->error = strerror(errno); return; }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || sb.st_size != FT_DISK_SIZE) { close(fd); s->error = "size is not 901,120 bytes"; return; }
+  BOOL ok = read_all(fd, s->image, FT_DISK_SIZE, 0);
+  close(fd);
+  if (!ok) { s->error = "read error"; return; }
+
+  for (ULONG t=0; t<FT_TRACKS; ++t) sha256(s->image + t * FT_TRACK_SIZE, FT_TRACK_SIZE, s->trackKey[t]);
+  sha256(s->image, FT_DISK_SIZE, s->imageKey);
+}
+
+static void *hash_worker(void *arg) {
+  struct Batch *b = (struct Batch*)arg;
+  for (;;) {
+    ULONG i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+    if (i >= b->n) break;
+    hash_slot(&b->slot[i]);
+  }
+  return NULL;
+}
+
+static int cmd_import(const char *dir, char **files, int nfiles, int threads) {
+  struct Store st;
+  if (!store_open(&st, dir, FALSE)) return 1;
+
+  struct Slot *slots = (struct Slot*)calloc(BATCH_FILES, sizeof(struct Slot));
+  if (!slots) { store_close(&st); return 1; }
+  for (int i=0; i<BATCH_FILES; ++i) {
+    slots[i].image = (UBYTE*)malloc(FT_DISK_SIZE);
+    if (!slots[i].image) { fprintf(stderr, "out of memory\n"); return 1; }
+  }
+  pthread_t *tid = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+
+  ULONG imported = 0, skipped = 0, failed = 0, newTracks = 0;
+  double t0 = now_sec();
+  int rc = 0;
+
+  for (int base=0; base<nfiles && rc == 0; base+=BATCH_FILES) {
+    struct Batch b;
+    b.slot = slots;
+    b.n    = (ULONG)((nfiles - base) < BATCH_FILES ? (nfiles - base) : BATCH_FILES);
+    b.next = 0;
+    for (ULONG i=0; i<b.n; ++i) slots[i].path = files[base + i];
+
+    /* Hash in parallel, commit in argument order so stores are reproducible */
+    int started = 0;
+    for (int k=0; k<threads; ++k) if (pthread_create(&tid[k], NULL, hash_worker, &b) == 0) started++;
+    if (started == 0) hash_worker(&b);
+    for (int k=0; k<started; ++k) pthread_join(tid[k], NULL);
+
+    for (ULONG i=0; i<b.n; ++i) {
+      struct Slot *s = &slots[i];
+      if (s->error) { fprintf(stderr, "%s: %s\n", s->path, s->error); failed++; continue; }
+
+      UBYTE rec[CAT_REC_SIZE];
+      memset(rec, 0, sizeof(rec));
+      const char *base = strrchr(s->path, '/'); base = base ? base + 1 : s->path;
+      strncpy((char*)rec, base, CAT_NAME_LEN - 1);
+
+      /* Same content under the same name: nothing to do */
+      ULONG same = key_find(&st.imageIdx, s->imageKey);
+      if (same && strncmp((const char*)st.heads + (size_t)(same-1) * CAT_HEAD_SIZE, (const char*)rec, CAT_NAME_LEN) == 0) {
+        skipped++;
+        continue;
+      }
+
+      memcpy(rec + CAT_NAME_LEN, s->imageKey, SHA256_LEN);
+      for (ULONG t=0; t<FT_TRACKS; ++t) {
+        ULONG idx = key_find(&st.trackIdx, s->trackKey[t]);
+        if (idx) idx--;
+        else if (store_add_track(&st, s->image + t * FT_TRACK_SIZE, s->trackKey[t], &idx)) newTracks++;
+        else { perror("tracks.dat"); rc = 1; break; }
+        put32(rec + CAT_NAME_LEN + SHA256_LEN + 4*t, idx);
+      }
+      if (rc) break;
+      if (!store_add_image(&st, rec)) { perror("images.cat"); rc = 1; break; }
+      imported++;
+    }
+  }
+
+  double dt = now_sec() - t0; if (dt <= 0) dt = 1e-9;
+  printf("imported %lu, unchanged %lu, failed %lu; %lu new tracks\n",
+         (unsigned long)imported, (unsigned long)skipped, (unsigned long)failed, (unsigned long)newTracks);
+  printf("%.1f images/s, %.1f MB/s (%d threads)\n",
+         (imported + skipped) / dt, (imported + skipped) * (double)FT_DISK_SIZE / dt / 1e6, threads);
+
+  for (int i=0; i<BATCH_FILES; ++i) free(slots[i].image);
+  free(slots);
+  free(tid);
+  store_close(&st);
+  return rc ? rc : (failed ? 2 : 0);
+}
+
+/* ----- Export / list / stats ----- */
+
+static int cmd_export(const char *dir, const char *what, const char *out) {
+  struct Store st;
+  if (!store_open(&st, dir, FALSE)) return 1;
+
+  UBYTE rec[CAT_REC_SIZE];
+  if (!store_find_image(&st, what, rec)) { fprintf(stderr, "%s: no such image\n", what); store_close(&st); return 1; }
+
+  UBYTE *image = (UBYTE*)malloc(FT_DISK_SIZE);
+  if (!image) { store_close(&st); return 1; }
+
+  int rc = 0;
+  for (ULONG t=0; t<FT_TRACKS && rc == 0; ++t) {
+    ULONG idx = get32(rec + CAT_NAME_LEN + SHA256_LEN + 4*t);
+    UBYTE key[SHA256_LEN];
+    if (idx >= st.nTracks || !read_all(st.fdData, image + t * FT_TRACK_SIZE, FT_TRACK_SIZE, (off_t)idx * FT_TRACK_SIZE)) {
+      fprintf(stderr, "track %lu: missing in store\n", (unsigned long)t); rc = 1; break;
+    }
+    sha256(image + t * FT_TRACK_SIZE, FT_TRACK_SIZE, key);
+    if (memcmp(key, st.keys + (size_t)idx * SHA256_LEN, SHA256_LEN) != 0) {
+      fprintf(stderr, "track %lu: store entry %lu is corrupt\n", (unsigned long)t, (unsigned long)idx); rc = 1;
+    }
+  }
+
+  UBYTE key[SHA256_LEN];
+  if (rc == 0) {
+    sha256(image, FT_DISK_SIZE, key);
+    if (memcmp(key, rec + CAT_NAME_LEN, SHA256_LEN) != 0) { fprintf(stderr, "image hash mismatch\n"); rc = 1; }
+  }
+  if (rc == 0) {
+    int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0 || !write_all(fd, image, FT_DISK_SIZE)) { perror(out); rc = 1; }
+    if (fd >= 0) close(fd);
+  }
+
+  free(image);
+  store_close(&st);
+  return rc;
+}
+
+static int cmd_list(const char *dir) {
+  struct Store st;
+  if (!store_open(&st, dir, FALSE)) return 1;
+  for (ULONG i=0; i<st.nImages; ++i) {
+    const UBYTE *h = st.heads + (size_t)i * CAT_HEAD_SIZE;
+    char hx[2*SHA256_LEN+1]; hash_hex(h + CAT_NAME_LEN, SHA256_LEN, hx);
+    printf("%s  %.*s\n", hx, CAT_NAME_LEN, (const char*)h);
+  }
+  store_close(&st);
+  return 0;
+}
+
+static int cmd_stats(const char *dir) {
+  struct Store st;
+  if (!store_open(&st, dir, FALSE)) return 1;
+  double logical = (double)st.nImages * FT_DISK_SIZE;
+  double stored  = (double)st.nTracks * (FT_TRACK_SIZE + SHA256_LEN) + (double)st.nImages * CAT_REC_SIZE;
+  printf("images        %lu\n", (unsigned long)st.nImages);
+  printf("unique tracks %lu of %lu\n", (unsigned long)st.nTracks, (unsigned long)st.nImages * FT_TRACKS);
+  printf("logical       %.1f MB\n", logical / 1e6);
+  printf("stored        %.1f MB", stored / 1e6);
+  if (stored > 0) printf(" (%.2fx)", logical / stored);
+  printf("\n");
+  store_close(&st);
+  return 0;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+    "usage: adfstore init   STORE\n"
+    "       adfstore import [-j threads] STORE file.adf ...\n"
+    "       adfstore export STORE NAME|SHA256-PREFIX out.adf\n"
+    "       adfstore list   STORE\n"
+    "       adfstore stats  STORE\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) { usage(); return 1; }
+  const char *cmd = argv[1];
+
+  if (strcmp(cmd, "init") == 0) {
+    struct Store st;
+    if (!store_open(&st, argv[2], TRUE)) return 1;
+    store_close(&st);
+    return 0;
+  }
+  if (strcmp(cmd, "import") == 0) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int a = 2;
+    if (a + 1 < argc && strcmp(argv[a], "-j") == 0) { threads = atoi(argv[a+1]); a += 2; }
+    if (threads < 1) threads = 1;
+    if (argc - a < 2) { usage(); return 1; }
+    return cmd_import(argv[a], argv + a + 1, argc - a - 1, threads);
+  }
+  if (strcmp(cmd, "export") == 0 && argc == 5) return cmd_export(argv[2], argv[3], argv[4]);
+  if (strcmp(cmd, "list")   == 0) return cmd_list(argv[2]);
+  if (strcmp(cmd, "stats")  == 0) return cmd_stats(argv[2]);
+  usage();
+  return 1;
+}
@@ -0,0 +1,181 @@
+/*
+ * adzbench - .adz (gzip) compression benchmark over a corpus of ADFs
+ * (Linux host tool)
+ *
+ * Runs the same ftgz.c code FloppyTool uses, fed track by track
+ * (5,632-byte writes/reads), and verifies every round trip.
+ *
+ *   adzbench [-l level] [-r repeats] [-T trace.json] file.adf ...
+ *
+ * Reports per image: compressed size and ratio; totals: ratio and
+ * compress / decompress throughput (MB/s of uncompressed data).
+ * -T records every track write/read in Chrome trace format (fttrace.h).
+ *
+ * Build: cc -O2 -I. -o adzbench host/adzbench.c ftgz.c fthash.c ftkern.c fttrace.c
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ftport.h"
+#include "ftgz.h"
+#include "fttrace.h"
+
+/* Growable in-memory sink/source for the gzip callbacks */
+struct MemBuf {
+  UBYTE *data;
+  ULONG  len, cap, pos;
+};
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static LONG mem_write(void *h, const UBYTE *buf, LONG len) {
+  struct MemBuf *m = (struct MemBuf *)h;
+  if (m->len + (ULONG)len > m->cap) {
+    ULONG cap = m->cap ? m->cap : 65536;
+    while (cap < m->len + (ULONG)len) cap *= 2;
+    UBYTE *p = (UBYTE *)realloc(m->data, cap);
+    if (!p) return -1;
+    m->data = p; m->cap = cap;
+  }
+  memcpy(m->data + m->len, buf, (size_t)len);
+  m->len += (ULONG)len;
+  return len;
+}
+
+static LONG file_write(void *h, const UBYTE *buf, LONG len) {
+  return (LONG)fwrite(buf, 1, (size_t)len, (FILE *)h);
+}
+
+static LONG mem_read(void *h, UBYTE *buf, LONG len) {
+  struct MemBuf *m = (struct MemBuf *)h;
+  ULONG n = m->len - m->pos;
+  if (n > (ULONG)len) n = (ULONG)len;
+  memcpy(buf, m->data + m->pos, n);
+  m->pos += n;
+  return (LONG)n;
+}
+
+static UBYTE *load_file(const char *path, ULONG *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  UBYTE *p = (n >= 0) ? (UBYTE *)malloc(n ? (size_t)n : 1) : NULL;
+  if (p && fread(p, 1, (size_t)n, f) != (size_t)n) { free(p); p = NULL; }
+  fclose(f);
+  *len = (ULONG)n;
+  return p;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: adzbench [-l level 1..9] [-r repeats] [-T trace.json] file.adf ...\n");
+}
+
+int main(int argc, char **argv) {
+  int level = 6, repeats = 3, i = 1;
+  const char *tracePath = NULL;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strcmp(argv[i], "-l") && i + 1 < argc) level = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc) repeats = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-T") && i + 1 < argc) tracePath = argv[++i];
+    else { usage(); return 2; }
+  }
+  if (i >= argc || level < 1 || level > 9 || repeats < 1) { usage(); return 2; }
+
+  struct GzOut *go = (struct GzOut *)malloc(sizeof(*go));
+  struct GzIn  *gi = (struct GzIn *)malloc(sizeof(*gi));
+  UBYTE *track = (UBYTE *)malloc(FT_TRACK_SIZE);
+  if (!go || !gi || !track) { fprintf(stderr, "out of memory\n"); return 1; }
+  if (tracePath) {
+    gTrace = (struct TraceRing *)malloc(sizeof(*gTrace));
+    if (!gTrace) { fprintf(stderr, "out of memory\n"); return 1; }
+    trace_init(gTrace, trace_host_clock, 1000000);
+  }
+
+  double tComp = 0, tDecomp = 0;
+  unsigned long long rawTotal = 0, gzTotal = 0;
+  int images = 0, failed = 0;
+
+  printf("%-40s %10s %10s %7s\n", "image", "raw", "adz", "ratio");
+  for (; i < argc; ++i) {
+    ULONG len;
+    UBYTE *img = load_file(argv[i], &len);
+    if (!img) { fprintf(stderr, "%s: cannot read\n", argv[i]); failed++; continue; }
+
+    struct MemBuf gz = { NULL, 0, 0, 0 };
+    BOOL ok = TRUE;
+    for (int r = 0; r < repeats && ok; ++r) {
+      gz.len = 0;
+      double t0 = now_sec();
+      TRACE_BEGIN("adz", "compress");
+      ok = gzout_open(go, mem_write, &gz, level) == GZ_OK;
+      for (ULONG off = 0; ok && off < len; off += FT_TRACK_SIZE) {
+        ULONG n = len - off < FT_TRACK_SIZE ? len - off : FT_TRACK_SIZE;
+        TRACE_BEGIN("adz", "gzout_write");
+        ok = gzout_write(go, img + off, n) == GZ_OK;
+        TRACE_END("adz", "gzout_write");
+      }
+      ok = ok && gzout_close(go) == GZ_OK;
+      TRACE_END("adz", "compress");
+      tComp += now_sec() - t0;
+    }
+
+    for (int r = 0; r < repeats && ok; ++r) {
+      gz.pos = 0;
+      ULONG off = 0;
+      double t0 = now_sec();
+      TRACE_BEGIN("adz", "decompress");
+      ok = gzin_open(gi, mem_read, &gz) == GZ_OK;
+      while (ok) {
+        TRACE_BEGIN("adz", "gzin_read");
+        LONG n = gzin_read(gi, track, FT_TRACK_SIZE);
+        TRACE_END("adz", "gzin_read");
+        if (n < 0 || off + (ULONG)n > len) { ok = FALSE; break; }
+        if (n == 0) break;
+        if (memcmp(track, img + off, (size_t)n)) ok = FALSE;
+        off += (ULONG)n;
+      }
+      TRACE_END("adz", "decompress");
+      tDecomp += now_sec() - t0;
+      if (off != len) ok = FALSE;
+    }
+
+    if (!ok) {
+      fprintf(stderr, "%s: round trip FAILED\n", argv[i]);
+      failed++;
+    } else {
+      printf("%-40.40s %10lu %10lu %6.2fx\n", argv[i], (unsigned long)len, (unsigned long)gz.len,
+             gz.len ? (double)len / gz.len : 0.0);
+      rawTotal += len;
+      gzTotal  += gz.len;
+      images++;
+    }
+    free(gz.data);
+    free(img);
+  }
+
+  if (images) {
+    double mb = (double)rawTotal * repeats / (1024.0 * 1024.0);
+    printf("\n%d image(s), level %d: %llu -> %llu bytes, ratio %.2fx (%.1f%% saved)\n",
+           images, level, rawTotal, gzTotal, gzTotal ? (double)rawTotal / gzTotal : 0.0,
+           rawTotal ? 100.0 * (1.0 - (double)gzTotal / rawTotal) : 0.0);
+    printf("compress   %8.1f MB/s\n", tComp   > 0 ? mb / tComp   : 0.0);
+    printf("decompress %8.1f MB/s\n", tDecomp > 0 ? mb / tDecomp : 0.0);
+  }
+  if (gTrace) {
+    FILE *tf = fopen(tracePath, "w");
+    if (!tf || trace_json(gTrace, file_write, tf) != 0) { fprintf(stderr, "%s: cannot write trace\n", tracePath); failed++; }
+    if (tf && fclose(tf)) failed++;
+    free(gTrace);
+  }
+  free(track); free(gi); free(go);
+  return failed ? 1 : 0;
+}
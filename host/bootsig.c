@@ -0,0 +1,385 @@
+/*
+ * bootsig - build the FloppyTool bootblock signature database and scan
+ * archives with it (Linux host tool)
+ *
+ *   bootsig db.bbd sigs.txt ...           build (format in ftboot.h)
+ *   bootsig -s db.bbd DIR|FILE ...        scan .adf/.adz/.dms/.bb files
+ *
+ * Signature lines, '#' starts a comment:
+ *   kind  where  pattern  name...
+ *   kind     virus, loader, os or util
+ *   where    * (anywhere), a byte offset in the bootblock, or crc
+ *   pattern  hex bytes (4eae ff3a written without spaces) or "text" with
+ *            \" \\ \xNN escapes; for crc, the CRC32 of bytes 12-1023
+ * e.g.
+ *   virus  *    "Something wonderful has happened"  SCA
+ *   os     crc  fd791ae7                            Install (1.3)
+ *
+ * The scan reads only the bootblock (for .adz/.dms the first track is
+ * unpacked) and prints: path, class, DOS type, checksum, code CRC32 and
+ * the signatures found. Exit status 1 if any virus signature matched.
+ * Copy db.bbd to PROGDIR:FloppyTool.bbd for FloppyTool to use it.
+ *
+ * Build: cc -O2 -I. -o bootsig host/bootsig.c ftboot.c ftgz.c ftdms.c fthash.c ftkern.c
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "ftport.h"
+#include "ftboot.h"
+#include "ftgz.h"
+#include "ftdms.h"
+
+#define PAT_MAX 256
+
+static void *xrealloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (!p) { fprintf(stderr, "out of memory\n"); exit(1); }
+  return p;
+}
+
+static void put16(UBYTE *p, ULONG v) { p[0] = (UBYTE)(v >> 8); p[1] = (UBYTE)v; }
+static void put32(UBYTE *p, ULONG v) { p[0] = (UBYTE)(v >> 24); p[1] = (UBYTE)(v >> 16); p[2] = (UBYTE)(v >> 8); p[3] = (UBYTE)v; }
+
+/* ----- Build ----- */
+
+struct Pat { ULONG state, name; UWORD ofs, len; UBYTE kind; };
+struct Crc { ULONG crc, name; UBYTE kind; };
+struct Node { int next[256]; int fail, dict, out; ULONG id; };   /* trie, in insertion order */
+
+static struct Pat *pats;  static size_t nPats, capPats;
+static struct Crc *crcs;  static size_t nCrcs, capCrcs;
+static struct Node *nodes; static size_t nNodes, capNodes;
+static char *names;       static size_t nNames, capNames;
+
+static int new_node(void) {
+  if (nNodes == capNodes) { capNodes = capNodes ? capNodes * 2 : 256; nodes = xrealloc(nodes, capNodes * sizeof(*nodes)); }
+  struct Node *n = &nodes[nNodes];
+  for (int c = 0; c < 256; ++c) n->next[c] = -1;
+  n->fail = 0; n->dict = -1; n->out = 0;
+  return (int)nNodes++;
+}
+
+static ULONG add_name(const char *s) {
+  size_t n = strlen(s) + 1;
+  if (nNames + n > capNames) { capNames = (nNames + n) * 2; names = xrealloc(names, capNames); }
+  memcpy(names + nNames, s, n);
+  nNames += n;
+  return (ULONG)(nNames - n);
+}
+
+static int hexval(int c) {
+  return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+/* Pattern token at *pp: "text" or hex; returns length, -1 if malformed */
+static int parse_pattern(char **pp, UBYTE *out) {
+  char *p = *pp;
+  int n = 0;
+  if (*p == '"') {
+    for (++p; *p && *p != '"'; ++p) {
+      if (n == PAT_MAX) return -1;
+      if (*p == '\\' && p[1] == 'x' && hexval(p[2]) >= 0 && hexval(p[3]) >= 0) { out[n++] = (UBYTE)(hexval(p[2]) << 4 | hexval(p[3])); p += 3; }
+      else if (*p == '\\' && p[1]) out[n++] = (UBYTE)*++p;
+      else out[n++] = (UBYTE)*p;
+    }
+    if (*p != '"') return -1;
+    ++p;
+  } else {
+    for (; *p && *p != ' ' && *p != '\t'; p += 2) {
+      if (n == PAT_MAX || hexval(p[0]) < 0 || hexval(p[1]) < 0) return -1;
+      out[n++] = (UBYTE)(hexval(p[0]) << 4 | hexval(p[1]));
+    }
+  }
+  if (*p && *p != ' ' && *p != '\t') return -1;
+  *pp = p;
+  return n;
+}
+
+static char *word(char **pp) {
+  char *p = *pp;
+  while (*p == ' ' || *p == '\t') ++p;
+  char *w = p;
+  if (*p == '"') return w;                       /* patterns are parsed separately */
+  while (*p && *p != ' ' && *p != '\t') ++p;
+  if (*p) *p++ = '\0';
+  *pp = p;
+  return w;
+}
+
+static int load_sigs(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) { perror(path); return 1; }
+  char line[1024];
+  int lineNo = 0, status = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineNo++;
+    line[strcspn(line, "\r\n")] = '\0';
+    char *p = line;
+    while (*p == ' ' || *p == '\t') ++p;
+    if (!*p || *p == '#') continue;
+
+    char *kindW = word(&p), *where = word(&p);
+    while (*p == ' ' || *p == '\t') ++p;
+    UBYTE kind = !strcmp(kindW, "virus") ? BOOT_KIND_VIRUS : !strcmp(kindW, "loader") ? BOOT_KIND_LOADER
+               : !strcmp(kindW, "os") ? BOOT_KIND_OS : !strcmp(kindW, "util") ? BOOT_KIND_UTIL : 0;
+    UBYTE pat[PAT_MAX];
+    int len = parse_pattern(&p, pat);
+    while (*p == ' ' || *p == '\t') ++p;
+    char *name = p;
+    char *end = name + strlen(name);
+    while (end > name && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+
+    char *e = NULL;
+    unsigned long ofs = strtoul(where, &e, 10);
+    int isCrc = !strcmp(where, "crc"), any = !strcmp(where, "*");
+    if (!kind || len < 1 || !*name || (isCrc && len != 4) || (!isCrc && !any && (*e || ofs + (unsigned long)len > BOOT_SIZE))) {
+      fprintf(stderr, "%s:%d: bad signature line\n", path, lineNo);
+      status = 1;
+      continue;
+    }
+    if (isCrc) {
+      if (nCrcs == capCrcs) { capCrcs = capCrcs ? capCrcs * 2 : 256; crcs = xrealloc(crcs, capCrcs * sizeof(*crcs)); }
+      struct Crc *c = &crcs[nCrcs++];
+      c->crc  = ((ULONG)pat[0] << 24) | ((ULONG)pat[1] << 16) | ((ULONG)pat[2] << 8) | pat[3];
+      c->kind = kind;
+      c->name = add_name(name);
+      continue;
+    }
+    int s = 0;
+    for (int i = 0; i < len; ++i) {
+      if (nodes[s].next[pat[i]] < 0) { int n = new_node(); nodes[s].next[pat[i]] = n; }
+      s = nodes[s].next[pat[i]];
+    }
+    if (nPats == capPats) { capPats = capPats ? capPats * 2 : 256; pats = xrealloc(pats, capPats * sizeof(*pats)); }
+    struct Pat *pt = &pats[nPats++];
+    pt->state = (ULONG)s;
+    pt->ofs   = any ? BOOT_ANY : (UWORD)ofs;
+    pt->len   = (UWORD)len;
+    pt->kind  = kind;
+    pt->name  = add_name(name);
+    nodes[s].out = 1;
+  }
+  fclose(f);
+  return status;
+}
+
+static int cmp_pat(const void *a, const void *b) {
+  ULONG x = nodes[((const struct Pat *)a)->state].id, y = nodes[((const struct Pat *)b)->state].id;
+  return (x > y) - (x < y);
+}
+
+static int cmp_crc(const void *a, const void *b) {
+  ULONG x = ((const struct Crc *)a)->crc, y = ((const struct Crc *)b)->crc;
+  return (x > y) - (x < y);
+}
+
+static int write_db(const char *path) {
+  if (nNodes >= BOOT_NONE || nPats >= BOOT_NONE) { fprintf(stderr, "too many signatures\n"); return 1; }
+
+  /* Breadth-first order gives every fail/dictionary link a smaller id */
+  int *order = xrealloc(NULL, nNodes * sizeof(int));
+  size_t head = 0, tail = 0, nEdges = 0;
+  order[tail++] = 0;
+  nodes[0].id = 0;
+  while (head < tail) {
+    int s = order[head++];
+    for (int c = 0; c < 256; ++c) {
+      int t = nodes[s].next[c];
+      if (t < 0) continue;
+      nEdges++;
+      int f = nodes[s].fail;
+      while (f && nodes[f].next[c] < 0) f = nodes[f].fail;
+      nodes[t].fail = (s && nodes[f].next[c] >= 0) ? nodes[f].next[c] : 0;
+      int ft = nodes[t].fail;
+      nodes[t].dict = !ft ? -1 : nodes[ft].out ? ft : nodes[ft].dict;
+      nodes[t].id = (ULONG)tail;
+      order[tail++] = t;
+    }
+  }
+
+  qsort(pats, nPats, sizeof(*pats), cmp_pat);
+  qsort(crcs, nCrcs, sizeof(*crcs), cmp_crc);
+
+  ULONG namesOff = BOOT_HEAD_SIZE + (ULONG)(nNodes * BOOT_STATE_SIZE + nEdges * BOOT_EDGE_SIZE
+                 + nPats * BOOT_PAT_SIZE + nCrcs * BOOT_CRC_SIZE);
+  ULONG size = namesOff + (ULONG)nNames;
+  UBYTE *db = xrealloc(NULL, size);
+  memset(db, 0, size);
+  put32(db, BOOT_MAGIC); put32(db + 4, BOOT_VERSION);
+  put32(db + 8, (ULONG)nNodes); put32(db + 12, (ULONG)nEdges);
+  put32(db + 16, (ULONG)nPats); put32(db + 20, (ULONG)nCrcs);
+  put32(db + 24, namesOff);     put32(db + 28, size);
+
+  UBYTE *st = db + BOOT_HEAD_SIZE, *ed = st + nNodes * BOOT_STATE_SIZE;
+  UBYTE *pt = ed + nEdges * BOOT_EDGE_SIZE, *cr = pt + nPats * BOOT_PAT_SIZE;
+  ULONG e = 0;
+  for (size_t k = 0; k < nNodes; ++k) {
+    const struct Node *n = &nodes[order[k]];
+    UBYTE *p = st + k * BOOT_STATE_SIZE;
+    put16(p, nodes[n->fail].id);
+    put16(p + 2, n->dict >= 0 ? nodes[n->dict].id : BOOT_NONE);
+    put16(p + 4, BOOT_NONE);
+    put32(p + 8, e);
+    UWORD cnt = 0;
+    for (int c = 0; c < 256; ++c) {
+      if (n->next[c] < 0) continue;
+      ed[e * BOOT_EDGE_SIZE] = (UBYTE)c;
+      put16(ed + e * BOOT_EDGE_SIZE + 2, nodes[n->next[c]].id);
+      e++; cnt++;
+    }
+    put16(p + 6, cnt);
+  }
+  /* Patterns sorted by state: each state's chain is a run, linked forwards */
+  for (size_t i = nPats; i-- > 0; ) {
+    UBYTE *p = pt + i * BOOT_PAT_SIZE, *s = st + nodes[pats[i].state].id * BOOT_STATE_SIZE;
+    put16(p, pats[i].ofs);
+    put16(p + 2, pats[i].len);
+    put16(p + 4, (s[4] << 8 | s[5]));
+    p[6] = pats[i].kind;
+    put32(p + 8, pats[i].name);
+    put16(s + 4, (ULONG)i);
+  }
+  for (size_t i = 0; i < nCrcs; ++i) {
+    UBYTE *p = cr + i * BOOT_CRC_SIZE;
+    put32(p, crcs[i].crc);
+    p[4] = crcs[i].kind;
+    put32(p + 8, crcs[i].name);
+  }
+  memcpy(db + namesOff, names, nNames);
+  free(order);
+
+  if (boot_db_check(db, size) != BOOT_OK) { fprintf(stderr, "%s: internal error, database fails its check\n", path); return 1; }
+  FILE *f = fopen(path, "wb");
+  int ok = f && fwrite(db, 1, size, f) == size;
+  if (f && fclose(f) != 0) ok = 0;
+  free(db);
+  if (!ok) { perror(path); return 1; }
+  printf("%s: %lu pattern(s), %lu code CRC(s), %lu states, %lu bytes\n", path,
+         (unsigned long)nPats, (unsigned long)nCrcs, (unsigned long)nNodes, (unsigned long)size);
+  return 0;
+}
+
+/* ----- Scan (-s) ----- */
+
+struct FileSrc { FILE *f; };
+
+static LONG file_read(void *h, UBYTE *buf, LONG len) {
+  return (LONG)fread(buf, 1, (size_t)len, ((struct FileSrc *)h)->f);
+}
+
+static const UBYTE *db;
+static struct GzIn gz;
+static struct DmsIn dms;
+static unsigned long nScanned, nClass[4], nVirus, nErr;
+
+static int is_image(const char *name) {
+  const char *dot = strrchr(name, '.');
+  return dot && (!strcasecmp(dot, ".adf") || !strcasecmp(dot, ".adz") || !strcasecmp(dot, ".dms") || !strcasecmp(dot, ".bb"));
+}
+
+static void scan_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) { perror(path); nErr++; return; }
+  static UBYTE buf[FT_TRACK_SIZE];
+  struct FileSrc src = { f };
+  size_t n = fread(buf, 1, BOOT_SIZE, f);
+  LONG got = (LONG)n;
+  if (n >= 4 && !memcmp(buf, "DMS!", 4)) {
+    rewind(f);
+    got = dms_open(&dms, file_read, &src) == 0 ? dms_read(&dms, buf, FT_TRACK_SIZE) : -1;
+  } else if (n >= 2 && buf[0] == 0x1F && buf[1] == 0x8B) {
+    rewind(f);
+    got = gzin_open(&gz, file_read, &src) == GZ_OK ? gzin_read(&gz, buf, BOOT_SIZE) : -1;
+  }
+  fclose(f);
+  if (got < BOOT_SIZE) { fprintf(stderr, "%s: no bootblock (short or corrupt)\n", path); nErr++; return; }
+
+  struct BootInfo bi;
+  boot_scan(buf, db, &bi);
+  nScanned++;
+  nClass[bi.class]++;
+  printf("%s\t%s\t", path, boot_class_name(bi.class));
+  if (bi.class == BOOT_NDOS) printf("-\t-");
+  else printf("DOS%u\t%s", (unsigned)bi.dosType, bi.class == BOOT_EMPTY ? "-" : bi.sumOk ? "sum-ok" : "sum-bad");
+  printf("\t%08lx\t", (unsigned long)bi.codeCrc);
+  int virus = 0;
+  for (UWORD i = 0; i < bi.nHits; ++i) {
+    printf("%s%s:%s", i ? "; " : "", boot_kind_name(bi.hit[i].kind), bi.hit[i].name);
+    virus |= bi.hit[i].kind == BOOT_KIND_VIRUS;
+  }
+  if (bi.more) printf("; more");
+  printf("\n");
+  if (virus) nVirus++;
+}
+
+static void walk(const char *path, int top) {
+  struct stat st;
+  if (stat(path, &st) != 0) { perror(path); nErr++; return; }
+  if (S_ISREG(st.st_mode)) { if (top || is_image(path)) scan_file(path); return; }
+  if (!S_ISDIR(st.st_mode)) return;
+  struct dirent **ents;
+  int n = scandir(path, &ents, NULL, alphasort);
+  if (n < 0) { perror(path); nErr++; return; }
+  for (int i = 0; i < n; ++i) {
+    const char *name = ents[i]->d_name;
+    if (strcmp(name, ".") && strcmp(name, "..")) {
+      char *sub = xrealloc(NULL, strlen(path) + strlen(name) + 2);
+      sprintf(sub, "%s/%s", path, name);
+      walk(sub, 0);
+      free(sub);
+    }
+    free(ents[i]);
+  }
+  free(ents);
+}
+
+static UBYTE *load_db(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) { perror(path); return NULL; }
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  UBYTE *p = (n > 0) ? xrealloc(NULL, (size_t)n) : NULL;
+  if (p && fread(p, 1, (size_t)n, f) != (size_t)n) { free(p); p = NULL; }
+  fclose(f);
+  if (!p || boot_db_check(p, (ULONG)n) != BOOT_OK) { fprintf(stderr, "%s: not a signature database\n", path); free(p); return NULL; }
+  return p;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: bootsig db.bbd sigs.txt ...        build\n"
+                  "       bootsig -s db.bbd DIR|FILE ...     scan bootblocks\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 4 && !strcmp(argv[1], "-s")) {
+    UBYTE *d = load_db(argv[2]);
+    if (!d) return 1;
+    db = d;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 3; i < argc; ++i) walk(argv[i], 1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double dt = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "%lu bootblock(s): %lu standard, %lu custom, %lu empty, %lu non-DOS; %lu with a virus signature; "
+                    "%lu error(s); %.2f s, %.0f/s\n",
+            nScanned, nClass[BOOT_STANDARD], nClass[BOOT_CUSTOM], nClass[BOOT_EMPTY], nClass[BOOT_NDOS],
+            nVirus, nErr, dt, dt > 0 ? nScanned / dt : 0.0);
+    free(d);
+    return nVirus ? 1 : 0;
+  }
+  if (argc < 3 || argv[1][0] == '-') { usage(); return 2; }
+
+  new_node();
+  int status = 0;
+  for (int i = 2; i < argc; ++i) status |= load_sigs(argv[i]);
+  if (status) return 1;
+  return write_db(argv[1]);
+}
@@ -0,0 +1,340 @@
+/*
+ * datindex - build the FloppyTool DAT index (Linux host tool)
+ *
+ * Reads DAT files in Logiqx XML or clrmamepro format (TOSEC, WHDLoad,
+ * No-Intro, ...) and writes the sorted binary index described in ftdat.h.
+ * Roms without a SHA-1 cannot be indexed and are counted as skipped;
+ * duplicate SHA-1s keep the first name seen.
+ *
+ *   datindex index.fdx file.dat ...       build
+ *   datindex -l index.fdx file.adf ...    identify images (same lookup
+ *                                         code as FloppyTool)
+ *
+ * Copy index.fdx to PROGDIR:FloppyTool.fdx for Verify ADF to use it.
+ *
+ * Build: cc -O2 -I. -o datindex host/datindex.c ftdat.c fthash.c ftkern.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ftport.h"
+#include "fthash.h"
+#include "ftdat.h"
+
+struct Entry {
+  UBYTE sha1[SHA1_LEN], md5[MD5_LEN];
+  ULONG crc, size;
+  ULONG name;                          /* offset into names */
+};
+
+static struct Entry *ents;
+static size_t nEnts, capEnts, nSkipped;
+static char  *names;
+static size_t nNames, capNames;
+
+static void *xrealloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (!p) { fprintf(stderr, "out of memory\n"); exit(1); }
+  return p;
+}
+
+static ULONG add_name(const char *game, const char *rom) {
+  size_t gl = strlen(game), rl = strlen(rom);
+  int prefix = gl && strncmp(rom, game, gl) != 0;
+  size_t need = (prefix ? gl + 1 : 0) + rl + 1;
+  if (nNames + need > capNames) { capNames = (nNames + need) * 2; names = xrealloc(names, capNames); }
+  ULONG off = (ULONG)nNames;
+  if (prefix) { memcpy(names + nNames, game, gl); names[nNames + gl] = '/'; nNames += gl + 1; }
+  memcpy(names + nNames, rom, rl + 1);
+  nNames += rl + 1;
+  return off;
+}
+
+static int hex_bytes(const char *s, UBYTE *out, size_t len) {
+  if (strlen(s) != 2 * len) return 0;
+  for (size_t i = 0; i < 2 * len; ++i) {
+    int c = s[i], v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                    : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+    if (v < 0) return 0;
+    if (i & 1) out[i / 2] |= (UBYTE)v; else out[i / 2] = (UBYTE)(v << 4);
+  }
+  return 1;
+}
+
+/* One rom: name/size/crc/md5/sha1 as text, any of them may be empty */
+static void add_rom(const char *game, const char *rom, const char *size, const char *crc,
+                    const char *md5, const char *sha1) {
+  struct Entry e;
+  memset(&e, 0, sizeof(e));
+  if (!hex_bytes(sha1, e.sha1, SHA1_LEN)) { nSkipped++; return; }
+  if (!hex_bytes(md5, e.md5, MD5_LEN)) memset(e.md5, 0, MD5_LEN);
+  e.crc  = (ULONG)strtoul(crc, NULL, 16);
+  e.size = (ULONG)strtoul(size, NULL, 10);
+  e.name = add_name(game, rom);
+  if (nEnts == capEnts) { capEnts = capEnts ? capEnts * 2 : 4096; ents = xrealloc(ents, capEnts * sizeof(*ents)); }
+  ents[nEnts++] = e;
+}
+
+/* ----- Logiqx XML: <game|machine name="..."> ... <rom name= size= crc= md5= sha1=/> ----- */
+
+static void xml_attr(const char *tag, const char *end, const char *key, char *out, size_t max) {
+  size_t kl = strlen(key);
+  out[0] = '\0';
+  for (const char *p = tag; p + kl + 2 < end; ++p) {
+    if ((p[-1] != ' ' && p[-1] != '\t' && p[-1] != '\n' && p[-1] != '\r') || strncmp(p, key, kl) || p[kl] != '=') continue;
+    char q = p[kl + 1];
+    if (q != '"' && q != '\'') continue;
+    const char *v = p + kl + 2;
+    size_t n = 0;
+    while (v < end && *v != q && n + 1 < max) {
+      static const struct { const char *ent; char c; } map[] = {
+        { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' }
+      };
+      size_t i = 0;
+      while (*v == '&' && i < 5 && strncmp(v, map[i].ent, strlen(map[i].ent))) ++i;
+      if (*v == '&' && i < 5) { out[n++] = map[i].c; v += strlen(map[i].ent); }
+      else out[n++] = *v++;
+    }
+    out[n] = '\0';
+    return;
+  }
+}
+
+static void parse_xml(const char *p, const char *end) {
+  char game[512] = "", rom[512], size[32], crc[32], md5[64], sha1[64];
+  while ((p = memchr(p, '<', (size_t)(end - p))) != NULL) {
+    const char *t = p + 1, *e = memchr(t, '>', (size_t)(end - t));
+    if (!e) break;
+    if (!strncmp(t, "game ", 5) || !strncmp(t, "machine ", 8))
+      xml_attr(t, e, "name", game, sizeof(game));
+    else if (!strncmp(t, "rom ", 4)) {
+      xml_attr(t, e, "name", rom, sizeof(rom));
+      xml_attr(t, e, "size", size, sizeof(size));
+      xml_attr(t, e, "crc", crc, sizeof(crc));
+      xml_attr(t, e, "md5", md5, sizeof(md5));
+      xml_attr(t, e, "sha1", sha1, sizeof(sha1));
+      add_rom(game, rom, size, crc, md5, sha1);
+    }
+    p = e + 1;
+  }
+}
+
+/* ----- clrmamepro: game ( name "..." rom ( name "..." size N crc X md5 X sha1 X ) ) ----- */
+
+enum { T_END, T_OPEN, T_CLOSE, T_WORD };
+struct Lex { const char *p, *end; char text[512]; };
+
+static int lex(struct Lex *l) {
+  while (l->p < l->end && (*l->p == ' ' || *l->p == '\t' || *l->p == '\r' || *l->p == '\n')) l->p++;
+  if (l->p >= l->end) return T_END;
+  if (*l->p == '(') { l->p++; return T_OPEN; }
+  if (*l->p == ')') { l->p++; return T_CLOSE; }
+  size_t n = 0;
+  if (*l->p == '"') {
+    for (l->p++; l->p < l->end && *l->p != '"'; l->p++) if (n + 1 < sizeof(l->text)) l->text[n++] = *l->p;
+    if (l->p < l->end) l->p++;
+  } else {
+    for (; l->p < l->end && !strchr(" \t\r\n()", *l->p); l->p++) if (n + 1 < sizeof(l->text)) l->text[n++] = *l->p;
+  }
+  l->text[n] = '\0';
+  return T_WORD;
+}
+
+static void field(char *dst, size_t max, const char *src) {
+  size_t n = strlen(src);
+  if (n >= max) n = max - 1;                     /* over-long values are cut */
+  memcpy(dst, src, n);
+  dst[n] = '\0';
+}
+
+static void cmp_skip(struct Lex *l) {
+  int depth = 1, t;
+  while (depth && (t = lex(l)) != T_END) depth += (t == T_OPEN) - (t == T_CLOSE);
+}
+
+static void cmp_block(struct Lex *l, int isRom, char *game) {
+  char key[64], rom[512] = "", size[32] = "", crc[32] = "", md5[64] = "", sha1[64] = "";
+  for (;;) {
+    int t = lex(l);
+    if (t == T_END || t == T_CLOSE) break;
+    if (t == T_OPEN) { cmp_skip(l); continue; }
+    field(key, sizeof(key), l->text);
+    t = lex(l);
+    if (t == T_END || t == T_CLOSE) break;
+    if (t == T_OPEN) {
+      if (!isRom && !strcmp(key, "rom")) cmp_block(l, 1, game);
+      else cmp_skip(l);
+      continue;
+    }
+    if (!isRom) { if (!strcmp(key, "name")) field(game, 512, l->text); continue; }
+    if (!strcmp(key, "name")) field(rom, sizeof(rom), l->text);
+    else if (!strcmp(key, "size")) field(size, sizeof(size), l->text);
+    else if (!strcmp(key, "crc")) field(crc, sizeof(crc), l->text);
+    else if (!strcmp(key, "md5")) field(md5, sizeof(md5), l->text);
+    else if (!strcmp(key, "sha1")) field(sha1, sizeof(sha1), l->text);
+  }
+  if (isRom) add_rom(game, rom, size, crc, md5, sha1);
+}
+
+static void parse_cmp(const char *p, const char *end) {
+  struct Lex l = { p, end, "" };
+  char game[512];
+  for (;;) {
+    int t = lex(&l);
+    if (t == T_END) break;
+    if (t != T_WORD) continue;
+    int isGame = !strcmp(l.text, "game") || !strcmp(l.text, "machine") || !strcmp(l.text, "resource");
+    if (lex(&l) != T_OPEN) continue;
+    if (isGame) { game[0] = '\0'; cmp_block(&l, 0, game); }
+    else cmp_skip(&l);
+  }
+}
+
+static char *slurp(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) { perror(path); return NULL; }
+  size_t cap = 1 << 16, n = 0, r;
+  char *buf = xrealloc(NULL, cap);
+  while ((r = fread(buf + n, 1, cap - n, f)) > 0) {
+    n += r;
+    if (n == cap) { cap *= 2; buf = xrealloc(buf, cap); }
+  }
+  fclose(f);
+  *len = n;
+  return buf;
+}
+
+/* ----- Index output ----- */
+
+static int cmp_sha1(const void *a, const void *b) {
+  int c = memcmp(((const struct Entry *)a)->sha1, ((const struct Entry *)b)->sha1, SHA1_LEN);
+  if (c) return c;
+  /* duplicates: earlier DAT entry first (names are appended in input order) */
+  ULONG na = ((const struct Entry *)a)->name, nb = ((const struct Entry *)b)->name;
+  return (na > nb) - (na < nb);
+}
+
+static void put32(UBYTE *p, ULONG v) { p[0] = (UBYTE)(v >> 24); p[1] = (UBYTE)(v >> 16); p[2] = (UBYTE)(v >> 8); p[3] = (UBYTE)v; }
+
+static int write_index(const char *path) {
+  qsort(ents, nEnts, sizeof(*ents), cmp_sha1);
+
+  size_t n = 0, dups = 0;
+  for (size_t i = 0; i < nEnts; ++i) {
+    if (n && !memcmp(ents[n - 1].sha1, ents[i].sha1, SHA1_LEN)) { dups++; continue; }
+    ents[n++] = ents[i];
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (!f) { perror(path); return 1; }
+  ULONG namesOff = DAT_ENTRY_OFS + (ULONG)n * DAT_ENTRY_SIZE;
+  UBYTE head[DAT_ENTRY_OFS];
+  put32(head, DAT_MAGIC); put32(head + 4, DAT_VERSION); put32(head + 8, (ULONG)n); put32(head + 12, namesOff);
+  size_t k = 0;
+  for (int b = 0; b <= DAT_FAN; ++b) {
+    while (k < n && ents[k].sha1[0] < b) k++;
+    put32(head + DAT_HEAD_SIZE + 4 * b, (ULONG)k);
+  }
+  int ok = fwrite(head, 1, sizeof(head), f) == sizeof(head);
+
+  ULONG nameOff = 0;
+  for (size_t i = 0; ok && i < n; ++i) {
+    UBYTE e[DAT_ENTRY_SIZE];
+    memcpy(e, ents[i].sha1, SHA1_LEN);
+    memcpy(e + SHA1_LEN, ents[i].md5, MD5_LEN);
+    put32(e + SHA1_LEN + MD5_LEN, ents[i].crc);
+    put32(e + SHA1_LEN + MD5_LEN + 4, ents[i].size);
+    put32(e + SHA1_LEN + MD5_LEN + 8, nameOff);
+    nameOff += (ULONG)strlen(names + ents[i].name) + 1;
+    ok = fwrite(e, 1, sizeof(e), f) == sizeof(e);
+  }
+  for (size_t i = 0; ok && i < n; ++i) {
+    const char *s = names + ents[i].name;
+    ok = fwrite(s, 1, strlen(s) + 1, f) == strlen(s) + 1;
+  }
+  if (fclose(f) != 0) ok = 0;
+  if (!ok) { perror(path); return 1; }
+  printf("%s: %lu entries, %lu duplicate SHA-1, %lu rom(s) without SHA-1 skipped\n", path,
+         (unsigned long)n, (unsigned long)dups, (unsigned long)nSkipped);
+  return 0;
+}
+
+/* ----- Lookup (-l) ----- */
+
+static LONG file_read_at(void *h, ULONG off, UBYTE *buf, LONG len) {
+  if (fseek((FILE *)h, (long)off, SEEK_SET) != 0) return -1;
+  size_t n = fread(buf, 1, (size_t)len, (FILE *)h);
+  return (n == 0 && ferror((FILE *)h)) ? -1 : (LONG)n;
+}
+
+static int lookup(const char *idxPath, char **files, int nFiles) {
+  FILE *idx = fopen(idxPath, "rb");
+  if (!idx) { perror(idxPath); return 1; }
+  int status = 0;
+  for (int i = 0; i < nFiles; ++i) {
+    FILE *f = fopen(files[i], "rb");
+    if (!f) { perror(files[i]); status = 1; continue; }
+    struct Md5 m; struct Sha1 s;
+    ULONG crc = crc32_init();
+    md5_init(&m); sha1_init(&s);
+    UBYTE buf[FT_TRACK_SIZE], sha1[SHA1_LEN], md5[MD5_LEN];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      crc = crc32_update(crc, buf, (ULONG)n);
+      md5_update(&m, buf, (ULONG)n);
+      sha1_update(&s, buf, (ULONG)n);
+    }
+    fclose(f);
+    crc = crc32_final(crc);
+    md5_final(&m, md5); sha1_final(&s, sha1);
+
+    struct DatHit hit;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int rc = dat_lookup(file_read_at, idx, sha1, &hit);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+    char hex[2 * SHA1_LEN + 1];
+    hash_hex(sha1, SHA1_LEN, hex);
+    if (rc == DAT_FOUND) {
+      static const UBYTE zero[MD5_LEN];
+      int md5Ok = !memcmp(hit.md5, zero, MD5_LEN) || !memcmp(hit.md5, md5, MD5_LEN);
+      printf("%s: %s%s (%.3f ms)\n", files[i], hit.name,
+             (md5Ok && hit.crc == crc) ? "" : " [SHA-1 match, MD5/CRC differ]", ms);
+    } else if (rc == DAT_NOT_FOUND) {
+      printf("%s: unknown, sha1 %s (%.3f ms)\n", files[i], hex, ms);
+    } else {
+      fprintf(stderr, "%s: %s\n", idxPath, rc == DAT_ERR_IO ? "read error" : "not a FloppyTool DAT index");
+      status = 1;
+      break;
+    }
+  }
+  fclose(idx);
+  return status;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: datindex index.fdx file.dat ...\n"
+                  "       datindex -l index.fdx file.adf ...\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 4 && !strcmp(argv[1], "-l")) return lookup(argv[2], argv + 3, argc - 3);
+  if (argc < 3 || argv[1][0] == '-') { usage(); return 2; }
+
+  for (int i = 2; i < argc; ++i) {
+    size_t len;
+    char *buf = slurp(argv[i], &len);
+    if (!buf) return 1;
+    const char *p = buf, *end = buf + len;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || (UBYTE)*p == 0xEF || (UBYTE)*p == 0xBB || (UBYTE)*p == 0xBF)) p++;
+    size_t before = nEnts;
+    if (p < end && *p == '<') parse_xml(p, end); else parse_cmp(p, end);
+    printf("%s: %lu rom(s)\n", argv[i], (unsigned long)(nEnts - before));
+    free(buf);
+  }
+  return write_index(argv[1]);
+}
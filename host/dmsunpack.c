@@ -0,0 +1,175 @@
+/*
+ * dmsunpack - DMS to ADF with the FloppyTool unpacker (Linux host tool)
+ *
+ * Runs ftdms.c exactly as the Amiga side does (track-sized reads), so
+ * fixture archives can be checked on the host.
+ *
+ *   dmsunpack [-v] file.dms [out.adf]     unpack (test only without out.adf)
+ *   dmsunpack -c file.dms ref.adf         compare with a reference ADF
+ *   dmsunpack -c file.dms 1a2b3c4d        ... or with the image's CRC32
+ *   dmsunpack -t SUMS                     check a list of fixtures
+ *
+ * A SUMS line is "archive crc32" or "archive !error" (data, crc, mode) for
+ * an archive that must fail that way, then an optional comment; archive
+ * paths are relative to the list. The fixtures in host/fixtures/dms cover
+ * every mode, a missing cylinder, a damaged record and an encrypted
+ * archive:  dmsunpack -t host/fixtures/dms/SUMS
+ *
+ * Exit status: 0 ok, 1 unpack error or mismatch, 2 usage.
+ *
+ * Build: cc -O2 -I. -o dmsunpack host/dmsunpack.c ftdms.c fthash.c ftkern.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftport.h"
+#include "ftdms.h"
+#include "fthash.h"
+
+static LONG file_read(void *h, UBYTE *buf, LONG len) {
+  size_t n = fread(buf, 1, (size_t)len, (FILE *)h);
+  return (n == 0 && ferror((FILE *)h)) ? -1 : (LONG)n;
+}
+
+static const char *dms_error(int rc) {
+  switch (rc) {
+    case DMS_ERR_IO:   return "read error";
+    case DMS_ERR_DATA: return "not DMS or corrupt data";
+    case DMS_ERR_CRC:  return "CRC/checksum mismatch";
+    case DMS_ERR_MODE: return "unsupported (encrypted, unknown mode or not DD)";
+    default:           return "error";
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: dmsunpack [-v] file.dms [out.adf]\n"
+                  "       dmsunpack -c file.dms ref.adf|crc32\n"
+                  "       dmsunpack -t SUMS\n");
+}
+
+/* A reference given as 8 hex digits is a CRC32, anything else a file */
+static int parse_crc(const char *s, ULONG *crc) {
+  char *end;
+  if (strlen(s) != 8) return 0;
+  *crc = (ULONG)strtoul(s, &end, 16);
+  return *end == '\0';
+}
+
+/* Unpacks inPath: to outPath, against a reference ADF (refPath) or CRC32
+   (hasCrc), or only tests it. 0 = ok, else the DMS_ERR_* code or 1. */
+static int unpack(const char *inPath, const char *outPath, const char *refPath, int hasCrc, ULONG wantCrc,
+                  int verbose, int quiet) {
+  FILE *in = fopen(inPath, "rb");
+  if (!in) { perror(inPath); return 1; }
+  FILE *out = NULL;
+  if (outPath || refPath) {
+    out = fopen(outPath ? outPath : refPath, outPath ? "wb" : "rb");
+    if (!out) { perror(outPath ? outPath : refPath); fclose(in); return 1; }
+  }
+
+  struct DmsIn *d = (struct DmsIn *)malloc(sizeof(*d));
+  UBYTE *buf = (UBYTE *)malloc(FT_TRACK_SIZE), *ref = (UBYTE *)malloc(FT_TRACK_SIZE);
+  if (!d || !buf || !ref) { fprintf(stderr, "out of memory\n"); exit(1); }
+
+  int status = dms_open(d, file_read, in);
+  if (status) {
+    if (!quiet) fprintf(stderr, "%s: %s\n", inPath, dms_error(status));
+  } else if (verbose)
+    printf("%s: tracks %u-%u, disk type %u, mode %u, creator v%u\n", inPath,
+           (unsigned)d->from, (unsigned)d->to, (unsigned)d->diskType, (unsigned)d->mode, (unsigned)d->version);
+
+  ULONG t = 0, crc = crc32_init();
+  for (; !status; ++t) {
+    LONG n = dms_read(d, buf, FT_TRACK_SIZE);
+    if (n < 0) {
+      if (!quiet) fprintf(stderr, "%s: track %lu: %s\n", inPath, (unsigned long)t, dms_error((int)n));
+      status = (int)n;
+      break;
+    }
+    if (n == 0) break;
+    crc = crc32_update(crc, buf, (ULONG)n);
+    if (refPath) {
+      if (fread(ref, 1, (size_t)n, out) != (size_t)n || memcmp(ref, buf, (size_t)n)) {
+        printf("%s: track %lu differs from %s\n", inPath, (unsigned long)t, refPath);
+        status = 1;
+      }
+    } else if (outPath && fwrite(buf, 1, (size_t)n, out) != (size_t)n) {
+      perror(outPath); status = 1;
+    }
+  }
+  crc = crc32_final(crc);
+  if (!status && hasCrc && crc != wantCrc) {
+    printf("%s: CRC32 %08lx, expected %08lx\n", inPath, (unsigned long)crc, (unsigned long)wantCrc);
+    status = 1;
+  }
+
+  if (!status && !quiet) {
+    printf("%s: %lu tracks OK, CRC32 %08lx", inPath, (unsigned long)t, (unsigned long)crc);
+    for (int m = 0; m < DMS_MODES; ++m)
+      if (d->modeCount[m]) printf(", %s x%lu", dms_mode_name[m], (unsigned long)d->modeCount[m]);
+    if (d->missing) printf(", %lu cylinder(s) missing (zeros)", (unsigned long)d->missing);
+    if (d->skipped) printf(", %lu record(s) out of order skipped", (unsigned long)d->skipped);
+    printf("\n");
+  }
+
+  free(ref); free(buf); free(d);
+  if (out && fclose(out) && outPath) { perror(outPath); status = 1; }
+  fclose(in);
+  return status;
+}
+
+static int error_code(const char *name) {
+  if (!strcmp(name, "data")) return DMS_ERR_DATA;
+  if (!strcmp(name, "crc"))  return DMS_ERR_CRC;
+  if (!strcmp(name, "mode")) return DMS_ERR_MODE;
+  return 0;
+}
+
+static int check_list(const char *listPath) {
+  FILE *f = fopen(listPath, "r");
+  if (!f) { perror(listPath); return 1; }
+  const char *slash = strrchr(listPath, '/');
+  int dirLen = slash ? (int)(slash - listPath + 1) : 0;
+  char line[512], name[256], want[32], path[800];
+  int status = 0, total = 0, failed = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || sscanf(line, "%255s %31s", name, want) != 2) continue;
+    snprintf(path, sizeof(path), "%.*s%s", dirLen, listPath, name);
+    ULONG crc = 0;
+    int rc, ok;
+    if (want[0] == '!') {
+      int code = error_code(want + 1);
+      if (!code) { fprintf(stderr, "%s: unknown error '%s'\n", name, want + 1); status = 1; continue; }
+      rc = unpack(path, NULL, NULL, 0, 0, 0, 1);
+      ok = (rc == code);
+    } else if (parse_crc(want, &crc)) {
+      rc = unpack(path, NULL, NULL, 1, crc, 0, 1);
+      ok = (rc == 0);
+    } else { fprintf(stderr, "%s: bad CRC32 '%s'\n", name, want); status = 1; continue; }
+    printf("%-12s %s", name, ok ? "ok" : "FAILED");
+    if (!ok && rc < 0) printf(" (%s)", dms_error(rc));
+    printf("\n");
+    total++;
+    if (!ok) failed++;
+  }
+  fclose(f);
+  printf("%d of %d fixture(s) passed\n", total - failed, total);
+  return (status || failed || !total) ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  int verbose = 0, compare = 0, i = 1;
+  if (argc == 3 && !strcmp(argv[1], "-t")) return check_list(argv[2]);
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strcmp(argv[i], "-v")) verbose = 1;
+    else if (!strcmp(argv[i], "-c")) compare = 1;
+    else { usage(); return 2; }
+  }
+  if (i >= argc || argc - i > 2 || (compare && argc - i != 2)) { usage(); return 2; }
+  const char *inPath = argv[i], *second = (argc - i == 2) ? argv[i + 1] : NULL;
+  ULONG crc = 0;
+  int hasCrc = compare && parse_crc(second, &crc);
+  const char *refPath = (compare && !hasCrc) ? second : NULL;
+  return unpack(inPath, compare ? NULL : second, refPath, hasCrc, crc, verbose, 0) ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+#!/bin/sh
+# Round trip through adfmake and adfmount's stand-in harness: a small tree
+# is packed as DOS0 to DOS3, then listed (-l), read back file by file (-c)
+# and searched (-g), and each result is compared with the source tree.
+#
+#   sh host/fixtures/adfmount/check.sh          (from the repository root)
+#
+# The tree is generated here, so nothing binary is kept: an empty file, a
+# 100,000-byte file (two extension blocks on OFS and on FFS), a nested
+# directory and mixed-case names. CC picks the compiler (default cc).
+#
+# Exit status: 0 all passed, 1 a mismatch (shown), 2 a build failed.
+set -u
+CC=${CC:-cc}
+tmp=$(mktemp -d) || exit 2
+trap 'rm -rf "$tmp"' EXIT INT TERM
+
+$CC -O2 -I. -o "$tmp/adfmake" host/adfmake.c ftofs.c || exit 2
+$CC -O2 -I. -o "$tmp/adfmount" host/adfmount.c ftofs.c || exit 2
+
+src=$tmp/Check
+mkdir -p "$src/Data/Sub"
+: > "$src/Empty"
+printf 'FloppyTool adfmount check\nneedle in the root\n' > "$src/ReadMe.txt"
+awk 'BEGIN { for (i = 0; i < 12500; ++i) printf "%07d\n", i * 7919 % 10000000 }' > "$src/Data/Big.bin"
+printf 'nested, no match here\n' > "$src/Data/Sub/Note"
+printf 'second needle, two levels down\n' > "$src/Data/Sub/Deep.txt"
+: > "$src/Data/Sub/Empty2"
+
+# What -l should print: "/dir/" and "/file  size", in any order
+(cd "$src" && find . -mindepth 1 | sed 's|^\.||' | while read -r p; do
+  if [ -d "$src$p" ]; then echo "$p/"; else echo "$p  $(wc -c < "$src$p" | tr -d ' ')"; fi
+done) | sort > "$tmp/list.want"
+(cd "$src" && grep -rl needle . | sed 's|^\.||') | sort > "$tmp/grep.want"
+
+status=0
+fail() { echo "FAIL $1: $2"; status=1; bad=1; }
+
+for dos in 0 1 2 3; do
+  case $dos in
+    0) opt= ;; 1) opt=-f ;; 2) opt=-i ;; 3) opt="-f -i" ;;
+  esac
+  adf=$tmp/dos$dos.adf
+  bad=0
+  # shellcheck disable=SC2086
+  SOURCE_DATE_EPOCH=946684800 "$tmp/adfmake" $opt -n Check "$adf" "$src" > /dev/null || { fail DOS$dos adfmake; continue; }
+
+  "$tmp/adfmount" -l "$adf" > "$tmp/list.raw" || fail DOS$dos "-l exit status"
+  sort "$tmp/list.raw" > "$tmp/list.got"
+  diff "$tmp/list.want" "$tmp/list.got" > /dev/null || { fail DOS$dos "-l listing"; diff "$tmp/list.want" "$tmp/list.got"; }
+
+  (cd "$src" && find . -type f | sed 's|^\.||') | while read -r p; do
+    "$tmp/adfmount" -c "$adf" "$p" > "$tmp/file" && cmp -s "$tmp/file" "$src$p" || echo "$p"
+  done > "$tmp/bad"
+  [ -s "$tmp/bad" ] && { fail DOS$dos "-c content"; cat "$tmp/bad"; }
+
+  "$tmp/adfmount" -g needle "$adf" 2> /dev/null | sed "s|^$adf:||" | sort > "$tmp/grep.got"
+  diff "$tmp/grep.want" "$tmp/grep.got" > /dev/null || { fail DOS$dos "-g matches"; diff "$tmp/grep.want" "$tmp/grep.got"; }
+
+  [ $bad = 0 ] && echo "ok   DOS$dos"
+done
+exit $status
@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+"""
+mkdms.py - writes the DMS fixture archives in this directory and their
+SUMS list (checked by: dmsunpack -t host/fixtures/dms/SUMS).
+
+This is a packer written from the DMS format description, one encoder per
+mode; no real DiskMasher archive was available. Each archive holds
+cylinders 0-3 of a synthetic disk, so the other 76 read back as missing
+(zeros). The CRC32 in SUMS is taken here, with zlib, from the data fed to
+the packer, not from anything ftdms.c produced.
+
+  python3 host/fixtures/dms/mkdms.py host/fixtures/dms
+"""
+import random, struct, sys, heapq, zlib
+
+dms_names = ['NONE', 'SIMPLE', 'QUICK', 'MEDIUM', 'DEEP', 'HEAVY1', 'HEAVY2']
+
+CYL = 11264
+
+def crc16(b):
+    c = 0
+    for x in b:
+        c ^= x
+        for _ in range(8):
+            c = (c >> 1) ^ 0xA001 if c & 1 else c >> 1
+    return c
+
+class BW:
+    def __init__(s): s.bits = []
+    def put(s, v, n):
+        for i in range(n - 1, -1, -1): s.bits.append((v >> i) & 1)
+    def data(s):
+        b = s.bits + [0] * (-len(s.bits) % 8)
+        return bytes(int(''.join(map(str, b[i:i+8])), 2) for i in range(0, len(b), 8))
+
+def rle(data):
+    out = bytearray(); i = 0
+    while i < len(data):
+        a = data[i]; n = 1
+        while i + n < len(data) and data[i+n] == a and n < 65535: n += 1
+        if n >= 4:
+            if n < 255: out += bytes([0x90, n, a])
+            else: out += bytes([0x90, 0xFF, a, n >> 8, n & 0xFF])
+            i += n
+        else:
+            if a == 0x90: out += b'\x90\x00'
+            else: out.append(a)
+            i += 1
+    return bytes(out)
+
+# LZHUF static position code
+dCode = []; dLen = []
+for k, (runs, span) in enumerate(zip([1,3,8,12,24,16], [32,16,8,4,2,1])):
+    base = len(set(dCode))
+    for c in range(runs):
+        for _ in range(span): dCode.append(base + c); dLen.append(3 + k)
+def static_code(v):
+    c = dCode.index(v); l = dLen[c]
+    return c >> (8 - l), l
+
+class State:
+    def __init__(s): s.reset()
+    def reset(s):
+        s.quick = 251; s.medium = 0x3FBE; s.heavy = 0; s.deep = 0x3FC4; s.deepTree = None
+        s.trees = None
+
+def matches(data, maxdist, minlen, maxlen):
+    """greedy (pos, len, dist) parse, only within this record"""
+    i = 0; out = []; idx = {}
+    while i < len(data):
+        best = (0, 0)
+        key = bytes(data[i:i+minlen])
+        if len(key) == minlen:
+            for j in reversed(idx.get(key, [])[-32:]):
+                if i - j > maxdist: break
+                l = 0
+                while l < maxlen and i + l < len(data) and data[j+l] == data[i+l]: l += 1
+                if l > best[0]: best = (l, i - j)
+        if best[0] >= minlen:
+            out.append(('m', best[0], best[1]))
+            for k in range(best[0]):
+                kk = bytes(data[i+k:i+k+minlen]); idx.setdefault(kk, []).append(i+k)
+            i += best[0]
+        else:
+            out.append(('l', data[i]))
+            idx.setdefault(key, []).append(i)
+            i += 1
+    return out
+
+def enc_quick(st, data):
+    w = BW()
+    for t in matches(data, 256, 2, 5):
+        if t[0] == 'l': w.put(1, 1); w.put(t[1], 8)
+        else: w.put(0, 1); w.put(t[1] - 2, 2); w.put(t[2] - 1, 8)
+    st.quick = (st.quick + len(data) + 5) & 0xFF
+    return w.data()
+
+def enc_medium(st, data):
+    w = BW()
+    for t in matches(data, 0x3FFF, 3, 66):
+        if t[0] == 'l': w.put(1, 1); w.put(t[1], 8)
+        else:
+            w.put(0, 1)
+            c, l = static_code(t[1] - 3); w.put(c, l)
+            p = t[2] - 1
+            c, l = static_code(p >> 8); w.put(c, l); w.put(p & 0xFF, 8)
+    return w.data()
+
+# DEEP adaptive Huffman, mirrored from the decoder
+NCHAR = 314; T = 627; R = 626
+class Deep:
+    def __init__(s):
+        s.freq = [0]*(T+1); s.son = [0]*T; s.prnt = [0]*(T+NCHAR)
+        for i in range(NCHAR): s.freq[i] = 1; s.son[i] = i + T; s.prnt[i+T] = i
+        i, j = 0, NCHAR
+        while j <= R:
+            s.freq[j] = s.freq[i] + s.freq[i+1]; s.son[j] = i; s.prnt[i] = s.prnt[i+1] = j; i += 2; j += 1
+        s.freq[T] = 0xFFFF; s.prnt[R] = 0
+    def reconst(s):
+        f, so = s.freq, s.son
+        j = 0
+        for i in range(T):
+            if so[i] >= T: f[j] = (f[i] + 1) // 2; so[j] = so[i]; j += 1
+        i, j = 0, NCHAR
+        while j < T:
+            fv = f[i] + f[i+1]; f[j] = fv
+            k = j - 1
+            while fv < f[k]: k -= 1
+            k += 1
+            f[k+1:j+1] = f[k:j]; f[k] = fv
+            so[k+1:j+1] = so[k:j]; so[k] = i
+            i += 2; j += 1
+        for i in range(T):
+            k = so[i]
+            if k >= T: s.prnt[k] = i
+            else: s.prnt[k] = s.prnt[k+1] = i
+    def update(s, c):
+        f, so, pr = s.freq, s.son, s.prnt
+        if f[R] == 0x8000: s.reconst()
+        c = pr[c + T]
+        while True:
+            f[c] += 1; k = f[c]; l = c + 1
+            if k > f[l]:
+                l += 1
+                while k > f[l]: l += 1
+                l -= 1
+                f[c] = f[l]; f[l] = k
+                i = so[c]; pr[i] = l
+                if i < T: pr[i+1] = l
+                j = so[l]; so[l] = i
+                pr[j] = c
+                if j < T: pr[j+1] = c
+                so[c] = j
+                c = l
+            c = pr[c]
+            if c == 0: break
+    def encode(s, w, c):
+        bits = []; node = s.prnt[c + T]
+        while node != R:
+            p = s.prnt[node]
+            bits.append(node - s.son[p]); node = p
+        for b in reversed(bits): w.put(b, 1)
+        s.update(c)
+
+def enc_deep(st, data):
+    if st.deepTree is None: st.deepTree = Deep()
+    dp = st.deepTree; w = BW()
+    for t in matches(data, 0x3FFF, 3, 60):
+        if t[0] == 'l': dp.encode(w, t[1])
+        else:
+            dp.encode(w, t[1] + 253)
+            p = t[2] - 1
+            c, l = static_code(p >> 8); w.put(c, l); w.put(p & 0xFF, 8)
+    return w.data()
+
+def huff_lengths(freqs):
+    h = [(f, i, None) for i, f in enumerate(freqs)]
+    heapq.heapify(h); depth = {}
+    nodes = {}
+    cnt = len(freqs)
+    while len(h) > 1:
+        a = heapq.heappop(h); b = heapq.heappop(h)
+        nodes[cnt] = (a[1], b[1]); heapq.heappush(h, (a[0] + b[0], cnt, None)); cnt += 1
+    lens = [0]*len(freqs)
+    def walk(n, d):
+        if n < len(freqs): lens[n] = d; return
+        walk(nodes[n][0], d+1); walk(nodes[n][1], d+1)
+    walk(h[0][1], 0)
+    return lens
+
+def canon(lens):
+    code = {}; c = 0
+    for l in range(1, 32):
+        for s in range(len(lens)):
+            if lens[s] == l: code[s] = (c, l); c += 1
+        c <<= 1
+    return code
+
+def enc_heavy(st, data, heavy2, send_trees):
+    np_ = 15 if heavy2 else 14
+    toks = matches(data, 0x1FFF if heavy2 else 0xFFF, 3, 256)
+    def pcode(p):
+        return 0 if p == 0 else p.bit_length()
+    if send_trees:
+        cf = [1]*510; pf = [1]*np_
+        for t in toks:
+            if t[0] == 'l': cf[t[1]] += 1
+            else: cf[t[1] + 253] += 1; pf[pcode(t[2]-1)] += 1
+        st.trees = (huff_lengths(cf), huff_lengths(pf))
+    cl, pl = st.trees
+    cc, pc = canon(cl), canon(pl)
+    w = BW()
+    if send_trees:
+        w.put(510, 9)
+        for l in cl: w.put(l, 5)
+        w.put(np_, 5)
+        for l in pl: w.put(l, 4)
+    for t in toks:
+        if t[0] == 'l': w.put(*cc[t[1]])
+        else:
+            w.put(*cc[t[1] + 253]); p = t[2] - 1; j = pcode(p)
+            w.put(*pc[j])
+            if j > 1: w.put(p - (1 << (j-1)), j-1)
+    return w.data()
+
+def record(num, data, mode, flags, st):
+    if mode == 0: pk, mid = data, len(data)
+    elif mode == 1: pk = rle(data); mid = len(data)
+    elif mode in (2, 3, 4):
+        r = rle(data); mid = len(r)
+        pk = [enc_quick, enc_medium, enc_deep][mode-2](st, r)
+    else:
+        r = rle(data) if flags & 4 else data; mid = len(r)
+        pk = enc_heavy(st, r, mode == 6, bool(flags & 2))
+    if not (flags & 1): st.reset()
+    h = bytearray(b'TR') + struct.pack('>HHHHHBBHH', num, 0, len(pk), mid, len(data), flags, mode,
+                                      sum(data) & 0xFFFF, crc16(pk))
+    h += struct.pack('>H', crc16(h))
+    return bytes(h) + pk
+
+def archive(recs, info=0, to=3):
+    h = bytearray(b'DMS!') + bytes(52)
+    struct.pack_into('>H', h, 10, info)
+    struct.pack_into('>HH', h, 16, 0, to)
+    struct.pack_into('>H', h, 50, 1)
+    struct.pack_into('>H', h, 54, crc16(h[4:54]))
+    return bytes(h) + b''.join(recs)
+
+NCYL = 4
+DISK = 901120
+
+def make_cyls(seed):
+    """Text, zero runs, 0x90 runs (the RLE escape) and noise, per cylinder"""
+    rnd = random.Random(seed); b = bytearray()
+    words = [bytes(rnd.choice(b'abcdefghijklmnop \n') for _ in range(rnd.randint(2, 9))) for _ in range(60)]
+    while len(b) < NCYL * CYL:
+        k = rnd.random()
+        if k < 0.3: b += bytes(rnd.randint(100, 3000))
+        elif k < 0.6: b += b' '.join(rnd.choice(words) for _ in range(rnd.randint(10, 300)))
+        elif k < 0.7: b += bytes([0x90]) * rnd.randint(1, 600)
+        else: b += bytes(rnd.getrandbits(8) for _ in range(rnd.randint(10, 2000)))
+    return bytes(b[:NCYL * CYL])
+
+def image_crc(cyls):
+    """CRC32 of the 901,120-byte image: cyls maps cylinder -> data, rest zeros"""
+    img = bytearray(DISK)
+    for n, data in cyls.items(): img[n*CYL:(n+1)*CYL] = data
+    return '%08x' % (zlib.crc32(bytes(img)) & 0xFFFFFFFF)
+
+if __name__ == '__main__':
+    d = sys.argv[1]
+    src = make_cyls(1)
+    cyl = lambda n: src[n*CYL:(n+1)*CYL]
+    sums = []
+    # Per mode: records 0 and 1 keep the decruncher state for the next one,
+    # 2 and 3 reset it; HEAVY re-sends its trees on all but record 1 and
+    # packs records 1-2 without the RLE pass
+    for mode in range(7):
+        st = State(); recs = []
+        for n in range(NCYL):
+            flags = 1 if n in (0, 1) else 0
+            if mode >= 5:
+                flags |= 2 if n != 1 else 0
+                flags |= 4 if n in (0, 3) else 0
+            recs.append(record(n, cyl(n), mode, flags, st))
+        open(f'{d}/m{mode}.dms', 'wb').write(archive(recs))
+        sums.append(f'm{mode}.dms {image_crc({n: cyl(n) for n in range(NCYL)})}  {dms_names[mode]}')
+    # Banner record, a different mode per cylinder, cylinder 2 missing
+    st = State(); recs = [record(0xFFFF, b'Banner text\n' * 10, 0, 0, State())]
+    for n in (0, 1, 3):
+        recs.append(record(n, cyl(n), (2, 4, 6)[min(n, 2)], 2 | 4, st))
+    open(f'{d}/gap.dms', 'wb').write(archive(recs))
+    sums.append(f'gap.dms {image_crc({0: cyl(0), 1: cyl(1), 3: cyl(3)})}  banner, QUICK/DEEP/HEAVY2, cylinder 2 missing')
+    # Damaged packed data (record CRC) and the encrypted flag
+    bad = bytearray(open(f'{d}/m4.dms', 'rb').read()); bad[56 + 20 + 100] ^= 0x10
+    open(f'{d}/badcrc.dms', 'wb').write(bad)
+    sums.append('badcrc.dms !crc  DEEP, one packed byte flipped')
+    open(f'{d}/crypt.dms', 'wb').write(archive([record(0, cyl(0), 0, 0, State())], info=2))
+    sums.append('crypt.dms !mode  encrypted flag set')
+    with open(f'{d}/SUMS', 'w') as f:
+        f.write('# archive  CRC32 of the unpacked 901,120 bytes, or !error expected  (see mkdms.py)\n')
+        f.write('\n'.join(sums) + '\n')